@@ -2,137 +2,287 @@
 
 #include "../util/rng.h"
 
+#include <algorithm>
 #include <cmath>
 #include <stdexcept>
+#include <vector>
 
-#ifdef __SSE__
-#define USE_INTRINSICS
-#endif
-
-#ifdef USE_INTRINSICS
-#include <xmmintrin.h>
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__x86_64__)
+#include <immintrin.h>
 #endif
 
 namespace algorithms {
 
-HighPassFilter::~HighPassFilter() {
-  delete[] _hKernel;
-  delete[] _vKernel;
+namespace {
+
+/**
+ * Number of columns that are processed together. The ring buffer of the
+ * Direct mode holds VWindowSize() rows of this width for both the data and
+ * the weights, so that it fits in the L2 cache for common window sizes.
+ */
+constexpr size_t kTileWidth = 512;
+
+/**
+ * Weights below this value are considered to be fully flagged in the
+ * Recursive mode, where the weights are normalized to one for unflagged
+ * data. Without this, samples far away from unflagged samples would get
+ * unreliable values from the tails of the filter.
+ */
+constexpr double kMinRecursiveWeight = 1e-4;
+
+void HorizontalScalar(const float* data, const float* weights,
+                      const num_t* kernel, size_t kernelSize, size_t xStart,
+                      size_t xEnd, float* dataOut, float* weightsOut) {
+  for (size_t x = xStart; x != xEnd; ++x) {
+    float d = 0.0f;
+    float w = 0.0f;
+    for (size_t i = 0; i != kernelSize; ++i) {
+      d += kernel[i] * data[x + i];
+      w += kernel[i] * weights[x + i];
+    }
+    dataOut[x] = d;
+    weightsOut[x] = w;
+  }
 }
 
-void HighPassFilter::applyLowPassSimple(const Image2DPtr& image) {
-  // Guassian convolution can be separated in two 1D convolution
-  // because of properties of the 2D Gaussian function.
-  const Image2DPtr temp =
-      Image2D::CreateZeroImagePtr(image->Width(), image->Height());
-  const size_t hKernelMid = _hWindowSize / 2;
-  for (size_t i = 0; i < _hWindowSize; ++i) {
-    const num_t kernelValue = _hKernel[i];
-    const size_t xStart = (i >= hKernelMid) ? 0 : (hKernelMid - i),
-                 xEnd = (i <= hKernelMid)
-                            ? image->Width()
-                            : (image->Width() + hKernelMid > i
-                                   ? (image->Width() - i + hKernelMid)
-                                   : 0);
-    for (unsigned y = 0; y < image->Height(); ++y) {
-      for (unsigned x = xStart; x < xEnd; ++x)
-        temp->AddValue(x, y, image->Value(x + i - hKernelMid, y) * kernelValue);
+void VerticalScalar(const float* const* dataRows,
+                    const float* const* weightRows, const num_t* kernel,
+                    size_t rowCount, size_t xStart, size_t xEnd,
+                    float* output) {
+  for (size_t x = xStart; x != xEnd; ++x) {
+    float d = 0.0f;
+    float w = 0.0f;
+    for (size_t i = 0; i != rowCount; ++i) {
+      d += kernel[i] * dataRows[i][x];
+      w += kernel[i] * weightRows[i][x];
     }
+    output[x] = (w == 0.0f) ? 0.0f : d / w;
   }
+}
 
-  image->SetAll(0.0);
-  const size_t vKernelMid = _vWindowSize / 2;
-  for (size_t i = 0; i < _vWindowSize; ++i) {
-    const num_t kernelValue = _vKernel[i];
-    const size_t yStart = (i >= vKernelMid) ? 0 : (vKernelMid - i),
-                 yEnd = (i <= vKernelMid)
-                            ? image->Height()
-                            : ((image->Height() + vKernelMid > i)
-                                   ? (image->Height() - i + vKernelMid)
-                                   : 0);
-    for (unsigned y = yStart; y < yEnd; ++y) {
-      for (unsigned x = 0; x < image->Width(); ++x)
-        image->AddValue(x, y, temp->Value(x, y + i - vKernelMid) * kernelValue);
+void HorizontalReference(const float* data, const float* weights,
+                         const num_t* kernel, size_t kernelSize, size_t n,
+                         float* dataOut, float* weightsOut) {
+  HorizontalScalar(data, weights, kernel, kernelSize, 0, n, dataOut,
+                   weightsOut);
+}
+
+void VerticalReference(const float* const* dataRows,
+                       const float* const* weightRows, const num_t* kernel,
+                       size_t rowCount, size_t n, float* output) {
+  VerticalScalar(dataRows, weightRows, kernel, rowCount, 0, n, output);
+}
+
+#if defined(__AVX2__) || defined(__x86_64__)
+// The AVX2 and AVX-512 kernels keep the data and weights of 2 vectors of
+// output samples in registers while looping over the taps of the kernel.
+
+__attribute__((target("avx2"))) void HorizontalAVX2(
+    const float* data, const float* weights, const num_t* kernel,
+    size_t kernelSize, size_t n, float* dataOut, float* weightsOut) {
+  size_t x = 0;
+  for (; x + 16 <= n; x += 16) {
+    __m256 d0 = _mm256_setzero_ps(), d1 = _mm256_setzero_ps();
+    __m256 w0 = _mm256_setzero_ps(), w1 = _mm256_setzero_ps();
+    for (size_t i = 0; i != kernelSize; ++i) {
+      const __m256 k = _mm256_set1_ps(kernel[i]);
+      d0 = _mm256_add_ps(d0, _mm256_mul_ps(k, _mm256_loadu_ps(data + x + i)));
+      d1 = _mm256_add_ps(d1,
+                         _mm256_mul_ps(k, _mm256_loadu_ps(data + x + 8 + i)));
+      w0 = _mm256_add_ps(w0,
+                         _mm256_mul_ps(k, _mm256_loadu_ps(weights + x + i)));
+      w1 = _mm256_add_ps(
+          w1, _mm256_mul_ps(k, _mm256_loadu_ps(weights + x + 8 + i)));
     }
+    _mm256_storeu_ps(dataOut + x, d0);
+    _mm256_storeu_ps(dataOut + x + 8, d1);
+    _mm256_storeu_ps(weightsOut + x, w0);
+    _mm256_storeu_ps(weightsOut + x + 8, w1);
   }
+  for (; x + 8 <= n; x += 8) {
+    __m256 d = _mm256_setzero_ps(), w = _mm256_setzero_ps();
+    for (size_t i = 0; i != kernelSize; ++i) {
+      const __m256 k = _mm256_set1_ps(kernel[i]);
+      d = _mm256_add_ps(d, _mm256_mul_ps(k, _mm256_loadu_ps(data + x + i)));
+      w = _mm256_add_ps(w, _mm256_mul_ps(k, _mm256_loadu_ps(weights + x + i)));
+    }
+    _mm256_storeu_ps(dataOut + x, d);
+    _mm256_storeu_ps(weightsOut + x, w);
+  }
+  HorizontalScalar(data, weights, kernel, kernelSize, x, n, dataOut,
+                   weightsOut);
 }
 
-void HighPassFilter::applyLowPassSSE(const Image2DPtr& image) {
-#ifdef USE_INTRINSICS
-  const Image2DPtr temp =
-      Image2D::CreateZeroImagePtr(image->Width(), image->Height());
-  const unsigned hKernelMid = _hWindowSize / 2;
-  for (unsigned i = 0; i < _hWindowSize; ++i) {
-    const num_t k = _hKernel[i];
-    const __m128 k4 = _mm_set_ps(k, k, k, k);
-    unsigned
-        /* xStart is the first column to start writing to. Note that it might be
-         * larger than the width. */
-        xStart = (i >= hKernelMid) ? 0 : (hKernelMid - i),
-        xEnd = (i <= hKernelMid) ? image->Width()
-                                 : (image->Width() + hKernelMid > i
-                                        ? (image->Width() - i + hKernelMid)
-                                        : 0);
-
-    for (unsigned y = 0; y < image->Height(); ++y) {
-      float* tempPtr = temp->ValuePtr(xStart, y);
-      const float* imagePtr = image->ValuePtr(xStart + i - hKernelMid, y);
-
-      unsigned x = xStart;
-      for (; x + 4 < xEnd; x += 4) {
-        const __m128 imageVal = _mm_loadu_ps(imagePtr),
-                     tempVal = _mm_loadu_ps(tempPtr);
-
-        // *tempPtr += k * (*imagePtr);
-        _mm_storeu_ps(tempPtr, _mm_add_ps(tempVal, _mm_mul_ps(imageVal, k4)));
-
-        tempPtr += 4;
-        imagePtr += 4;
-      }
-      for (; x < xEnd; ++x) {
-        *tempPtr += k * (*imagePtr);
-        ++tempPtr;
-        ++imagePtr;
-      }
+__attribute__((target("avx2"))) void VerticalAVX2(
+    const float* const* dataRows, const float* const* weightRows,
+    const num_t* kernel, size_t rowCount, size_t n, float* output) {
+  const __m256 zero = _mm256_setzero_ps();
+  size_t x = 0;
+  for (; x + 16 <= n; x += 16) {
+    __m256 d0 = zero, d1 = zero, w0 = zero, w1 = zero;
+    for (size_t i = 0; i != rowCount; ++i) {
+      const __m256 k = _mm256_set1_ps(kernel[i]);
+      d0 = _mm256_add_ps(d0,
+                         _mm256_mul_ps(k, _mm256_loadu_ps(dataRows[i] + x)));
+      d1 = _mm256_add_ps(
+          d1, _mm256_mul_ps(k, _mm256_loadu_ps(dataRows[i] + x + 8)));
+      w0 = _mm256_add_ps(w0,
+                         _mm256_mul_ps(k, _mm256_loadu_ps(weightRows[i] + x)));
+      w1 = _mm256_add_ps(
+          w1, _mm256_mul_ps(k, _mm256_loadu_ps(weightRows[i] + x + 8)));
+    }
+    // Where the weight is zero, the result is set to zero
+    _mm256_storeu_ps(output + x,
+                     _mm256_andnot_ps(_mm256_cmp_ps(w0, zero, _CMP_EQ_OQ),
+                                      _mm256_div_ps(d0, w0)));
+    _mm256_storeu_ps(output + x + 8,
+                     _mm256_andnot_ps(_mm256_cmp_ps(w1, zero, _CMP_EQ_OQ),
+                                      _mm256_div_ps(d1, w1)));
+  }
+  for (; x + 8 <= n; x += 8) {
+    __m256 d = zero, w = zero;
+    for (size_t i = 0; i != rowCount; ++i) {
+      const __m256 k = _mm256_set1_ps(kernel[i]);
+      d = _mm256_add_ps(d, _mm256_mul_ps(k, _mm256_loadu_ps(dataRows[i] + x)));
+      w = _mm256_add_ps(w,
+                        _mm256_mul_ps(k, _mm256_loadu_ps(weightRows[i] + x)));
     }
+    _mm256_storeu_ps(output + x,
+                     _mm256_andnot_ps(_mm256_cmp_ps(w, zero, _CMP_EQ_OQ),
+                                      _mm256_div_ps(d, w)));
   }
+  VerticalScalar(dataRows, weightRows, kernel, rowCount, x, n, output);
+}
+#endif  // defined(__AVX2__) || defined(__x86_64__)
 
-  image->SetAll(0.0);
-  const unsigned vKernelMid = _vWindowSize / 2;
-  for (unsigned i = 0; i < _vWindowSize; ++i) {
-    const num_t k = _vKernel[i];
-    const __m128 k4 = _mm_set_ps(k, k, k, k);
-    const unsigned yStart = (i >= vKernelMid) ? 0 : (vKernelMid - i),
-                   yEnd = (i <= vKernelMid)
-                              ? image->Height()
-                              : ((image->Height() + vKernelMid > i)
-                                     ? (image->Height() - i + vKernelMid)
-                                     : 0);
-    for (unsigned y = yStart; y < yEnd; ++y) {
-      const float* tempPtr = temp->ValuePtr(0, y + i - vKernelMid);
-      float* imagePtr = image->ValuePtr(0, y);
-
-      unsigned x = 0;
-      for (; x + 4 < image->Width(); x += 4) {
-        const __m128 imageVal = _mm_load_ps(imagePtr),
-                     tempVal = _mm_load_ps(tempPtr);
-
-        // *imagePtr += k * (*tempPtr);
-        _mm_store_ps(imagePtr, _mm_add_ps(imageVal, _mm_mul_ps(tempVal, k4)));
-
-        tempPtr += 4;
-        imagePtr += 4;
-      }
-      for (; x < image->Width(); ++x) {
-        *imagePtr += k * (*tempPtr);
-        ++tempPtr;
-        ++imagePtr;
-      }
+#if defined(__AVX512F__) || defined(__x86_64__)
+__attribute__((target("avx512f"))) void HorizontalAVX512(
+    const float* data, const float* weights, const num_t* kernel,
+    size_t kernelSize, size_t n, float* dataOut, float* weightsOut) {
+  size_t x = 0;
+  for (; x + 32 <= n; x += 32) {
+    __m512 d0 = _mm512_setzero_ps(), d1 = _mm512_setzero_ps();
+    __m512 w0 = _mm512_setzero_ps(), w1 = _mm512_setzero_ps();
+    for (size_t i = 0; i != kernelSize; ++i) {
+      const __m512 k = _mm512_set1_ps(kernel[i]);
+      d0 = _mm512_add_ps(d0, _mm512_mul_ps(k, _mm512_loadu_ps(data + x + i)));
+      d1 = _mm512_add_ps(
+          d1, _mm512_mul_ps(k, _mm512_loadu_ps(data + x + 16 + i)));
+      w0 = _mm512_add_ps(w0,
+                         _mm512_mul_ps(k, _mm512_loadu_ps(weights + x + i)));
+      w1 = _mm512_add_ps(
+          w1, _mm512_mul_ps(k, _mm512_loadu_ps(weights + x + 16 + i)));
     }
+    _mm512_storeu_ps(dataOut + x, d0);
+    _mm512_storeu_ps(dataOut + x + 16, d1);
+    _mm512_storeu_ps(weightsOut + x, w0);
+    _mm512_storeu_ps(weightsOut + x + 16, w1);
   }
-#else
-  throw std::runtime_error("SSE function called without SSE available");
-#endif
+  for (; x + 16 <= n; x += 16) {
+    __m512 d = _mm512_setzero_ps(), w = _mm512_setzero_ps();
+    for (size_t i = 0; i != kernelSize; ++i) {
+      const __m512 k = _mm512_set1_ps(kernel[i]);
+      d = _mm512_add_ps(d, _mm512_mul_ps(k, _mm512_loadu_ps(data + x + i)));
+      w = _mm512_add_ps(w, _mm512_mul_ps(k, _mm512_loadu_ps(weights + x + i)));
+    }
+    _mm512_storeu_ps(dataOut + x, d);
+    _mm512_storeu_ps(weightsOut + x, w);
+  }
+  HorizontalScalar(data, weights, kernel, kernelSize, x, n, dataOut,
+                   weightsOut);
+}
+
+__attribute__((target("avx512f"))) void VerticalAVX512(
+    const float* const* dataRows, const float* const* weightRows,
+    const num_t* kernel, size_t rowCount, size_t n, float* output) {
+  const __m512 zero = _mm512_setzero_ps();
+  size_t x = 0;
+  for (; x + 32 <= n; x += 32) {
+    __m512 d0 = zero, d1 = zero, w0 = zero, w1 = zero;
+    for (size_t i = 0; i != rowCount; ++i) {
+      const __m512 k = _mm512_set1_ps(kernel[i]);
+      d0 = _mm512_add_ps(d0,
+                         _mm512_mul_ps(k, _mm512_loadu_ps(dataRows[i] + x)));
+      d1 = _mm512_add_ps(
+          d1, _mm512_mul_ps(k, _mm512_loadu_ps(dataRows[i] + x + 16)));
+      w0 = _mm512_add_ps(w0,
+                         _mm512_mul_ps(k, _mm512_loadu_ps(weightRows[i] + x)));
+      w1 = _mm512_add_ps(
+          w1, _mm512_mul_ps(k, _mm512_loadu_ps(weightRows[i] + x + 16)));
+    }
+    // Only divide where the weight is not zero; the other values are zeroed
+    const __mmask16 nonZero0 = _mm512_cmp_ps_mask(w0, zero, _CMP_NEQ_UQ);
+    const __mmask16 nonZero1 = _mm512_cmp_ps_mask(w1, zero, _CMP_NEQ_UQ);
+    _mm512_storeu_ps(output + x, _mm512_maskz_div_ps(nonZero0, d0, w0));
+    _mm512_storeu_ps(output + x + 16, _mm512_maskz_div_ps(nonZero1, d1, w1));
+  }
+  for (; x + 16 <= n; x += 16) {
+    __m512 d = zero, w = zero;
+    for (size_t i = 0; i != rowCount; ++i) {
+      const __m512 k = _mm512_set1_ps(kernel[i]);
+      d = _mm512_add_ps(d, _mm512_mul_ps(k, _mm512_loadu_ps(dataRows[i] + x)));
+      w = _mm512_add_ps(w,
+                        _mm512_mul_ps(k, _mm512_loadu_ps(weightRows[i] + x)));
+    }
+    const __mmask16 nonZero = _mm512_cmp_ps_mask(w, zero, _CMP_NEQ_UQ);
+    _mm512_storeu_ps(output + x, _mm512_maskz_div_ps(nonZero, d, w));
+  }
+  VerticalScalar(dataRows, weightRows, kernel, rowCount, x, n, output);
+}
+#endif  // defined(__AVX512F__) || defined(__x86_64__)
+
+/**
+ * Coefficients of the recursive Gaussian filter of Young and van Vliet,
+ * "Recursive implementation of the Gaussian filter", Signal Processing 44
+ * (1995).
+ */
+struct RecursiveCoefficients {
+  explicit RecursiveCoefficients(double sigma) {
+    const double q = (sigma >= 2.5)
+                         ? 0.98711 * sigma - 0.96330
+                         : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+    const double q2 = q * q;
+    const double q3 = q2 * q;
+    const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    a1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+    a2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+    a3 = 0.422205 * q3 / b0;
+    b = 1.0 - (a1 + a2 + a3);
+    // Beyond the end of the data, the input is zero, but the response of the
+    // causal pass is not. It is calculated over this many extra samples, after
+    // which the response has become negligible.
+    padding = static_cast<size_t>(std::ceil(6.0 * sigma)) + 3;
+  }
+  double b, a1, a2, a3;
+  size_t padding;
+};
+
+/**
+ * Filters @p count interleaved series in place: element t of series s is
+ * stored at values[(t + 3) * count + s]. The first and last three "rows" of
+ * @p values are guards that should be zero.
+ */
+void RecursiveGaussian(double* values, size_t length, size_t count,
+                       const RecursiveCoefficients& c) {
+  for (size_t t = 3; t != length + 3; ++t) {
+    double* row = &values[t * count];
+    for (size_t s = 0; s != count; ++s)
+      row[s] = c.b * row[s] + c.a1 * row[s - count] +
+               c.a2 * row[s - 2 * count] + c.a3 * row[s - 3 * count];
+  }
+  for (size_t t = length + 2; t != 2; --t) {
+    double* row = &values[t * count];
+    for (size_t s = 0; s != count; ++s)
+      row[s] = c.b * row[s] + c.a1 * row[s + count] +
+               c.a2 * row[s + 2 * count] + c.a3 * row[s + 3 * count];
+  }
+}
+
+}  // namespace
+
+HighPassFilter::~HighPassFilter() {
+  delete[] _hKernel;
+  delete[] _vKernel;
 }
 
 Image2DPtr HighPassFilter::ApplyHighPass(const Image2DCPtr& image,
@@ -144,19 +294,151 @@ Image2DPtr HighPassFilter::ApplyHighPass(const Image2DCPtr& image,
 
 Image2DPtr HighPassFilter::ApplyLowPass(const Image2DCPtr& image,
                                         const Mask2DCPtr& mask) {
-  initializeKernel();
   Image2DPtr outputImage =
-                 Image2D::CreateUnsetImagePtr(image->Width(), image->Height()),
-             weights =
-                 Image2D::CreateUnsetImagePtr(image->Width(), image->Height());
-  setFlaggedValuesToZeroAndMakeWeights(image, outputImage, mask, weights);
-  applyLowPass(outputImage);
-  applyLowPass(weights);
-  elementWiseDivide(outputImage, weights);
-  weights.reset();
+      Image2D::CreateUnsetImagePtr(image->Width(), image->Height());
+  if (_mode == Mode::Recursive && _hKernelSigmaSq >= 0.25 &&
+      _vKernelSigmaSq >= 0.25) {
+    applyLowPassRecursive(*image, *mask, *outputImage);
+  } else {
+    initializeKernel();
+    applyLowPassDirect(*image, *mask, *outputImage);
+  }
   return outputImage;
 }
 
+void HighPassFilter::applyLowPassDirect(const Image2D& image,
+                                        const Mask2D& mask, Image2D& output) {
+  // Guassian convolution can be separated in two 1D convolutions
+  // because of properties of the 2D Gaussian function. The image is
+  // processed in tiles of columns. For every row of a tile, the row is
+  // convolved horizontally into a ring buffer, after which the row that
+  // now has all its vertical neighbours in the ring buffer is convolved
+  // vertically.
+  const Kernels& kernels = kernelsFor(_isa);
+  const size_t width = image.Width();
+  const size_t height = image.Height();
+  const size_t hMid = _hWindowSize / 2;
+  const size_t vMid = _vWindowSize / 2;
+  const size_t tileWidth = std::min(width, kTileWidth);
+  std::vector<float> paddedData(tileWidth + 2 * hMid);
+  std::vector<float> paddedWeights(tileWidth + 2 * hMid);
+  std::vector<float> ringData(_vWindowSize * tileWidth);
+  std::vector<float> ringWeights(_vWindowSize * tileWidth);
+  std::vector<const float*> dataRows(_vWindowSize);
+  std::vector<const float*> weightRows(_vWindowSize);
+
+  for (size_t x0 = 0; x0 < width; x0 += tileWidth) {
+    const size_t n = std::min(tileWidth, width - x0);
+    // Padded sample i corresponds with column x0 + i - hMid. Columns
+    // outside the image have a weight of zero.
+    const size_t segmentSize = n + 2 * hMid;
+    const size_t begin = std::max(x0, hMid) - hMid;
+    const size_t end = std::min(width, x0 + n + hMid);
+    const size_t beginIndex = begin + hMid - x0;
+    const size_t endIndex = end + hMid - x0;
+    std::fill_n(paddedData.begin(), beginIndex, 0.0f);
+    std::fill_n(paddedWeights.begin(), beginIndex, 0.0f);
+    std::fill(paddedData.begin() + endIndex,
+              paddedData.begin() + segmentSize, 0.0f);
+    std::fill(paddedWeights.begin() + endIndex,
+              paddedWeights.begin() + segmentSize, 0.0f);
+
+    for (size_t y = 0; y != height + vMid; ++y) {
+      if (y < height) {
+        const float* input = image.ValuePtr(begin, y);
+        const bool* flags = mask.ValuePtr(begin, y);
+        float* dataPtr = &paddedData[beginIndex];
+        float* weightPtr = &paddedWeights[beginIndex];
+        for (size_t i = 0; i != end - begin; ++i) {
+          const bool isValid = !flags[i] && std::isfinite(input[i]);
+          dataPtr[i] = isValid ? input[i] : 0.0f;
+          weightPtr[i] = isValid ? 1.0f : 0.0f;
+        }
+        const size_t ringIndex = (y % _vWindowSize) * tileWidth;
+        kernels.horizontal(paddedData.data(), paddedWeights.data(), _hKernel,
+                           _hWindowSize, n, &ringData[ringIndex],
+                           &ringWeights[ringIndex]);
+      }
+      if (y >= vMid) {
+        const size_t outY = y - vMid;
+        const size_t iStart = (outY < vMid) ? (vMid - outY) : 0;
+        const size_t iEnd =
+            std::min<size_t>(_vWindowSize, height + vMid - outY);
+        for (size_t i = iStart; i != iEnd; ++i) {
+          const size_t ringIndex =
+              ((outY + i - vMid) % _vWindowSize) * tileWidth;
+          dataRows[i - iStart] = &ringData[ringIndex];
+          weightRows[i - iStart] = &ringWeights[ringIndex];
+        }
+        kernels.vertical(dataRows.data(), weightRows.data(), _vKernel + iStart,
+                         iEnd - iStart, n, output.ValuePtr(x0, outY));
+      }
+    }
+  }
+}
+
+void HighPassFilter::applyLowPassRecursive(const Image2D& image,
+                                           const Mask2D& mask,
+                                           Image2D& output) {
+  const size_t width = image.Width();
+  const size_t height = image.Height();
+  const RecursiveCoefficients hCoefficients(std::sqrt(_hKernelSigmaSq));
+  const RecursiveCoefficients vCoefficients(std::sqrt(_vKernelSigmaSq));
+
+  // Horizontal pass, per row
+  const Image2DPtr hData = Image2D::CreateUnsetImagePtr(width, height);
+  const Image2DPtr hWeights = Image2D::CreateUnsetImagePtr(width, height);
+  const size_t rowLength = width + hCoefficients.padding;
+  std::vector<double> rowData(rowLength + 6);
+  std::vector<double> rowWeights(rowLength + 6);
+  for (size_t y = 0; y != height; ++y) {
+    const float* input = image.ValuePtr(0, y);
+    const bool* flags = mask.ValuePtr(0, y);
+    std::fill(rowData.begin(), rowData.end(), 0.0);
+    std::fill(rowWeights.begin(), rowWeights.end(), 0.0);
+    for (size_t x = 0; x != width; ++x) {
+      if (!flags[x] && std::isfinite(input[x])) {
+        rowData[x + 3] = input[x];
+        rowWeights[x + 3] = 1.0;
+      }
+    }
+    RecursiveGaussian(rowData.data(), rowLength, 1, hCoefficients);
+    RecursiveGaussian(rowWeights.data(), rowLength, 1, hCoefficients);
+    float* dataOut = hData->ValuePtr(0, y);
+    float* weightsOut = hWeights->ValuePtr(0, y);
+    for (size_t x = 0; x != width; ++x) {
+      dataOut[x] = rowData[x + 3];
+      weightsOut[x] = rowWeights[x + 3];
+    }
+  }
+
+  // Vertical pass, on tiles of columns at the same time
+  const size_t tileWidth = std::min(width, kTileWidth);
+  const size_t columnLength = height + vCoefficients.padding;
+  std::vector<double> tileData((columnLength + 6) * tileWidth);
+  std::vector<double> tileWeights((columnLength + 6) * tileWidth);
+  for (size_t x0 = 0; x0 < width; x0 += tileWidth) {
+    const size_t n = std::min(tileWidth, width - x0);
+    std::fill(tileData.begin(), tileData.end(), 0.0);
+    std::fill(tileWeights.begin(), tileWeights.end(), 0.0);
+    for (size_t y = 0; y != height; ++y) {
+      std::copy_n(hData->ValuePtr(x0, y), n, &tileData[(y + 3) * n]);
+      std::copy_n(hWeights->ValuePtr(x0, y), n, &tileWeights[(y + 3) * n]);
+    }
+    RecursiveGaussian(tileData.data(), columnLength, n, vCoefficients);
+    RecursiveGaussian(tileWeights.data(), columnLength, n, vCoefficients);
+    for (size_t y = 0; y != height; ++y) {
+      const double* data = &tileData[(y + 3) * n];
+      const double* weights = &tileWeights[(y + 3) * n];
+      float* outputPtr = output.ValuePtr(x0, y);
+      for (size_t x = 0; x != n; ++x)
+        outputPtr[x] = (weights[x] < kMinRecursiveWeight)
+                           ? 0.0f
+                           : static_cast<float>(data[x] / weights[x]);
+    }
+  }
+}
+
 void HighPassFilter::initializeKernel() {
   if (_hKernel == nullptr) {
     _hKernel = new num_t[_hWindowSize];
@@ -175,99 +457,79 @@ void HighPassFilter::initializeKernel() {
   }
 }
 
-void HighPassFilter::setFlaggedValuesToZeroAndMakeWeightsSimple(
-    const Image2DCPtr& inputImage, const Image2DPtr& outputImage,
-    const Mask2DCPtr& inputMask, const Image2DPtr& weightsOutput) {
-  const size_t width = inputImage->Width();
-  for (size_t y = 0; y < inputImage->Height(); ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      if (inputMask->Value(x, y) || !std::isfinite(inputImage->Value(x, y))) {
-        outputImage->SetValue(x, y, 0.0);
-        weightsOutput->SetValue(x, y, 0.0);
-      } else {
-        outputImage->SetValue(x, y, inputImage->Value(x, y));
-        weightsOutput->SetValue(x, y, 1.0);
-      }
-    }
-  }
+void HighPassFilter::SetIsa(Isa isa) {
+  if (!IsSupported(isa))
+    throw std::runtime_error("High-pass filter kernels for " + IsaName(isa) +
+                             " are not supported on this machine");
+  _isa = isa;
 }
 
-void HighPassFilter::setFlaggedValuesToZeroAndMakeWeightsSSE(
-    const Image2DCPtr& inputImage, const Image2DPtr& outputImage,
-    const Mask2DCPtr& inputMask, const Image2DPtr& weightsOutput) {
-#ifdef USE_INTRINSICS
-  const size_t width = inputImage->Width();
-  const __m128i zero4i = _mm_set_epi32(0, 0, 0, 0);
-  const __m128 zero4 = _mm_set_ps(0.0, 0.0, 0.0, 0.0);
-  const __m128 one4 = _mm_set_ps(1.0, 1.0, 1.0, 1.0);
-  for (size_t y = 0; y < inputImage->Height(); ++y) {
-    const bool* rowPtr = inputMask->ValuePtr(0, y);
-    const float* inputPtr = inputImage->ValuePtr(0, y);
-    float* outputPtr = outputImage->ValuePtr(0, y);
-    float* weightsPtr = weightsOutput->ValuePtr(0, y);
-    const float* end = inputPtr + width;
-    while (inputPtr < end) {
-      // Assign each integer to one bool in the mask
-      // Convert false to 0xFFFFFFFF and true to 0
-      const __m128 conditionMask = _mm_castsi128_ps(_mm_cmpeq_epi32(
-          _mm_set_epi32(rowPtr[3] || !std::isfinite(inputPtr[3]),
-                        rowPtr[2] || !std::isfinite(inputPtr[2]),
-                        rowPtr[1] || !std::isfinite(inputPtr[1]),
-                        rowPtr[0] || !std::isfinite(inputPtr[0])),
-          zero4i));
-
-      _mm_store_ps(weightsPtr, _mm_or_ps(_mm_and_ps(conditionMask, one4),
-                                         _mm_andnot_ps(conditionMask, zero4)));
-      _mm_store_ps(outputPtr,
-                   _mm_or_ps(_mm_and_ps(conditionMask, _mm_load_ps(inputPtr)),
-                             _mm_andnot_ps(conditionMask, zero4)));
-
-      rowPtr += 4;
-      outputPtr += 4;
-      inputPtr += 4;
-      weightsPtr += 4;
+const HighPassFilter::Kernels& HighPassFilter::kernelsFor(Isa isa) {
+  static const Kernels reference{&HorizontalReference, &VerticalReference};
+  switch (isa) {
+    case Isa::Reference:
+      return reference;
+    case Isa::AVX2: {
+#if defined(__AVX2__) || defined(__x86_64__)
+      static const Kernels avx2{&HorizontalAVX2, &VerticalAVX2};
+      return avx2;
+#else
+      break;
+#endif
+    }
+    case Isa::AVX512: {
+#if defined(__AVX512F__) || defined(__x86_64__)
+      static const Kernels avx512{&HorizontalAVX512, &VerticalAVX512};
+      return avx512;
+#else
+      break;
+#endif
     }
   }
+  throw std::runtime_error("High-pass filter kernels for " + IsaName(isa) +
+                           " are not available in this build");
+}
+
+bool HighPassFilter::IsSupported(Isa isa) {
+  switch (isa) {
+    case Isa::Reference:
+      return true;
+    case Isa::AVX2:
+#if defined(__AVX2__) || defined(__x86_64__)
+      return __builtin_cpu_supports("avx2");
+#else
+      return false;
+#endif
+    case Isa::AVX512:
+#if defined(__AVX512F__) || defined(__x86_64__)
+      return __builtin_cpu_supports("avx512f");
 #else
-  throw std::runtime_error("SSE function called without SSE available");
+      return false;
 #endif
+  }
+  return false;
 }
 
-void HighPassFilter::elementWiseDivideSimple(const Image2DPtr& leftHand,
-                                             const Image2DCPtr& rightHand) {
-  for (unsigned y = 0; y < leftHand->Height(); ++y) {
-    for (unsigned x = 0; x < leftHand->Width(); ++x) {
-      if (rightHand->Value(x, y) == 0.0)
-        leftHand->SetValue(x, y, 0.0);
-      else
-        leftHand->SetValue(x, y,
-                           leftHand->Value(x, y) / rightHand->Value(x, y));
-    }
+HighPassFilter::Isa HighPassFilter::BestSupportedIsa() {
+  // AVX2 is preferred: most of the loads of the convolution are unaligned,
+  // and with 64-byte vectors nearly all of them cross a cache line, which
+  // made the AVX-512 kernels slower than the AVX2 kernels in benchmarks.
+  for (Isa isa : {Isa::AVX2, Isa::AVX512}) {
+    if (IsSupported(isa)) return isa;
   }
+  return Isa::Reference;
 }
 
-void HighPassFilter::elementWiseDivideSSE(const Image2DPtr& leftHand,
-                                          const Image2DCPtr& rightHand) {
-#ifdef USE_INTRINSICS
-  const __m128 zero4 = _mm_set_ps(0.0, 0.0, 0.0, 0.0);
-
-  for (unsigned y = 0; y < leftHand->Height(); ++y) {
-    float* leftHandPtr = leftHand->ValuePtr(0, y);
-    const float* rightHandPtr = rightHand->ValuePtr(0, y);
-    float* end = leftHandPtr + leftHand->Width();
-    while (leftHandPtr < end) {
-      __m128 l = _mm_load_ps(leftHandPtr), r = _mm_load_ps(rightHandPtr);
-      const __m128 conditionMask = _mm_cmpeq_ps(r, zero4);
-      _mm_store_ps(leftHandPtr,
-                   _mm_or_ps(_mm_and_ps(conditionMask, zero4),
-                             _mm_andnot_ps(conditionMask, _mm_div_ps(l, r))));
-      leftHandPtr += 4;
-      rightHandPtr += 4;
-    }
+std::string HighPassFilter::IsaName(Isa isa) {
+  switch (isa) {
+    case Isa::Reference:
+      return "reference";
+    case Isa::AVX2:
+      return "AVX2";
+    case Isa::AVX512:
+      return "AVX-512";
   }
-#else
-  throw std::runtime_error("SSE function called without SSE available");
-#endif
+  return "unknown";
 }
 
 }  // namespace algorithms
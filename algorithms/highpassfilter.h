@@ -4,18 +4,49 @@
 #include "../structures/image2d.h"
 #include "../structures/mask2d.h"
 
-#ifdef __SSE__
-#define USE_INTRINSICS
-#endif
+#include <cstddef>
+#include <string>
 
 namespace algorithms {
 
 /**
  * This class is able to perform a Gaussian high pass filter on an
  * Image2D .
+ *
+ * Flagged samples are ignored by convolving both the image (with flagged
+ * samples set to zero) and a weight image (one for unflagged samples) with
+ * the kernel, and dividing the two. Both convolutions are done together in
+ * a single pass over the image: the image is processed in tiles of columns,
+ * and the rows of the horizontally convolved tile are kept in a small ring
+ * buffer from which the vertical convolution is calculated, so that the
+ * intermediate results stay in the cache.
  */
 class HighPassFilter {
  public:
+  /**
+   * How the Gaussian convolution is calculated.
+   */
+  enum class Mode {
+    /**
+     * Convolution with the kernel, truncated to the window sizes.
+     */
+    Direct,
+    /**
+     * Approximation of the Gaussian with a recursive (IIR) filter by Young
+     * and van Vliet (1995). Its cost does not depend on the size of the
+     * kernel, which makes it faster for large kernels. The window sizes are
+     * ignored in this mode, and small differences with the Direct mode occur.
+     * The Direct mode is used when one of the sigmas is below 0.5, for which
+     * the approximation is not valid.
+     */
+    Recursive
+  };
+
+  /**
+   * Instruction set of the kernels of the Direct mode.
+   */
+  enum class Isa { Reference, AVX2, AVX512 };
+
   /**
    * Construct a new high pass filter with default parameters
    */
@@ -25,10 +56,15 @@ class HighPassFilter {
         _hKernelSigmaSq(7.5),
         _vKernel(nullptr),
         _vWindowSize(45),
-        _vKernelSigmaSq(15.0) {}
+        _vKernelSigmaSq(15.0),
+        _mode(Mode::Direct),
+        _isa(BestSupportedIsa()) {}
 
   ~HighPassFilter();
 
+  HighPassFilter(const HighPassFilter&) = delete;
+  HighPassFilter& operator=(const HighPassFilter&) = delete;
+
   /**
    * Apply a Gaussian high pass filter on the given image.
    */
@@ -127,55 +163,59 @@ class HighPassFilter {
     _vKernelSigmaSq = newSigmaSquared;
   }
 
+  Mode GetMode() const { return _mode; }
+
+  void SetMode(Mode mode) { _mode = mode; }
+
+  Isa GetIsa() const { return _isa; }
+
+  /**
+   * Selects the instruction set of the Direct mode, e.g. to compare or
+   * benchmark the implementations. By default, BestSupportedIsa() is used.
+   * @throws std::runtime_error if the CPU does not support @p isa.
+   */
+  void SetIsa(Isa isa);
+
+  /**
+   * Whether the binary contains kernels for the given instruction set and
+   * the CPU supports them.
+   */
+  static bool IsSupported(Isa isa);
+
+  static Isa BestSupportedIsa();
+
+  static std::string IsaName(Isa isa);
+
  private:
   /**
-   * Applies the low-pass convolution. Kernel has to be initialized
-   * before calling.
+   * Convolves @p n samples horizontally. @p data and @p weights point to
+   * the sample at the left edge of the window of the first output sample,
+   * and hold n + kernelSize - 1 samples.
    */
-  void applyLowPass(const Image2DPtr& image) {
-#ifdef USE_INTRINSICS
-    applyLowPassSSE(image);
-#else
-    applyLowPassSimple(image);
-#endif
-  }
-  void applyLowPassSimple(const Image2DPtr& image);
-  void applyLowPassSSE(const Image2DPtr& image);
+  using HorizontalKernel = void (*)(const float* data, const float* weights,
+                                    const num_t* kernel, size_t kernelSize,
+                                    size_t n, float* dataOut,
+                                    float* weightsOut);
+  /**
+   * Convolves @p n samples vertically and divides the data by the weights.
+   * Row i of @p dataRows and @p weightRows is multiplied with kernel[i].
+   */
+  using VerticalKernel = void (*)(const float* const* dataRows,
+                                  const float* const* weightRows,
+                                  const num_t* kernel, size_t rowCount,
+                                  size_t n, float* output);
+  struct Kernels {
+    HorizontalKernel horizontal;
+    VerticalKernel vertical;
+  };
+  static const Kernels& kernelsFor(Isa isa);
 
-  void initializeKernel();
+  void applyLowPassDirect(const Image2D& image, const Mask2D& mask,
+                          Image2D& output);
+  void applyLowPassRecursive(const Image2D& image, const Mask2D& mask,
+                             Image2D& output);
 
-  void setFlaggedValuesToZeroAndMakeWeights(const Image2DCPtr& inputImage,
-                                            const Image2DPtr& outputImage,
-                                            const Mask2DCPtr& inputMask,
-                                            const Image2DPtr& weightsOutput) {
-#ifdef USE_INTRINSICS
-    setFlaggedValuesToZeroAndMakeWeightsSSE(inputImage, outputImage, inputMask,
-                                            weightsOutput);
-#else
-    setFlaggedValuesToZeroAndMakeWeightsSimple(inputImage, outputImage,
-                                               inputMask, weightsOutput);
-#endif
-  }
-  void setFlaggedValuesToZeroAndMakeWeightsSimple(
-      const Image2DCPtr& inputImage, const Image2DPtr& outputImage,
-      const Mask2DCPtr& inputMask, const Image2DPtr& weightsOutput);
-  void setFlaggedValuesToZeroAndMakeWeightsSSE(const Image2DCPtr& inputImage,
-                                               const Image2DPtr& outputImage,
-                                               const Mask2DCPtr& inputMask,
-                                               const Image2DPtr& weightsOutput);
-
-  void elementWiseDivide(const Image2DPtr& leftHand,
-                         const Image2DCPtr& rightHand) {
-#ifdef USE_INTRINSICS
-    elementWiseDivideSSE(leftHand, rightHand);
-#else
-    elementWiseDivideSimple(leftHand, rightHand);
-#endif
-  }
-  void elementWiseDivideSimple(const Image2DPtr& leftHand,
-                               const Image2DCPtr& rightHand);
-  void elementWiseDivideSSE(const Image2DPtr& leftHand,
-                            const Image2DCPtr& rightHand);
+  void initializeKernel();
 
   /**
    * The values of the kernel used in the convolution. This kernel is applied
@@ -212,10 +252,11 @@ class HighPassFilter {
    * @ref _hKernelSize.
    */
   double _vKernelSigmaSq;
+
+  Mode _mode;
+  Isa _isa;
 };
 
 }  // namespace algorithms
 
-#undef USE_INTRINSICS
-
 #endif  // HIGHPASS_FILTER_H
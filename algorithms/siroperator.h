@@ -1,8 +1,10 @@
 #ifndef SIROPERATOR_H
 #define SIROPERATOR_H
 
+#include <cstring>
 #include <memory>
 
+#include "../structures/bitmask2d.h"
 #include "../structures/mask2d.h"
 #include "../structures/types.h"
 #include "../structures/xyswappedmask2d.h"
@@ -126,6 +128,14 @@ class SIROperator {
     operateHorizontally(mask, eta);
   }
 
+  /**
+   * Like OperateHorizontally(Mask2D&, num_t), but for a bit-packed mask.
+   * Rows without flags are recognized a word at a time and skipped.
+   */
+  static void OperateHorizontally(BitMask2D& mask, num_t eta) {
+    operateHorizontally(mask, eta);
+  }
+
   /**
    * Performs a horizontal dilation directly on a mask, with missing value.
    * Missing values are values for which it is not know they should have
@@ -172,6 +182,14 @@ class SIROperator {
     operateHorizontally<XYSwappedMask2D<Mask2D>>(swappedMask, eta);
   }
 
+  /**
+   * Like OperateVertically(Mask2D&, num_t), but for a bit-packed mask.
+   */
+  static void OperateVertically(BitMask2D& mask, num_t eta) {
+    XYSwappedMask2D<BitMask2D> swappedMask(mask);
+    operateHorizontally<XYSwappedMask2D<BitMask2D>>(swappedMask, eta);
+  }
+
   /**
    * Performs a vertical dilation directly on a mask, with missing value.
    * Identical to @ref OperateHorizontallyMissing(), but then vertically.
@@ -198,6 +216,24 @@ class SIROperator {
  private:
   SIROperator() = delete;
 
+  template <typename MaskLike>
+  static bool rowHasFlags(const MaskLike& mask, unsigned row) {
+    for (unsigned i = 0; i != mask.Width(); ++i)
+      if (mask.Value(i, row)) return true;
+    return false;
+  }
+
+  static bool rowHasFlags(const Mask2D& mask, unsigned row) {
+    return std::memchr(mask.ValuePtr(0, row), true, mask.Width()) != nullptr;
+  }
+
+  static bool rowHasFlags(const BitMask2D& mask, unsigned row) {
+    const BitMask2D::Word* words = mask.RowPtr(row);
+    for (size_t i = 0; i != mask.WordsPerRow(); ++i)
+      if (words[i] != 0) return true;
+    return false;
+  }
+
   /**
    * Performs a horizontal dilation directly on a mask. Algorithm is equal to
    * Operate(). This is the implementation.
@@ -214,6 +250,10 @@ class SIROperator {
         maxIndices(new unsigned[wSize]);
 
     for (unsigned row = 0; row < mask.Height(); ++row) {
+      // With η < 1, every subsequence of a row without flags has a flagged
+      // ratio below η, so the row stays unflagged. This is the common case.
+      if (eta < 1.0 && !rowHasFlags(mask, row)) continue;
+
       for (unsigned i = 0; i < width; ++i) {
         if (mask.Value(i, row))
           values[i] = eta;
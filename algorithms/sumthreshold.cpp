@@ -4,8 +4,14 @@
 
 #include "../util/logger.h"
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/align/aligned_alloc.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
 #if defined(__SSE__) || defined(__x86_64__)
 
 #include <stdint.h>
@@ -1627,4 +1633,625 @@ template void SumThreshold::HorizontalAVXDumas<256>(const Image2D* input,
 
 #endif  // defined(__AVX2__) || defined(__x86_64__)
 
+#if defined(__AVX512F__) || defined(__x86_64__)
+
+namespace {
+
+/**
+ * Returns a bit for each of the 16 mask values at @p values that is set when
+ * the value is not flagged. Only the values selected by @p lanes are read.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl"))) inline __mmask16
+UnflaggedLanes(const bool* values, __mmask16 lanes) {
+  const __m128i values_m128i = _mm_maskz_loadu_epi8(lanes, values);
+  return _mm_mask_testn_epi8_mask(lanes, values_m128i, values_m128i);
+}
+
+/**
+ * Same as _mm512_cvtepi32_ps(), but written such that gcc 12 does not emit a
+ * false "may be used uninitialized" warning for _mm512_undefined_ps().
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl"))) inline __m512
+CountToFloat(__m512i count) {
+  return _mm512_maskz_cvtepi32_ps(0xFFFF, count);
+}
+
+/**
+ * Selects the first @p n lanes, or all 16 if n >= 16.
+ */
+inline __mmask16 FirstLanes(int n) {
+  return n >= 16 ? 0xFFFF : (1u << n) - 1u;
+}
+
+/**
+ * Implements values[i] |= lanes[i] for 16 consecutive mask values.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl"))) inline void FlagLanes(
+    bool* values, __mmask16 lanes) {
+  _mm_mask_storeu_epi8(values, lanes, _mm_set1_epi8(1));
+}
+
+/**
+ * Like UnflaggedLanes(), but for 16 mask values that are gathered with the
+ * given byte offsets. Each gathered dword holds the requested value in the
+ * byte selected by @p bytes.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl"))) inline __mmask16
+GatherUnflaggedLanes(const bool* values, __m512i offsets, __m512i bytes) {
+  const __m512i values_m512i = _mm512_mask_i32gather_epi32(
+      _mm512_setzero_si512(), 0xFFFF, offsets, values, 1);
+  return _mm512_testn_epi32_mask(values_m512i, bytes);
+}
+
+/**
+ * Gathers 16 values with the given indices. Lanes that are not selected are
+ * not read and set to zero.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl"))) inline __m512 GatherLanes(
+    const float* values, __m512i indices, __mmask16 lanes) {
+  return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), lanes, indices, values,
+                                  4);
+}
+
+template <size_t Length>
+void HorizontalDumasRows(const Image2D* input, Mask2D* mask, num_t threshold,
+                         int startRow, int endRow) {
+  for (int iRow = startRow; iRow < endRow; ++iRow) {
+    int lastFlaggedPos = -1;
+    num_t sum = 0;
+    int count = 0;
+
+    // Do prefix sum and count
+    for (int maxCol = 0; maxCol < (int)Length - 1; ++maxCol) {
+      sum += input->Value(maxCol, iRow) * !mask->Value(maxCol, iRow);
+      count += !mask->Value(maxCol, iRow);
+    }
+
+    // Iterate through positions
+    for (int maxCol = (int)Length - 1; maxCol < (int)mask->Width(); ++maxCol) {
+      const int minCol = maxCol - (int)Length + 1;
+
+      // add the sample at the right
+      sum += input->Value(maxCol, iRow) * !mask->Value(maxCol, iRow);
+      count += !mask->Value(maxCol, iRow);
+
+      // Check current pos
+      lastFlaggedPos +=
+          int(std::fabs(sum) > count * threshold) * (maxCol - lastFlaggedPos);
+
+      // subtract the sample at the left
+      sum -= input->Value(minCol, iRow) * !mask->Value(minCol, iRow);
+      count -= !mask->Value(minCol, iRow);
+
+      // Flag left edge
+      *mask->ValuePtr(minCol, iRow) |= (lastFlaggedPos >= minCol);
+    }
+
+    // Flag last window
+    for (int minCol = (int)mask->Width() - (int)Length + 1;
+         minCol < (int)mask->Width(); ++minCol) {
+      *mask->ValuePtr(minCol, iRow) |= (lastFlaggedPos >= minCol);
+    }
+  }
+}
+
+}  // namespace
+
+template <size_t Length>
+__attribute__((target("avx512f,avx512bw,avx512vl"))) void
+SumThreshold::VerticalAVX512Dumas(const Image2D* input, Mask2D* mask,
+                                  VerticalScratch* scratch, num_t threshold) {
+  if (Length <= mask->Height()) {
+    int* lastFlaggedPos = scratch->lastFlaggedPos.get();
+    num_t* sum = scratch->sum.get();
+    int* count = scratch->count.get();
+    const int width = mask->Width();
+
+    std::fill(lastFlaggedPos, lastFlaggedPos + width, -1);
+    std::fill(sum, sum + width, 0);
+    std::fill(count, count + width, 0);
+
+    // Unlike the AVX2 version, there is no scalar remainder: the last,
+    // partial vector of a row is handled with a lane mask, which also
+    // prevents reading past the end of the rows.
+    constexpr int vectorWidth = 16;
+    const __m512 threshold_m512 = _mm512_set1_ps(threshold);
+    const __m512i one_m512i = _mm512_set1_epi32(1);
+
+    // Set sum and count for initial window position
+    for (int maxRow = 0; maxRow < (int)Length - 1; ++maxRow) {
+      for (int iCol = 0; iCol < width; iCol += vectorWidth) {
+        const __mmask16 lanes = FirstLanes(width - iCol);
+        const __mmask16 unflagged =
+            UnflaggedLanes(mask->ValuePtr(iCol, maxRow), lanes);
+        const __m512 input_m512 =
+            _mm512_maskz_loadu_ps(unflagged, input->ValuePtr(iCol, maxRow));
+        const __m512 sum_m512 = _mm512_add_ps(
+            _mm512_maskz_load_ps(lanes, &sum[iCol]), input_m512);
+        const __m512i count_m512i =
+            _mm512_maskz_load_epi32(lanes, &count[iCol]);
+        _mm512_mask_store_epi32(
+            &count[iCol], lanes,
+            _mm512_mask_add_epi32(count_m512i, unflagged, count_m512i,
+                                  one_m512i));
+        _mm512_mask_store_ps(&sum[iCol], lanes, sum_m512);
+      }
+    }
+
+    // Iterate through positions
+    for (int maxRow = (int)Length - 1; maxRow < (int)mask->Height(); ++maxRow) {
+      const int minRow = maxRow - (int)Length + 1;
+      const __m512i maxRow_m512i = _mm512_set1_epi32(maxRow);
+      const __m512i minRowt1_m512i = _mm512_set1_epi32(minRow - 1);
+
+      for (int iCol = 0; iCol < width; iCol += vectorWidth) {
+        const __mmask16 lanes = FirstLanes(width - iCol);
+        __m512 sum_m512 = _mm512_maskz_load_ps(lanes, &sum[iCol]);
+        __m512i count_m512i = _mm512_maskz_load_epi32(lanes, &count[iCol]);
+
+        /*
+         * Implements:
+         *    sum(iCol) += input(maxRow, iCol) * !mask(maxRow, iCol);
+         *    count(iCol) += !mask(maxRow, iCol);
+         */
+        const __mmask16 addLanes =
+            UnflaggedLanes(mask->ValuePtr(iCol, maxRow), lanes);
+        sum_m512 = _mm512_add_ps(
+            sum_m512,
+            _mm512_maskz_loadu_ps(addLanes, input->ValuePtr(iCol, maxRow)));
+        count_m512i = _mm512_mask_add_epi32(count_m512i, addLanes, count_m512i,
+                                            one_m512i);
+
+        /*
+         * Implements:
+         * if (abs(sum(iCol)) > count(iCol) * threshold)
+         *    lastFlaggedPos(iCol) = maxRow;
+         */
+        const __mmask16 exceeds = _mm512_cmp_ps_mask(
+            _mm512_abs_ps(sum_m512),
+            _mm512_mul_ps(threshold_m512, CountToFloat(count_m512i)),
+            _CMP_GT_OQ);
+        const __m512i lastFlaggedPos_m512i = _mm512_mask_mov_epi32(
+            _mm512_maskz_load_epi32(lanes, &lastFlaggedPos[iCol]), exceeds,
+            maxRow_m512i);
+        _mm512_mask_store_epi32(&lastFlaggedPos[iCol], lanes,
+                                lastFlaggedPos_m512i);
+
+        /*
+         * Implements:
+         *    sum(iCol) -= input(minRow, iCol) * !mask(minRow, iCol);
+         *    count(iCol) -= !mask(minRow, iCol);
+         */
+        const __mmask16 subLanes =
+            UnflaggedLanes(mask->ValuePtr(iCol, minRow), lanes);
+        sum_m512 = _mm512_sub_ps(
+            sum_m512,
+            _mm512_maskz_loadu_ps(subLanes, input->ValuePtr(iCol, minRow)));
+        count_m512i = _mm512_mask_sub_epi32(count_m512i, subLanes, count_m512i,
+                                            one_m512i);
+
+        _mm512_mask_store_ps(&sum[iCol], lanes, sum_m512);
+        _mm512_mask_store_epi32(&count[iCol], lanes, count_m512i);
+
+        /*
+         * Implements:
+         * mask(minRow, iCol) |= (lastFlaggedPos(iCol) > minRow - 1);
+         */
+        FlagLanes(mask->ValuePtr(iCol, minRow),
+                  _mm512_mask_cmpgt_epi32_mask(lanes, lastFlaggedPos_m512i,
+                                               minRowt1_m512i));
+      }
+    }
+
+    // Flag last window
+    for (int minRow = (int)mask->Height() - (int)Length + 1;
+         minRow < (int)mask->Height(); ++minRow) {
+      const __m512i minRowt1_m512i = _mm512_set1_epi32(minRow - 1);
+      for (int iCol = 0; iCol < width; iCol += vectorWidth) {
+        const __mmask16 lanes = FirstLanes(width - iCol);
+        const __m512i lastFlaggedPos_m512i =
+            _mm512_maskz_load_epi32(lanes, &lastFlaggedPos[iCol]);
+        FlagLanes(mask->ValuePtr(iCol, minRow),
+                  _mm512_mask_cmpgt_epi32_mask(lanes, lastFlaggedPos_m512i,
+                                               minRowt1_m512i));
+      }
+    }
+  }
+}
+
+template <size_t Length>
+__attribute__((target("avx512f,avx512bw,avx512vl"))) void
+SumThreshold::HorizontalAVX512Dumas(const Image2D* input, Mask2D* mask,
+                                    num_t threshold) {
+  if (Length <= mask->Width()) {
+    constexpr int vectorWidth = 16;
+#ifndef NDEBUG
+    if (input->Stride() * (vectorWidth - 1) > 0x7FFFFFFF) {
+      throw std::runtime_error("Array too big for gather intrinsic");
+    }
+#endif
+    // The gathered mask dwords of the last three rows are read from one to
+    // three bytes before the requested value, so that no value past the end
+    // of the last row is read. The byte masks select the requested value.
+    alignas(64) int inputIndexes[vectorWidth];
+    alignas(64) int maskIndexes[vectorWidth];
+    alignas(64) int maskBytes[vectorWidth];
+    for (int i = 0; i != vectorWidth; ++i) {
+      const int shift = std::max(0, i - (vectorWidth - 4));
+      inputIndexes[i] = input->Stride() * i;
+      maskIndexes[i] = mask->Stride() * i - shift;
+      maskBytes[i] = 0xFF << (shift * 8);
+    }
+    const __m512i inputIndexes_m512i = _mm512_load_si512(inputIndexes);
+    const __m512i maskIndexes_m512i = _mm512_load_si512(maskIndexes);
+    const __m512i maskBytes_m512i = _mm512_load_si512(maskBytes);
+    const __m512i one_m512i = _mm512_set1_epi32(1);
+    const __m512 threshold_m512 = _mm512_set1_ps(threshold);
+    const size_t maskStride = mask->Stride();
+
+    const int vectorizedHeight =
+        (int)mask->Height() - (int)mask->Height() % vectorWidth;
+    for (int iRow = 0; iRow < vectorizedHeight; iRow += vectorWidth) {
+      __m512 sum_m512 = _mm512_setzero_ps();
+      __m512i count_m512i = _mm512_setzero_si512();
+      __m512i lastFlaggedPos_m512i = _mm512_set1_epi32(-1);
+
+      // Set sum and count for initial window position
+      for (int maxCol = 0; maxCol < (int)Length - 1; ++maxCol) {
+        const __mmask16 lanes = GatherUnflaggedLanes(
+            mask->ValuePtr(maxCol, iRow), maskIndexes_m512i, maskBytes_m512i);
+        sum_m512 = _mm512_add_ps(
+            sum_m512, GatherLanes(input->ValuePtr(maxCol, iRow),
+                                  inputIndexes_m512i, lanes));
+        count_m512i =
+            _mm512_mask_add_epi32(count_m512i, lanes, count_m512i, one_m512i);
+      }
+
+      // Iterate through positions
+      for (int maxCol = (int)Length - 1; maxCol < (int)mask->Width();
+           ++maxCol) {
+        const int minCol = maxCol - (int)Length + 1;
+
+        /*
+         * Implements:
+         *    sum += input(iRow, maxCol) * !mask(iRow, maxCol);
+         *    count += !mask(iRow,maxCol);
+         */
+        const __mmask16 addLanes = GatherUnflaggedLanes(
+            mask->ValuePtr(maxCol, iRow), maskIndexes_m512i, maskBytes_m512i);
+        sum_m512 = _mm512_add_ps(
+            sum_m512, GatherLanes(input->ValuePtr(maxCol, iRow),
+                                  inputIndexes_m512i, addLanes));
+        count_m512i = _mm512_mask_add_epi32(count_m512i, addLanes, count_m512i,
+                                            one_m512i);
+
+        /*
+         * Implements:
+         * if (abs(sum) > count * threshold)
+         *    lastFlaggedPos = maxCol;
+         */
+        const __mmask16 exceeds = _mm512_cmp_ps_mask(
+            _mm512_abs_ps(sum_m512),
+            _mm512_mul_ps(threshold_m512, CountToFloat(count_m512i)),
+            _CMP_GT_OQ);
+        lastFlaggedPos_m512i = _mm512_mask_mov_epi32(
+            lastFlaggedPos_m512i, exceeds, _mm512_set1_epi32(maxCol));
+
+        /*
+         * Implements:
+         *    sum -= input(iRow, minCol) * !mask(iRow, minCol);
+         *    count -= !mask(iRow, minCol);
+         */
+        const __mmask16 subLanes = GatherUnflaggedLanes(
+            mask->ValuePtr(minCol, iRow), maskIndexes_m512i, maskBytes_m512i);
+        sum_m512 = _mm512_sub_ps(
+            sum_m512, GatherLanes(input->ValuePtr(minCol, iRow),
+                                  inputIndexes_m512i, subLanes));
+        count_m512i = _mm512_mask_sub_epi32(count_m512i, subLanes, count_m512i,
+                                            one_m512i);
+
+        /*
+         * Implements:
+         *    mask(iRow, minCol) |= (lastFlaggedPos > minCol - 1);
+         */
+        const unsigned flagged = _mm512_cmpgt_epi32_mask(
+            lastFlaggedPos_m512i, _mm512_set1_epi32(minCol - 1));
+        bool* maskPtr = mask->ValuePtr(minCol, iRow);
+        for (int i = 0; i != vectorWidth; ++i)
+          maskPtr[maskStride * i] |= (flagged >> i) & 1u;
+      }
+
+      // Flag last window
+      for (int minCol = (int)mask->Width() - (int)Length + 1;
+           minCol < (int)mask->Width(); ++minCol) {
+        const unsigned flagged = _mm512_cmpgt_epi32_mask(
+            lastFlaggedPos_m512i, _mm512_set1_epi32(minCol - 1));
+        bool* maskPtr = mask->ValuePtr(minCol, iRow);
+        for (int i = 0; i != vectorWidth; ++i)
+          maskPtr[maskStride * i] |= (flagged >> i) & 1u;
+      }
+    }
+
+    HorizontalDumasRows<Length>(input, mask, threshold, vectorizedHeight,
+                                mask->Height());
+  }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) void
+SumThreshold::HorizontalAVX512Dumas(const Image2D* input, Mask2D* mask,
+                                    size_t length, num_t threshold) {
+  switch (length) {
+    case 1:
+      HorizontalAVX512Dumas<1>(input, mask, threshold);
+      break;
+    case 2:
+      HorizontalAVX512Dumas<2>(input, mask, threshold);
+      break;
+    case 4:
+      HorizontalAVX512Dumas<4>(input, mask, threshold);
+      break;
+    case 8:
+      HorizontalAVX512Dumas<8>(input, mask, threshold);
+      break;
+    case 16:
+      HorizontalAVX512Dumas<16>(input, mask, threshold);
+      break;
+    case 32:
+      HorizontalAVX512Dumas<32>(input, mask, threshold);
+      break;
+    case 64:
+      HorizontalAVX512Dumas<64>(input, mask, threshold);
+      break;
+    case 128:
+      HorizontalAVX512Dumas<128>(input, mask, threshold);
+      break;
+    case 256:
+      HorizontalAVX512Dumas<256>(input, mask, threshold);
+      break;
+    default:
+      throw std::runtime_error("Invalid value for length");
+  }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) void
+SumThreshold::VerticalAVX512Dumas(const Image2D* input, Mask2D* mask,
+                                  VerticalScratch* scratch, size_t length,
+                                  num_t threshold) {
+  switch (length) {
+    case 1:
+      VerticalAVX512Dumas<1>(input, mask, scratch, threshold);
+      break;
+    case 2:
+      VerticalAVX512Dumas<2>(input, mask, scratch, threshold);
+      break;
+    case 4:
+      VerticalAVX512Dumas<4>(input, mask, scratch, threshold);
+      break;
+    case 8:
+      VerticalAVX512Dumas<8>(input, mask, scratch, threshold);
+      break;
+    case 16:
+      VerticalAVX512Dumas<16>(input, mask, scratch, threshold);
+      break;
+    case 32:
+      VerticalAVX512Dumas<32>(input, mask, scratch, threshold);
+      break;
+    case 64:
+      VerticalAVX512Dumas<64>(input, mask, scratch, threshold);
+      break;
+    case 128:
+      VerticalAVX512Dumas<128>(input, mask, scratch, threshold);
+      break;
+    case 256:
+      VerticalAVX512Dumas<256>(input, mask, scratch, threshold);
+      break;
+    default:
+      throw std::runtime_error("Invalid value for length");
+  }
+}
+
+#endif  // defined(__AVX512F__) || defined(__x86_64__)
+
+/*
+ * Kernel registry. The kernels for each instruction set are wrapped in
+ * functions with the same signature, so that the dispatching
+ * HorizontalLarge() and VerticalLarge() only need to follow a pointer instead
+ * of testing the CPU features on every call.
+ */
+namespace {
+
+void HorizontalReferenceKernel(const Image2D* input, Mask2D* mask,
+                               Mask2D* scratch, size_t length,
+                               num_t threshold) {
+  SumThreshold::HorizontalLargeReference(input, mask, scratch, length,
+                                         threshold);
+}
+
+void VerticalReferenceKernel(const Image2D* input, Mask2D* mask,
+                             Mask2D* scratch, SumThreshold::VerticalScratch*,
+                             size_t length, num_t threshold) {
+  SumThreshold::VerticalLargeReference(input, mask, scratch, length, threshold);
+}
+
+#if defined(__SSE__) || defined(__x86_64__)
+void HorizontalSSEKernel(const Image2D* input, Mask2D* mask, Mask2D* scratch,
+                         size_t length, num_t threshold) {
+  SumThreshold::HorizontalLargeSSE(input, mask, scratch, length, threshold);
+}
+
+void VerticalSSEKernel(const Image2D* input, Mask2D* mask, Mask2D* scratch,
+                       SumThreshold::VerticalScratch*, size_t length,
+                       num_t threshold) {
+  SumThreshold::VerticalLargeSSE(input, mask, scratch, length, threshold);
+}
+#endif
+
+#if defined(__AVX2__) || defined(__x86_64__)
+void HorizontalAVX2Kernel(const Image2D* input, Mask2D* mask, Mask2D* scratch,
+                          size_t length, num_t threshold) {
+  // The gathers make the Dumas algorithm slower than SSE for short lengths
+  if (length >= 64)
+    SumThreshold::HorizontalAVXDumas(input, mask, length, threshold);
+  else
+    SumThreshold::HorizontalLargeSSE(input, mask, scratch, length, threshold);
+}
+
+void VerticalAVX2Kernel(const Image2D* input, Mask2D* mask, Mask2D*,
+                        SumThreshold::VerticalScratch* vScratch, size_t length,
+                        num_t threshold) {
+  SumThreshold::VerticalAVXDumas(input, mask, vScratch, length, threshold);
+}
+#endif
+
+#if defined(__AVX512F__) || defined(__x86_64__)
+// In horizontal direction, the 16-wide gathers of HorizontalAVX512Dumas() are
+// not faster than the 8-wide ones, so AVX-512 uses the AVX2 horizontal kernel.
+void VerticalAVX512Kernel(const Image2D* input, Mask2D* mask, Mask2D*,
+                          SumThreshold::VerticalScratch* vScratch,
+                          size_t length, num_t threshold) {
+  SumThreshold::VerticalAVX512Dumas(input, mask, vScratch, length, threshold);
+}
+#endif
+
+}  // namespace
+
+std::atomic<const SumThreshold::Kernels*> SumThreshold::_selectedKernels(
+    nullptr);
+
+const SumThreshold::Kernels& SumThreshold::kernelsFor(Isa isa) {
+  static const Kernels reference{Isa::Reference, &HorizontalReferenceKernel,
+                                 &VerticalReferenceKernel};
+  switch (isa) {
+    case Isa::Reference:
+      return reference;
+    case Isa::SSE: {
+#if defined(__SSE__) || defined(__x86_64__)
+      static const Kernels sse{Isa::SSE, &HorizontalSSEKernel,
+                               &VerticalSSEKernel};
+      return sse;
+#else
+      break;
+#endif
+    }
+    case Isa::AVX2: {
+#if defined(__AVX2__) || defined(__x86_64__)
+      static const Kernels avx2{Isa::AVX2, &HorizontalAVX2Kernel,
+                                &VerticalAVX2Kernel};
+      return avx2;
+#else
+      break;
+#endif
+    }
+    case Isa::AVX512: {
+#if defined(__AVX512F__) || defined(__x86_64__)
+      static const Kernels avx512{Isa::AVX512, &HorizontalAVX2Kernel,
+                                  &VerticalAVX512Kernel};
+      return avx512;
+#else
+      break;
+#endif
+    }
+  }
+  throw std::runtime_error("SumThreshold kernels for " + IsaName(isa) +
+                           " are not available in this build");
+}
+
+bool SumThreshold::IsSupported(Isa isa) {
+  switch (isa) {
+    case Isa::Reference:
+      return true;
+    case Isa::SSE:
+#if defined(__SSE__) || defined(__x86_64__)
+      return __builtin_cpu_supports("sse");
+#else
+      return false;
+#endif
+    case Isa::AVX2:
+#if defined(__AVX2__) || defined(__x86_64__)
+      return __builtin_cpu_supports("avx2");
+#else
+      return false;
+#endif
+    case Isa::AVX512:
+#if defined(__AVX512F__) || defined(__x86_64__)
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512bw") &&
+             __builtin_cpu_supports("avx512vl");
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+SumThreshold::Isa SumThreshold::BestSupportedIsa() {
+  for (Isa isa : {Isa::AVX512, Isa::AVX2, Isa::SSE}) {
+    if (IsSupported(isa)) return isa;
+  }
+  return Isa::Reference;
+}
+
+std::string SumThreshold::IsaName(Isa isa) {
+  switch (isa) {
+    case Isa::Reference:
+      return "reference";
+    case Isa::SSE:
+      return "sse";
+    case Isa::AVX2:
+      return "avx2";
+    case Isa::AVX512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+SumThreshold::Isa SumThreshold::ParseIsa(const std::string& name) {
+  const std::string lowerName = boost::to_lower_copy(name);
+  for (Isa isa : {Isa::Reference, Isa::SSE, Isa::AVX2, Isa::AVX512}) {
+    if (lowerName == IsaName(isa)) return isa;
+  }
+  throw std::runtime_error(
+      "Invalid SumThreshold instruction set '" + name +
+      "': should be one of reference, sse, avx2 or avx512");
+}
+
+const SumThreshold::Kernels& SumThreshold::initializeKernels() {
+  // A function-local static makes sure the selection (and its logging) is
+  // done only once, even when the first calls are made from several threads.
+  static const Kernels& initial = []() -> const Kernels& {
+    Isa isa = BestSupportedIsa();
+    const char* requested = std::getenv("AOFLAGGER_SUMTHRESHOLD_ISA");
+    if (requested && *requested) {
+      try {
+        const Isa requestedIsa = ParseIsa(requested);
+        if (IsSupported(requestedIsa))
+          isa = requestedIsa;
+        else
+          Logger::Warn << "AOFLAGGER_SUMTHRESHOLD_ISA requests " << requested
+                       << ", which is not supported by this CPU: using "
+                       << IsaName(isa) << " instead.\n";
+      } catch (std::exception& e) {
+        Logger::Warn << e.what() << " (in AOFLAGGER_SUMTHRESHOLD_ISA)\n";
+      }
+    }
+    Logger::Debug << "Using " << IsaName(isa) << " SumThreshold kernels.\n";
+    return kernelsFor(isa);
+  }();
+  const Kernels* expected = nullptr;
+  // Don't replace a selection that was made with SelectIsa() in the meantime
+  _selectedKernels.compare_exchange_strong(expected, &initial,
+                                           std::memory_order_acq_rel);
+  return *_selectedKernels.load(std::memory_order_acquire);
+}
+
+SumThreshold::Isa SumThreshold::SelectedIsa() { return kernels().isa; }
+
+void SumThreshold::SelectIsa(Isa isa) {
+  if (!IsSupported(isa))
+    throw std::runtime_error("The " + IsaName(isa) +
+                             " instruction set is not supported by this CPU");
+  _selectedKernels.store(&kernelsFor(isa), std::memory_order_release);
+  Logger::Debug << "Using " << IsaName(isa) << " SumThreshold kernels.\n";
+}
+
 }  // namespace algorithms
@@ -1,9 +1,11 @@
 #ifndef SUMTHRESHOLD_H
 #define SUMTHRESHOLD_H
 
+#include <atomic>
 #include <cstddef>
 #include <cstring>
 #include <memory>
+#include <string>
 
 #include "../structures/image2d.h"
 #include "../structures/mask2d.h"
@@ -12,6 +14,12 @@ namespace algorithms {
 
 class SumThreshold {
  public:
+  /**
+   * Instruction set used by the dispatching HorizontalLarge() and
+   * VerticalLarge() functions.
+   */
+  enum class Isa { Reference, SSE, AVX2, AVX512 };
+
   struct VerticalScratch {
     VerticalScratch();
     VerticalScratch(size_t width, size_t height);
@@ -84,6 +92,27 @@ class SumThreshold {
 
 #endif  // defined(__AVX2__) || defined(__x86_64__)
 
+/* Like AVX2, AVX-512 is always compiled for 64-bit Intel, but only executed
+   when the CPU supports AVX-512F, AVX-512BW and AVX-512VL. */
+#if defined(__AVX512F__) || defined(__x86_64__)
+  __attribute__((target("avx512f,avx512bw,avx512vl"))) static void
+  HorizontalAVX512Dumas(const Image2D* input, Mask2D* mask, size_t length,
+                        num_t threshold);
+
+  __attribute__((target("avx512f,avx512bw,avx512vl"))) static void
+  VerticalAVX512Dumas(const Image2D* input, Mask2D* mask,
+                      VerticalScratch* scratch, size_t length, num_t threshold);
+
+  template <size_t Length>
+  __attribute__((target("avx512f,avx512bw,avx512vl"))) static void
+  HorizontalAVX512Dumas(const Image2D* input, Mask2D* mask, num_t threshold);
+
+  template <size_t Length>
+  __attribute__((target("avx512f,avx512bw,avx512vl"))) static void
+  VerticalAVX512Dumas(const Image2D* input, Mask2D* mask,
+                      VerticalScratch* scratch, num_t threshold);
+#endif  // defined(__AVX512F__) || defined(__x86_64__)
+
   template <size_t Length>
   static void VerticalLarge(const Image2D* input, Mask2D* mask, Mask2D* scratch,
                             num_t threshold);
@@ -95,22 +124,15 @@ class SumThreshold {
     VerticalLarge<Length>(input, mask, vThreshold);
   }
 
+  /**
+   * Runs the vertical SumThreshold with the kernel of the selected
+   * instruction set.
+   * @see SelectedIsa()
+   */
   static void VerticalLarge(const Image2D* input, Mask2D* mask, Mask2D* scratch,
                             VerticalScratch* vScratch, size_t length,
                             num_t threshold) {
-#if defined(__AVX2__) || defined(__x86_64__)
-    if (__builtin_cpu_supports("avx2")) {
-      VerticalAVXDumas(input, mask, vScratch, length, threshold);
-      return;
-    }
-#endif
-#if defined(__SSE__) || defined(__x86_64__)
-    if (__builtin_cpu_supports("sse")) {
-      VerticalLargeSSE(input, mask, scratch, length, threshold);
-      return;
-    }
-#endif
-    VerticalLargeReference(input, mask, scratch, length, threshold);
+    kernels().vertical(input, mask, scratch, vScratch, length, threshold);
   }
 
   static void VerticalLargeReference(const Image2D* input, Mask2D* mask,
@@ -121,25 +143,69 @@ class SumThreshold {
                                        Mask2D* scratch, size_t length,
                                        num_t threshold);
 
+  /**
+   * Runs the horizontal SumThreshold with the kernel of the selected
+   * instruction set.
+   * @see SelectedIsa()
+   */
   static void HorizontalLarge(const Image2D* input, Mask2D* mask,
                               Mask2D* scratch, size_t length, num_t threshold) {
-#if defined(__AVX2__) || defined(__x86_64__)
-    if (__builtin_cpu_supports("avx2")) {
-      if (length >= 64)
-        HorizontalAVXDumas(input, mask, length, threshold);
-      else
-        HorizontalLargeSSE(input, mask, scratch, length, threshold);
-      return;
-    }
-#endif
-#if defined(__SSE__) || defined(__x86_64__)
-    if (__builtin_cpu_supports("sse")) {
-      HorizontalLargeSSE(input, mask, scratch, length, threshold);
-      return;
-    }
-#endif
-    HorizontalLargeReference(input, mask, scratch, length, threshold);
+    kernels().horizontal(input, mask, scratch, length, threshold);
   }
+
+  /**
+   * The instruction set of the kernels that are currently in use. On first
+   * use, this is the best instruction set that the CPU supports, unless the
+   * AOFLAGGER_SUMTHRESHOLD_ISA environment variable is set to a supported
+   * instruction set.
+   */
+  static Isa SelectedIsa();
+
+  /**
+   * Forces the kernels of the given instruction set to be used, e.g. to
+   * compare or benchmark the implementations.
+   * @throws std::runtime_error if the CPU does not support @p isa.
+   */
+  static void SelectIsa(Isa isa);
+
+  /**
+   * Whether the binary contains kernels for the given instruction set and
+   * the CPU supports them.
+   */
+  static bool IsSupported(Isa isa);
+
+  static Isa BestSupportedIsa();
+
+  static std::string IsaName(Isa isa);
+
+  /**
+   * Parses a (case insensitive) instruction set name as returned by
+   * IsaName().
+   * @throws std::runtime_error if the name is not recognized.
+   */
+  static Isa ParseIsa(const std::string& name);
+
+ private:
+  using HorizontalKernel = void (*)(const Image2D* input, Mask2D* mask,
+                                    Mask2D* scratch, size_t length,
+                                    num_t threshold);
+  using VerticalKernel = void (*)(const Image2D* input, Mask2D* mask,
+                                  Mask2D* scratch, VerticalScratch* vScratch,
+                                  size_t length, num_t threshold);
+  struct Kernels {
+    Isa isa;
+    HorizontalKernel horizontal;
+    VerticalKernel vertical;
+  };
+
+  static const Kernels& kernels() {
+    const Kernels* selected = _selectedKernels.load(std::memory_order_acquire);
+    return selected ? *selected : initializeKernels();
+  }
+  static const Kernels& initializeKernels();
+  static const Kernels& kernelsFor(Isa isa);
+
+  static std::atomic<const Kernels*> _selectedKernels;
 };
 
 }  // namespace algorithms
@@ -6,6 +6,7 @@
 #include "../structures/antennainfo.h"
 
 #include "../util/logger.h"
+#include "../util/memoryplanner.h"
 #include "../util/progress/dummyprogresslistener.h"
 #include "../util/stopwatch.h"
 
@@ -13,39 +14,65 @@
 #include "../imagesets/fitsimageset.h"
 #include "../imagesets/imageset.h"
 #include "../imagesets/msimageset.h"
-#include "../imagesets/filterbankset.h"
+#include "../imagesets/multibandmsimageset.h"
 #include "../imagesets/qualitystatimageset.h"
 #include "../imagesets/rfibaselineset.h"
 
-#include "writethread.h"
+#include "../msio/memorybaselinereader.h"
 
-#include <aocommon/system.h>
+#include "writethread.h"
 
+#include <algorithm>
 #include <sstream>
 #include <vector>
 
-BaselineIterator::BaselineIterator(std::mutex* ioMutex, const Options& options)
+BaselineIterator::BaselineIterator(const Options& options)
     : _options(options),
       _sequenceCount(0),
       _nextIndex(0),
       _threadCount(4),
+      _minBufferSize(0),
+      _maxBufferSize(0),
       _loopIndex(),
-      _ioMutex(ioMutex),
-      _finishedBaselines(false),
       _exceptionOccured(false),
       _baselineProgress(0) {}
 
 BaselineIterator::~BaselineIterator() {}
 
+void BaselineIterator::planMemory(uint64_t baselineSize, uint64_t residentSize,
+                                  size_t minBufferSize, size_t maxBufferSize) {
+  Logger::Debug << "Estimate of memory each thread will use: "
+                << memToStr(3.0 * baselineSize) << ".\n";
+  const uint64_t memSize = MemoryPlanner::Budget();
+  Logger::Debug << "Memory budget is " << memToStr(memSize) << ".\n";
+
+  const MemoryPlanner::ProcessingPlan plan =
+      MemoryPlanner::PlanProcessing(baselineSize, residentSize, _threadCount,
+                                    minBufferSize, maxBufferSize, memSize);
+  if (plan.threadCount < _threadCount) {
+    Logger::Warn << "This measurement set is TOO LARGE to be processed with "
+                 << _threadCount << " threads!\n"
+                 << _threadCount << " threads would require "
+                 << memToStr(3.0 * baselineSize * _threadCount + residentSize)
+                 << " of memory approximately.\n"
+                    "Number of threads that will actually be used: "
+                 << plan.threadCount
+                 << "\n"
+                    "This might hurt performance a lot!\n\n";
+    _threadCount = plan.threadCount;
+  }
+  _minBufferSize = minBufferSize;
+  _maxBufferSize = plan.maxBufferSize;
+  Logger::Debug << "Reader will buffer at most " << _maxBufferSize
+                << " baselines.\n";
+}
+
 void BaselineIterator::Run(imagesets::ImageSet& imageSet, LuaThreadGroup& lua,
                            ScriptData& scriptData) {
   _lua = &lua;
   _imageSet = &imageSet;
   _threadCount = _options.CalculateThreadCount();
 
-  _writeThread.reset(new WriteThread(imageSet, _threadCount, _ioMutex));
-  _globalScriptData = &scriptData;
-
   imagesets::MSImageSet* msImageSet =
       dynamic_cast<imagesets::MSImageSet*>(&imageSet);
   if (msImageSet) {
@@ -54,38 +81,32 @@ void BaselineIterator::Run(imagesets::ImageSet& imageSet, LuaThreadGroup& lua,
     const size_t timeStepCount =
         msImageSet->ObservationTimesVector(tempIndex).size();
     const size_t channelCount = msImageSet->GetBandInfo(0).channels.size();
-    const double estMemorySizePerThread =
-        8.0 /*bp complex*/ * 4.0 /*polarizations*/ * double(timeStepCount) *
-        double(channelCount) *
-        3.0 /* approx copies of the data that will be made in memory*/;
-    Logger::Debug << "Estimate of memory each thread will use: "
-                  << memToStr(estMemorySizePerThread) << ".\n";
-    size_t compThreadCount = _threadCount;
-    if (compThreadCount > 0) --compThreadCount;
-
-    const int64_t memSize = aocommon::system::TotalMemory();
-    Logger::Debug << "Detected " << memToStr(memSize) << " of system memory.\n";
-
-    if (estMemorySizePerThread * double(compThreadCount) > memSize) {
-      size_t maxThreads = size_t(memSize / estMemorySizePerThread);
-      if (maxThreads < 1) maxThreads = 1;
-      Logger::Warn << "This measurement set is TOO LARGE to be processed with "
-                   << _threadCount << " threads!\n"
-                   << _threadCount << " threads would require "
-                   << memToStr(estMemorySizePerThread * compThreadCount)
-                   << " of memory approximately.\n"
-                      "Number of threads that will actually be used: "
-                   << maxThreads
-                   << "\n"
-                      "This might hurt performance a lot!\n\n";
-      _threadCount = maxThreads;
-    }
-  }
-  if (dynamic_cast<imagesets::FilterBankSet*>(&imageSet) != nullptr &&
-      _threadCount != 1) {
-    Logger::Info << "This is a Filterbank set -- disabling multi-threading\n";
-    _threadCount = 1;
+    const uint64_t baselineSize = 8 /*bp complex*/ * 4 /*polarizations*/ *
+                                  uint64_t(timeStepCount) * channelCount;
+    // The memory reader holds all baselines in memory.
+    const BaselineReaderPtr reader = msImageSet->Reader();
+    const uint64_t residentSize =
+        dynamic_cast<MemoryBaselineReader*>(reader.get())
+            ? baselineSize * msImageSet->Size()
+            : 0;
+    planMemory(baselineSize, residentSize,
+               reader->GetMinRecommendedBufferSize(_threadCount),
+               reader->GetMaxRecommendedBufferSize(_threadCount));
+  } else if (const imagesets::MultiBandMsImageSet* multiBandSet =
+                 dynamic_cast<imagesets::MultiBandMsImageSet*>(&imageSet);
+             multiBandSet && multiBandSet->IsStreaming()) {
+    // Only the buffered baselines of a streaming set are in memory, so the
+    // number of buffered baselines is planned like for a single set.
+    planMemory(multiBandSet->BaselineSize(), 0,
+               multiBandSet->GetMinRecommendedBufferSize(_threadCount),
+               multiBandSet->GetMaxRecommendedBufferSize(_threadCount));
   }
+  _ioLocks.SetConcurrentReadWrite(imageSet.SupportsConcurrentReadWrite());
+  if (_ioLocks.ConcurrentReadWrite())
+    Logger::Debug << "Reading and writing of flags will be overlapped.\n";
+  _writeThread.reset(new WriteThread(imageSet, _threadCount, _ioLocks));
+  _globalScriptData = &scriptData;
+
   if (!_options.antennaeToSkip.empty()) {
     Logger::Debug << "The following antennas will be skipped: ";
     for (const size_t a : _options.antennaeToSkip) Logger::Debug << a << ' ';
@@ -97,7 +118,6 @@ void BaselineIterator::Run(imagesets::ImageSet& imageSet, LuaThreadGroup& lua,
     Logger::Debug << '\n';
   }
 
-  _finishedBaselines = false;
   _sequenceCount = 0;
   _baselineProgress = 0;
   _nextIndex = 0;
@@ -112,6 +132,8 @@ void BaselineIterator::Run(imagesets::ImageSet& imageSet, LuaThreadGroup& lua,
 
   // Initialize thread data and threads
   _loopIndex = imageSet.StartIndex();
+  _baselineQueue = std::make_unique<BaselineQueue>(
+      _threadCount, _options.baselineOrder.value_or(BaselineOrder::Read));
 
   std::vector<std::thread> threadGroup;
   const ReaderThread reader(*this);
@@ -124,7 +146,13 @@ void BaselineIterator::Run(imagesets::ImageSet& imageSet, LuaThreadGroup& lua,
 
   for (std::thread& t : threadGroup) t.join();
 
+  Logger::Debug << "Baselines taken over from another thread's queue: "
+                << _baselineQueue->StolenCount() << '\n';
+  _baselineQueue.reset();
   _writeThread.reset();
+  Logger::Debug << "Time that reading was blocked by I/O of other threads: "
+                << _ioLocks.ReadBlockedSeconds()
+                << " s, writing: " << _ioLocks.WriteBlockedSeconds() << " s.\n";
 
   if (_exceptionOccured)
     throw std::runtime_error(
@@ -194,19 +222,17 @@ imagesets::ImageSetIndex BaselineIterator::GetNextIndex() {
 }
 
 void BaselineIterator::SetExceptionOccured() {
-  const std::lock_guard<std::mutex> lock(_mutex);
-  _exceptionOccured = true;
-  _dataProcessed.notify_all();
-  _dataAvailable.notify_all();
-}
-
-void BaselineIterator::SetFinishedBaselines() {
-  const std::lock_guard<std::mutex> lock(_mutex);
-  _finishedBaselines = true;
+  {
+    const std::lock_guard<std::mutex> lock(_mutex);
+    _exceptionOccured = true;
+  }
+  _baselineQueue->Abort();
 }
 
 void BaselineIterator::ProcessingThread::operator()() {
   ScriptData scriptData;
+  scriptData.SetStatisticsChannelsPerBand(
+      _parent._globalScriptData->StatisticsChannelsPerBand());
   const std::string executeFunctionName =
       _parent._options.executeFunctionName.empty()
           ? "execute"
@@ -214,7 +240,7 @@ void BaselineIterator::ProcessingThread::operator()() {
 
   try {
     std::unique_ptr<imagesets::BaselineData> baseline =
-        _parent.GetNextBaseline();
+        _parent._baselineQueue->Pop(_threadIndex);
 
     while (baseline != nullptr) {
       /* TODO
@@ -235,7 +261,7 @@ void BaselineIterator::ProcessingThread::operator()() {
 
       _parent._writeThread->SaveFlags(data, baseline->Index());
 
-      baseline = _parent.GetNextBaseline();
+      baseline = _parent._baselineQueue->Pop(_threadIndex);
       _parent.IncBaselineProgress();
     }
 
@@ -245,7 +271,7 @@ void BaselineIterator::ProcessingThread::operator()() {
   }
 
   {
-    const std::unique_lock<std::mutex> ioLock(*_parent._ioMutex);
+    const std::lock_guard<std::mutex> lock(_parent._mutex);
     _parent._globalScriptData->Combine(std::move(scriptData));
   }
 
@@ -255,16 +281,15 @@ void BaselineIterator::ProcessingThread::operator()() {
 void BaselineIterator::ReaderThread::operator()() {
   Stopwatch watch(true);
   bool finished = false;
-  const size_t threadCount = _parent._threadCount;
   size_t minRecommendedBufferSize, maxRecommendedBufferSize;
-  imagesets::MSImageSet* msImageSet =
-      dynamic_cast<imagesets::MSImageSet*>(_parent._imageSet);
-  if (msImageSet != nullptr) {
+  if (_parent._maxBufferSize != 0) {
+    // The maximum is limited by the memory planner in Run()
+    const size_t queued = _parent._baselineQueue->Size();
+    maxRecommendedBufferSize = _parent._maxBufferSize > queued
+                                   ? _parent._maxBufferSize - queued
+                                   : 1;
     minRecommendedBufferSize =
-        msImageSet->Reader()->GetMinRecommendedBufferSize(threadCount);
-    maxRecommendedBufferSize =
-        msImageSet->Reader()->GetMaxRecommendedBufferSize(threadCount) -
-        _parent.GetBaselinesInBufferCount();
+        std::min(_parent._minBufferSize, maxRecommendedBufferSize);
   } else {
     minRecommendedBufferSize = 1;
     maxRecommendedBufferSize = 2;
@@ -272,13 +297,15 @@ void BaselineIterator::ReaderThread::operator()() {
 
   do {
     watch.Pause();
-    _parent.WaitForReadBufferAvailable(minRecommendedBufferSize);
-    if (!_parent._exceptionOccured) {
+    _parent._baselineQueue->WaitForSizeAtMost(minRecommendedBufferSize);
+    if (!_parent._baselineQueue->IsAborted()) {
+      const size_t queued = _parent._baselineQueue->Size();
       const size_t wantedCount =
-          maxRecommendedBufferSize - _parent.GetBaselinesInBufferCount();
+          maxRecommendedBufferSize > queued ? maxRecommendedBufferSize - queued
+                                            : 0;
       size_t requestedCount = 0;
 
-      std::unique_lock<std::mutex> lock(*_parent._ioMutex);
+      std::unique_lock<std::mutex> lock = _parent._ioLocks.LockForReading();
       watch.Start();
 
       for (size_t i = 0; i < wantedCount; ++i) {
@@ -292,28 +319,24 @@ void BaselineIterator::ReaderThread::operator()() {
         }
       }
 
+      std::vector<std::unique_ptr<imagesets::BaselineData>> batch;
       if (requestedCount > 0) {
         DummyProgressListener dummy;
         _parent._imageSet->PerformReadRequests(dummy);
         watch.Pause();
 
-        for (size_t i = 0; i < requestedCount; ++i) {
-          std::unique_ptr<imagesets::BaselineData> baseline =
-              _parent._imageSet->GetNextRequested();
-
-          const std::lock_guard<std::mutex> bufferLock(_parent._mutex);
-          _parent._baselineBuffer.emplace(std::move(baseline));
-        }
+        batch.reserve(requestedCount);
+        for (size_t i = 0; i < requestedCount; ++i)
+          batch.emplace_back(_parent._imageSet->GetNextRequested());
       }
 
       lock.unlock();
 
-      _parent._dataAvailable.notify_all();
+      _parent._baselineQueue->PushBatch(std::move(batch));
     }
     watch.Start();
-  } while (!finished && !_parent._exceptionOccured);
-  _parent.SetFinishedBaselines();
-  _parent._dataAvailable.notify_all();
+  } while (!finished && !_parent._baselineQueue->IsAborted());
+  _parent._baselineQueue->SetFinished();
   watch.Pause();
   Logger::Debug << "Time spent on reading: " << watch.ToString() << '\n';
 }
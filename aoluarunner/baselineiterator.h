@@ -1,22 +1,23 @@
 #ifndef RFISTRATEGYFOREACHBASELINEACTION_H
 #define RFISTRATEGYFOREACHBASELINEACTION_H
 
+#include "baselinequeue.h"
+#include "iolocks.h"
 #include "options.h"
 
 #include "../imagesets/imageset.h"
 
-#include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <set>
-#include <stack>
 #include <string>
 #include <thread>
 #include <utility>
 
 class BaselineIterator {
  public:
-  BaselineIterator(std::mutex* ioMutex, const Options& options);
+  explicit BaselineIterator(const Options& options);
   ~BaselineIterator();
 
   void Run(imagesets::ImageSet& imageSet, class LuaThreadGroup& lua,
@@ -26,9 +27,10 @@ class BaselineIterator {
   bool IsSequenceSelected(imagesets::ImageSetIndex& index);
   imagesets::ImageSetIndex GetNextIndex();
   static std::string memToStr(double memSize);
+  void planMemory(uint64_t baselineSize, uint64_t residentSize,
+                  size_t minBufferSize, size_t maxBufferSize);
 
   void SetExceptionOccured();
-  void SetFinishedBaselines();
   // void SetProgress(ProgressListener &progress, int no, int count, const
   // std::string& taskName, int threadId);
 
@@ -41,34 +43,6 @@ class BaselineIterator {
     ++_baselineProgress;
   }
 
-  void WaitForReadBufferAvailable(size_t maxSize) {
-    std::unique_lock<std::mutex> lock(_mutex);
-    while (_baselineBuffer.size() > maxSize && !_exceptionOccured)
-      _dataProcessed.wait(lock);
-  }
-
-  std::unique_ptr<imagesets::BaselineData> GetNextBaseline() {
-    std::unique_lock<std::mutex> lock(_mutex);
-    while (_baselineBuffer.size() == 0 && !_exceptionOccured &&
-           !_finishedBaselines)
-      _dataAvailable.wait(lock);
-    if ((_finishedBaselines && _baselineBuffer.size() == 0) ||
-        _exceptionOccured) {
-      return nullptr;
-    } else {
-      std::unique_ptr<imagesets::BaselineData> next =
-          std::move(_baselineBuffer.top());
-      _baselineBuffer.pop();
-      _dataProcessed.notify_one();
-      return next;
-    }
-  }
-
-  size_t GetBaselinesInBufferCount() {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _baselineBuffer.size();
-  }
-
   struct ProcessingThread {
     ProcessingThread(BaselineIterator& parent, size_t threadIndex)
         : _parent(parent), _threadIndex(threadIndex) {}
@@ -89,15 +63,19 @@ class BaselineIterator {
   imagesets::ImageSet* _imageSet;
   size_t _sequenceCount, _nextIndex;
   size_t _threadCount;
+  // Minimum and maximum number of baselines that the reader buffers, as
+  // selected by the MemoryPlanner. Only used for measurement sets and
+  // streaming multi-band sets; zero otherwise.
+  size_t _minBufferSize;
+  size_t _maxBufferSize;
 
   imagesets::ImageSetIndex _loopIndex;
 
   std::unique_ptr<class WriteThread> _writeThread;
 
-  std::mutex _mutex, *_ioMutex;
-  std::condition_variable _dataAvailable, _dataProcessed;
-  std::stack<std::unique_ptr<imagesets::BaselineData>> _baselineBuffer;
-  bool _finishedBaselines;
+  std::mutex _mutex;
+  IOLocks _ioLocks;
+  std::unique_ptr<BaselineQueue> _baselineQueue;
 
   bool _exceptionOccured;
   size_t _baselineProgress;
@@ -0,0 +1,121 @@
+#include "baselinequeue.h"
+
+#include <algorithm>
+
+BaselineQueue::BaselineQueue(size_t threadCount, BaselineOrder order)
+    : _order(order),
+      _queues(std::max<size_t>(threadCount, 1)),
+      _nextQueue(0),
+      _size(0),
+      _stolenCount(0),
+      _finished(false),
+      _aborted(false),
+      _readerWaitSize(kReaderNotWaiting) {}
+
+double BaselineQueue::EstimateCost(const imagesets::BaselineData& baseline) {
+  const TimeFrequencyData& data = baseline.Data();
+  double cost = double(data.ImageWidth()) * double(data.ImageHeight()) *
+                double(data.PolarizationCount());
+  const TimeFrequencyMetaDataCPtr& metaData = baseline.MetaData();
+  if (metaData && metaData->HasBaseline()) {
+    // Use the length only to order otherwise equally sized baselines: the
+    // fraction is always smaller than one sample.
+    const double distance = metaData->Baseline().Distance();
+    cost += distance / (distance + 1.0);
+  }
+  return cost;
+}
+
+void BaselineQueue::PushBatch(
+    std::vector<std::unique_ptr<imagesets::BaselineData>> batch) {
+  if (_order == BaselineOrder::Cost) {
+    std::vector<std::pair<double, size_t>> costs;
+    costs.reserve(batch.size());
+    for (size_t i = 0; i != batch.size(); ++i)
+      costs.emplace_back(EstimateCost(*batch[i]), i);
+    std::stable_sort(costs.begin(), costs.end(),
+                     [](const std::pair<double, size_t>& a,
+                        const std::pair<double, size_t>& b) {
+                       return a.first > b.first;
+                     });
+    std::vector<std::unique_ptr<imagesets::BaselineData>> sorted;
+    sorted.reserve(batch.size());
+    for (const std::pair<double, size_t>& c : costs)
+      sorted.emplace_back(std::move(batch[c.second]));
+    batch = std::move(sorted);
+  }
+
+  for (std::unique_ptr<imagesets::BaselineData>& baseline : batch) {
+    ThreadQueue& queue = _queues[_nextQueue];
+    _nextQueue = (_nextQueue + 1) % _queues.size();
+    // The size is changed while holding the lock of the queue, such that a
+    // baseline is never popped before it is counted.
+    const std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.items.emplace_back(std::move(baseline));
+    ++_size;
+  }
+  if (!batch.empty()) notifyWaiters(_dataAvailable);
+}
+
+std::unique_ptr<imagesets::BaselineData> BaselineQueue::tryPop(
+    size_t threadIndex) {
+  const size_t n = _queues.size();
+  const size_t ownQueue = threadIndex % n;
+  // Start with the thread's own queue; only when that is empty, try to steal
+  // from the others, starting with the neighbour.
+  for (size_t i = 0; i != n; ++i) {
+    ThreadQueue& queue = _queues[(ownQueue + i) % n];
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (!queue.items.empty()) {
+      std::unique_ptr<imagesets::BaselineData> baseline =
+          std::move(queue.items.front());
+      queue.items.pop_front();
+      const size_t newSize = --_size;
+      lock.unlock();
+      if (i != 0) _stolenCount.fetch_add(1, std::memory_order_relaxed);
+      const size_t readerWaitSize = _readerWaitSize;
+      if (readerWaitSize != kReaderNotWaiting && newSize <= readerWaitSize)
+        notifyWaiters(_dataProcessed);
+      return baseline;
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<imagesets::BaselineData> BaselineQueue::Pop(
+    size_t threadIndex) {
+  while (!IsAborted()) {
+    std::unique_ptr<imagesets::BaselineData> baseline = tryPop(threadIndex);
+    if (baseline) return baseline;
+
+    std::unique_lock<std::mutex> lock(_waitMutex);
+    while (Size() == 0 && !_finished && !_aborted) _dataAvailable.wait(lock);
+    if (Size() == 0) return nullptr;
+  }
+  return nullptr;
+}
+
+void BaselineQueue::WaitForSizeAtMost(size_t maxSize) {
+  std::unique_lock<std::mutex> lock(_waitMutex);
+  _readerWaitSize = maxSize;
+  while (Size() > maxSize && !_aborted) _dataProcessed.wait(lock);
+  _readerWaitSize = kReaderNotWaiting;
+}
+
+void BaselineQueue::SetFinished() {
+  _finished = true;
+  notifyWaiters(_dataAvailable);
+}
+
+void BaselineQueue::Abort() {
+  _aborted = true;
+  notifyWaiters(_dataAvailable);
+  notifyWaiters(_dataProcessed);
+}
+
+void BaselineQueue::notifyWaiters(std::condition_variable& condition) {
+  // Taking the lock makes sure that a waiter is either not yet checking its
+  // condition, or is already waiting, so that the notification is never lost.
+  { const std::lock_guard<std::mutex> lock(_waitMutex); }
+  condition.notify_all();
+}
@@ -0,0 +1,118 @@
+#ifndef AOLUA_BASELINE_QUEUE_H
+#define AOLUA_BASELINE_QUEUE_H
+
+#include "options.h"
+
+#include "../imagesets/imageset.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Hands baselines that have been read over to the processing threads.
+ *
+ * Every processing thread has its own FIFO queue with its own lock. The reader
+ * distributes a batch of baselines round-robin over these queues, so that the
+ * threads only contend with the reader and not with each other. A thread whose
+ * queue runs empty steals from the front of the other queues before it goes
+ * to sleep, such that no core is left idle while there is still work queued.
+ *
+ * Because all queues are FIFO, baselines are processed (and therefore written)
+ * in approximately the order in which they were read. With
+ * BaselineOrder::Cost, each batch is first sorted on estimated processing
+ * cost, so that the largest baselines of a batch start first and the last
+ * few baselines of a run are the cheapest ones.
+ */
+class BaselineQueue {
+ public:
+  BaselineQueue(size_t threadCount, BaselineOrder order);
+
+  /**
+   * Adds a batch of baselines. The batch is reordered according to the
+   * order that was given to the constructor.
+   */
+  void PushBatch(std::vector<std::unique_ptr<imagesets::BaselineData>> batch);
+
+  /**
+   * Takes the next baseline for the thread with the given index. If no
+   * baselines are queued, this blocks until new baselines are pushed or until
+   * the queue is finished or aborted, in which case nullptr is returned.
+   */
+  std::unique_ptr<imagesets::BaselineData> Pop(size_t threadIndex);
+
+  /**
+   * Blocks until at most @p maxSize baselines are queued, or the queue was
+   * aborted.
+   */
+  void WaitForSizeAtMost(size_t maxSize);
+
+  /**
+   * Number of queued baselines. The count is changed together with the
+   * queues, so it never exceeds the number of baselines that were pushed and
+   * not yet popped.
+   */
+  size_t Size() const { return _size; }
+
+  /**
+   * Marks that no more baselines will be pushed. Pop() will return nullptr
+   * once the queues have been emptied.
+   */
+  void SetFinished();
+
+  /**
+   * Makes all current and future waits return immediately.
+   */
+  void Abort();
+
+  bool IsAborted() const { return _aborted.load(std::memory_order_acquire); }
+
+  /**
+   * Number of baselines that were taken from another thread's queue.
+   */
+  size_t StolenCount() const {
+    return _stolenCount.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Estimated relative cost of processing a baseline, used for
+   * BaselineOrder::Cost. The primary measure is the number of samples. For
+   * equal sizes, longer baselines get a (slightly) higher cost, which
+   * results in a deterministic "longest baseline first" order.
+   */
+  static double EstimateCost(const imagesets::BaselineData& baseline);
+
+ private:
+  struct ThreadQueue {
+    std::mutex mutex;
+    std::deque<std::unique_ptr<imagesets::BaselineData>> items;
+  };
+
+  std::unique_ptr<imagesets::BaselineData> tryPop(size_t threadIndex);
+  void notifyWaiters(std::condition_variable& condition);
+
+  const BaselineOrder _order;
+  std::vector<ThreadQueue> _queues;
+  size_t _nextQueue;
+
+  std::atomic<size_t> _size;
+  std::atomic<size_t> _stolenCount;
+  std::atomic<bool> _finished;
+  std::atomic<bool> _aborted;
+  // The size for which the reader waits in WaitForSizeAtMost(), or
+  // kReaderNotWaiting. Avoids notifying the reader on every Pop().
+  static constexpr size_t kReaderNotWaiting =
+      std::numeric_limits<size_t>::max();
+  std::atomic<size_t> _readerWaitSize;
+
+  // Only used for sleeping when there is nothing to do; the queues themselves
+  // are protected by their own mutex.
+  std::mutex _waitMutex;
+  std::condition_variable _dataAvailable, _dataProcessed;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef AOLUA_IO_LOCKS_H
+#define AOLUA_IO_LOCKS_H
+
+#include "../util/stopwatch.h"
+
+#include <mutex>
+
+/**
+ * Serializes the I/O of the reader thread and the flag writing thread.
+ *
+ * By default, reading and writing share one mutex, so a flag flush and a
+ * read never run at the same time. When the image set reports that it
+ * supports concurrent reading and writing, the reader and the writer each get
+ * their own mutex, such that reading the next baselines overlaps with writing
+ * the flags of the previous ones.
+ *
+ * The time spent waiting for the locks is accumulated, which shows how much
+ * the reader and writer block each other.
+ */
+class IOLocks {
+ public:
+  IOLocks()
+      : _concurrentReadWrite(false),
+        _readBlockedSeconds(0.0),
+        _writeBlockedSeconds(0.0) {}
+
+  /**
+   * Should be set before any of the locks are used.
+   */
+  void SetConcurrentReadWrite(bool concurrentReadWrite) {
+    _concurrentReadWrite = concurrentReadWrite;
+  }
+  bool ConcurrentReadWrite() const { return _concurrentReadWrite; }
+
+  std::unique_lock<std::mutex> LockForReading() {
+    return lock(_readMutex, _readBlockedSeconds);
+  }
+
+  std::unique_lock<std::mutex> LockForWriting() {
+    return lock(_concurrentReadWrite ? _writeMutex : _readMutex,
+                _writeBlockedSeconds);
+  }
+
+  /**
+   * Total time that reading waited for the lock. Should only be called when
+   * no thread is using the locks.
+   */
+  double ReadBlockedSeconds() const { return _readBlockedSeconds; }
+  double WriteBlockedSeconds() const { return _writeBlockedSeconds; }
+
+ private:
+  static std::unique_lock<std::mutex> lock(std::mutex& mutex,
+                                           double& blockedSeconds) {
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      const Stopwatch watch(true);
+      lock.lock();
+      // The counter is protected by the mutex that was just acquired.
+      blockedSeconds += watch.Seconds();
+    }
+    return lock;
+  }
+
+  bool _concurrentReadWrite;
+  std::mutex _readMutex, _writeMutex;
+  double _readBlockedSeconds, _writeBlockedSeconds;
+};
+
+#endif
@@ -19,6 +19,14 @@ enum class BaselineSelection {
   Current
 };
 
+/**
+ * Order in which baselines are handed to the processing threads.
+ * - Read: baselines are processed in the order in which they are read.
+ * - Cost: within each batch that is read, baselines that are most expensive
+ *   to process (most samples, then longest baseline) are processed first.
+ */
+enum class BaselineOrder { Read, Cost };
+
 struct BaselineIntegration {
   enum Mode { Count, Average, AverageAbs, Squared, Stddev };
   enum Differencing { NoDifference, TimeDifference, FrequencyDifference };
@@ -50,8 +58,12 @@ struct Options {
   std::set<size_t> antennaeToInclude, antennaeToSkip;
   std::set<size_t> bands;
   std::optional<BaselineSelection> baselineSelection;
+  std::optional<BaselineOrder> baselineOrder;
   BaselineIntegration baselineIntegration;
   size_t chunkSize;
+  // Memory in bytes that may be used for chunks that are read or written
+  // while another chunk is flagged. Zero disables pipelining.
+  std::optional<size_t> chunkPipelineMemory;
   std::optional<bool> combineSPWs;
   std::optional<bool> concatenateFrequency;
   std::string dataColumn;
@@ -84,7 +96,10 @@ struct Options {
     if (!other.bands.empty()) bands = other.bands;
     baselineIntegration.Override(other.baselineIntegration);
     if (other.baselineSelection) baselineSelection = other.baselineSelection;
+    if (other.baselineOrder) baselineOrder = other.baselineOrder;
     if (other.chunkSize) chunkSize = other.chunkSize;
+    if (other.chunkPipelineMemory)
+      chunkPipelineMemory = other.chunkPipelineMemory;
     if (other.combineSPWs) combineSPWs = other.combineSPWs;
     if (other.concatenateFrequency)
       concatenateFrequency = other.concatenateFrequency;
@@ -115,7 +130,10 @@ struct Options {
            antennaeToSkip == rhs.antennaeToSkip && bands == rhs.bands &&
            baselineIntegration == rhs.baselineIntegration &&
            baselineSelection == rhs.baselineSelection &&
-           chunkSize == rhs.chunkSize && combineSPWs == rhs.combineSPWs &&
+           baselineOrder == rhs.baselineOrder &&
+           chunkSize == rhs.chunkSize &&
+           chunkPipelineMemory == rhs.chunkPipelineMemory &&
+           combineSPWs == rhs.combineSPWs &&
            concatenateFrequency == rhs.concatenateFrequency &&
            dataColumn == rhs.dataColumn &&
            executeFilename == rhs.executeFilename &&
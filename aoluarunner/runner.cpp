@@ -10,6 +10,7 @@
 
 #include "../structures/msmetadata.h"
 
+#include "../imagesets/filterbankset.h"
 #include "../imagesets/h5imageset.h"
 #include "../imagesets/joinedspwset.h"
 #include "../imagesets/msimageset.h"
@@ -17,6 +18,8 @@
 #include "../imagesets/multibandmsimageset.h"
 
 #include "../util/logger.h"
+#include "../util/memoryplanner.h"
+#include "../util/stopwatch.h"
 
 #include <aocommon/system.h>
 
@@ -24,7 +27,10 @@
 
 #include <algorithm>
 #include <fstream>
+#include <future>
+#include <mutex>
 
+using imagesets::FilterBankSet;
 using imagesets::H5ImageSet;
 using imagesets::ImageSet;
 using imagesets::JoinedSPWSet;
@@ -158,6 +164,31 @@ void Runner::run(const Options& options) {
   }
 }
 
+// Returns the chunk size that was given, or when a memory limit was given but
+// no chunk size, a chunk size such that every chunk can be read in memory.
+// Zero means no chunking.
+static size_t GetChunkSize(const Options& options,
+                           const std::vector<std::string>& ms_names,
+                           size_t n_time_steps) {
+  const BaselineIOMode read_mode =
+      options.readMode.value_or(BaselineIOMode::AutoReadMode);
+  if (options.chunkSize != 0 || !MemoryPlanner::HasLimit() ||
+      (read_mode != BaselineIOMode::AutoReadMode &&
+       read_mode != BaselineIOMode::MemoryReadMode))
+    return options.chunkSize;
+
+  const uint64_t data_size =
+      ms_names.size() *
+      BaselineReader::MeasurementSetIntervalDataSize(
+          ms_names.front(), options.startTimestep, options.endTimestep);
+  const size_t chunk_size = MemoryPlanner::ChunkSize(data_size, n_time_steps);
+  if (chunk_size != 0)
+    Logger::Info << "The data requires " << (data_size / 1000000)
+                 << " MB; to fit the memory limit, chunks of at most "
+                 << chunk_size << " timesteps will be used.\n";
+  return chunk_size;
+}
+
 std::unique_ptr<ImageSet> Runner::initializeImageSet(const Options& options,
                                                      FileOptions& fileOptions) {
   MSOptions msOptions;
@@ -169,6 +200,10 @@ std::unique_ptr<ImageSet> Runner::initializeImageSet(const Options& options,
   if (H5ImageSet* h5ImageSet = dynamic_cast<H5ImageSet*>(imageSet.get());
       h5ImageSet) {
     h5ImageSet->SetInterval(fileOptions.intervalStart, fileOptions.intervalEnd);
+  } else if (FilterBankSet* filterBankSet =
+                 dynamic_cast<FilterBankSet*>(imageSet.get());
+             filterBankSet) {
+    filterBankSet->SetThreadCount(options.CalculateThreadCount());
   } else if (MSImageSet* msImageSet = dynamic_cast<MSImageSet*>(imageSet.get());
              msImageSet) {
     if (options.dataColumn.empty())
@@ -176,31 +211,35 @@ std::unique_ptr<ImageSet> Runner::initializeImageSet(const Options& options,
     else
       msImageSet->SetDataColumnName(options.dataColumn);
     msImageSet->SetReadUVW(options.readUVW.value_or(false));
+    msImageSet->SetReorderThreadCount(options.CalculateThreadCount());
     // during the first iteration, the nr of intervals hasn't been calculated
     // yet. Do that now.
     if (fileOptions.intervalIndex == 0) {
-      if (options.chunkSize != 0) {
+      fileOptions.nIntervals = 1;
+      // A chunk size is also selected when only a memory limit is given.
+      if (options.chunkSize != 0 || MemoryPlanner::HasLimit()) {
         msImageSet->SetInterval(fileOptions.intervalStart,
                                 fileOptions.intervalEnd);
         const size_t obsTimesSize =
             msImageSet->MetaData().GetObservationTimes().size();
-        fileOptions.nIntervals =
-            (obsTimesSize + options.chunkSize - 1) / options.chunkSize;
-        Logger::Info << "Maximum interval size of " << options.chunkSize
-                     << " timesteps for total of " << obsTimesSize
-                     << " timesteps results in " << fileOptions.nIntervals
-                     << " intervals.\n";
-        if (options.startTimestep)
-          fileOptions.resolvedIntStart = *options.startTimestep;
-        else
-          fileOptions.resolvedIntStart = 0;
-        if (options.endTimestep)
-          fileOptions.resolvedIntEnd = *options.endTimestep;
-        else
-          fileOptions.resolvedIntEnd =
-              obsTimesSize + fileOptions.resolvedIntStart;
-      } else {
-        fileOptions.nIntervals = 1;
+        const size_t chunkSize =
+            GetChunkSize(options, {fileOptions.filename}, obsTimesSize);
+        if (chunkSize != 0) {
+          fileOptions.nIntervals = (obsTimesSize + chunkSize - 1) / chunkSize;
+          Logger::Info << "Maximum interval size of " << chunkSize
+                       << " timesteps for total of " << obsTimesSize
+                       << " timesteps results in " << fileOptions.nIntervals
+                       << " intervals.\n";
+          if (options.startTimestep)
+            fileOptions.resolvedIntStart = *options.startTimestep;
+          else
+            fileOptions.resolvedIntStart = 0;
+          if (options.endTimestep)
+            fileOptions.resolvedIntEnd = *options.endTimestep;
+          else
+            fileOptions.resolvedIntEnd =
+                obsTimesSize + fileOptions.resolvedIntStart;
+        }
       }
     }
     if (fileOptions.nIntervals == 1) {
@@ -253,8 +292,7 @@ void Runner::processFile(const Options& options, const std::string& filename,
 
     loadStrategy(lua, options, imageSet);
 
-    std::mutex ioMutex;
-    BaselineIterator blIterator(&ioMutex, options);
+    BaselineIterator blIterator(options);
     blIterator.Run(*imageSet, lua, scriptData);
 
     ++fileOptions.intervalIndex;
@@ -272,9 +310,9 @@ struct ChunkInfo {
   size_t chunk_size;
 };
 
-static std::optional<ChunkInfo> GetChunkInfo(const Options& options,
-                                             const std::string& ms_name) {
-  if (!options.chunkSize) return {};
+static std::optional<ChunkInfo> GetChunkInfo(
+    const Options& options, const std::vector<std::string>& ms_names) {
+  if (!options.chunkSize && !MemoryPlanner::HasLimit()) return {};
 
   assert(options.startTimestep.has_value() == options.endTimestep.has_value() &&
          "These fields should either both be set or both be unset.");
@@ -286,14 +324,15 @@ static std::optional<ChunkInfo> GetChunkInfo(const Options& options,
     result.start_time_step = *options.startTimestep;
     result.end_time_step = *options.endTimestep;
   } else {
-    MSMetaData MetaData{ms_name};
+    MSMetaData MetaData{ms_names.front()};
     result.start_time_step = 0;
     result.end_time_step = MetaData.TimestepCount();
   }
 
   const size_t time_step_count = result.end_time_step - result.start_time_step;
-  result.n_chunks =
-      (time_step_count + options.chunkSize - 1) / options.chunkSize;
+  const size_t chunk_size = GetChunkSize(options, ms_names, time_step_count);
+  if (chunk_size == 0) return {};
+  result.n_chunks = (time_step_count + chunk_size - 1) / chunk_size;
   result.chunk_size = (time_step_count + result.n_chunks - 1) / result.n_chunks;
 
   Logger::Info << "Chunking settings result in " << time_step_count
@@ -304,6 +343,56 @@ static std::optional<ChunkInfo> GetChunkInfo(const Options& options,
   return result;
 }
 
+// Returns the options with the interval set to the interval of the chunk
+// with the given index.
+static Options GetChunkOptions(const Options& options,
+                               const std::optional<ChunkInfo>& chunk_info,
+                               size_t chunk_index) {
+  Options result = options;
+  if (chunk_info) {
+    result.startTimestep =
+        chunk_info->start_time_step + chunk_index * chunk_info->chunk_size;
+    result.endTimestep = chunk_index + 1 == chunk_info->n_chunks
+                             ? chunk_info->end_time_step
+                             : *result.startTimestep + chunk_info->chunk_size;
+  }
+  return result;
+}
+
+// Returns how many chunks, besides the chunk that is being flagged, can be
+// kept in memory to read the next and write the previous chunk while
+// flagging. This is at most two.
+static size_t GetPipelineChunkCount(
+    const Options& options, const std::vector<std::string>& ms_names,
+    const std::optional<ChunkInfo>& chunk_info) {
+  if (!chunk_info || options.chunkPipelineMemory.value_or(0) == 0) return 0;
+
+  // The direct reader reads and writes while the strategy runs, so there is
+  // nothing to overlap.
+  if (options.readMode == BaselineIOMode::DirectReadMode) {
+    Logger::Warn << "Chunk pipelining is not used in direct read mode.\n";
+    return 0;
+  }
+
+  const size_t start = chunk_info->start_time_step;
+  const uint64_t chunk_size =
+      ms_names.size() *
+      BaselineReader::MeasurementSetIntervalDataSize(
+          ms_names.front(), start, start + chunk_info->chunk_size);
+  const size_t n_extra_chunks = std::min<uint64_t>(
+      2, chunk_size == 0 ? 2 : *options.chunkPipelineMemory / chunk_size);
+  if (n_extra_chunks == 0)
+    Logger::Warn << "A chunk requires " << (chunk_size / 1000000)
+                 << " MB, which is more than the chunk pipeline memory of "
+                 << (*options.chunkPipelineMemory / 1000000)
+                 << " MB: chunks will be processed one after the other.\n";
+  else
+    Logger::Info << "Chunks require " << (chunk_size / 1000000)
+                 << " MB; reading and writing of " << n_extra_chunks
+                 << " extra chunk(s) will be overlapped with flagging.\n";
+  return n_extra_chunks;
+}
+
 void Runner::processFrequencyConcatenatedFiles(
     Options options, const std::vector<std::string>& ms_names,
     size_t n_threads) {
@@ -322,66 +411,116 @@ void Runner::processFrequencyConcatenatedFiles(
   const size_t n_io_threads =
       std::min({kMaxIoThreads, n_threads, ms_names.size()});
 
-  int remaining_chunks = 1;
-  const std::optional<ChunkInfo> chunk_info =
-      GetChunkInfo(options, ms_names.front());
   // When the -chunk-size argument is used and more than one chunk is used the
-  // interval is adjusted.
-  if (chunk_info) {
-    remaining_chunks = chunk_info->n_chunks;
-    options.startTimestep = chunk_info->start_time_step;
-    options.endTimestep = *options.startTimestep + chunk_info->chunk_size;
-  }
+  // interval is adjusted per chunk.
+  const std::optional<ChunkInfo> chunk_info =
+      GetChunkInfo(options, ms_names);
+  const size_t n_chunks = chunk_info ? chunk_info->n_chunks : 1;
+  const size_t n_extra_chunks =
+      GetPipelineChunkCount(options, ms_names, chunk_info);
+
+  // When pipelining, the I/O of two chunks may run at the same time. Their
+  // accesses to the same measurement set are serialized with these mutexes.
+  std::vector<std::mutex> ms_mutexes(n_extra_chunks ? ms_names.size() : 0);
+  auto read_chunk = [&](size_t chunk_index) -> std::unique_ptr<ImageSet> {
+    const Options chunk_options =
+        GetChunkOptions(options, chunk_info, chunk_index);
+    return std::make_unique<imagesets::MultiBandMsImageSet>(
+        ms_names,
+        chunk_options.readMode.value_or(BaselineIOMode::AutoReadMode),
+        chunk_options.startTimestep, chunk_options.endTimestep, n_io_threads,
+        n_extra_chunks ? &ms_mutexes : nullptr);
+  };
+  // Writing the flags also releases the memory of the chunk. The statistics
+  // of all chunks are collected in one script data, and are written per band
+  // together with the flags of the last chunk.
+  ScriptData script_data;
+  auto write_chunk = [n_io_threads](std::unique_ptr<ImageSet> image_set,
+                                    const StatisticsCollection* statistics) {
+    static_cast<imagesets::MultiBandMsImageSet*>(image_set.get())
+        ->WriteToMs(n_io_threads, statistics);
+  };
+
+  std::future<std::unique_ptr<ImageSet>> next_chunk;
+  std::future<void> previous_chunk_written;
+  Stopwatch io_wait_watch;
+  for (size_t chunk_index = 0; chunk_index != n_chunks; ++chunk_index) {
+    const Options chunk_options =
+        GetChunkOptions(options, chunk_info, chunk_index);
+
+    std::unique_ptr<ImageSet> image_set;
+    if (next_chunk.valid()) {
+      io_wait_watch.Start();
+      image_set = next_chunk.get();
+      io_wait_watch.Pause();
+    } else {
+      image_set = read_chunk(chunk_index);
+    }
+
+    if (n_extra_chunks != 0 && chunk_index + 1 != n_chunks) {
+      if (n_extra_chunks == 1) {
+        // There is only memory for one other chunk, so the next chunk can
+        // only be read once the previous chunk has been written.
+        next_chunk = std::async(
+            std::launch::async,
+            [&read_chunk, chunk_index,
+             written = std::move(previous_chunk_written)]() mutable {
+              if (written.valid()) written.get();
+              return read_chunk(chunk_index + 1);
+            });
+      } else {
+        next_chunk =
+            std::async(std::launch::async, read_chunk, chunk_index + 1);
+      }
+    }
 
-  // The number of chunks to process is greater than or equal to one.
-  // After processing the next iteration is prepared. Therefore the termination
-  // condition is in the middle of the loop.
-  while (true) {
     if (chunk_info)
-      Logger::Info << "Starting flagging of interval "
-                   << 1 + (chunk_info->n_chunks - remaining_chunks)
-                   << ", timesteps " << *options.startTimestep << " - "
-                   << *options.endTimestep << '\n';
-
-    ProcessFrequencyConcatenatedFilesChunk(options, ms_names, n_threads,
-                                           n_io_threads, chunk_info);
-    if (--remaining_chunks; remaining_chunks == 0) break;
-
-    *options.startTimestep += chunk_info->chunk_size;
-    options.endTimestep = remaining_chunks == 1
-                              ? chunk_info->end_time_step
-                              : *options.startTimestep + chunk_info->chunk_size;
+      Logger::Info << "Starting flagging of interval " << 1 + chunk_index
+                   << ", timesteps " << *chunk_options.startTimestep << " - "
+                   << *chunk_options.endTimestep << '\n';
+    FlagFrequencyConcatenatedChunk(chunk_options, image_set, n_threads,
+                                   script_data);
+
+    const StatisticsCollection* statistics =
+        chunk_index + 1 == n_chunks ? script_data.GetStatistics().get()
+                                    : nullptr;
+    if (statistics)
+      Logger::Debug << "Writing quality statistics to the measurement sets.\n";
+    if (n_extra_chunks == 0) {
+      write_chunk(std::move(image_set), statistics);
+    } else {
+      if (previous_chunk_written.valid()) {
+        io_wait_watch.Start();
+        previous_chunk_written.get();
+        io_wait_watch.Pause();
+      }
+      previous_chunk_written = std::async(std::launch::async, write_chunk,
+                                          std::move(image_set), statistics);
+    }
   }
+  if (previous_chunk_written.valid()) previous_chunk_written.get();
+  if (n_extra_chunks != 0)
+    Logger::Debug << "Flagging waited " << io_wait_watch.ToString()
+                  << " for reading and writing of chunks.\n";
 
   for (const std::string& ms_name : ms_names) {
     writeHistory(options, ms_name);
   }
 }
 
-void Runner::ProcessFrequencyConcatenatedFilesChunk(
-    const Options& options, const std::vector<std::string>& ms_names,
-    size_t n_threads, size_t n_io_threads,
-    const std::optional<ChunkInfo>& chunk_info) {
-  std::unique_ptr<ImageSet> image_set =
-      std::make_unique<imagesets::MultiBandMsImageSet>(
-          ms_names, options.readMode.value_or(BaselineIOMode::AutoReadMode),
-          options.startTimestep, options.endTimestep, n_io_threads);
-
+void Runner::FlagFrequencyConcatenatedChunk(
+    const Options& options, const std::unique_ptr<ImageSet>& image_set,
+    size_t n_threads, ScriptData& script_data) {
   LuaThreadGroup thread_pool(n_threads);
   loadStrategy(thread_pool, options, image_set);
 
-  std::mutex io_mutex;
-  BaselineIterator baseline_iterator(&io_mutex, options);
-  ScriptData script_data;
+  // Statistics are collected per measurement set, such that they can be
+  // written to the measurement set of every band.
+  script_data.SetStatisticsChannelsPerBand(
+      static_cast<const imagesets::MultiBandMsImageSet&>(*image_set)
+          .ChannelsPerBand());
+  BaselineIterator baseline_iterator(options);
   baseline_iterator.Run(*image_set, thread_pool, script_data);
-
-  static_cast<imagesets::MultiBandMsImageSet*>(image_set.get())
-      ->WriteToMs(n_io_threads);
-
-  if (script_data.GetStatistics())
-    Logger::Warn
-        << "Statistics can't be written in multi-MS processing mode.\n"
-           "Please remove collecting statistics from your Lua strategy.\n";
 }
 
 void Runner::writeHistory(const Options& options, const std::string& filename) {
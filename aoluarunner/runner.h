@@ -10,8 +10,6 @@
 #include <string>
 #include <vector>
 
-struct ChunkInfo;
-
 class Runner {
  public:
   explicit Runner(const Options& cmdLineOptions)
@@ -36,10 +34,10 @@ class Runner {
   void processFrequencyConcatenatedFiles(
       Options options, const std::vector<std::string>& filenames,
       size_t n_threads);
-  void ProcessFrequencyConcatenatedFilesChunk(
-      const Options& options, const std::vector<std::string>& ms_names,
-      size_t n_threads, size_t n_io_threads,
-      const std::optional<ChunkInfo>& chunk_info);
+  void FlagFrequencyConcatenatedChunk(
+      const Options& options,
+      const std::unique_ptr<imagesets::ImageSet>& image_set, size_t n_threads,
+      class ScriptData& script_data);
   std::unique_ptr<imagesets::ImageSet> initializeImageSet(
       const Options& options, FileOptions& fileOptions);
   void writeHistory(const Options& options, const std::string& filename);
@@ -2,10 +2,13 @@
 
 #include "../imagesets/multibandmsimageset.h"
 #include "../util/logger.h"
+#include "../util/stopwatch.h"
+
+#include <algorithm>
 
 WriteThread::WriteThread(imagesets::ImageSet& imageSet, size_t calcThreadCount,
-                         std::mutex* ioMutex)
-    : _ioMutex(ioMutex),
+                         IOLocks& ioLocks)
+    : _ioLocks(ioLocks),
       _isWriteFinishing(false),
       _maxWriteBufferItems(calcThreadCount * 5),
       _minWriteBufferItemsForWriting(calcThreadCount * 4) {
@@ -15,7 +18,7 @@ WriteThread::WriteThread(imagesets::ImageSet& imageSet, size_t calcThreadCount,
     // TODO Would this method also be safe for other writers?
     _flusher.reset(new std::thread(flushFunction, &imageSet));
   } else {
-    std::unique_lock<std::mutex> iolock(*_ioMutex);
+    std::unique_lock<std::mutex> iolock = _ioLocks.LockForReading();
     std::unique_ptr<imagesets::ImageSet> localImageSet = imageSet.Clone();
     iolock.unlock();
     _flusher.reset(new std::thread(flushFunction, std::move(localImageSet)));
@@ -30,26 +33,36 @@ WriteThread::~WriteThread() {
 
   Logger::Debug << "Finishing the flusher thread...\n";
   _flusher->join();
+
+  const Metrics metrics = GetMetrics();
+  Logger::Debug << "Wrote the flags of " << metrics.baselinesWritten
+                << " baselines in " << metrics.flushCount << " batches";
+  if (metrics.writeTime > 0.0)
+    Logger::Debug << " (" << (metrics.baselinesWritten / metrics.writeTime)
+                  << " baselines/s)";
+  Logger::Debug << "; at most " << metrics.maxQueueDepth
+                << " baselines waited to be written.\n";
 }
 
 void WriteThread::SaveFlags(const TimeFrequencyData& data,
                             imagesets::ImageSetIndex& imageSetIndex) {
-  std::vector<Mask2DCPtr> masks;
+  std::vector<BitMask2D> masks;
   if (data.MaskCount() <= 1)
-    masks.emplace_back(data.GetSingleMask());
+    masks.emplace_back(*data.GetSingleMask());
   else
     for (size_t i = 0; i < data.MaskCount(); ++i) {
-      masks.emplace_back(data.GetMask(i));
+      masks.emplace_back(*data.GetMask(i));
     }
-  const BufferItem newItem(masks, imageSetIndex);
-  pushInWriteBuffer(newItem);
+  pushInWriteBuffer(BufferItem(std::move(masks), imageSetIndex));
 }
 
-void WriteThread::pushInWriteBuffer(const BufferItem& newItem) {
+void WriteThread::pushInWriteBuffer(BufferItem&& newItem) {
   std::unique_lock<std::mutex> lock(_writeMutex);
   while (_writeBuffer.size() >= _maxWriteBufferItems)
     _writeBufferChange.wait(lock);
-  _writeBuffer.emplace(newItem);
+  _writeBuffer.emplace_back(std::move(newItem));
+  _metrics.maxQueueDepth =
+      std::max(_metrics.maxQueueDepth, _writeBuffer.size());
   _writeBufferChange.notify_all();
 }
 
@@ -59,6 +72,7 @@ void WriteThread::FlushThread::operator()(
 }
 
 void WriteThread::FlushThread::operator()(imagesets::ImageSet* imageSet) {
+  Stopwatch watch;
   std::unique_lock<std::mutex> lock(_parent->_writeMutex);
   do {
     while (_parent->_writeBuffer.size() <
@@ -66,12 +80,8 @@ void WriteThread::FlushThread::operator()(imagesets::ImageSet* imageSet) {
            !_parent->_isWriteFinishing)
       _parent->_writeBufferChange.wait(lock);
 
-    std::stack<BufferItem> bufferCopy;
-    while (!_parent->_writeBuffer.empty()) {
-      const BufferItem item = _parent->_writeBuffer.top();
-      _parent->_writeBuffer.pop();
-      bufferCopy.push(item);
-    }
+    std::deque<BufferItem> bufferCopy;
+    bufferCopy.swap(_parent->_writeBuffer);
     _parent->_writeBufferChange.notify_all();
     if (bufferCopy.size() >= _parent->_minWriteBufferItemsForWriting)
       Logger::Debug << "Flag buffer has reached minimal writing size, flushing "
@@ -80,15 +90,30 @@ void WriteThread::FlushThread::operator()(imagesets::ImageSet* imageSet) {
       Logger::Debug << "Flushing flags...\n";
     lock.unlock();
 
-    std::unique_lock<std::mutex> ioLock(*_parent->_ioMutex);
+    const size_t itemCount = bufferCopy.size();
+    std::unique_lock<std::mutex> ioLock = _parent->_ioLocks.LockForWriting();
+    watch.Start();
+    // The items are handed over in the order in which they were saved, and
+    // each item is released as soon as it is handed over.
     while (!bufferCopy.empty()) {
-      BufferItem item = bufferCopy.top();
-      bufferCopy.pop();
-      imageSet->AddWriteFlagsTask(item._index, item._masks);
+      const BufferItem& item = bufferCopy.front();
+      std::vector<Mask2DCPtr> masks;
+      masks.reserve(item._masks.size());
+      for (const BitMask2D& mask : item._masks)
+        masks.emplace_back(Mask2D::MakePtr(mask.ToMask2D()));
+      imageSet->AddWriteFlagsTask(item._index, masks);
+      bufferCopy.pop_front();
     }
     imageSet->PerformWriteFlagsTask();
+    watch.Pause();
     ioLock.unlock();
 
     lock.lock();
+    if (itemCount != 0) {
+      _parent->_metrics.baselinesWritten += itemCount;
+      ++_parent->_metrics.flushCount;
+    }
+    _parent->_metrics.writeTime = watch.Seconds();
   } while (!_parent->_isWriteFinishing || !_parent->_writeBuffer.empty());
+  Logger::Debug << "Time spent on writing: " << watch.ToString() << '\n';
 }
@@ -1,23 +1,50 @@
 #ifndef AOLUA_WRITE_THREAD_H
 #define AOLUA_WRITE_THREAD_H
 
+#include "iolocks.h"
+
 #include "../imagesets/imageset.h"
 
+#include "../structures/bitmask2d.h"
+
 #include <condition_variable>
+#include <deque>
 #include <memory>
-#include <stack>
 #include <thread>
 #include <vector>
 
 class WriteThread {
  public:
   WriteThread(imagesets::ImageSet& imageSet, size_t calcThreadCount,
-              std::mutex* ioMutex);
+              IOLocks& ioLocks);
   ~WriteThread();
 
   void SaveFlags(const TimeFrequencyData& data,
                  imagesets::ImageSetIndex& imageSetIndex);
 
+  /**
+   * Counters of the written flags, which are logged when the thread finishes.
+   */
+  struct Metrics {
+    // The largest number of baselines that waited to be written.
+    size_t maxQueueDepth = 0;
+    size_t baselinesWritten = 0;
+    size_t flushCount = 0;
+    // Time spent in writing, in seconds.
+    double writeTime = 0.0;
+  };
+
+  /** Number of baselines that currently wait to be written. */
+  size_t QueueDepth() {
+    const std::lock_guard<std::mutex> lock(_writeMutex);
+    return _writeBuffer.size();
+  }
+
+  Metrics GetMetrics() {
+    const std::lock_guard<std::mutex> lock(_writeMutex);
+    return _metrics;
+  }
+
  private:
   struct FlushThread {
     WriteThread* _parent;
@@ -25,17 +52,23 @@ class WriteThread {
     void operator()(imagesets::ImageSet* imageSet);
   };
 
+  /**
+   * The flags of one baseline that wait to be written. The masks are kept
+   * bit-packed, which reduces the memory of the buffer eight-fold, and are
+   * only unpacked when they are handed to the image set.
+   */
   struct BufferItem {
-    BufferItem(const std::vector<Mask2DCPtr>& masks,
+    BufferItem(std::vector<BitMask2D> masks,
                const imagesets::ImageSetIndex& index)
-        : _masks(masks), _index(index) {}
-    std::vector<Mask2DCPtr> _masks;
+        : _masks(std::move(masks)), _index(index) {}
+    std::vector<BitMask2D> _masks;
     imagesets::ImageSetIndex _index;
   };
 
-  void pushInWriteBuffer(const BufferItem& newItem);
+  void pushInWriteBuffer(BufferItem&& newItem);
 
-  std::mutex _writeMutex, *_ioMutex;
+  std::mutex _writeMutex;
+  IOLocks& _ioLocks;
   std::condition_variable _writeBufferChange;
   std::unique_ptr<std::thread> _flusher;
   bool _isWriteFinishing;
@@ -43,7 +76,10 @@ class WriteThread {
   size_t _maxWriteBufferItems;
   size_t _minWriteBufferItemsForWriting;
 
-  std::stack<BufferItem> _writeBuffer;
+  // The baselines are written in the order in which they were processed, such
+  // that a batch contains baselines that are close together in the set.
+  std::deque<BufferItem> _writeBuffer;
+  Metrics _metrics;
 };
 
 #endif
@@ -8,6 +8,8 @@
 
 #include "aoqplotpagecontroller.h"
 
+#include "../../quality/statisticscollection.h"
+
 class FrequencyPageController final : public AOQPlotPageController {
  public:
   void SetPerformFT(bool performFT) { _performFT = performFT; }
@@ -17,12 +19,9 @@ class FrequencyPageController final : public AOQPlotPageController {
                          const std::vector<AntennaInfo>&) override {
     _statistics.clear();
 
-    const std::map<double, class DefaultStatistics>& map =
-        statCollection->FrequencyStatistics();
+    const DoubleStatMap& map = statCollection->FrequencyStatistics();
 
-    for (std::map<double, class DefaultStatistics>::const_iterator i =
-             map.begin();
-         i != map.end(); ++i) {
+    for (DoubleStatMap::const_iterator i = map.begin(); i != map.end(); ++i) {
       _statistics.insert(std::pair<double, DefaultStatistics>(
           i->first / 1000000.0, i->second));
     }
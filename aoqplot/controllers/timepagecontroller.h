@@ -3,6 +3,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "aoqplotpagecontroller.h"
 
@@ -10,20 +11,28 @@
 
 class TimePageController final : public AOQPlotPageController {
  protected:
-  const std::map<double, DefaultStatistics>& getStatistics() const override {
-    if (getStatCollection()->AllTimeStatistics().empty()) {
-      static std::map<double, DefaultStatistics> empty_set;
-      return empty_set;
-    } else {
-      return getStatCollection()->TimeStatistics();
+  void processStatistics(const StatisticsCollection* statCollection,
+                         const std::vector<AntennaInfo>&) override {
+    _statistics.clear();
+    if (!statCollection->AllTimeStatistics().empty()) {
+      const DoubleStatMap& map = statCollection->TimeStatistics();
+      for (DoubleStatMap::const_iterator i = map.begin(); i != map.end(); ++i)
+        _statistics.emplace_hint(_statistics.end(), i->first, i->second);
     }
   }
 
+  const std::map<double, DefaultStatistics>& getStatistics() const override {
+    return _statistics;
+  }
+
   void startLine(XYPlot& plot, const std::string& name, int lineIndex,
                  const std::string& yAxisDesc, bool second_axis) override {
     XYPointSet& points = plot.StartLine(name, "Time", yAxisDesc);
     points.SetUseSecondYAxis(second_axis);
   }
+
+ private:
+  std::map<double, DefaultStatistics> _statistics;
 };
 
 #endif
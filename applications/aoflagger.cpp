@@ -1,8 +1,12 @@
 #include "../aoluarunner/options.h"
 
+#include "../algorithms/sumthreshold.h"
+
+#include "../structures/msmetadataindex.h"
 #include "../structures/types.h"
 
 #include "../util/logger.h"
+#include "../util/memoryplanner.h"
 #include "../util/stopwatch.h"
 #include "../util/numberlist.h"
 
@@ -16,6 +20,7 @@
 #include <iostream>
 #include <string>
 #include <mutex>
+#include <optional>
 
 #define RETURN_SUCCESS 0
 #define RETURN_CMDLINE_ERROR 10
@@ -52,7 +57,10 @@ int main(int argc, char** argv) {
   -strategy <strategy>
      Specifies a customized strategy.
   -direct-read
-     Will perform the slowest IO but will always work.
+     Will perform the slowest IO but will always work. With
+     -concatenate-frequency, the measurement sets are streamed: baselines are
+     read from all subbands in groups and their flags are written while
+     flagging, such that the memory does not depend on the -chunk-size.
   -indirect-read
      Will reorder the measurement set before starting, which is normally faster
      but requires free disk space to reorder the data to.
@@ -65,6 +73,14 @@ int main(int argc, char** argv) {
   -skip-flagged
      Will skip an ms if it has already been processed by AOFlagger according to
      its HISTORY table.
+  -metadata-index
+     Stores the metadata of the main table of a measurement set in an index
+     file next to the measurement set (<name>.aoflagger-index), and uses this
+     index when the measurement set is opened again. This avoids reading the
+     entire main table to find the baselines and timesteps. The index is
+     recreated when the main table has changed.
+  -metadata-index-dir <directory>
+     Like -metadata-index, but stores the index files in the given directory.
   -uvw
      Reads uvw values (some exotic strategies require these).
   -column <name>
@@ -80,6 +96,22 @@ int main(int argc, char** argv) {
      100 the difference is mostly not problematic either. In some cases,
      splitting the data increases accuracy, in particular when the statistics
      in the set change significantly over time (e.g.  rising Galaxy).
+  -chunk-pipeline-memory <mb>
+     When processing chunks with -concatenate-frequency, read the next chunk
+     and write the flags of the previous chunk while the current chunk is
+     flagged. This keeps up to two extra chunks in memory; the given number of
+     megabytes limits the memory for these extra chunks. When a single extra
+     chunk fits, writing the previous chunk and reading the next chunk are
+     done one after the other, but still while flagging. Not used with
+     -direct-read. Default: 0 (disabled).
+  -memory-limit <limit>
+     Limits the memory that is used, either as an absolute size (e.g. 16G or
+     500M) or as a percentage (e.g. 50%) or fraction (e.g. 0.5) of the available
+     memory. The read mode, the number of threads and the number of baselines
+     that are buffered are chosen to fit in this limit. When no -chunk-size is
+     given, measurement sets that don't fit in memory are split into chunks
+     that do fit. Even without this option, memory limits of the cgroup that
+     aoflagger runs in (e.g. set by a batch system) are taken into account.
   -bands <list>
      Comma separated list of (zero-indexed) band ids to process.
   -fields <list>
@@ -88,6 +120,11 @@ int main(int argc, char** argv) {
      Run the strategy on the given baseline types. The default is to run
      the strategy on all cross-correlation baselines. This parameter has no
      effect for single-dish observations.
+  -baseline-order < read / cost >
+     Order in which the baselines are processed. 'read' processes baselines in
+     the order in which they are read (default). 'cost' processes the
+     baselines with the most samples and the longest baselines first, which
+     avoids a few large baselines holding up the end of a run.
   -combine-spws
      Join all SPWs together in frequency direction before flagging.
   -preamble <statement>
@@ -98,6 +135,11 @@ int main(int argc, char** argv) {
      Reads all obs arguments and processes them as one measurement set. Every
      obs argument contains one band the same measurement; meaning the other
      metadata of the measurement sets is identical.
+  -sumthreshold-isa < reference / sse / avx2 / avx512 >
+     Forces the SumThreshold algorithm to use the kernels for the given
+     instruction set, instead of the best one supported by the CPU. This is
+     meant for comparing and benchmarking the implementations. The
+     AOFLAGGER_SUMTHRESHOLD_ISA environment variable has the same effect.
 
 This tool supports the Casacore measurement set, the SDFITS and Filterbank
 formats and some more. See the documentation for support of other file types.
@@ -109,6 +151,7 @@ formats and some more. See the documentation for support of other file types.
   }
 
   Options options;
+  std::optional<algorithms::SumThreshold::Isa> sumThresholdIsa;
 
   size_t parameterIndex = 1;
   while (parameterIndex < (size_t)argc && argv[parameterIndex][0] == '-') {
@@ -142,6 +185,11 @@ formats and some more. See the documentation for support of other file types.
       options.strategyFilename = argv[parameterIndex];
     } else if (flag == "skip-flagged") {
       options.skipFlagged = true;
+    } else if (flag == "metadata-index") {
+      MSMetaDataIndex::Enable(std::string());
+    } else if (flag == "metadata-index-dir") {
+      ++parameterIndex;
+      MSMetaDataIndex::Enable(std::string(argv[parameterIndex]));
     } else if (flag == "uvw") {
       options.readUVW = true;
     } else if (flag == "column") {
@@ -167,6 +215,18 @@ formats and some more. See the documentation for support of other file types.
     } else if (flag == "chunk-size" || flag == "max-interval-size") {
       ++parameterIndex;
       options.chunkSize = atoi(argv[parameterIndex]);
+    } else if (flag == "memory-limit") {
+      ++parameterIndex;
+      try {
+        MemoryPlanner::SetLimit(std::string(argv[parameterIndex]));
+      } catch (std::exception& e) {
+        Logger::Error << "Incorrect usage; " << e.what() << ".\n";
+        return RETURN_CMDLINE_ERROR;
+      }
+    } else if (flag == "chunk-pipeline-memory") {
+      ++parameterIndex;
+      options.chunkPipelineMemory =
+          size_t(atof(argv[parameterIndex]) * 1e6);
     } else if (flag == "baselines") {
       ++parameterIndex;
       const std::string bTypes = argv[parameterIndex];
@@ -181,6 +241,32 @@ formats and some more. See the documentation for support of other file types.
                          "to 'all', 'cross' or 'auto'.\n";
         return RETURN_CMDLINE_ERROR;
       }
+    } else if (flag == "baseline-order") {
+      ++parameterIndex;
+      const std::string order = argv[parameterIndex];
+      if (order == "read") {
+        options.baselineOrder = BaselineOrder::Read;
+      } else if (order == "cost") {
+        options.baselineOrder = BaselineOrder::Cost;
+      } else {
+        Logger::Error << "Incorrect usage; baseline-order parameter should be "
+                         "set to 'read' or 'cost'.\n";
+        return RETURN_CMDLINE_ERROR;
+      }
+    } else if (flag == "sumthreshold-isa") {
+      ++parameterIndex;
+      try {
+        sumThresholdIsa =
+            algorithms::SumThreshold::ParseIsa(argv[parameterIndex]);
+      } catch (std::exception& e) {
+        Logger::Error << "Incorrect usage; " << e.what() << ".\n";
+        return RETURN_CMDLINE_ERROR;
+      }
+      if (!algorithms::SumThreshold::IsSupported(*sumThresholdIsa)) {
+        Logger::Error << "The " << argv[parameterIndex]
+                      << " instruction set is not supported by this CPU.\n";
+        return RETURN_CMDLINE_ERROR;
+      }
     } else {
       Logger::Error << "Incorrect usage; parameter \"" << argv[parameterIndex]
                     << "\" not understood.\n";
@@ -196,6 +282,9 @@ formats and some more. See the documentation for support of other file types.
 
     checkRelease();
 
+    if (sumThresholdIsa)
+      algorithms::SumThreshold::SelectIsa(*sumThresholdIsa);
+
     const Stopwatch watch(true);
 
     std::stringstream commandLineStr;
@@ -80,8 +80,8 @@ int main(int argc, char* argv[]) {
         } else if (helpAction == "collect") {
           std::cout
               << "Syntax: " << argv[0]
-              << " collect [-d [column]/-tf/-h] <ms> [quack timesteps] [list "
-                 "of antennae]\n\n"
+              << " collect [-d [column]/-tf/-h/-double] <ms> [quack timesteps] "
+                 "[list of antennae]\n\n"
                  "The collect action will go over a whole measurement set and "
                  "\n"
                  "collect the default statistics. It will write the results in "
@@ -92,7 +92,12 @@ int main(int argc, char* argv[]) {
                  "The subtables that will be updated are:\n"
                  "\tQUALITY_KIND_NAME, QUALITY_TIME_STATISTIC,\n"
                  "\tQUALITY_FREQUENCY_STATISTIC and "
-                 "QUALITY_BASELINE_STATISTIC.\n\n";
+                 "QUALITY_BASELINE_STATISTIC.\n\n"
+                 "With -double, sums are accumulated in double precision with "
+                 "compensated\n"
+                 "summation instead of in long double precision, which is "
+                 "faster and\n"
+                 "nearly as accurate.\n\n";
         } else if (helpAction == "summarize") {
           std::cout
               << "Syntax: " << argv[0]
@@ -152,7 +157,8 @@ int main(int argc, char* argv[]) {
         return -1;
       } else {
         int argi = 2;
-        bool histograms = false, timeFrequency = false;
+        bool histograms = false, timeFrequency = false,
+             compensatedSummation = false;
         const char* dataColumnName = "DATA";
         size_t intervalStart = 0, intervalEnd = 0;
         while (argi < argc && argv[argi][0] == '-') {
@@ -164,6 +170,8 @@ int main(int argc, char* argv[]) {
             dataColumnName = argv[argi];
           } else if (p == "tf") {
             timeFrequency = true;
+          } else if (p == "double") {
+            compensatedSummation = true;
           } else if (p == "interval") {
             intervalStart = atoi(argv[argi + 1]);
             intervalEnd = atoi(argv[argi + 2]);
@@ -195,7 +203,8 @@ int main(int argc, char* argv[]) {
           mode = Collector::CollectDefault;
         quality::CollectStatistics(filename, mode, flaggedTimesteps,
                                    std::move(flaggedAntennae), dataColumnName,
-                                   intervalStart, intervalEnd);
+                                   intervalStart, intervalEnd,
+                                   compensatedSummation);
       }
     } else if (action == "combine") {
       if (argc < 3) {
@@ -4,12 +4,98 @@
 
 #include "../lua/telescopefile.h"
 
-#include <aocommon/system.h>
+#include "../util/memoryplanner.h"
 
+#include <aocommon/parallelfor.h>
+
+#include <cerrno>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace imagesets {
 
+namespace {
+// Samples are transposed in square blocks, such that both the samples that
+// are read and those that are written stay in the cache.
+constexpr size_t kBlockSize = 64;
+// Approximate number of bytes that are written at once when writing flags.
+constexpr size_t kWriteBlockSize = 8 * 1024 * 1024;
+
+template <typename T>
+T LoadSample(const char* data) {
+  // The data in the mapping is not necessarily aligned.
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+/**
+ * Converts the samples of timesteps [xStart, xEnd) of type T, stored as
+ * [time][channel], into the image. For floating point samples, non-finite
+ * values are flagged in the mask.
+ */
+template <typename T>
+void TransposeSamples(const char* data, size_t xStart, size_t xEnd,
+                      Image2D& image, Mask2D& mask) {
+  const size_t channelCount = image.Height();
+  for (size_t yBlock = 0; yBlock < channelCount; yBlock += kBlockSize) {
+    const size_t yEnd = std::min(yBlock + kBlockSize, channelCount);
+    for (size_t xBlock = xStart; xBlock < xEnd; xBlock += kBlockSize) {
+      const size_t xBlockEnd = std::min(xBlock + kBlockSize, xEnd);
+      for (size_t y = yBlock; y != yEnd; ++y) {
+        num_t* imageRow = image.ValuePtr(0, y);
+        bool* maskRow = mask.ValuePtr(0, y);
+        const char* sample = data + (xBlock * channelCount + y) * sizeof(T);
+        for (size_t x = xBlock; x != xBlockEnd; ++x) {
+          const num_t value = LoadSample<T>(sample);
+          imageRow[x] = value;
+          if constexpr (std::is_floating_point_v<T>)
+            maskRow[x] = !std::isfinite(value);
+          sample += channelCount * sizeof(T);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Overwrites the flagged samples of timesteps [xStart, xEnd) in @p data,
+ * which holds these timesteps as [time][channel], with @p flagValue.
+ */
+template <typename T>
+void ApplyFlags(char* data, size_t xStart, size_t xEnd, const Mask2D& flags,
+                T flagValue) {
+  const size_t channelCount = flags.Height();
+  for (size_t yBlock = 0; yBlock < channelCount; yBlock += kBlockSize) {
+    const size_t yEnd = std::min(yBlock + kBlockSize, channelCount);
+    for (size_t xBlock = xStart; xBlock < xEnd; xBlock += kBlockSize) {
+      const size_t xBlockEnd = std::min(xBlock + kBlockSize, xEnd);
+      for (size_t y = yBlock; y != yEnd; ++y) {
+        const bool* flagRow = flags.ValuePtr(0, y);
+        for (size_t x = xBlock; x != xBlockEnd; ++x) {
+          if (flagRow[x])
+            std::memcpy(
+                data + ((x - xStart) * channelCount + y) * sizeof(T),
+                &flagValue, sizeof(T));
+        }
+      }
+    }
+  }
+}
+
+[[noreturn]] void ThrowIoError(const std::string& what,
+                               const std::string& filename) {
+  throw std::runtime_error("Error while trying to " + what +
+                           " filterbank file '" + filename +
+                           "': " + std::strerror(errno));
+}
+}  // namespace
+
 FilterBankSet::FilterBankSet(const std::string& location)
     : _location(location),
       _timeOfSample(0.0),
@@ -24,6 +110,7 @@ FilterBankSet::FilterBankSet(const std::string& location)
       _iBeam(0),
       _machineId(0),
       _intervalCount(0),
+      _threadCount(1),
       _headerEnd(0) {
   std::ifstream file(_location.c_str());
   if (!file.good())
@@ -71,11 +158,26 @@ FilterBankSet::FilterBankSet(const std::string& location)
       readInt(file);
   }
   _headerEnd = file.tellg();
+  if (!file.good())
+    throw std::runtime_error("Filterbank file " + _location +
+                             " has an incomplete header");
+  if (_bitCount != 8 && _bitCount != 16 && _bitCount != 32)
+    throw std::runtime_error("Filterbank file has " +
+                             std::to_string(_bitCount) +
+                             "-bit samples: only 8, 16 and 32-bit samples "
+                             "are supported");
+  if (_channelCount == 0)
+    throw std::runtime_error("Filterbank file has no channels");
+  _mappedFile = std::make_shared<MappedFile>(_location, false);
+  const size_t dataSize = _mappedFile->Size() - size_t(_headerEnd);
+  const size_t availableSamples = dataSize / (_channelCount * sampleSize());
   if (_sampleCount == 0) {
-    file.seekg(0, std::ios::end);
-    const std::streampos endPos = file.tellg();
-    const size_t dataSize = endPos - _headerEnd;
-    _sampleCount = (dataSize * 8) / _channelCount / _bitCount;
+    _sampleCount = availableSamples;
+  } else if (_sampleCount > availableSamples) {
+    Logger::Warn << "Filterbank file has " << _sampleCount
+                 << " samples according to its header, but only holds "
+                 << availableSamples << " samples.\n";
+    _sampleCount = availableSamples;
   }
   Logger::Debug << "tsamp=" << _timeOfSample << ", tstart=" << _timeStart
                 << ", fch1=" << _fch1 << ", foff=" << _foff << '\n'
@@ -85,52 +187,56 @@ FilterBankSet::FilterBankSet(const std::string& location)
                 << ", telescope_ID=" << _telescopeId << '\n';
 
   _timeStart = Date::MJDToAipsMJD(_timeStart);
-
-  const double sizeOfImage =
-      double(_channelCount) * _sampleCount * _bitCount / 8.0;
-  const double memSize = aocommon::system::TotalMemory();
-  _intervalCount = ceil(sizeOfImage / (memSize / 16.0));
-  if (_intervalCount < 1) _intervalCount = 1;
-  if (_intervalCount * 8 > _sampleCount) _intervalCount = _sampleCount / 8;
-  Logger::Debug << round(sizeOfImage * 1e-8) * 0.1
-                << " GB/image required of total of "
-                << round(memSize * 1e-8) * 0.1 << " GB of mem, splitting in "
-                << _intervalCount << " intervals\n";
 }
 
 void FilterBankSet::AddReadRequest(const ImageSetIndex& index) {
   _requests.push_back(new BaselineData(index));
 }
 
-std::unique_ptr<BaselineData> FilterBankSet::GetNextRequested() {
-  if (_bitCount != 32)
-    throw std::runtime_error(
-        "Only support for 32-bit filterbank sets has been added as of yet");
-
-  std::unique_ptr<BaselineData> baseline(std::move(_requests.front()));
-  _requests.pop_front();
-  const size_t intervalIndex = baseline->Index().Value();
-
-  const size_t startIndex = (_sampleCount * intervalIndex) / _intervalCount,
-               endIndex = (_sampleCount * (intervalIndex + 1)) / _intervalCount;
+void FilterBankSet::PerformReadRequests(class ProgressListener&) {
+  for (BaselineData* baseline : _requests) {
+    const size_t intervalIndex = baseline->Index().Value();
+    const size_t startIndex = intervalStart(intervalIndex),
+                 endIndex = intervalStart(intervalIndex + 1);
+    const size_t rowSize = _channelCount * sampleSize();
+    _mappedFile->WillNeed(size_t(_headerEnd) + startIndex * rowSize,
+                          (endIndex - startIndex) * rowSize);
+  }
+  for (BaselineData* baseline : _requests) readInterval(*baseline);
+}
 
-  std::ifstream file(_location.c_str());
-  file.seekg(_headerEnd +
-             std::streampos(startIndex * sizeof(float) * _channelCount));
+void FilterBankSet::readInterval(BaselineData& baseline) const {
+  const size_t intervalIndex = baseline.Index().Value();
+  const size_t startIndex = intervalStart(intervalIndex),
+               endIndex = intervalStart(intervalIndex + 1);
+  const size_t width = endIndex - startIndex;
+  const char* data = _mappedFile->Data() + size_t(_headerEnd) +
+                     startIndex * _channelCount * sampleSize();
 
-  const Image2DPtr image =
-      Image2D::CreateUnsetImagePtr(endIndex - startIndex, _channelCount);
+  const Image2DPtr image = Image2D::CreateUnsetImagePtr(width, _channelCount);
   const Mask2DPtr mask =
-      Mask2D::CreateUnsetMaskPtr(endIndex - startIndex, _channelCount);
-  std::vector<float> buffer(_channelCount);
-  for (size_t x = 0; x != endIndex - startIndex; ++x) {
-    file.read(reinterpret_cast<char*>(&buffer[0]),
-              _channelCount * sizeof(float));
-    for (size_t y = 0; y != _channelCount; ++y) {
-      image->SetValue(x, y, buffer[y]);
-      mask->SetValue(x, y, !std::isfinite(buffer[y]));
+      Mask2D::CreateSetMaskPtr<false>(width, _channelCount);
+  // Threads convert separate blocks of timesteps. An empty interval has no
+  // blocks, but ParallelFor needs at least one thread.
+  const size_t blockCount = (width + kBlockSize - 1) / kBlockSize;
+  aocommon::ParallelFor<size_t> executor(
+      std::max<size_t>(1, std::min(_threadCount, blockCount)));
+  executor.Run(0, blockCount, [&](size_t block) {
+    const size_t xStart = block * kBlockSize;
+    const size_t xEnd = std::min(xStart + kBlockSize, width);
+    switch (_bitCount) {
+      case 8:
+        TransposeSamples<uint8_t>(data, xStart, xEnd, *image, *mask);
+        break;
+      case 16:
+        TransposeSamples<uint16_t>(data, xStart, xEnd, *image, *mask);
+        break;
+      default:
+        TransposeSamples<float>(data, xStart, xEnd, *image, *mask);
+        break;
     }
-  }
+  });
+
   TimeFrequencyData tfData(TimeFrequencyData::AmplitudePart,
                            aocommon::Polarization::StokesI, image);
   tfData.SetGlobalMask(mask);
@@ -156,55 +262,99 @@ std::unique_ptr<BaselineData> FilterBankSet::GetNextRequested() {
     band.channels.push_back(channel);
   }
   metaData->SetBand(band);
-  std::vector<double> observationTimes(endIndex - startIndex);
+  std::vector<double> observationTimes(width);
   for (size_t t = startIndex; t != endIndex; ++t)
     observationTimes[t - startIndex] = (_timeStart + _timeOfSample * t);
   metaData->SetObservationTimes(observationTimes);
   metaData->SetValueDescription("Power");
 
-  baseline->SetData(tfData);
-  baseline->SetMetaData(metaData);
+  baseline.SetData(tfData);
+  baseline.SetMetaData(metaData);
+}
 
+std::unique_ptr<BaselineData> FilterBankSet::GetNextRequested() {
+  std::unique_ptr<BaselineData> baseline(std::move(_requests.front()));
+  _requests.pop_front();
   return baseline;
 }
 
 void FilterBankSet::AddWriteFlagsTask(const ImageSetIndex& index,
                                       std::vector<Mask2DCPtr>& flags) {
-  if (_bitCount != 32)
-    throw std::runtime_error(
-        "Only support for 32-bit filterbank sets has been added as of yet");
-
   const size_t intervalIndex = index.Value();
+  const size_t startIndex = intervalStart(intervalIndex),
+               endIndex = intervalStart(intervalIndex + 1);
+  const size_t width = endIndex - startIndex;
+  const size_t rowSize = _channelCount * sampleSize();
+  const Mask2D& mask = *flags[0];
 
-  const size_t startIndex = (_sampleCount * intervalIndex) / _intervalCount,
-               endIndex = (_sampleCount * (intervalIndex + 1)) / _intervalCount;
-
-  std::fstream file(_location.c_str());
-  file.seekg(_headerEnd +
-             std::streampos(startIndex * sizeof(float) * _channelCount));
-
-  std::vector<float> buffer(_channelCount);
-  for (size_t x = 0; x != endIndex - startIndex; ++x) {
-    const std::streampos pos = file.tellg();
-    file.read(reinterpret_cast<char*>(&buffer[0]),
-              _channelCount * sizeof(float));
-    for (size_t y = 0; y != _channelCount; ++y) {
-      if (flags[0]->Value(x, y))
-        buffer[y] = std::numeric_limits<float>::quiet_NaN();
+  const int fd = open(_location.c_str(), O_WRONLY);
+  if (fd < 0) ThrowIoError("open", _location);
+  // The interval is written in blocks of whole timesteps, which are
+  // independent and are therefore processed in parallel.
+  const size_t rowsPerBlock = std::max<size_t>(1, kWriteBlockSize / rowSize);
+  const size_t blockCount = (width + rowsPerBlock - 1) / rowsPerBlock;
+  std::vector<int> errors(blockCount, 0);
+  aocommon::ParallelFor<size_t> executor(
+      std::max<size_t>(1, std::min(_threadCount, blockCount)));
+  executor.Run(0, blockCount, [&](size_t block) {
+    const size_t xStart = block * rowsPerBlock;
+    const size_t xEnd = std::min(xStart + rowsPerBlock, width);
+    const size_t offset = size_t(_headerEnd) + (startIndex + xStart) * rowSize;
+    std::vector<char> buffer(_mappedFile->Data() + offset,
+                             _mappedFile->Data() + offset +
+                                 (xEnd - xStart) * rowSize);
+    switch (_bitCount) {
+      case 8:
+        ApplyFlags<uint8_t>(buffer.data(), xStart, xEnd, mask, 0);
+        break;
+      case 16:
+        ApplyFlags<uint16_t>(buffer.data(), xStart, xEnd, mask, 0);
+        break;
+      default:
+        ApplyFlags<float>(buffer.data(), xStart, xEnd, mask,
+                          std::numeric_limits<float>::quiet_NaN());
+        break;
+    }
+    size_t written = 0;
+    while (written != buffer.size()) {
+      const ssize_t result = pwrite(fd, buffer.data() + written,
+                                    buffer.size() - written, offset + written);
+      if (result < 0) {
+        if (errno == EINTR) continue;
+        errors[block] = errno;
+        return;
+      }
+      written += result;
+    }
+  });
+  for (const int error : errors) {
+    if (error != 0) {
+      close(fd);
+      errno = error;
+      ThrowIoError("write flags to", _location);
     }
-    file.seekp(pos);
-    file.write(reinterpret_cast<char*>(&buffer[0]),
-               _channelCount * sizeof(float));
   }
+  if (close(fd) != 0) ThrowIoError("close", _location);
 }
 
 std::string FilterBankSet::TelescopeName() {
   return TelescopeFile::TelescopeName(TelescopeFile::GENERIC_TELESCOPE);
 }
 
-void FilterBankSet::Initialize() {}
-
-void FilterBankSet::PerformReadRequests(class ProgressListener&) {}
+void FilterBankSet::Initialize() {
+  // The image is converted to floats, and masks are stored as bools.
+  const double sizeOfImage =
+      double(_channelCount) * _sampleCount * (sizeof(float) + sizeof(bool));
+  const uint64_t memSize = MemoryPlanner::Budget();
+  // The interval count does not depend on the number of threads, because
+  // splitting the image changes the flagging result.
+  _intervalCount =
+      MemoryPlanner::IntervalCount(sizeOfImage, _sampleCount, memSize);
+  Logger::Debug << round(sizeOfImage * 1e-8) * 0.1
+                << " GB/image required of total of "
+                << round(memSize * 1e-8) * 0.1 << " GB of mem, splitting in "
+                << _intervalCount << " intervals\n";
+}
 
 void FilterBankSet::PerformWriteDataTask(
     const ImageSetIndex& index, std::vector<Image2DCPtr> realImages,
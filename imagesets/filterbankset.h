@@ -1,6 +1,7 @@
 #ifndef FILTERBANKSET_H
 #define FILTERBANKSET_H
 
+#include <algorithm>
 #include <deque>
 #include <memory>
 #include <string>
@@ -8,10 +9,22 @@
 
 #include "imageset.h"
 
+#include "../msio/mappedfile.h"
+
 #include "../util/logger.h"
 
 namespace imagesets {
 
+/**
+ * Image set for Sigproc filterbank files with 8-bit or 16-bit unsigned
+ * integer, or 32-bit floating point samples. The file is split into time
+ * intervals, which are read from a memory mapping of the file and can be
+ * processed by multiple threads at the same time.
+ *
+ * Flags are written back into the data, because the format has no flags:
+ * flagged samples are set to NaN in floating point files, and to zero in
+ * integer files.
+ */
 class FilterBankSet final : public ImageSet {
  public:
   explicit FilterBankSet(const std::string& location);
@@ -47,6 +60,20 @@ class FilterBankSet final : public ImageSet {
 
   void Initialize() override;
 
+  /**
+   * Number of threads that are used to convert the data of an interval. The
+   * number of intervals does not depend on it.
+   */
+  void SetThreadCount(size_t threadCount) {
+    _threadCount = std::max<size_t>(threadCount, 1);
+  }
+
+  /**
+   * Reads use a memory mapping and flag writes use their own file
+   * descriptor, and different intervals use different parts of the file.
+   */
+  bool SupportsConcurrentReadWrite() const override { return true; }
+
   void PerformWriteDataTask(const ImageSetIndex& index,
                             std::vector<Image2DCPtr> realImages,
                             std::vector<Image2DCPtr> imaginaryImages) override;
@@ -68,10 +95,19 @@ class FilterBankSet final : public ImageSet {
   size_t _nBeams, _iBeam;
   int _machineId, _telescopeId;
   size_t _intervalCount;
+  size_t _threadCount;
   std::streampos _headerEnd;
+  // Shared with clones; the mapping is only read from.
+  std::shared_ptr<MappedFile> _mappedFile;
 
   std::deque<BaselineData*> _requests;
 
+  size_t intervalStart(size_t intervalIndex) const {
+    return (_sampleCount * intervalIndex) / _intervalCount;
+  }
+  size_t sampleSize() const { return _bitCount / 8; }
+  void readInterval(BaselineData& baseline) const;
+
   static int32_t readInt(std::istream& str) {
     int32_t val;
     str.read(reinterpret_cast<char*>(&val), sizeof(int32_t));
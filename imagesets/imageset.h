@@ -92,6 +92,14 @@ class ImageSet {
       std::vector<Image2DCPtr> /*_imaginaryImages*/) {
     throw std::runtime_error("Not implemented");
   }
+  /**
+   * Returns true when PerformReadRequests() may run in one thread while
+   * PerformWriteFlagsTask() runs in another thread, either on this image set
+   * or on a Clone() of it. When false, reading and writing have to be
+   * serialized by the caller.
+   */
+  virtual bool SupportsConcurrentReadWrite() const { return false; }
+
   /**
    * If an imageset has the concept of cross correlations, this returns true.
    * When true, aoflagger will by default only process baselines that are formed
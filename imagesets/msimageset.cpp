@@ -46,6 +46,7 @@ void MSImageSet::initReader() {
         ReorderingBaselineReader* indirectReader =
             new ReorderingBaselineReader(_msFile);
         indirectReader->SetReadUVW(_readUVW);
+        indirectReader->SetReorderThreadCount(_reorderThreadCount);
         _reader = BaselineReaderPtr(indirectReader);
       } break;
       case DirectReadMode:
@@ -35,6 +35,7 @@ class MSImageSet final : public IndexableSet {
         _sequencesPerBaselineCount(0),
         _readFlags(true),
         _readUVW(false),
+        _reorderThreadCount(0),
         _ioMode(ioMode) {}
 
   MSImageSet(const MSImageSet&) = default;
@@ -76,6 +77,13 @@ class MSImageSet final : public IndexableSet {
 
   BaselineReaderPtr Reader() const override { return _reader; }
 
+  /**
+   * A clone shares the reader, so this depends only on the reader.
+   */
+  bool SupportsConcurrentReadWrite() const override {
+    return _reader && _reader->SupportsConcurrentReadWrite();
+  }
+
   MSMetaData& MetaData() { return _metaData; }
 
   size_t GetAntenna1(const ImageSetIndex& index) const override {
@@ -129,6 +137,13 @@ class MSImageSet final : public IndexableSet {
   size_t FieldCount() const { return _fieldCount; }
   void SetReadFlags(bool readFlags) { _readFlags = readFlags; }
   void SetReadUVW(bool readUVW) { _readUVW = readUVW; }
+  /**
+   * Number of threads used when the measurement set is reordered. Zero means
+   * one thread per processor.
+   */
+  void SetReorderThreadCount(size_t threadCount) {
+    _reorderThreadCount = threadCount;
+  }
   const std::vector<MSMetaData::Sequence>& Sequences() const {
     return _sequences;
   }
@@ -148,6 +163,7 @@ class MSImageSet final : public IndexableSet {
         _dataColumnName("DATA"),
         _readFlags(true),
         _readUVW(false),
+        _reorderThreadCount(0),
         _ioMode(AutoReadMode) {}
   void initReader();
   static const size_t not_found = std::numeric_limits<size_t>::max();
@@ -165,6 +181,7 @@ class MSImageSet final : public IndexableSet {
   std::vector<MSMetaData::Sequence> _sequences;
   size_t _bandCount, _fieldCount, _sequencesPerBaselineCount;
   bool _readFlags, _readUVW;
+  size_t _reorderThreadCount;
   BaselineIOMode _ioMode;
   std::vector<BaselineData> _baselineData;
 };
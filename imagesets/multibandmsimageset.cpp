@@ -4,6 +4,8 @@
 #include "../msio/directbaselinereader.h"
 #include "../msio/memorybaselinereader.h"
 #include "../msio/reorderingbaselinereader.h"
+#include "../quality/qualitytablesformatter.h"
+#include "../quality/statisticscollection.h"
 #include "../util/logger.h"
 #include "../util/progress/dummyprogresslistener.h"
 #include "../util/progress/subtasklistener.h"
@@ -40,19 +42,36 @@ static std::unique_ptr<BaselineReader> CreateReader(const std::string& ms_name,
 MultiBandMsImageSet::MultiBandMsImageSet(
     const std::vector<std::string>& ms_names, BaselineIOMode io_mode,
     std::optional<size_t> start_time_step, std::optional<size_t> end_time_step,
-    size_t n_threads)
-    : ms_names_(ms_names) {
+    size_t n_threads, std::vector<std::mutex>* ms_mutexes)
+    : ms_names_(ms_names), n_io_threads_(n_threads) {
+  // The mutexes are installed first, because every access to a measurement
+  // set, including opening it, should hold its lock: another set may be
+  // writing to it.
+  if (ms_mutexes) {
+    assert(ms_mutexes->size() == ms_names_.size());
+    for (std::mutex& mutex : *ms_mutexes) reader_mutexes_.emplace_back(&mutex);
+  }
+
   // AutoReadMode behaves as-if MemoryReadMode. When the estimated amount of
   // memory is insufficent switch to the direct reader. This behaviour matches
   // MSImageSet::initReader.
-  if (io_mode == BaselineIOMode::AutoReadMode &&
-      !MemoryBaselineReader::IsEnoughMemoryAvailable(
-          ms_names.size() * BaselineReader::MeasurementSetIntervalDataSize(
-                                ms_names[0], start_time_step, end_time_step)))
-    io_mode = BaselineIOMode::ReorderingReadMode;
-
-  for (const std::string& ms_name : ms_names_) {
-    readers_.emplace_back(CreateReader(ms_name, io_mode));
+  if (io_mode == BaselineIOMode::AutoReadMode) {
+    uint64_t ms_size;
+    {
+      const std::unique_lock<std::mutex> lock = LockMs(0);
+      ms_size = BaselineReader::MeasurementSetIntervalDataSize(
+          ms_names[0], start_time_step, end_time_step);
+    }
+    if (!MemoryBaselineReader::IsEnoughMemoryAvailable(ms_names.size() *
+                                                       ms_size))
+      io_mode = BaselineIOMode::ReorderingReadMode;
+  }
+  io_mode_ = io_mode;
+
+  // Creating a reader reads the subtables of its measurement set.
+  for (size_t i = 0; i != ms_names_.size(); ++i) {
+    const std::unique_lock<std::mutex> lock = LockMs(i);
+    readers_.emplace_back(CreateReader(ms_names_[i], io_mode));
     readers_.back()->SetInterval(start_time_step, end_time_step);
   }
 
@@ -62,28 +81,50 @@ MultiBandMsImageSet::MultiBandMsImageSet(
   ProcessMetaData();
 }
 
-static std::vector<BaselineReader*> GetWriters(
-    std::vector<std::unique_ptr<BaselineReader>>& readers) {
-  std::vector<BaselineReader*> writers;
-  // Only the modified readers need to be written.
-  for (std::unique_ptr<BaselineReader>& reader : readers)
-    if (reader->IsModified()) writers.emplace_back(reader.get());
-
-  return writers;
-}
-
-void MultiBandMsImageSet::WriteToMs(size_t n_threads) {
+void MultiBandMsImageSet::WriteToMs(size_t n_threads,
+                                    const StatisticsCollection* statistics) {
   assert(n_threads != 0 && n_threads <= readers_.size() &&
          "Caller should provide a valid number of execution threads.");
   const Stopwatch watch(true);
 
-  const std::vector<BaselineReader*> writers = GetWriters(readers_);
   aocommon::ParallelFor<size_t> executor(n_threads);
-  executor.Run(0, writers.size(), [&](size_t i) { writers[i]->WriteToMs(); });
+  executor.Run(0, readers_.size(), [&](size_t i) {
+    // Only the modified readers need to be written.
+    const bool is_modified = readers_[i]->IsModified();
+    if (is_modified || statistics) {
+      const std::unique_lock<std::mutex> lock = LockMs(i);
+      if (is_modified) readers_[i]->WriteToMs();
+      if (statistics) WriteStatistics(i, *statistics);
+    }
+  });
 
   Logger::Debug << "Writing took " << watch.ToString() << ".\n";
 }
 
+void MultiBandMsImageSet::WriteStatistics(
+    size_t reader_index, const StatisticsCollection& statistics) const {
+  const size_t channel_start =
+      std::accumulate(channels_per_band_.begin(),
+                      channels_per_band_.begin() + reader_index, size_t(0));
+  const size_t channel_count = channels_per_band_[reader_index];
+  std::vector<double> frequencies(channel_count);
+  for (size_t i = 0; i != channel_count; ++i)
+    frequencies[i] = band_.channels[channel_start + i].frequencyHz;
+  const StatisticsCollection band_statistics =
+      statistics.ExtractBand(frequencies.data(), channel_count);
+  QualityTablesFormatter formatter(ms_names_[reader_index]);
+  band_statistics.Save(formatter);
+}
+
+uint64_t MultiBandMsImageSet::BaselineSize() const {
+  size_t n_time_steps = 0;
+  for (const std::set<double>& times : observation_times_per_sequence_)
+    n_time_steps = std::max(n_time_steps, times.size());
+  return uint64_t(8) /* bytes per complex */ *
+         readers_.front()->Polarizations().size() * n_time_steps *
+         band_.channels.size();
+}
+
 std::optional<ImageSetIndex> MultiBandMsImageSet::Index(
     size_t antenna_1, size_t antenna_2, size_t band, size_t sequence_id) const {
   const size_t value =
@@ -120,16 +161,6 @@ static std::pair<BandInfo, std::vector<size_t>> CombineBands(
   return {std::move(band_info), std::move(channels_per_band)};
 }
 
-static const std::vector<std::pair<size_t, size_t>>& GetBaselines(
-    const MSMetaData* meta_data) {
-  return meta_data->GetBaselines();
-}
-
-static const std::set<double>& GetObservationTimes(
-    const MSMetaData* meta_data) {
-  return meta_data->GetObservationTimes();
-}
-
 static const std::vector<std::set<double>>& GetObservationTimesPerSequence(
     const MSMetaData* meta_data) {
   return meta_data->GetObservationTimesPerSequence();
@@ -175,23 +206,34 @@ static auto ExtractField(const std::vector<const MSMetaData*>& meta_data,
 
 void MultiBandMsImageSet::ReadData(size_t n_threads) {
   const Stopwatch watch(true);
+  // The sets contain different subbands of the same observation, so only the
+  // main table of the first set is read. The other sets share its metadata.
+  {
+    const std::unique_lock<std::mutex> lock = LockMs(0);
+    readers_[0]->MetaData().InitializeMainTableData();
+  }
+  const MSMetaData& shared_meta_data = readers_[0]->MetaData();
   aocommon::ParallelFor<size_t> executor(n_threads);
   executor.Run(0, readers_.size(), [&](size_t i) {
+    const std::unique_lock<std::mutex> lock = LockMs(i);
+    if (i != 0) readers_[i]->MetaData().ShareMainTableData(shared_meta_data);
     readers_[i]->PrepareReadWrite(BaselineReader::dummy_progress_);
+    // The polarizations are read on first use, which should also happen
+    // while holding the lock.
+    readers_[i]->Polarizations();
   });
   Logger::Debug << "Reading took " << watch.ToString() << ".\n";
 }
 
-// Returns the metadata of the readers and initializes their main tables.
+// Returns the metadata of the readers. Their main tables have been
+// initialized by ReadData(), so this does not access the measurement sets.
 static std::vector<const MSMetaData*> GetInitializedMetaData(
     std::vector<std::unique_ptr<BaselineReader>>::iterator first,
     std::vector<std::unique_ptr<BaselineReader>>::iterator last) {
   std::vector<const MSMetaData*> result;
   std::transform(first, last, std::back_inserter(result),
                  [](std::unique_ptr<BaselineReader>& reader) {
-                   MSMetaData& meta_data{reader->MetaData()};
-                   meta_data.InitializeMainTableData();
-                   return &meta_data;
+                   return &reader->MetaData();
                  });
   return result;
 }
@@ -326,18 +368,22 @@ void MultiBandMsImageSet::ProcessMetaData() {
   // Apply the permutation to ms_names_ and its derivatives
   ApplyPermutation(ms_names_, permutation);
   ApplyPermutation(readers_, permutation);
+  if (!reader_mutexes_.empty()) ApplyPermutation(reader_mutexes_, permutation);
   ApplyPermutation(meta_data, permutation);
 
-  // These fields are only validated.
-  ExtractField(meta_data, GetBaselines, "baselines");
-  ExtractField(meta_data, GetObservationTimes, "timesteps");
+  // The main table data is shared by all sets and was validated when it was
+  // shared, see ReadData().
+  assert(std::all_of(meta_data.begin(), meta_data.end(),
+                     [&](const MSMetaData* element) {
+                       return element->SharesMainTableData(*meta_data[0]);
+                     }));
+  sequences_ = GetSequences(meta_data[0]);
+  observation_times_per_sequence_ =
+      GetObservationTimesPerSequence(meta_data[0]);
 
   // These fields are validated and cached.
   antennae_ = ExtractField(meta_data, GetAntennae, "antennas");
   fields_ = ExtractField(meta_data, GetFields, "fields");
-  sequences_ = ExtractField(meta_data, GetSequences, "sequences");
-  observation_times_per_sequence_ = ExtractField(
-      meta_data, GetObservationTimesPerSequence, "timesteps per sequence");
   std::tie(band_, channels_per_band_) = CombineBands(meta_data);
 }
 
@@ -441,35 +487,43 @@ void MultiBandMsImageSet::AddReadRequest(const ImageSetIndex& index) {
 }
 
 void MultiBandMsImageSet::PerformReadRequests(ProgressListener& progress) {
-  if (!data_.empty()) {
+  if (!performed_requests_.empty()) {
     throw std::runtime_error(
         "PerformReadRequest() called, but a previous read request was not "
         "completely processed.");
   }
 
-  for (size_t i = 0; i != readers_.size(); ++i) {
-    SubTaskListener listener(progress, i, readers_.size());
-    readers_[i]->PerformReadRequests(listener);
+  if (IsStreaming()) {
+    // The requested baselines are read from the measurement sets, so the
+    // subbands are read in parallel, like in ReadData().
+    aocommon::ParallelFor<size_t> executor(n_io_threads_);
+    executor.Run(0, readers_.size(), [&](size_t i) {
+      const std::unique_lock<std::mutex> lock = LockMs(i);
+      DummyProgressListener listener;
+      readers_[i]->PerformReadRequests(listener);
+    });
+  } else {
+    for (size_t i = 0; i != readers_.size(); ++i) {
+      SubTaskListener listener(progress, i, readers_.size());
+      readers_[i]->PerformReadRequests(listener);
+    }
   }
   progress.OnFinish();
 
-  for (const ImageSetIndex& index : read_requests_) {
-    data_.emplace_back(CombineData(index));
-  }
-
+  performed_requests_.insert(performed_requests_.end(), read_requests_.begin(),
+                             read_requests_.end());
   read_requests_.clear();
 }
 
 std::unique_ptr<BaselineData> MultiBandMsImageSet::GetNextRequested() {
-  std::unique_ptr<BaselineData> result = std::move(data_.front());
-  data_.pop_front();
-
-  if (result->Data().IsEmpty()) {
+  if (performed_requests_.empty()) {
     throw std::runtime_error(
         "Calling GetNextRequested(), but requests were not read with "
         "LoadRequests.");
   }
-  return result;
+  const ImageSetIndex index = performed_requests_.front();
+  performed_requests_.pop_front();
+  return CombineData(index);
 }
 
 }  // namespace imagesets
@@ -512,8 +566,18 @@ void MultiBandMsImageSet::AddWriteFlagsTask(const ImageSetIndex& index,
 }
 
 void MultiBandMsImageSet::PerformWriteFlagsTask() {
-  for (std::unique_ptr<BaselineReader>& reader : readers_)
-    reader->PerformFlagWriteRequests();
+  if (IsStreaming()) {
+    // The flags are written to the measurement sets, which is done in
+    // parallel. This releases the flags of the written baselines.
+    aocommon::ParallelFor<size_t> executor(n_io_threads_);
+    executor.Run(0, readers_.size(), [&](size_t i) {
+      const std::unique_lock<std::mutex> lock = LockMs(i);
+      readers_[i]->PerformFlagWriteRequests();
+    });
+  } else {
+    for (std::unique_ptr<BaselineReader>& reader : readers_)
+      reader->PerformFlagWriteRequests();
+  }
 }
 
 }  // namespace imagesets
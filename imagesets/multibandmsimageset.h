@@ -5,13 +5,18 @@
 
 #include "indexableset.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
 #include <string>
 #include <vector>
 
+class StatisticsCollection;
+
 namespace imagesets {
 
 struct MetaData;
@@ -24,13 +29,20 @@ struct MetaData;
  * same observation, where every file contains one subband of the
  * observation. The files are listed in consecutive order and all
  * subbands should be present.
+ *
+ * When \a ms_mutexes is not null, it should hold one mutex for every
+ * measurement set in \a names. The set locks the mutex of a measurement set
+ * while it reads from or writes to it. This allows multiple sets of the same
+ * measurement sets, e.g. different time chunks, to perform their I/O at the
+ * same time, because casacore tables are not thread safe.
  */
 class MultiBandMsImageSet final : public IndexableSet {
  public:
   MultiBandMsImageSet(const std::vector<std::string>& names,
                       BaselineIOMode io_mode,
                       std::optional<size_t> start_time_step,
-                      std::optional<size_t> end_time_step, size_t n_threads);
+                      std::optional<size_t> end_time_step, size_t n_threads,
+                      std::vector<std::mutex>* ms_mutexes = nullptr);
 
   MultiBandMsImageSet(const MultiBandMsImageSet&) = delete;
 
@@ -38,7 +50,47 @@ class MultiBandMsImageSet final : public IndexableSet {
 
   MultiBandMsImageSet& operator=(const MultiBandMsImageSet&) = delete;
 
-  void WriteToMs(size_t n_threads);
+  /**
+   * Writes the modified flags to the measurement sets. When @p statistics is
+   * not null, the statistics of every band, collected with the channels per
+   * band of ChannelsPerBand(), are also written to the quality tables of the
+   * measurement set of that band.
+   */
+  void WriteToMs(size_t n_threads,
+                 const StatisticsCollection* statistics = nullptr);
+
+  /**
+   * The number of channels of every measurement set, in the order in which
+   * they are concatenated.
+   */
+  const std::vector<size_t>& ChannelsPerBand() const {
+    return channels_per_band_;
+  }
+
+  /**
+   * True when the set streams the data, which is the case in direct read
+   * mode. The baselines are then read from the measurement sets in groups,
+   * when they are requested, and their flags are written when the write task
+   * is performed. Otherwise, the entire chunk is read by the constructor and
+   * kept in memory until WriteToMs() is called.
+   */
+  bool IsStreaming() const {
+    return io_mode_ == BaselineIOMode::DirectReadMode;
+  }
+
+  /**
+   * Number of bytes of the visibilities of one spectrally concatenated
+   * baseline of the longest sequence.
+   */
+  uint64_t BaselineSize() const;
+
+  size_t GetMinRecommendedBufferSize(size_t n_threads) const {
+    return readers_.front()->GetMinRecommendedBufferSize(n_threads);
+  }
+
+  size_t GetMaxRecommendedBufferSize(size_t n_threads) const {
+    return readers_.front()->GetMaxRecommendedBufferSize(n_threads);
+  }
 
   std::unique_ptr<ImageSet> Clone() override {
     throw std::runtime_error("Not available");
@@ -80,7 +132,15 @@ class MultiBandMsImageSet final : public IndexableSet {
     throw std::runtime_error("Not available");
   }
 
+  bool SupportsConcurrentReadWrite() const override {
+    return std::all_of(readers_.begin(), readers_.end(),
+                       [](const std::unique_ptr<BaselineReader>& reader) {
+                         return reader->SupportsConcurrentReadWrite();
+                       });
+  }
+
   std::string TelescopeName() override {
+    const std::unique_lock<std::mutex> lock = LockMs(0);
     casacore::MeasurementSet ms = readers_[0]->OpenMS();
     return MSMetaData::GetTelescopeName(ms);
   }
@@ -128,20 +188,30 @@ class MultiBandMsImageSet final : public IndexableSet {
   size_t EndTimeIndex(size_t sequence_id) const {
     return observation_times_per_sequence_[sequence_id].size();
   }
+  std::unique_lock<std::mutex> LockMs(size_t reader_index) const {
+    return reader_mutexes_.empty()
+               ? std::unique_lock<std::mutex>()
+               : std::unique_lock<std::mutex>(*reader_mutexes_[reader_index]);
+  }
   size_t FindBaselineIndex(size_t antenna_1, size_t antenna_2, size_t band,
                            size_t sequence_id) const;
 
   void ReadData(size_t n_threads);
+  void WriteStatistics(size_t reader_index,
+                       const StatisticsCollection& statistics) const;
   void ProcessMetaData();
   std::unique_ptr<BaselineData> CombineData(const ImageSetIndex& index);
 
   static const size_t kNotFound;
   std::vector<std::string> ms_names_;
+  BaselineIOMode io_mode_;
+  size_t n_io_threads_;
 
-  // TODO Other readers use a vector and call pop_front, if the vector contains
-  // a lot of elements this is inefficient.
-  std::deque<std::unique_ptr<BaselineData>> data_;
   std::vector<ImageSetIndex> read_requests_;
+  // The requests that have been read by the readers. Their data is combined
+  // when it is retrieved with GetNextRequested(), such that only the
+  // retrieved baselines are held in their spectrally concatenated form.
+  std::deque<ImageSetIndex> performed_requests_;
 
   // All measurement sets read contain the same metadata this a cached copy.
   std::vector<AntennaInfo> antennae_;
@@ -156,6 +226,8 @@ class MultiBandMsImageSet final : public IndexableSet {
   std::vector<size_t> channels_per_band_;
 
   std::vector<std::unique_ptr<BaselineReader>> readers_;
+  // The mutex of every reader, or empty when the set does not need to lock.
+  std::vector<std::mutex*> reader_mutexes_;
 };
 
 }  // namespace imagesets
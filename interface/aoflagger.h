@@ -7,6 +7,7 @@
 #define AOFLAGGER_INTERFACE_H
 
 #include <cstring>
+#include <future>
 #include <string>
 #include <memory>
 #include <utility>
@@ -336,8 +337,10 @@ class FlagMask {
  * of the aoflagger package.
  *
  * When flagging a large number of baselines it is recommended to use multiple
- * threads. This class is itself not thread save, but it is safe to use
- * different Strategy objects from different thread contexts.
+ * threads. This can be done with @ref RunBatch() or @ref RunAsync(), which
+ * let the strategy run on an internal pool of threads. Alternatively,
+ * different Strategy objects can be used from different thread contexts:
+ * @ref Run() is itself not thread safe.
  */
 class Strategy {
  public:
@@ -391,6 +394,85 @@ class Strategy {
    */
   FlagMask Run(const ImageSet& input, const FlagMask& existingFlags);
 
+  /** @brief Run the flagging strategy on multiple data sets in parallel.
+   *
+   * The data sets are flagged by an internal pool of threads (see
+   * @ref SetThreadCount()). Every thread of the pool has its own instance of
+   * the strategy, which is made when the thread flags its first data set and
+   * which is reused by later calls. The pool is made by the first call to
+   * RunBatch() or RunAsync().
+   *
+   * This function returns after all data sets are flagged. If flagging a
+   * data set fails, the exception is rethrown after the other data sets are
+   * flagged.
+   *
+   * RunBatch() and RunAsync() are thread safe: they may be called from
+   * different threads on the same Strategy object at the same time. A status
+   * listener (see @ref AOFlagger::SetStatusListener()) should be thread safe
+   * when they are used.
+   *
+   * @param inputs The data sets to run the flagger on.
+   * @return The flags of each data set, in the order of @p inputs.
+   * @since Version 3.5
+   */
+  std::vector<FlagMask> RunBatch(const std::vector<ImageSet>& inputs);
+
+  /** @brief Run the flagging strategy on multiple data sets with existing
+   * flags in parallel.
+   *
+   * Like @ref RunBatch(const std::vector<ImageSet>&), except that existing
+   * flags are passed to the strategy, as in
+   * @ref Run(const ImageSet&, const FlagMask&).
+   * @param inputs The data sets to run the flagger on.
+   * @param existingFlags Flags for every data set in @p inputs.
+   * @return The flags of each data set, in the order of @p inputs.
+   * @since Version 3.5
+   */
+  std::vector<FlagMask> RunBatch(const std::vector<ImageSet>& inputs,
+                                 const std::vector<FlagMask>& existingFlags);
+
+  /** @brief Start running the flagging strategy on the given data.
+   *
+   * The data is flagged by the internal pool of threads that is also used by
+   * @ref RunBatch(), and this function returns directly. Data sets that
+   * are started while all threads are busy are flagged in the order in which
+   * they are started. The images of @p input should not be changed until
+   * the result is available. An exception that occurs while flagging is
+   * rethrown by @c std::future::get().
+   *
+   * Destructing the Strategy waits until all started runs are finished.
+   *
+   * @param input The data to run the flagger on.
+   * @return The flags that will be found.
+   * @since Version 3.5
+   */
+  std::future<FlagMask> RunAsync(const ImageSet& input);
+
+  /** @brief Start running the flagging strategy on the given data with
+   * existing flags.
+   *
+   * Like @ref RunAsync(const ImageSet&), with existing flags as in
+   * @ref Run(const ImageSet&, const FlagMask&).
+   * @since Version 3.5
+   */
+  std::future<FlagMask> RunAsync(const ImageSet& input,
+                                 const FlagMask& existingFlags);
+
+  /** @brief Set the number of threads used by @ref RunBatch() and
+   * @ref RunAsync().
+   *
+   * The default is the number of processors. This function waits until all
+   * started runs are finished, and should not be called at the same time as
+   * other methods of this object.
+   * @since Version 3.5
+   */
+  void SetThreadCount(size_t threadCount);
+
+  /** @brief Number of threads used by @ref RunBatch() and @ref RunAsync().
+   * @since Version 3.5
+   */
+  size_t ThreadCount() const;
+
  private:
   Strategy(const std::string& filename, class AOFlagger* aoflagger);
   Strategy(const Strategy& sourceStrategy) = delete;
@@ -399,11 +481,115 @@ class Strategy {
                                  class AOFlagger* aoflagger);
 
   FlagMask run(const ImageSet& input, const FlagMask* existingFlags);
+  std::future<FlagMask> runAsync(const ImageSet& input,
+                                 const FlagMask* existingFlags);
+  static FlagMask run(class AOFlagger& aoflagger,
+                      class StatusListener* statusListener,
+                      class StrategyInterpreters& interpreters,
+                      size_t threadIndex, const ImageSet& input,
+                      const FlagMask* existingFlags);
 
   std::unique_ptr<class StrategyData> _data;
   class AOFlagger* _aoflagger;
 };
 
+/** @brief Flags a continuous stream of data that arrives in pieces.
+ *
+ * A strategy that is run on a block of data can not flag the edges of the
+ * block as well as the rest, because e.g. the low-pass filter and the
+ * SumThreshold and SIR operators lack the data beyond the edges. A
+ * StreamingFlagger solves this by keeping a rolling window of the most recent
+ * timesteps. Timesteps can be added in pieces of any width with
+ * @ref Add(). Once a block of new timesteps is followed by enough context,
+ * the strategy is run on the window and the flags of the block become final.
+ * They can then be taken with @ref TakeFinished().
+ *
+ * The window consists of at most @c contextSize finished timesteps, a block
+ * of @c blockSize timesteps that are being finished, and @c contextSize
+ * later timesteps. A timestep is therefore finished at most
+ * <tt>blockSize + contextSize</tt> timesteps after it was added, and every
+ * timestep is flagged <tt>(blockSize + 2 * contextSize) / blockSize</tt>
+ * times on average. Only the window is kept in memory, and its buffers are
+ * reused.
+ *
+ * Streams are created with @ref AOFlagger::MakeStreamingFlagger(). The
+ * strategy is run with @ref Strategy::RunAsync(), so different streams of
+ * the same strategy (e.g. one per baseline) may be used from different
+ * threads. A single stream is not thread safe.
+ * @since Version 3.5
+ */
+class StreamingFlagger {
+ public:
+  friend class AOFlagger;
+
+  /** @brief Construct an empty stream, which can only be assigned to. */
+  StreamingFlagger();
+
+  /** @brief Move construct a stream. */
+  StreamingFlagger(StreamingFlagger&& source);
+
+  /** @brief Destruct the stream. Unfinished timesteps are discarded. */
+  ~StreamingFlagger();
+
+  /** @brief Move assign to the stream. */
+  StreamingFlagger& operator=(StreamingFlagger&& source);
+
+  /** @brief Add timesteps to the end of the stream.
+   *
+   * The strategy is run for every block of timesteps that has enough context
+   * after this call, so this may take a while. The antennas and band of
+   * @p input are passed on to the strategy; its interval is not, because the
+   * window is not one of the intervals.
+   * @param input Data of the new timesteps. The height and image count should
+   * be equal to those of the stream; the width can be anything.
+   */
+  void Add(const ImageSet& input);
+
+  /** @brief Add timesteps with existing flags to the end of the stream.
+   *
+   * Like @ref Add(const ImageSet&), but with flags (e.g. set by the
+   * correlator) that are passed to the strategy as in
+   * @ref Strategy::Run(const ImageSet&, const FlagMask&).
+   */
+  void Add(const ImageSet& input, const FlagMask& existingFlags);
+
+  /** @brief End the stream: flag all timesteps that are not finished yet.
+   *
+   * The last timesteps are flagged without context after them. After this
+   * call, their flags can be taken with @ref TakeFinished(), and new
+   * timesteps start a new stream.
+   */
+  void Finish();
+
+  /** @brief Number of timesteps of which the flags are final, but have not
+   * been taken with @ref TakeFinished() yet. */
+  size_t FinishedCount() const;
+
+  /** @brief Take the flags of all finished timesteps.
+   *
+   * Flags are returned in the order in which the timesteps were added. The
+   * width of the mask is @ref FinishedCount(), which is zero afterwards.
+   * Throws when there are no finished timesteps.
+   */
+  FlagMask TakeFinished();
+
+  /** @brief Maximum number of timesteps between adding a timestep and its
+   * flags becoming final, i.e. the block size plus the context size. */
+  size_t Latency() const;
+
+ private:
+  StreamingFlagger(class Strategy& strategy, class AOFlagger& aoflagger,
+                   size_t height, size_t count, size_t blockSize,
+                   size_t contextSize);
+  StreamingFlagger(const StreamingFlagger&) = delete;
+  StreamingFlagger& operator=(const StreamingFlagger&) = delete;
+
+  void add(const ImageSet& input, const FlagMask* existingFlags);
+  void flagWindow(size_t finishCount);
+
+  std::unique_ptr<class StreamingFlaggerData> _data;
+};
+
 /** @brief Statistics that can be collected online and saved to a measurement
  * set.
  *
@@ -712,6 +898,26 @@ class AOFlagger {
     return FlagMask(width, height, initialValue);
   }
 
+  /** @brief Create a stream that flags data that arrives in pieces.
+   *
+   * See @ref StreamingFlagger for details. The strategy and this object
+   * should outlive the stream.
+   * @param strategy The strategy that is run on the stream.
+   * @param height Number of channels of the stream.
+   * @param count Number of images of the stream, see @ref ImageSet.
+   * @param blockSize Number of timesteps that are finished by one run of the
+   * strategy.
+   * @param contextSize Number of timesteps of context on both sides of a
+   * block.
+   * @since Version 3.5
+   */
+  StreamingFlagger MakeStreamingFlagger(Strategy& strategy, size_t height,
+                                        size_t count, size_t blockSize,
+                                        size_t contextSize) {
+    return StreamingFlagger(strategy, *this, height, count, blockSize,
+                            contextSize);
+  }
+
   /** @brief Find a Lua strategy for a specific telescope.
    *
    * The scenario name can be used to
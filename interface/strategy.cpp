@@ -1,14 +1,20 @@
 #include "aoflagger.h"
 #include "structures.h"
 
-#include "../lua/luastrategy.h"
+#include "../lua/luathreadgroup.h"
 #include "../lua/scriptdata.h"
 
 #include "../util/progress/progresslistener.h"
 
 #include "../structures/timefrequencydata.h"
 
+#include <aocommon/system.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <mutex>
+#include <thread>
 
 namespace aoflagger {
 
@@ -45,23 +51,117 @@ class ForwardingListener final : public ProgressListener {
   StatusListener* _destination;
 };
 
+/**
+ * Interpreters of a strategy, one for every thread that runs it. The
+ * interpreter of a thread is created when the thread first runs the strategy.
+ */
+class StrategyInterpreters final : public LuaThreadGroup {
+ public:
+  StrategyInterpreters(size_t nThreads, const std::string& filename,
+                       const std::string& script)
+      : LuaThreadGroup(nThreads) {
+    if (filename.empty())
+      LoadText(script);
+    else
+      LoadFile(filename.c_str());
+  }
+};
+
+/**
+ * Threads that run a strategy for Strategy::RunBatch() and
+ * Strategy::RunAsync(). Tasks are run in the order in which they are added.
+ * Every thread uses its own interpreter, which is reused for all the tasks
+ * that the thread runs.
+ */
+class StrategyPool {
+ public:
+  using Task = std::function<void(StrategyInterpreters&, size_t)>;
+
+  StrategyPool(size_t nThreads, const std::string& filename,
+               const std::string& script)
+      : _interpreters(nThreads, filename, script) {
+    _threads.reserve(nThreads);
+    for (size_t i = 0; i != nThreads; ++i)
+      _threads.emplace_back([this, i]() { work(i); });
+  }
+
+  /**
+   * Waits until all tasks have been run.
+   */
+  ~StrategyPool() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _isStopping = true;
+    _taskAvailable.notify_all();
+    lock.unlock();
+    for (std::thread& thread : _threads) thread.join();
+  }
+
+  size_t NThreads() const { return _threads.size(); }
+
+  void Add(Task task) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks.emplace_back(std::move(task));
+    _taskAvailable.notify_one();
+  }
+
+ private:
+  void work(size_t threadIndex) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      while (_tasks.empty() && !_isStopping) _taskAvailable.wait(lock);
+      if (_tasks.empty()) return;
+      const Task task = std::move(_tasks.front());
+      _tasks.pop_front();
+      lock.unlock();
+      task(_interpreters, threadIndex);
+      lock.lock();
+    }
+  }
+
+  StrategyInterpreters _interpreters;
+  std::mutex _mutex;
+  std::condition_variable _taskAvailable;
+  std::deque<Task> _tasks;
+  bool _isStopping = false;
+  std::vector<std::thread> _threads;
+};
+
 class StrategyData {
  public:
-  [[no_unique_address]] LuaStrategy _lua;
+  StrategyData(const std::string& filename, const std::string& script)
+      : _filename(filename),
+        _script(script),
+        _lua(1, filename, script),
+        _poolThreadCount(aocommon::system::ProcessorCount()) {}
+
+  StrategyPool& Pool() {
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    if (!_pool)
+      _pool = std::make_unique<StrategyPool>(_poolThreadCount, _filename,
+                                             _script);
+    return *_pool;
+  }
+
+  // Either the filename or the script of the strategy is set.
+  std::string _filename;
+  std::string _script;
+  // Interpreter used by Strategy::Run()
+  StrategyInterpreters _lua;
+  std::mutex _poolMutex;
+  size_t _poolThreadCount;
+  // Declared last, such that it is destructed first: its tasks may still use
+  // the other members.
+  std::unique_ptr<StrategyPool> _pool;
 };
 
 Strategy::Strategy() : _data(), _aoflagger(nullptr) {}
 
 Strategy::Strategy(const std::string& filename, AOFlagger* aoflagger)
-    : _data(new StrategyData()), _aoflagger(aoflagger) {
-  _data->_lua.Initialize();
-  _data->_lua.LoadFile(filename.c_str());
-}
+    : _data(new StrategyData(filename, std::string())),
+      _aoflagger(aoflagger) {}
 
 Strategy::Strategy(Strategy&& sourceStrategy)
-    : _data(sourceStrategy._data
-                ? new StrategyData(std::move(*sourceStrategy._data))
-                : nullptr),
+    : _data(std::move(sourceStrategy._data)),
       _aoflagger(sourceStrategy._aoflagger) {}
 
 Strategy::~Strategy() {}
@@ -69,18 +169,13 @@ Strategy::~Strategy() {}
 Strategy Strategy::makeFromString(const std::string& script,
                                   AOFlagger* aoflagger) {
   Strategy strategy;
-  strategy._data.reset(new StrategyData());
+  strategy._data.reset(new StrategyData(std::string(), script));
   strategy._aoflagger = aoflagger;
-  strategy._data->_lua.Initialize();
-  strategy._data->_lua.LoadText(script);
   return strategy;
 }
 
 Strategy& Strategy::operator=(Strategy&& sourceStrategy) {
-  if (sourceStrategy._data)
-    _data = std::move(sourceStrategy._data);
-  else
-    _data = nullptr;
+  _data = std::move(sourceStrategy._data);
   _aoflagger = sourceStrategy._aoflagger;
   return *this;
 }
@@ -119,13 +214,96 @@ FlagMask Strategy::Run(const ImageSet& input,
 
 FlagMask Strategy::Run(const ImageSet& input) { return run(input, nullptr); }
 
+std::vector<FlagMask> Strategy::RunBatch(const std::vector<ImageSet>& inputs) {
+  std::vector<std::future<FlagMask>> futures;
+  futures.reserve(inputs.size());
+  for (const ImageSet& input : inputs)
+    futures.emplace_back(runAsync(input, nullptr));
+  // Wait for all runs before a possible exception leaves this function
+  for (std::future<FlagMask>& future : futures) future.wait();
+  std::vector<FlagMask> result;
+  result.reserve(inputs.size());
+  for (std::future<FlagMask>& future : futures)
+    result.emplace_back(future.get());
+  return result;
+}
+
+std::vector<FlagMask> Strategy::RunBatch(
+    const std::vector<ImageSet>& inputs,
+    const std::vector<FlagMask>& existingFlags) {
+  if (existingFlags.size() != inputs.size())
+    throw std::runtime_error(
+        "RunBatch() was called with a different number of flag masks than "
+        "image sets");
+  std::vector<std::future<FlagMask>> futures;
+  futures.reserve(inputs.size());
+  for (size_t i = 0; i != inputs.size(); ++i)
+    futures.emplace_back(runAsync(inputs[i], &existingFlags[i]));
+  for (std::future<FlagMask>& future : futures) future.wait();
+  std::vector<FlagMask> result;
+  result.reserve(inputs.size());
+  for (std::future<FlagMask>& future : futures)
+    result.emplace_back(future.get());
+  return result;
+}
+
+std::future<FlagMask> Strategy::RunAsync(const ImageSet& input) {
+  return runAsync(input, nullptr);
+}
+
+std::future<FlagMask> Strategy::RunAsync(const ImageSet& input,
+                                         const FlagMask& existingFlags) {
+  return runAsync(input, &existingFlags);
+}
+
+void Strategy::SetThreadCount(size_t threadCount) {
+  if (threadCount == 0)
+    throw std::runtime_error("Strategy thread count should be at least one");
+  std::lock_guard<std::mutex> lock(_data->_poolMutex);
+  if (_data->_pool && _data->_pool->NThreads() != threadCount)
+    _data->_pool.reset();
+  _data->_poolThreadCount = threadCount;
+}
+
+size_t Strategy::ThreadCount() const { return _data->_poolThreadCount; }
+
 FlagMask Strategy::run(const ImageSet& input,
                        const FlagMask* preExistingFlags) {
+  return run(*_aoflagger, _aoflagger->_statusListener, _data->_lua, 0, input,
+             preExistingFlags);
+}
+
+std::future<FlagMask> Strategy::runAsync(const ImageSet& input,
+                                         const FlagMask* existingFlags) {
+  // Only references to the images and flags are copied. The promise is
+  // shared, because a StrategyPool::Task has to be copyable.
+  auto promise = std::make_shared<std::promise<FlagMask>>();
+  std::future<FlagMask> future = promise->get_future();
+  _data->Pool().Add(
+      [aoflagger = _aoflagger, statusListener = _aoflagger->_statusListener,
+       input, flags = existingFlags ? *existingFlags : FlagMask(),
+       hasFlags = existingFlags != nullptr,
+       promise](StrategyInterpreters& interpreters, size_t threadIndex) {
+        try {
+          promise->set_value(run(*aoflagger, statusListener, interpreters,
+                                 threadIndex, input,
+                                 hasFlags ? &flags : nullptr));
+        } catch (...) {
+          promise->set_exception(std::current_exception());
+        }
+      });
+  return future;
+}
+
+FlagMask Strategy::run(AOFlagger& aoflagger, StatusListener* statusListener,
+                       StrategyInterpreters& interpreters, size_t threadIndex,
+                       const ImageSet& input,
+                       const FlagMask* preExistingFlags) {
   std::unique_ptr<ProgressListener> listener;
-  if (_aoflagger->_statusListener == nullptr)
+  if (statusListener == nullptr)
     listener.reset(new ErrorListener());
   else
-    listener.reset(new ForwardingListener(_aoflagger->_statusListener));
+    listener.reset(new ForwardingListener(statusListener));
 
   Mask2DCPtr inputMask;
   if (preExistingFlags == nullptr)
@@ -168,23 +346,24 @@ FlagMask Strategy::run(const ImageSet& input,
   }
 
   const TimeFrequencyMetaDataPtr metaData(new TimeFrequencyMetaData());
-  if (input.HasAntennas() && !_aoflagger->_antennas.empty()) {
+  if (input.HasAntennas() && !aoflagger._antennas.empty()) {
     metaData->SetAntenna1(
-        ConvertAntenna(_aoflagger->_antennas[input.Antenna1()]));
+        ConvertAntenna(aoflagger._antennas[input.Antenna1()]));
     metaData->SetAntenna2(
-        ConvertAntenna(_aoflagger->_antennas[input.Antenna2()]));
+        ConvertAntenna(aoflagger._antennas[input.Antenna2()]));
   }
-  if (input.HasBand() && !_aoflagger->_bands.empty()) {
-    metaData->SetBand(ConvertBand(_aoflagger->_bands[input.Band()]));
+  if (input.HasBand() && !aoflagger._bands.empty()) {
+    metaData->SetBand(ConvertBand(aoflagger._bands[input.Band()]));
   }
-  if (input.HasInterval() && !_aoflagger->_intervals.empty()) {
+  if (input.HasInterval() && !aoflagger._intervals.empty()) {
     metaData->SetObservationTimes(
-        _aoflagger->_intervals[input.Interval()].times);
+        aoflagger._intervals[input.Interval()].times);
   }
   ScriptData scriptData;
   scriptData.SetProgressListener(*listener);
 
-  _data->_lua.Execute(inputData, metaData, scriptData, "execute");
+  interpreters.Execute(threadIndex, inputData, metaData, scriptData,
+                       "execute");
 
   listener.reset();
   inputMask.reset();
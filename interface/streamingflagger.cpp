@@ -0,0 +1,195 @@
+#include "aoflagger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace aoflagger {
+
+class StreamingFlaggerData {
+ public:
+  StreamingFlaggerData(Strategy& _strategy, AOFlagger& _aoflagger,
+                       size_t _height, size_t _count, size_t _blockSize,
+                       size_t _contextSize)
+      : strategy(&_strategy),
+        aoflagger(&_aoflagger),
+        height(_height),
+        blockSize(_blockSize),
+        contextSize(_contextSize),
+        capacity(_blockSize + 2 * _contextSize),
+        window(_aoflagger.MakeImageSet(capacity, _height, _count, 0.0f,
+                                       capacity)),
+        windowFlags(_aoflagger.MakeFlagMask(capacity, _height, false)),
+        width(0),
+        finishedContext(0),
+        finishedCount(0) {}
+
+  Strategy* strategy;
+  AOFlagger* aoflagger;
+  size_t height, blockSize, contextSize, capacity;
+  // The window holds finishedContext finished timesteps, followed by
+  // unfinished timesteps. Its buffers are allocated once with the maximum
+  // width of the window.
+  ImageSet window;
+  // Existing flags of the timesteps in the window
+  FlagMask windowFlags;
+  size_t width;
+  size_t finishedContext;
+  std::vector<FlagMask> finished;
+  size_t finishedCount;
+};
+
+StreamingFlagger::StreamingFlagger() : _data() {}
+
+StreamingFlagger::StreamingFlagger(Strategy& strategy, AOFlagger& aoflagger,
+                                   size_t height, size_t count,
+                                   size_t blockSize, size_t contextSize) {
+  if (blockSize == 0)
+    throw std::runtime_error("The block size of a stream should be positive");
+  _data.reset(new StreamingFlaggerData(strategy, aoflagger, height, count,
+                                       blockSize, contextSize));
+}
+
+StreamingFlagger::StreamingFlagger(StreamingFlagger&& source)
+    : _data(std::move(source._data)) {}
+
+StreamingFlagger::~StreamingFlagger() {}
+
+StreamingFlagger& StreamingFlagger::operator=(StreamingFlagger&& source) {
+  _data = std::move(source._data);
+  return *this;
+}
+
+void StreamingFlagger::Add(const ImageSet& input) { add(input, nullptr); }
+
+void StreamingFlagger::Add(const ImageSet& input,
+                           const FlagMask& existingFlags) {
+  add(input, &existingFlags);
+}
+
+void StreamingFlagger::add(const ImageSet& input,
+                           const FlagMask* existingFlags) {
+  StreamingFlaggerData& data = *_data;
+  if (input.Height() != data.height ||
+      input.ImageCount() != data.window.ImageCount())
+    throw std::runtime_error(
+        "Image set added to stream has a different height or image count than "
+        "the stream");
+  if (existingFlags && (existingFlags->Width() != input.Width() ||
+                        existingFlags->Height() != input.Height()))
+    throw std::runtime_error(
+        "Flags added to stream have different dimensions than the data");
+  if (input.HasAntennas())
+    data.window.SetAntennas(input.Antenna1(), input.Antenna2());
+  if (input.HasBand()) data.window.SetBand(input.Band());
+
+  size_t position = 0;
+  while (position != input.Width()) {
+    // Fill the window until the next block has enough context after it
+    const size_t flagWidth =
+        data.finishedContext + data.blockSize + data.contextSize;
+    const size_t n = std::min(input.Width() - position, flagWidth - data.width);
+    data.window.ResizeWithoutReallocation(data.width + n);
+    for (size_t image = 0; image != input.ImageCount(); ++image) {
+      for (size_t y = 0; y != data.height; ++y) {
+        std::copy_n(
+            input.ImageBuffer(image) + y * input.HorizontalStride() + position,
+            n,
+            data.window.ImageBuffer(image) +
+                y * data.window.HorizontalStride() + data.width);
+      }
+    }
+    for (size_t y = 0; y != data.height; ++y) {
+      bool* flags = data.windowFlags.Buffer() +
+                    y * data.windowFlags.HorizontalStride() + data.width;
+      if (existingFlags)
+        std::copy_n(existingFlags->Buffer() +
+                        y * existingFlags->HorizontalStride() + position,
+                    n, flags);
+      else
+        std::fill_n(flags, n, false);
+    }
+    data.width += n;
+    position += n;
+    if (data.width == flagWidth) flagWindow(data.blockSize);
+  }
+}
+
+void StreamingFlagger::Finish() {
+  StreamingFlaggerData& data = *_data;
+  if (data.width > data.finishedContext)
+    flagWindow(data.width - data.finishedContext);
+  data.width = 0;
+  data.finishedContext = 0;
+}
+
+void StreamingFlagger::flagWindow(size_t finishCount) {
+  StreamingFlaggerData& data = *_data;
+  data.window.ResizeWithoutReallocation(data.width);
+  FlagMask existingFlags =
+      data.aoflagger->MakeFlagMask(data.width, data.height);
+  for (size_t y = 0; y != data.height; ++y)
+    std::copy_n(
+        data.windowFlags.Buffer() + y * data.windowFlags.HorizontalStride(),
+        data.width,
+        existingFlags.Buffer() + y * existingFlags.HorizontalStride());
+  const FlagMask result =
+      data.strategy->RunAsync(data.window, existingFlags).get();
+
+  FlagMask finished = data.aoflagger->MakeFlagMask(finishCount, data.height);
+  for (size_t y = 0; y != data.height; ++y)
+    std::copy_n(result.Buffer() + y * result.HorizontalStride() +
+                    data.finishedContext,
+                finishCount,
+                finished.Buffer() + y * finished.HorizontalStride());
+  data.finished.emplace_back(std::move(finished));
+  data.finishedCount += finishCount;
+
+  // Keep the last finished timesteps as context for the next block
+  const size_t newContext =
+      std::min(data.contextSize, data.finishedContext + finishCount);
+  const size_t shift = data.finishedContext + finishCount - newContext;
+  const size_t remaining = data.width - shift;
+  if (shift != 0) {
+    for (size_t image = 0; image != data.window.ImageCount(); ++image) {
+      for (size_t y = 0; y != data.height; ++y) {
+        float* row =
+            data.window.ImageBuffer(image) + y * data.window.HorizontalStride();
+        std::memmove(row, row + shift, remaining * sizeof(float));
+      }
+    }
+    for (size_t y = 0; y != data.height; ++y) {
+      bool* row =
+          data.windowFlags.Buffer() + y * data.windowFlags.HorizontalStride();
+      std::memmove(row, row + shift, remaining * sizeof(bool));
+    }
+  }
+  data.width = remaining;
+  data.finishedContext = newContext;
+}
+
+size_t StreamingFlagger::FinishedCount() const { return _data->finishedCount; }
+
+FlagMask StreamingFlagger::TakeFinished() {
+  StreamingFlaggerData& data = *_data;
+  if (data.finishedCount == 0)
+    throw std::runtime_error("The stream has no finished timesteps");
+  FlagMask result =
+      data.aoflagger->MakeFlagMask(data.finishedCount, data.height);
+  size_t x = 0;
+  for (const FlagMask& block : data.finished) {
+    for (size_t y = 0; y != data.height; ++y)
+      std::copy_n(block.Buffer() + y * block.HorizontalStride(), block.Width(),
+                  result.Buffer() + y * result.HorizontalStride() + x);
+    x += block.Width();
+  }
+  data.finished.clear();
+  data.finishedCount = 0;
+  return result;
+}
+
+size_t StreamingFlagger::Latency() const {
+  return _data->blockSize + _data->contextSize;
+}
+
+}  // namespace aoflagger
@@ -1,6 +1,7 @@
 #include "datawrapper.h"
 
 #include "data.h"
+#include "functions.h"
 #include "tools.h"
 
 #include "../algorithms/restorechannelrange.h"
@@ -86,22 +87,7 @@ int Data::flag_zeros(lua_State* L) {
 int Data::flag_nans(lua_State* L) {
   aoflagger_lua::Data* data = reinterpret_cast<aoflagger_lua::Data*>(
       luaL_checkudata(L, 1, "AOFlaggerData"));
-  TimeFrequencyData newData = data->TFData();
-  for (size_t p = 0; p != newData.PolarizationCount(); ++p) {
-    TimeFrequencyData singlePol = newData.MakeFromPolarizationIndex(p);
-    Mask2DPtr mask = Mask2D::MakePtr(*singlePol.GetSingleMask());
-    for (size_t i = 0; i != singlePol.ImageCount(); ++i) {
-      const Image2DCPtr image = singlePol.GetImage(i);
-      for (unsigned y = 0; y < image->Height(); ++y) {
-        for (unsigned x = 0; x < image->Width(); ++x) {
-          if (!std::isfinite(image->Value(x, y))) mask->SetValue(x, y, true);
-        }
-      }
-    }
-    singlePol.SetGlobalMask(std::move(mask));
-    newData.SetPolarizationData(p, std::move(singlePol));
-  }
-  data->TFData() = newData;
+  aoflagger_lua::flag_nans(*data);
   return 0;
 }
 
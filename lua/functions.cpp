@@ -22,6 +22,7 @@
 
 #include "../quality/statisticscollection.h"
 
+#include <cmath>
 #include <complex>
 #include <iostream>
 
@@ -72,12 +73,38 @@ void collect_statistics(const Data& dataAfter, const Data& dataBefore,
     throw std::runtime_error("collect_statistics(): missing band metadata");
   if (!statistics)
     statistics.reset(new StatisticsCollection(polarizationCount));
-  const size_t bandIndex = dataBefore.MetaData()->Band().windowIndex;
-  if (!statistics->HasBand(bandIndex)) {
-    std::vector<double> channels(dataBefore.MetaData()->Band().channels.size());
-    for (size_t i = 0; i != channels.size(); ++i)
-      channels[i] = dataBefore.MetaData()->Band().channels[i].frequencyHz;
-    statistics->InitializeBand(bandIndex, channels.data(), channels.size());
+  // Every band is a range of channels. Normally, the data holds one band,
+  // but concatenated bands are collected separately.
+  const std::vector<size_t>& channelsPerBand =
+      scriptData.StatisticsChannelsPerBand();
+  const size_t channelCount = dataBefore.MetaData()->Band().channels.size();
+  std::vector<std::pair<size_t, size_t>> bandRanges;
+  if (channelsPerBand.empty()) {
+    bandRanges.emplace_back(0, channelCount);
+  } else {
+    size_t channelStart = 0;
+    for (size_t count : channelsPerBand) {
+      bandRanges.emplace_back(channelStart, count);
+      channelStart += count;
+    }
+    if (channelStart != channelCount)
+      throw std::runtime_error(
+          "collect_statistics(): the channels of the bands don't add up to "
+          "the number of channels in the data");
+  }
+  const size_t firstBandIndex =
+      channelsPerBand.empty() ? dataBefore.MetaData()->Band().windowIndex : 0;
+  for (size_t band = 0; band != bandRanges.size(); ++band) {
+    const size_t bandIndex = firstBandIndex + band;
+    if (!statistics->HasBand(bandIndex)) {
+      std::vector<double> channels(bandRanges[band].second);
+      for (size_t i = 0; i != channels.size(); ++i)
+        channels[i] = dataBefore.MetaData()
+                          ->Band()
+                          .channels[bandRanges[band].first + i]
+                          .frequencyHz;
+      statistics->InitializeBand(bandIndex, channels.data(), channels.size());
+    }
   }
   const bool useEmpty = (dataBefore.TFData().MaskCount() == 0 ||
                          dataAfter.TFData().MaskCount() == 0);
@@ -116,10 +143,13 @@ void collect_statistics(const Data& dataAfter, const Data& dataBefore,
     else
       afterMask = polDataAfter.GetSingleMask();
 
-    statistics->AddImage(antenna1, antenna2, &times[0], bandIndex, polarization,
-                         polDataBefore.GetRealPart(),
-                         polDataBefore.GetImaginaryPart(), afterMask,
-                         beforeMask);
+    for (size_t band = 0; band != bandRanges.size(); ++band) {
+      statistics->AddImage(antenna1, antenna2, &times[0], firstBandIndex + band,
+                           polarization, polDataBefore.GetRealPart(),
+                           polDataBefore.GetImaginaryPart(), afterMask,
+                           beforeMask, bandRanges[band].first,
+                           bandRanges[band].second);
+    }
   }
 }
 
@@ -156,6 +186,25 @@ void copy_to_frequency(Data& destination, const Data& source,
   copy_to_channel(destination, source, channelIndex);
 }
 
+void flag_nans(Data& data) {
+  TimeFrequencyData newData = data.TFData();
+  for (size_t p = 0; p != newData.PolarizationCount(); ++p) {
+    TimeFrequencyData singlePol = newData.MakeFromPolarizationIndex(p);
+    Mask2DPtr mask = Mask2D::MakePtr(*singlePol.GetSingleMask());
+    for (size_t i = 0; i != singlePol.ImageCount(); ++i) {
+      const Image2DCPtr image = singlePol.GetImage(i);
+      for (unsigned y = 0; y < image->Height(); ++y) {
+        for (unsigned x = 0; x < image->Width(); ++x) {
+          if (!std::isfinite(image->Value(x, y))) mask->SetValue(x, y, true);
+        }
+      }
+    }
+    singlePol.SetGlobalMask(std::move(mask));
+    newData.SetPolarizationData(p, std::move(singlePol));
+  }
+  data.TFData() = newData;
+}
+
 void upsample_image(const Data& input, Data& destination,
                     size_t horizontalFactor, size_t verticalFactor) {
   algorithms::upsample_image(input.TFData(), destination.TFData(),
@@ -351,14 +400,11 @@ void sumthreshold_masked(Data& data, const Data& missing,
                        horizontal, vertical);
 }
 
-void threshold_channel_rms(Data& data, double threshold,
-                           bool thresholdLowValues) {
-  const Image2DCPtr image(data.TFData().GetSingleImage());
-  SampleRow channels = SampleRow::MakeEmpty(image->Height());
-  Mask2DPtr mask(new Mask2D(*data.TFData().GetSingleMask()));
-  for (size_t y = 0; y < image->Height(); ++y) {
-    const SampleRow row =
-        SampleRow::MakeFromRowWithMissings(image.get(), mask.get(), y);
+void threshold_channel_rms(const Image2D& image, Mask2D& mask,
+                           double threshold, bool thresholdLowValues) {
+  SampleRow channels = SampleRow::MakeEmpty(image.Height());
+  for (size_t y = 0; y < image.Height(); ++y) {
+    const SampleRow row = SampleRow::MakeFromRowWithMissings(&image, &mask, y);
     channels.SetValue(y, row.RMSWithMissings());
   }
   bool change;
@@ -372,41 +418,53 @@ void threshold_channel_rms(Data& data, double threshold,
           (channels.Value(y) - median > effectiveThreshold ||
            (thresholdLowValues &&
             median - channels.Value(y) > effectiveThreshold))) {
-        mask->SetAllHorizontally<true>(y);
+        mask.SetAllHorizontally<true>(y);
         channels.SetValueMissing(y);
         change = true;
       }
     }
   } while (change);
+}
+
+void threshold_channel_rms(Data& data, double threshold,
+                           bool thresholdLowValues) {
+  const Image2DCPtr image(data.TFData().GetSingleImage());
+  Mask2DPtr mask(new Mask2D(*data.TFData().GetSingleMask()));
+  threshold_channel_rms(*image, *mask, threshold, thresholdLowValues);
   data.TFData().SetGlobalMask(std::move(mask));
 }
 
+void threshold_timestep_rms(const Image2D& image, Mask2D& mask,
+                            double threshold) {
+  SampleRow timesteps = SampleRow::MakeEmpty(image.Width());
+  for (size_t x = 0; x < image.Width(); ++x) {
+    const SampleRow row =
+        SampleRow::MakeFromColumnWithMissings(&image, &mask, x);
+    timesteps.SetValue(x, row.RMSWithMissings());
+  }
+  bool change;
+  MedianWindow<num_t>::SubtractMedian(timesteps, 511);
+  do {
+    const num_t median = 0.0;
+    const num_t stddev = timesteps.StdDevWithMissings(0.0);
+    change = false;
+    for (size_t x = 0; x < timesteps.Size(); ++x) {
+      if (!timesteps.ValueIsMissing(x) &&
+          (timesteps.Value(x) - median > stddev * threshold ||
+           median - timesteps.Value(x) > stddev * threshold)) {
+        mask.SetAllVertically<true>(x);
+        timesteps.SetValueMissing(x);
+        change = true;
+      }
+    }
+  } while (change);
+}
+
 void threshold_timestep_rms(Data& data, double threshold) {
   if (!data.TFData().IsEmpty()) {
     const Image2DCPtr image = data.TFData().GetSingleImage();
-    SampleRow timesteps = SampleRow::MakeEmpty(image->Width());
     Mask2DPtr mask(new Mask2D(*data.TFData().GetSingleMask()));
-    for (size_t x = 0; x < image->Width(); ++x) {
-      const SampleRow row =
-          SampleRow::MakeFromColumnWithMissings(image.get(), mask.get(), x);
-      timesteps.SetValue(x, row.RMSWithMissings());
-    }
-    bool change;
-    MedianWindow<num_t>::SubtractMedian(timesteps, 511);
-    do {
-      const num_t median = 0.0;
-      const num_t stddev = timesteps.StdDevWithMissings(0.0);
-      change = false;
-      for (size_t x = 0; x < timesteps.Size(); ++x) {
-        if (!timesteps.ValueIsMissing(x) &&
-            (timesteps.Value(x) - median > stddev * threshold ||
-             median - timesteps.Value(x) > stddev * threshold)) {
-          mask->SetAllVertically<true>(x);
-          timesteps.SetValueMissing(x);
-          change = true;
-        }
-      }
-    } while (change);
+    threshold_timestep_rms(*image, *mask, threshold);
     data.TFData().SetGlobalMask(std::move(mask));
   }
 }
@@ -19,6 +19,12 @@ void copy_to_channel(Data& destination, const Data& source, size_t channel);
 void copy_to_frequency(Data& destination, const Data& source,
                        double frequencyHz);
 
+/**
+ * Flags all samples that are not finite (NaN or infinite) in any of the
+ * images of their polarization.
+ */
+void flag_nans(Data& data);
+
 Data downsample(const Data& data, size_t horizontalFactor,
                 size_t verticalFactor);
 
@@ -67,8 +73,20 @@ void sumthreshold_masked(Data& data, const Data& missing,
 void threshold_channel_rms(Data& data, double threshold,
                            bool thresholdLowValues);
 
+/**
+ * Same as threshold_channel_rms(Data&, ...), but flags @p mask in place.
+ */
+void threshold_channel_rms(const Image2D& image, Mask2D& mask,
+                           double threshold, bool thresholdLowValues);
+
 void threshold_timestep_rms(Data& data, double threshold);
 
+/**
+ * Same as threshold_timestep_rms(Data&, double), but flags @p mask in place.
+ */
+void threshold_timestep_rms(const Image2D& image, Mask2D& mask,
+                            double threshold);
+
 Data trim_channels(const Data& data, size_t start_channel, size_t end_channel);
 
 Data trim_frequencies(const Data& data, double start_frequency,
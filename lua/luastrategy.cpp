@@ -1,5 +1,6 @@
 #include "luastrategy.h"
 
+#include <memory>
 #include <stdexcept>
 
 #include "datawrapper.h"
@@ -138,6 +139,39 @@ void LuaStrategy::LoadText(const std::string& data) {
   check(lua_pcall(_state, 0, 0, 0));
 }
 
+std::string LuaStrategy::CompileFile(const char* filename) {
+  const std::unique_ptr<lua_State, decltype(&lua_close)> state(luaL_newstate(),
+                                                               &lua_close);
+  check(state.get(), luaL_loadfile(state.get(), filename));
+  return dump(state.get());
+}
+
+std::string LuaStrategy::CompileText(const std::string& data) {
+  const std::unique_ptr<lua_State, decltype(&lua_close)> state(luaL_newstate(),
+                                                               &lua_close);
+  check(state.get(), luaL_loadstring(state.get(), data.c_str()));
+  return dump(state.get());
+}
+
+std::string LuaStrategy::dump(lua_State* state) {
+  std::string bytecode;
+  const lua_Writer writer = [](lua_State*, const void* data, size_t size,
+                               void* userData) -> int {
+    static_cast<std::string*>(userData)->append(static_cast<const char*>(data),
+                                                size);
+    return 0;
+  };
+  // The function is on top of the stack after loading it
+  check(state, lua_dump(state, writer, &bytecode, 0));
+  return bytecode;
+}
+
+void LuaStrategy::LoadBytecode(const std::string& bytecode) {
+  check(luaL_loadbufferx(_state, bytecode.data(), bytecode.size(), "strategy",
+                         "b"));
+  check(lua_pcall(_state, 0, 0, 0));
+}
+
 void LuaStrategy::RunPreamble(const std::vector<std::string>& preamble) {
   for (const std::string& str : preamble) {
     luaL_loadstring(_state, str.c_str());
@@ -28,6 +28,22 @@ class LuaStrategy {
   void Initialize();
   void LoadFile(const char* filename);
   void LoadText(const std::string& data);
+
+  /**
+   * Compiles a Lua file without running it, and returns the bytecode. The
+   * bytecode can be loaded into any number of strategies with LoadBytecode(),
+   * which avoids parsing the script once for every strategy.
+   */
+  static std::string CompileFile(const char* filename);
+  static std::string CompileText(const std::string& data);
+
+  /**
+   * Loads and runs bytecode that was made with CompileFile() or
+   * CompileText(). Debug info is kept in the bytecode, so error messages
+   * still refer to the original file and lines.
+   */
+  void LoadBytecode(const std::string& bytecode);
+
   void Execute(class TimeFrequencyData& tfData,
                TimeFrequencyMetaDataCPtr metaData, class ScriptData& scriptData,
                const std::string& executeFunctionName);
@@ -39,6 +55,7 @@ class LuaStrategy {
  private:
   void loadaoflagger();
 
+  static std::string dump(lua_State* state);
   static void check(lua_State* state, int error);
   void check(int error) { check(_state, error); }
   void clear();
@@ -2,45 +2,126 @@
 #define LUA_THREAD_GROUP_H
 
 #include "luastrategy.h"
+#include "nativedefaultstrategy.h"
 
+#include <memory>
+#include <string>
 #include <vector>
 
+/**
+ * A set of Lua strategies, one for every processing thread.
+ *
+ * A strategy is only compiled once: the loaded scripts are stored as bytecode,
+ * and the strategy of a thread is only created and initialized from this
+ * bytecode when the thread uses it for the first time. The strategy of the
+ * first thread is always created directly, such that errors in the script
+ * are reported while loading, and such that the options of the script can be
+ * read from it.
+ *
+ * When the only thing that is loaded is the unchanged default strategy,
+ * Execute() runs the NativeDefaultStrategy instead of the script. This gives
+ * the same result, but is faster. The Lua strategies are still made, for
+ * example to read the options from.
+ *
+ * Different threads may call Execute() and GetThread() at the same time, as
+ * long as each thread uses its own index. Loading and running the preamble
+ * should be done before that.
+ */
 class LuaThreadGroup {
  public:
-  explicit LuaThreadGroup(size_t nThreads) : _strategies(nThreads) {}
+  explicit LuaThreadGroup(size_t nThreads)
+      : _strategies(nThreads), _nativeStrategies(nThreads) {
+    if (!_strategies.empty()) _strategies[0] = std::make_unique<LuaStrategy>();
+  }
 
   void LoadFile(const char* filename) {
-    for (LuaStrategy& s : _strategies) {
-      s.Initialize();
-      s.LoadFile(filename);
-    }
+    addStep(Step{Step::Chunk, LuaStrategy::CompileFile(filename)});
+    _isDefaultStrategy = _steps.size() == 1 &&
+                         NativeDefaultStrategy::IsDefaultStrategyFile(filename);
   }
   void LoadText(const std::string& text) {
-    for (LuaStrategy& s : _strategies) {
-      s.Initialize();
-      s.LoadText(text);
-    }
+    addStep(Step{Step::Chunk, LuaStrategy::CompileText(text)});
+    _isDefaultStrategy =
+        _steps.size() == 1 && NativeDefaultStrategy::IsDefaultStrategy(text);
   }
   void Execute(size_t threadIndex, class TimeFrequencyData& tfData,
                const TimeFrequencyMetaDataCPtr& metaData,
                class ScriptData& scriptData,
                const std::string& executeFunctionName) {
-    _strategies[threadIndex].Execute(tfData, metaData, scriptData,
-                                     executeFunctionName);
+    if (UsesNativeDefaultStrategy() && executeFunctionName == "execute") {
+      std::unique_ptr<NativeDefaultStrategy>& strategy =
+          _nativeStrategies[threadIndex];
+      if (!strategy) strategy = std::make_unique<NativeDefaultStrategy>();
+      strategy->Execute(tfData, metaData, scriptData);
+    } else {
+      GetThread(threadIndex)
+          .Execute(tfData, metaData, scriptData, executeFunctionName);
+    }
   }
   void RunPreamble(const std::vector<std::string>& preamble) {
-    for (LuaStrategy& s : _strategies) s.RunPreamble(preamble);
+    for (const std::string& str : preamble) addStep(Step{Step::Preamble, str});
   }
 
   size_t NThreads() const { return _strategies.size(); }
 
-  const LuaStrategy& GetThread(size_t index) const {
-    return _strategies[index];
+  /**
+   * True when Execute() runs the NativeDefaultStrategy for the "execute"
+   * function. This is the case when a single script was loaded that is equal
+   * to the default strategy, and no preamble was given.
+   */
+  bool UsesNativeDefaultStrategy() const {
+    return _isDefaultStrategy && _steps.size() == 1;
+  }
+
+  /**
+   * Number of threads for which the strategy has been created so far.
+   */
+  size_t InitializedThreadCount() const {
+    size_t count = 0;
+    for (const std::unique_ptr<LuaStrategy>& s : _strategies)
+      if (s) ++count;
+    return count;
+  }
+
+  LuaStrategy& GetThread(size_t index) {
+    std::unique_ptr<LuaStrategy>& strategy = _strategies[index];
+    if (!strategy) {
+      strategy = std::make_unique<LuaStrategy>();
+      for (const Step& step : _steps) apply(*strategy, step);
+    }
+    return *strategy;
   }
-  LuaStrategy& GetThread(size_t index) { return _strategies[index]; }
 
  private:
-  std::vector<LuaStrategy> _strategies;
+  /**
+   * A preamble line or a compiled script, in the order in which they were
+   * given, such that strategies that are created later end up in the same
+   * state.
+   */
+  struct Step {
+    enum Type { Preamble, Chunk } type;
+    std::string code;
+  };
+
+  void addStep(Step step) {
+    for (std::unique_ptr<LuaStrategy>& s : _strategies)
+      if (s) apply(*s, step);
+    _steps.emplace_back(std::move(step));
+  }
+
+  static void apply(LuaStrategy& strategy, const Step& step) {
+    if (step.type == Step::Preamble) {
+      strategy.RunPreamble({step.code});
+    } else {
+      strategy.Initialize();
+      strategy.LoadBytecode(step.code);
+    }
+  }
+
+  std::vector<std::unique_ptr<LuaStrategy>> _strategies;
+  std::vector<Step> _steps;
+  std::vector<std::unique_ptr<NativeDefaultStrategy>> _nativeStrategies;
+  bool _isDefaultStrategy = false;
 };
 
 #endif
@@ -0,0 +1,224 @@
+#include "nativedefaultstrategy.h"
+
+#include "default-strategy.h"
+#include "functions.h"
+#include "scriptdata.h"
+
+#include "../algorithms/siroperator.h"
+
+#include "../util/progress/progresslistener.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using algorithms::SIROperator;
+using algorithms::ThresholdConfig;
+using aoflagger_lua::Data;
+
+namespace {
+// These are the settings at the start of the execute() function of
+// generic-default.lua. Changing one of these in the script gives a different
+// script, and thus the script will be run by Lua instead.
+constexpr double kBaseThreshold = 1.0;
+constexpr size_t kIterationCount = 3;
+constexpr double kThresholdFactorStep = 2.0;
+constexpr size_t kFrequencyResizeFactor = 1;
+constexpr double kTransientThresholdFactor = 1.0;
+// Default penalty of scale_invariant_rank_operator_masked()
+constexpr double kSirPenalty = 0.1;
+// Masks that are returned to the caller are not reused until the caller has
+// released them, so the number of scratch masks is limited.
+constexpr size_t kMaxScratchMasks = 16;
+
+bool HasMetaData(const TimeFrequencyMetaDataCPtr& metaData) {
+  return metaData && metaData->HasAntenna1() && metaData->HasAntenna2() &&
+         metaData->HasBand() && metaData->HasObservationTimes();
+}
+}  // namespace
+
+NativeDefaultStrategy::NativeDefaultStrategy() {
+  _thresholdConfig.InitializeLengthsDefault();
+  _thresholdConfig.InitializeThresholdsFromFirstThreshold(
+      6.0L, ThresholdConfig::Rayleigh);
+  _lowPassFilter.SetHWindowSize(21);
+  _lowPassFilter.SetVWindowSize(31);
+  _lowPassFilter.SetHKernelSigmaSq(2.5);
+  _lowPassFilter.SetVKernelSigmaSq(5.0);
+}
+
+bool NativeDefaultStrategy::IsDefaultStrategy(const std::string& script) {
+  return script.size() == data_strategies_generic_default_lua_len &&
+         std::memcmp(script.data(), data_strategies_generic_default_lua,
+                     script.size()) == 0;
+}
+
+bool NativeDefaultStrategy::IsDefaultStrategyFile(const char* filename) {
+  std::error_code error;
+  // Most strategies can be rejected without reading them.
+  if (std::filesystem::file_size(filename, error) !=
+          data_strategies_generic_default_lua_len ||
+      error)
+    return false;
+  std::ifstream file(filename, std::ios::binary);
+  const std::string script((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+  return file && IsDefaultStrategy(script);
+}
+
+void NativeDefaultStrategy::Execute(TimeFrequencyData& tfData,
+                                    const TimeFrequencyMetaDataCPtr& metaData,
+                                    ScriptData& scriptData) {
+  Data input(tfData, metaData, _context);
+  const std::vector<aocommon::PolarizationEnum> polarizations =
+      input.TFData().Polarizations();
+  const bool isComplex =
+      input.TFData().ComplexRepresentation() == TimeFrequencyData::ComplexParts;
+  // Copying data only copies the pointers to the images and masks.
+  const Data copyOfInput(input);
+
+  for (size_t polIndex = 0; polIndex != polarizations.size(); ++polIndex) {
+    const aocommon::PolarizationEnum polarization = polarizations[polIndex];
+    Data convertedData(input.TFData()
+                           .Make(polarization)
+                           .Make(TimeFrequencyData::AmplitudePart),
+                       input.MetaData(), _context);
+    const Data convertedCopy(convertedData);
+
+    for (size_t i = 1; i != kIterationCount; ++i) {
+      const double thresholdFactor =
+          std::pow(kThresholdFactorStep, double(kIterationCount - i));
+      sumThreshold(convertedData, convertedCopy,
+                   thresholdFactor * kBaseThreshold);
+
+      // Timestep & channel flagging
+      Data channelData(convertedData);
+      thresholdTimestepRms(convertedData, 3.5);
+      thresholdChannelRms(channelData, 3.0 * thresholdFactor);
+      convertedData.TFData().JoinMask(channelData.TFData());
+
+      // High-pass filtering
+      for (size_t image = 0; image != convertedCopy.TFData().ImageCount();
+           ++image)
+        convertedData.TFData().SetImage(image,
+                                        convertedCopy.TFData().GetImage(image));
+      convertedData.TFData().JoinMask(convertedCopy.TFData());
+
+      Data resizedData =
+          aoflagger_lua::downsample_masked(convertedData, 3,
+                                           kFrequencyResizeFactor);
+      lowPassFilter(resizedData);
+      aoflagger_lua::upsample_image(resizedData, convertedData, 3,
+                                    kFrequencyResizeFactor);
+
+      scriptData.AddVisualization(convertedData.TFData(),
+                                  "Fit #" + std::to_string(i), i - 1);
+
+      Data residual(TimeFrequencyData::MakeFromDiff(convertedCopy.TFData(),
+                                                    convertedData.TFData()),
+                    convertedCopy.MetaData(), _context);
+      residual.TFData().SetMask(convertedData.TFData());
+      convertedData = std::move(residual);
+
+      scriptData.AddVisualization(convertedData.TFData(),
+                                  "Residual #" + std::to_string(i),
+                                  i + kIterationCount);
+      if (scriptData.Progress())
+        scriptData.Progress()->OnProgress(
+            polIndex * kIterationCount + i,
+            polarizations.size() * kIterationCount);
+    }
+
+    sumThreshold(convertedData, convertedCopy, kBaseThreshold);
+    convertedData.TFData().JoinMask(convertedCopy.TFData());
+
+    if (isComplex)
+      convertedData.TFData() =
+          convertedData.TFData().Make(TimeFrequencyData::ComplexParts);
+    input.TFData().SetPolarizationData(
+        input.TFData().GetPolarizationIndex(polarization),
+        convertedData.TFData());
+
+    scriptData.AddVisualization(convertedData.TFData(),
+                                "Residual #" + std::to_string(kIterationCount),
+                                2 * kIterationCount);
+    if (scriptData.Progress())
+      scriptData.Progress()->OnProgress(polIndex + 1, polarizations.size());
+  }
+
+  scaleInvariantRankOperator(input, copyOfInput);
+  thresholdTimestepRms(input, 4.0);
+
+  if (isComplex && HasMetaData(input.MetaData()))
+    aoflagger_lua::collect_statistics(input, copyOfInput, scriptData);
+  aoflagger_lua::flag_nans(input);
+
+  tfData = input.TFData();
+}
+
+void NativeDefaultStrategy::sumThreshold(Data& data, const Data& missing,
+                                         double level) {
+  if (data.TFData().PolarizationCount() != 1)
+    throw std::runtime_error("Input data in sum_threshold has wrong format");
+  const Image2DCPtr image = data.TFData().GetSingleImage();
+  const Mask2DCPtr missingMask = missing.TFData().GetSingleMask();
+  const Mask2DPtr mask = copyMask(*data.TFData().GetSingleMask());
+  _thresholdConfig.ExecuteWithMissing(image.get(), mask.get(),
+                                      missingMask.get(), false, level,
+                                      level * kTransientThresholdFactor);
+  data.TFData().SetGlobalMask(mask);
+}
+
+void NativeDefaultStrategy::thresholdChannelRms(Data& data, double threshold) {
+  const Image2DCPtr image = data.TFData().GetSingleImage();
+  const Mask2DPtr mask = copyMask(*data.TFData().GetSingleMask());
+  aoflagger_lua::threshold_channel_rms(*image, *mask, threshold, true);
+  data.TFData().SetGlobalMask(mask);
+}
+
+void NativeDefaultStrategy::thresholdTimestepRms(Data& data,
+                                                 double threshold) {
+  if (!data.TFData().IsEmpty()) {
+    const Image2DCPtr image = data.TFData().GetSingleImage();
+    const Mask2DPtr mask = copyMask(*data.TFData().GetSingleMask());
+    aoflagger_lua::threshold_timestep_rms(*image, *mask, threshold);
+    data.TFData().SetGlobalMask(mask);
+  }
+}
+
+void NativeDefaultStrategy::lowPassFilter(Data& data) {
+  if (data.TFData().PolarizationCount() != 1)
+    throw std::runtime_error("High-pass filtering needs single polarization");
+  const Mask2DCPtr mask = data.TFData().GetSingleMask();
+  for (size_t i = 0; i != data.TFData().ImageCount(); ++i)
+    data.TFData().SetImage(
+        i, _lowPassFilter.ApplyLowPass(data.TFData().GetImage(i), mask));
+}
+
+void NativeDefaultStrategy::scaleInvariantRankOperator(Data& data,
+                                                       const Data& missing) {
+  if (!data.TFData().IsEmpty()) {
+    const Mask2DPtr mask = copyMask(*data.TFData().GetSingleMask());
+    const Mask2DCPtr missingMask = missing.TFData().GetSingleMask();
+    SIROperator::OperateHorizontallyMissing(*mask, *missingMask, 0.2,
+                                            kSirPenalty);
+    SIROperator::OperateVerticallyMissing(*mask, *missingMask, 0.2,
+                                          kSirPenalty);
+    data.TFData().SetGlobalMask(mask);
+  }
+}
+
+Mask2DPtr NativeDefaultStrategy::copyMask(const Mask2D& source) {
+  for (Mask2DPtr& mask : _scratchMasks) {
+    // A use count of one means that only this list refers to the mask.
+    if (mask->use_count() == 1) {
+      *mask = source;
+      return mask;
+    }
+  }
+  Mask2DPtr mask = Mask2D::MakePtr(source);
+  if (_scratchMasks.size() < kMaxScratchMasks) _scratchMasks.push_back(mask);
+  return mask;
+}
@@ -0,0 +1,77 @@
+#ifndef LUA_NATIVE_DEFAULT_STRATEGY_H
+#define LUA_NATIVE_DEFAULT_STRATEGY_H
+
+#include "data.h"
+
+#include "../algorithms/highpassfilter.h"
+#include "../algorithms/thresholdconfig.h"
+
+#include "../structures/mask2d.h"
+#include "../structures/timefrequencydata.h"
+#include "../structures/timefrequencymetadata.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * C++ implementation of the default Lua strategy
+ * (data/strategies/generic-default.lua), which gives the same flags as
+ * running the script, but without the overhead of the Lua interpreter.
+ *
+ * It is used by the LuaThreadGroup when the loaded strategy is exactly the
+ * default strategy. It performs the same steps, but keeps the SumThreshold
+ * configuration and the low-pass filter kernels between calls, and changes
+ * masks in place in a small set of reused scratch masks, instead of
+ * allocating a new mask for every step.
+ *
+ * An instance should only be used by one thread at a time.
+ */
+class NativeDefaultStrategy {
+ public:
+  NativeDefaultStrategy();
+
+  NativeDefaultStrategy(const NativeDefaultStrategy&) = delete;
+  NativeDefaultStrategy& operator=(const NativeDefaultStrategy&) = delete;
+
+  /**
+   * Performs the default strategy on @p tfData, like the execute() function
+   * of the default Lua strategy.
+   */
+  void Execute(TimeFrequencyData& tfData,
+               const TimeFrequencyMetaDataCPtr& metaData,
+               class ScriptData& scriptData);
+
+  /**
+   * True when @p script is equal to the default strategy that is
+   * embedded in aoflagger.
+   */
+  static bool IsDefaultStrategy(const std::string& script);
+
+  /**
+   * Like IsDefaultStrategy(), but reads the script from a file. Returns false
+   * if the file can not be read.
+   */
+  static bool IsDefaultStrategyFile(const char* filename);
+
+ private:
+  void sumThreshold(aoflagger_lua::Data& data,
+                    const aoflagger_lua::Data& missing, double level);
+  void thresholdChannelRms(aoflagger_lua::Data& data, double threshold);
+  void thresholdTimestepRms(aoflagger_lua::Data& data, double threshold);
+  void lowPassFilter(aoflagger_lua::Data& data);
+  void scaleInvariantRankOperator(aoflagger_lua::Data& data,
+                                  const aoflagger_lua::Data& missing);
+
+  /**
+   * Returns a copy of @p source. The copy is made in a scratch mask that is
+   * no longer used by any data, when available.
+   */
+  Mask2DPtr copyMask(const Mask2D& source);
+
+  aoflagger_lua::Data::Context _context;
+  algorithms::ThresholdConfig _thresholdConfig;
+  algorithms::HighPassFilter _lowPassFilter;
+  std::vector<Mask2DPtr> _scratchMasks;
+};
+
+#endif
@@ -152,6 +152,15 @@ Options OptionsFunction::fillOptions(lua_State* state,
         throw std::runtime_error(
             "options(): Invalid setting '" + val +
             "' for option 'baseline-integration' returned");
+    } else if (keyStr == "baseline-order") {
+      const std::string val = strOption(state, keyStr, runName);
+      if (val == "read")
+        options.baselineOrder = BaselineOrder::Read;
+      else if (val == "cost")
+        options.baselineOrder = BaselineOrder::Cost;
+      else
+        throw std::runtime_error("options(): Invalid setting '" + val +
+                                 "' for option 'baseline-order' returned");
     } else if (keyStr == "baselines") {
       const std::string val = strOption(state, keyStr, runName);
       if (val == "all")
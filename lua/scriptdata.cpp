@@ -10,7 +10,8 @@ ScriptData::ScriptData()
       _bandpassMutex(),
       _canVisualize(false),
       _visualizationData(),
-      _statistics() {}
+      _statistics(),
+      _statisticsChannelsPerBand() {}
 
 ScriptData::~ScriptData() {}
 
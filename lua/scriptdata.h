@@ -26,6 +26,19 @@ class ScriptData {
     return _statistics;
   }
 
+  /**
+   * When set, the data consists of several spectrally concatenated bands
+   * with the given number of channels each, and collect_statistics() collects
+   * the statistics of every band separately. This allows storing the
+   * statistics per band, e.g. in the measurement set of each band.
+   */
+  void SetStatisticsChannelsPerBand(std::vector<size_t> channelsPerBand) {
+    _statisticsChannelsPerBand = std::move(channelsPerBand);
+  }
+  const std::vector<size_t>& StatisticsChannelsPerBand() const {
+    return _statisticsChannelsPerBand;
+  }
+
   void AddVisualization(TimeFrequencyData& data, const std::string& label,
                         size_t sortingIndex) {
     if (_canVisualize) {
@@ -86,6 +99,7 @@ class ScriptData {
   std::vector<std::tuple<std::string, TimeFrequencyData, size_t>>
       _visualizationData;
   std::unique_ptr<class StatisticsCollection> _statistics;
+  std::vector<size_t> _statisticsChannelsPerBand;
 };
 
 #endif
@@ -54,6 +54,14 @@ class BaselineReader {
 
   static class DummyProgressListener dummy_progress_;
 
+  /**
+   * Whether PerformReadRequests() may be called from one thread while another
+   * thread calls AddWriteTask() and PerformFlagWriteRequests(). Readers that
+   * access the measurement set in both cases can not do this, because casacore
+   * tables are not thread safe.
+   */
+  virtual bool SupportsConcurrentReadWrite() const { return false; }
+
   bool ReadFlags() const { return _readFlags; }
   void SetReadFlags(bool readFlags) { _readFlags = readFlags; }
 
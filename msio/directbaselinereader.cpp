@@ -269,32 +269,71 @@ void DirectBaselineReader::PerformFlagWriteRequests() {
     }
   }
 
-  size_t rowsWritten = 0;
-
+  // Select the rows that are written, with their request and time index. The
+  // rows remain sorted.
+  struct RowToWrite {
+    size_t rowIndex;
+    size_t requestIndex;
+    size_t timeIndex;
+  };
+  std::vector<RowToWrite> selectedRows;
+  selectedRows.reserve(rows.size());
   for (const std::pair<size_t, size_t>& row : rows) {
     const size_t rowIndex = row.first;
-    FlagWriteRequest& request = _writeRequests[row.second];
+    const FlagWriteRequest& request = _writeRequests[row.second];
     const double time = timeColumn(rowIndex);
     const size_t timeIndex =
         ObservationTimes(request.sequenceId).find(time)->second;
     if (timeIndex >= request.startIndex + request.leftBorder &&
         timeIndex < request.endIndex - request.rightBorder) {
-      casacore::Array<bool> flag = flagColumn(rowIndex);
-      casacore::Array<bool>::iterator j = flag.begin();
-      for (size_t f = 0;
-           f < (size_t)MetaData().FrequencyCount(request.spectralWindow); ++f) {
-        for (size_t p = 0; p < Polarizations().size(); ++p) {
-          *j = request.flags[p]->Value(timeIndex - request.startIndex, f);
-          ++j;
+      selectedRows.push_back(RowToWrite{rowIndex, row.second, timeIndex});
+    }
+  }
+
+  // Consecutive rows with the same shape are written with one call, which is
+  // much faster than writing the rows one by one. Because the rows of all
+  // requests are sorted together, the rows of different baselines of the same
+  // timestep are combined.
+  const size_t polarizationCount = Polarizations().size();
+  size_t spanCount = 0;
+  size_t spanStart = 0;
+  while (spanStart != selectedRows.size()) {
+    const size_t channelCount = MetaData().FrequencyCount(
+        _writeRequests[selectedRows[spanStart].requestIndex].spectralWindow);
+    size_t spanEnd = spanStart + 1;
+    while (spanEnd != selectedRows.size() &&
+           selectedRows[spanEnd].rowIndex ==
+               selectedRows[spanEnd - 1].rowIndex + 1 &&
+           MetaData().FrequencyCount(
+               _writeRequests[selectedRows[spanEnd].requestIndex]
+                   .spectralWindow) == channelCount)
+      ++spanEnd;
+
+    casacore::Array<bool> flags(casacore::IPosition(
+        3, polarizationCount, channelCount, spanEnd - spanStart));
+    bool* flagIter = flags.data();
+    for (size_t i = spanStart; i != spanEnd; ++i) {
+      const FlagWriteRequest& request =
+          _writeRequests[selectedRows[i].requestIndex];
+      const size_t x = selectedRows[i].timeIndex - request.startIndex;
+      for (size_t f = 0; f != channelCount; ++f) {
+        for (size_t p = 0; p != polarizationCount; ++p) {
+          *flagIter = request.flags[p]->Value(x, f);
+          ++flagIter;
         }
       }
-      flagColumn.basePut(rowIndex, flag);
-      ++rowsWritten;
     }
+    const casacore::Slicer rowRange(
+        casacore::IPosition(1, selectedRows[spanStart].rowIndex),
+        casacore::IPosition(1, spanEnd - spanStart));
+    flagColumn.putColumnRange(rowRange, flags);
+    ++spanCount;
+    spanStart = spanEnd;
   }
   _writeRequests.clear();
 
-  Logger::Debug << rowsWritten << "/" << rows.size() << " rows written in "
+  Logger::Debug << selectedRows.size() << "/" << rows.size()
+                << " rows written in " << spanCount << " spans in "
                 << stopwatch.ToString() << '\n';
 }
 
@@ -0,0 +1,79 @@
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+[[noreturn]] void ThrowError(const std::string& what,
+                             const std::string& filename) {
+  std::ostringstream s;
+  s << "Error while trying to " << what << " file '" << filename
+    << "': " << std::strerror(errno);
+  throw std::runtime_error(s.str());
+}
+}  // namespace
+
+MappedFile::MappedFile(const std::string& filename, bool sequential)
+    : data_(nullptr), size_(0) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) ThrowError("open", filename);
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    const int error = errno;
+    close(fd);
+    errno = error;
+    ThrowError("query the size of", filename);
+  }
+  size_ = status.st_size;
+  // A mapping of zero bytes is not allowed; an empty file is left unmapped.
+  if (size_ != 0) {
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      ThrowError("memory map", filename);
+    }
+    data_ = static_cast<char*>(mapping);
+    if (sequential) madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+  // The mapping stays valid after closing the descriptor.
+  close(fd);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept {
+  if (this != &rhs) {
+    unmap();
+    data_ = rhs.data_;
+    size_ = rhs.size_;
+    rhs.data_ = nullptr;
+    rhs.size_ = 0;
+  }
+  return *this;
+}
+
+void MappedFile::WillNeed(size_t offset, size_t length) const {
+  if (data_ == nullptr || offset >= size_) return;
+  length = std::min(length, size_ - offset);
+  // madvise() requires a page-aligned start address.
+  const size_t pageSize = sysconf(_SC_PAGESIZE);
+  const size_t alignedOffset = offset - offset % pageSize;
+  madvise(data_ + alignedOffset, length + (offset - alignedOffset),
+          MADV_WILLNEED);
+}
+
+void MappedFile::unmap() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
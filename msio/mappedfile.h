@@ -0,0 +1,62 @@
+#ifndef MSIO_MAPPED_FILE_H_
+#define MSIO_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file.
+ *
+ * The mapping is shared, so changes that are written to the file through
+ * other file descriptors (e.g. an std::ofstream) are directly visible in the
+ * mapping. This is what the ReorderingBaselineReader relies on: its flag and
+ * data write tasks write to the temporary files while the reader keeps them
+ * mapped.
+ */
+class MappedFile {
+ public:
+  MappedFile() : data_(nullptr), size_(0) {}
+
+  /**
+   * Maps the file @p filename. Throws a std::runtime_error when the file can
+   * not be opened or mapped.
+   * @param sequential If true, the kernel is told that the file will be read
+   * sequentially, which makes it read ahead more aggressively.
+   */
+  MappedFile(const std::string& filename, bool sequential);
+
+  ~MappedFile() { unmap(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& source) noexcept
+      : data_(source.data_), size_(source.size_) {
+    source.data_ = nullptr;
+    source.size_ = 0;
+  }
+
+  MappedFile& operator=(MappedFile&& rhs) noexcept;
+
+  bool IsMapped() const { return data_ != nullptr; }
+
+  const char* Data() const { return data_; }
+
+  size_t Size() const { return size_; }
+
+  /**
+   * Tells the kernel that the given byte range will be accessed soon, so
+   * that it can start reading it in the background. This is only a hint: it
+   * returns immediately and errors are ignored. The range is clipped to the
+   * size of the file.
+   */
+  void WillNeed(size_t offset, size_t length) const;
+
+ private:
+  void unmap();
+
+  char* data_;
+  size_t size_;
+};
+
+#endif  // MSIO_MAPPED_FILE_H_
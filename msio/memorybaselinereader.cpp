@@ -3,11 +3,10 @@
 #include "msselection.h"
 
 #include "../util/logger.h"
+#include "../util/memoryplanner.h"
 #include "../util/progress/dummyprogresslistener.h"
 #include "../util/stopwatch.h"
 
-#include <aocommon/system.h>
-
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 #include <casacore/tables/Tables/ArrayColumn.h>
 #include <casacore/tables/Tables/ScalarColumn.h>
@@ -15,6 +14,7 @@
 #include <vector>
 
 void MemoryBaselineReader::PrepareReadWrite(ProgressListener& progress) {
+  const std::lock_guard<std::mutex> lock(_mutex);
   if (!_isRead) {
     progress.OnStartTask("Reading measurement set into memory");
     readSet(progress);
@@ -25,6 +25,7 @@ void MemoryBaselineReader::PrepareReadWrite(ProgressListener& progress) {
 void MemoryBaselineReader::PerformReadRequests(ProgressListener& progress) {
   PrepareReadWrite(progress);
 
+  const std::lock_guard<std::mutex> lock(_mutex);
   for (size_t i = 0; i != _readRequests.size(); ++i) {
     const ReadRequest& request = _readRequests[i];
     const BaselineID id(request.antenna1, request.antenna2,
@@ -209,11 +210,20 @@ void MemoryBaselineReader::readSet(ProgressListener& progress) {
 void MemoryBaselineReader::PerformFlagWriteRequests() {
   PrepareReadWrite(dummy_progress_);
 
+  const std::lock_guard<std::mutex> lock(_mutex);
   for (size_t i = 0; i != _writeRequests.size(); ++i) {
     const FlagWriteRequest& request = _writeRequests[i];
     const BaselineID id(request.antenna1, request.antenna2,
                         request.spectralWindow, request.sequenceId);
-    std::unique_ptr<Result>& result = _baselines[id];
+    // Use find() instead of operator[], because the map may not change while
+    // another thread is reading.
+    const std::map<BaselineID, std::unique_ptr<Result>>::iterator iter =
+        _baselines.find(id);
+    if (iter == _baselines.end())
+      throw std::runtime_error(
+          "Exception in PerformFlagWriteRequests(): baseline is not "
+          "available in measurement set");
+    std::unique_ptr<Result>& result = iter->second;
     if (result->_flags.size() != request.flags.size())
       throw std::runtime_error("Polarizations do not match");
     for (size_t p = 0; p != result->_flags.size(); ++p)
@@ -283,9 +293,9 @@ void MemoryBaselineReader::WriteToMs() {
 }
 
 bool MemoryBaselineReader::IsEnoughMemoryAvailable(uint64_t size) {
-  const uint64_t totalMem = aocommon::system::TotalMemory();
+  const uint64_t totalMem = MemoryPlanner::Budget();
 
-  if (size * 2 >= totalMem) {
+  if (!MemoryPlanner::FitsInMemory(size, totalMem)) {
     Logger::Warn
         << (size / 1000000) << " MB required, but " << (totalMem / 1000000)
         << " MB available.\n"
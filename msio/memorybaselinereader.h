@@ -2,6 +2,7 @@
 #define MEMORY_BASELINE_READER_H
 
 #include <map>
+#include <mutex>
 #include <vector>
 #include <stdexcept>
 
@@ -51,6 +52,13 @@ class MemoryBaselineReader final : public BaselineReader {
 
   bool IsModified() const override { return _areFlagsChanged; }
 
+  /**
+   * Both reading and writing only access memory, which is protected by a
+   * mutex. The measurement set is only accessed in PrepareReadWrite() and
+   * WriteToMs().
+   */
+  bool SupportsConcurrentReadWrite() const override { return true; }
+
   void WriteToMs() override;
 
  private:
@@ -58,6 +66,7 @@ class MemoryBaselineReader final : public BaselineReader {
   void clear();
 
   bool _isRead, _areFlagsChanged;
+  std::mutex _mutex;
 
   class BaselineID {
    public:
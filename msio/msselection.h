@@ -17,48 +17,71 @@ class MSSelection {
   MSSelection(casacore::MeasurementSet& ms,
               const std::vector<std::map<double, size_t>>& observationTimes,
               ProgressListener& progress)
-      : _observationTimes(observationTimes), _ms(ms), _progress(progress) {}
+      : _observationTimes(observationTimes),
+        _ms(ms),
+        _progress(progress),
+        _timeColumn(ms, "TIME"),
+        _fieldIdColumn(ms, "FIELD_ID") {
+    reset();
+  }
 
   template <typename Function>
   void Process(Function function) {
-    casacore::ScalarColumn<double> timeColumn(_ms, "TIME");
-    casacore::ScalarColumn<int> fieldIdColumn(_ms, "FIELD_ID");
-
-    double prevTime = -1.0;
-    size_t prevFieldId = size_t(-1), sequenceId = size_t(-1),
-           timeIndexInSequence = size_t(-1);
+    reset();
+    ProcessRange(0, _ms.nrow(), function);
+  }
 
-    for (size_t rowIndex = 0; rowIndex != _ms.nrow(); ++rowIndex) {
+  /**
+   * Like Process(), but only processes the rows in the range [startRow,
+   * endRow). The sequence of a row depends on the rows before it, so the
+   * ranges should be consecutive and start at row zero. This allows the caller
+   * to process the measurement set in chunks.
+   */
+  template <typename Function>
+  void ProcessRange(size_t startRow, size_t endRow, Function function) {
+    for (size_t rowIndex = startRow; rowIndex != endRow; ++rowIndex) {
       _progress.OnProgress(rowIndex, _ms.nrow());
-      double time = timeColumn(rowIndex);
-      bool newTime = time != prevTime;
-      size_t fieldId = fieldIdColumn(rowIndex);
-      if (fieldId != prevFieldId) {
-        prevFieldId = fieldId;
-        sequenceId++;
+      double time = _timeColumn(rowIndex);
+      bool newTime = time != _prevTime;
+      size_t fieldId = _fieldIdColumn(rowIndex);
+      if (fieldId != _prevFieldId) {
+        _prevFieldId = fieldId;
+        _sequenceId++;
         newTime = true;
       }
       if (newTime) {
         const std::map<double, size_t>& observationTimes =
-            _observationTimes[sequenceId];
-        prevTime = time;
+            _observationTimes[_sequenceId];
+        _prevTime = time;
         auto elem = observationTimes.find(time);
         if (elem == observationTimes.end())
-          timeIndexInSequence = std::numeric_limits<size_t>::max();
+          _timeIndexInSequence = std::numeric_limits<size_t>::max();
         else
-          timeIndexInSequence = elem->second;
+          _timeIndexInSequence = elem->second;
       }
-      if (timeIndexInSequence != std::numeric_limits<size_t>::max()) {
-        function(rowIndex, sequenceId, timeIndexInSequence);
+      if (_timeIndexInSequence != std::numeric_limits<size_t>::max()) {
+        function(rowIndex, _sequenceId, _timeIndexInSequence);
       }
     }
   }
 
  private:
+  void reset() {
+    _prevTime = -1.0;
+    _prevFieldId = size_t(-1);
+    _sequenceId = size_t(-1);
+    _timeIndexInSequence = size_t(-1);
+  }
+
   std::vector<std::map<double, size_t>> _observationTimes;
 
   casacore::MeasurementSet& _ms;
   ProgressListener& _progress;
+  casacore::ScalarColumn<double> _timeColumn;
+  casacore::ScalarColumn<int> _fieldIdColumn;
+
+  double _prevTime;
+  size_t _prevFieldId, _sequenceId, _timeIndexInSequence;
 };
 
 #endif
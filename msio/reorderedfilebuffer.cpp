@@ -0,0 +1,169 @@
+#include "reorderedfilebuffer.h"
+
+#include "../util/logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+std::runtime_error WriteError(const std::string& filename) {
+  std::ostringstream s;
+  s << "Error: failed to write to reordered file '" << filename
+    << "': " << std::strerror(errno)
+    << ". Check access rights and free disk space.";
+  return std::runtime_error(s.str());
+}
+
+/**
+ * Writes all the buffers in @p iov to consecutive positions, starting at
+ * @p offset, and returns the number of calls that were necessary.
+ */
+size_t WriteVectors(int fd, std::vector<iovec>& iov, size_t offset,
+                    const std::string& filename) {
+  size_t index = 0;
+  size_t callCount = 0;
+  while (index != iov.size()) {
+    const int count = std::min<size_t>(iov.size() - index, IOV_MAX);
+    const ssize_t result = pwritev(fd, &iov[index], count, offset);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      throw WriteError(filename);
+    }
+    if (result == 0) {
+      errno = EIO;
+      throw WriteError(filename);
+    }
+    ++callCount;
+    offset += result;
+    // Skip the buffers that were fully written. A partial write is unlikely,
+    // but not forbidden; in that case, the remainder is written next.
+    size_t written = result;
+    while (index != iov.size() && written >= iov[index].iov_len) {
+      written -= iov[index].iov_len;
+      ++index;
+    }
+    if (written != 0) {
+      iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + written;
+      iov[index].iov_len -= written;
+    }
+  }
+  return callCount;
+}
+}  // namespace
+
+ReorderedFileBuffer::ReorderedFileBuffer(const std::string& filename,
+                                         size_t maxSize)
+    : _filename(filename),
+      _fd(open(filename.c_str(), O_WRONLY)),
+      _nextWritePos(0),
+      _bucketSize(std::max<size_t>(maxSize / 2, 1)),
+      _activeBucket(0),
+      _writtenBytes(0),
+      _writeCallCount(0) {
+  if (_fd < 0) {
+    std::ostringstream s;
+    s << "Error while opening file '" << filename
+      << "' for writing: " << std::strerror(errno)
+      << ". Check access rights and free disk space.";
+    throw std::runtime_error(s.str());
+  }
+  _buckets[0].data.reserve(_bucketSize);
+}
+
+ReorderedFileBuffer::~ReorderedFileBuffer() {
+  try {
+    flush();
+  } catch (std::exception& e) {
+    Logger::Error << e.what() << '\n';
+  }
+  close(_fd);
+}
+
+void ReorderedFileBuffer::write(const char* data, size_t length) {
+  Bucket& bucket = _buckets[_activeBucket];
+  bucket.entries.push_back(Entry{_nextWritePos, bucket.data.size(), length});
+  bucket.data.insert(bucket.data.end(), data, data + length);
+  _nextWritePos += length;
+
+  if (bucket.Size() > _bucketSize) startFlush();
+}
+
+void ReorderedFileBuffer::flush() {
+  startFlush();
+  waitForFlush();
+}
+
+void ReorderedFileBuffer::startFlush() {
+  // Only one bucket can be written at a time: the previous one needs to have
+  // been written before the active bucket can be handed to the writer.
+  waitForFlush();
+  Bucket& bucket = _buckets[_activeBucket];
+  _activeBucket = 1 - _activeBucket;
+  if (bucket.entries.empty()) return;
+  Logger::Debug << "Flushing reordered file buffer...\n";
+  _writeThread = std::thread([this, &bucket]() {
+    try {
+      writeBucket(bucket);
+    } catch (...) {
+      _writeError = std::current_exception();
+    }
+  });
+  Bucket& nextBucket = _buckets[_activeBucket];
+  if (nextBucket.data.capacity() < _bucketSize)
+    nextBucket.data.reserve(_bucketSize);
+}
+
+void ReorderedFileBuffer::waitForFlush() {
+  if (_writeThread.joinable()) _writeThread.join();
+  if (_writeError) {
+    const std::exception_ptr error = _writeError;
+    _writeError = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void ReorderedFileBuffer::writeBucket(Bucket& bucket) {
+  // Writes to the same position keep their order, so that the last write
+  // wins, as it would have when writing directly.
+  std::sort(bucket.entries.begin(), bucket.entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.position < b.position ||
+                     (a.position == b.position &&
+                      a.bufferOffset < b.bufferOffset);
+            });
+  std::vector<iovec> iov;
+  size_t start = 0;
+  size_t end = 0;
+  for (const Entry& entry : bucket.entries) {
+    if (entry.length == 0) continue;
+    char* data = bucket.data.data() + entry.bufferOffset;
+    if (!iov.empty() && entry.position == end) {
+      iovec& last = iov.back();
+      // Consecutive in the file and in the bucket: extend the last buffer.
+      if (static_cast<char*>(last.iov_base) + last.iov_len == data)
+        last.iov_len += entry.length;
+      else
+        iov.push_back(iovec{data, entry.length});
+    } else {
+      if (!iov.empty()) {
+        _writeCallCount += WriteVectors(_fd, iov, start, _filename);
+        iov.clear();
+      }
+      start = entry.position;
+      iov.push_back(iovec{data, entry.length});
+    }
+    end = entry.position + entry.length;
+    _writtenBytes += entry.length;
+  }
+  if (!iov.empty()) _writeCallCount += WriteVectors(_fd, iov, start, _filename);
+  bucket.data.clear();
+  bucket.entries.clear();
+}
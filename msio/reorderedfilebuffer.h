@@ -1,64 +1,92 @@
 #ifndef REORDERED_FILE_BUFFER_H
 #define REORDERED_FILE_BUFFER_H
 
-#include <fstream>
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <thread>
 #include <vector>
-#include <set>
-
-#include "../util/logger.h"
 
+/**
+ * Collects many small writes at random positions of a file, and writes them
+ * in large, ordered batches. It is used to write the temporary files of the
+ * ReorderingBaselineReader, which are written in measurement set order (time
+ * major), whereas the file is ordered per baseline.
+ *
+ * The written data is appended to one large preallocated bucket, together
+ * with a small index entry per write. When the bucket is full, it is handed
+ * to a background thread, which sorts the index on file position, merges
+ * writes that are adjacent in the file and writes them with vectored
+ * pwritev() calls. In the mean time, the next writes go into a second bucket,
+ * so that the caller (reading the measurement set) and the writing of the
+ * file overlap.
+ */
 class ReorderedFileBuffer {
  public:
-  ReorderedFileBuffer(std::ofstream* stream, size_t maxSize)
-      : _nextWritePos(0),
-        _unflushedSize(0),
-        _maxSize(maxSize),
-        _stream(stream) {}
+  /**
+   * Opens the (existing) file @p filename for writing.
+   * @param maxSize Maximum amount of memory to use for buffering, including
+   * the index. It is divided over the two buckets.
+   */
+  ReorderedFileBuffer(const std::string& filename, size_t maxSize);
+
+  /**
+   * Writes any remaining data. Errors are reported but not thrown; call
+   * flush() before destruction to get an exception on errors.
+   */
+  ~ReorderedFileBuffer();
 
-  ~ReorderedFileBuffer() { flush(); }
+  ReorderedFileBuffer(const ReorderedFileBuffer&) = delete;
+  ReorderedFileBuffer& operator=(const ReorderedFileBuffer&) = delete;
 
   void seekp(size_t offset) { _nextWritePos = offset; }
 
-  void write(const char* data, size_t length) {
-    _buffer.insert(BufferEntry(_nextWritePos, data, length));
-    _nextWritePos += length;
-    _unflushedSize += length + sizeof(_nextWritePos) * 2;
+  void write(const char* data, size_t length);
 
-    if (_unflushedSize > _maxSize) flush();
-  }
+  /**
+   * Writes all buffered data to the file, and waits until that is done.
+   * Throws a std::runtime_error when writing failed.
+   */
+  void flush();
 
-  void flush() {
-    Logger::Debug << "Flushing reordered file buffer...\n";
-    for (std::set<BufferEntry>::const_iterator i = _buffer.begin();
-         i != _buffer.end(); ++i) {
-      _stream->seekp(i->position, std::ios_base::beg);
-      _stream->write(i->data.data(), i->data.size());
-      if (_stream->fail())
-        throw std::runtime_error(
-            "Error: failed to write to reordered file! Check access rights and "
-            "free disk space.");
-    }
-    _buffer.clear();
-    _unflushedSize = 0;
-  }
+  /**
+   * Total number of bytes that have been written to the file. Only
+   * up to date directly after a call to flush().
+   */
+  size_t WrittenBytes() const { return _writtenBytes; }
 
-  std::ofstream& stream() { return *_stream; }
+  /**
+   * Number of pwritev() calls that were used to write the data. Like
+   * WrittenBytes(), only up to date directly after a call to flush().
+   */
+  size_t WriteCallCount() const { return _writeCallCount; }
 
  private:
-  struct BufferEntry {
-    BufferEntry(size_t pos_, const char* data_, size_t length_)
-        : position(pos_), data(data_, data_ + length_) {}
-    bool operator<(const BufferEntry& other) const {
-      return position < other.position;
-    }
+  struct Entry {
     size_t position;
+    size_t bufferOffset;
+    size_t length;
+  };
+  struct Bucket {
     std::vector<char> data;
+    std::vector<Entry> entries;
+    size_t Size() const { return data.size() + entries.size() * sizeof(Entry); }
   };
-  std::set<BufferEntry> _buffer;
+
+  void startFlush();
+  void waitForFlush();
+  void writeBucket(Bucket& bucket);
+
+  std::string _filename;
+  int _fd;
   size_t _nextWritePos;
-  size_t _unflushedSize;
-  size_t _maxSize;
-  std::ofstream* _stream;
+  size_t _bucketSize;
+  Bucket _buckets[2];
+  size_t _activeBucket;
+  std::thread _writeThread;
+  std::exception_ptr _writeError;
+  size_t _writtenBytes;
+  size_t _writeCallCount;
 };
 
 #endif
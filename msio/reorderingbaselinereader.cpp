@@ -1,26 +1,37 @@
 #include "reorderingbaselinereader.h"
 
+#include "../structures/packedflags.h"
 #include "../structures/timefrequencydata.h"
 
 #include "../util/logger.h"
+#include "../util/memoryplanner.h"
 #include "../util/stopwatch.h"
 #include "../util/progress/dummyprogresslistener.h"
 
 #include "reorderedfilebuffer.h"
 #include "msselection.h"
 
+#include <aocommon/parallelfor.h>
 #include <aocommon/system.h>
 
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <vector>
 
 #include <fcntl.h>
 
+namespace {
+// Written to the meta file, so that temporary files that were written with a
+// different flag layout are not reused.
+const std::string kFlagFileFormat = "flags=packed-bits";
+}  // namespace
+
 ReorderingBaselineReader::ReorderingBaselineReader(const std::string& msFile)
     : BaselineReader(msFile),
       direct_reader_(msFile),
@@ -29,7 +40,8 @@ ReorderingBaselineReader::ReorderingBaselineReader(const std::string& msFile)
       remove_reordered_files_(false),
       reordered_data_files_have_changed_(false),
       reordered_flag_files_have_changed_(false),
-      read_uvw_(false) {
+      read_uvw_(false),
+      reorder_thread_count_(0) {
   // In order to use multiple readers at the same time the temporary files need
   // unique names. Use the address of the object to generate a unique prefix.
   const std::string uid = std::to_string(reinterpret_cast<uintptr_t>(this));
@@ -51,6 +63,7 @@ void ReorderingBaselineReader::WriteToMs() {
 }
 
 void ReorderingBaselineReader::PrepareReadWrite(ProgressListener& progress) {
+  const std::lock_guard<std::mutex> lock(prepare_mutex_);
   if (!ms_is_reordered_) {
     reorderMS(progress);
   }
@@ -58,69 +71,106 @@ void ReorderingBaselineReader::PrepareReadWrite(ProgressListener& progress) {
 
 void ReorderingBaselineReader::PerformReadRequests(
     class ProgressListener& progress) {
+  // Preparing first also initializes the meta data, while holding the lock,
+  // in case a writing thread calls this at the same time.
+  PrepareReadWrite(dummy_progress_);
   initializeMeta();
 
-  PrepareReadWrite(dummy_progress_);
+  mapReorderedFiles();
+
+  const size_t polarizationCount = Polarizations().size();
+  std::vector<size_t> filePositions(_readRequests.size());
+  std::vector<size_t> flagFilePositions(_readRequests.size());
+  for (size_t i = 0; i != _readRequests.size(); ++i) {
+    const ReadRequest& request = _readRequests[i];
+    const size_t index = sequence_index_table_->Value(
+        request.antenna1, request.antenna2, request.spectralWindow,
+        request.sequenceId);
+    filePositions[i] = file_positions_[index];
+    flagFilePositions[i] = flag_file_positions_[index];
+    // Let the kernel read in all requested baselines in the background, while
+    // the first ones are being copied.
+    const size_t timeCount = ObservationTimes(request.sequenceId).size();
+    const size_t samplesPerTime =
+        MetaData().FrequencyCount(request.spectralWindow) * polarizationCount;
+    const size_t sampleCount = timeCount * samplesPerTime;
+    const size_t flagSize = timeCount * PackedFlagsSize(samplesPerTime);
+    const size_t dataEnd = (filePositions[i] + sampleCount) * sizeof(float) * 2;
+    const size_t flagEnd = flagFilePositions[i] + flagSize;
+    if ((ReadData() && data_mapping_.Size() < dataEnd) ||
+        (ReadFlags() && flag_mapping_.Size() < flagEnd))
+      throw std::runtime_error(
+          "Error: temporary files are smaller than expected; were they "
+          "modified by another process?");
+    if (ReadData())
+      data_mapping_.WillNeed(filePositions[i] * sizeof(float) * 2,
+                             sampleCount * sizeof(float) * 2);
+    if (ReadFlags())
+      flag_mapping_.WillNeed(flagFilePositions[i], flagSize);
+  }
 
   _results.clear();
   for (size_t i = 0; i < _readRequests.size(); ++i) {
     const ReadRequest request = _readRequests[i];
     _results.push_back(Result());
+    Result& result = _results[i];
     const size_t width = ObservationTimes(request.sequenceId).size();
-    for (size_t p = 0; p < Polarizations().size(); ++p) {
+    const size_t height = MetaData().FrequencyCount(request.spectralWindow);
+    // The temporary files hold the full time range of every baseline
+    // (missing time steps are padded), so every value will be set below.
+    for (size_t p = 0; p < polarizationCount; ++p) {
       if (ReadData()) {
-        _results[i]._realImages.push_back(Image2D::CreateZeroImagePtr(
-            width, MetaData().FrequencyCount(request.spectralWindow)));
-        _results[i]._imaginaryImages.push_back(Image2D::CreateZeroImagePtr(
-            width, MetaData().FrequencyCount(request.spectralWindow)));
+        result._realImages.push_back(
+            Image2D::CreateUnsetImagePtr(width, height));
+        result._imaginaryImages.push_back(
+            Image2D::CreateUnsetImagePtr(width, height));
       }
       if (ReadFlags()) {
-        // The flags should be initialized to true, as a baseline might
-        // miss some time scans that other baselines do have, and these
-        // should be flagged.
-        _results[i]._flags.push_back(Mask2D::CreateSetMaskPtr<true>(
-            width, MetaData().FrequencyCount(request.spectralWindow)));
+        result._flags.push_back(Mask2D::CreateUnsetMaskPtr(width, height));
       }
     }
     if (read_uvw_) {
-      _results[i]._uvw =
+      result._uvw =
           direct_reader_.ReadUVW(request.antenna1, request.antenna2,
                                  request.spectralWindow, request.sequenceId);
     } else {
-      _results[i]._uvw.clear();
+      result._uvw.clear();
       for (unsigned j = 0; j < width; ++j)
-        _results[i]._uvw.emplace_back(0.0, 0.0, 0.0);
+        result._uvw.emplace_back(0.0, 0.0, 0.0);
     }
 
-    std::ifstream dataFile(data_filename_, std::ifstream::binary);
-    std::ifstream flagFile(flag_filename_, std::ifstream::binary);
-    const size_t index = sequence_index_table_->Value(
-        request.antenna1, request.antenna2, request.spectralWindow,
-        request.sequenceId);
-    const size_t filePos = file_positions_[index];
-    dataFile.seekg(filePos * (sizeof(float) * 2), std::ios_base::beg);
-    flagFile.seekg(filePos * sizeof(bool), std::ios_base::beg);
-
-    const size_t bufferSize =
-        MetaData().FrequencyCount(request.spectralWindow) *
-        Polarizations().size();
-    for (size_t x = 0; x < width; ++x) {
-      std::vector<float> dataBuffer(bufferSize * 2);
-      std::vector<char> flagBuffer(bufferSize);
-      dataFile.read((char*)&dataBuffer[0], bufferSize * sizeof(float) * 2);
-      size_t dataBufferPtr = 0;
-      flagFile.read((char*)&flagBuffer[0], bufferSize * sizeof(bool));
-      size_t flagBufferPtr = 0;
-      for (size_t f = 0; f < MetaData().FrequencyCount(request.spectralWindow);
-           ++f) {
-        for (size_t p = 0; p < Polarizations().size(); ++p) {
-          _results[i]._realImages[p]->SetValue(x, f, dataBuffer[dataBufferPtr]);
-          ++dataBufferPtr;
-          _results[i]._imaginaryImages[p]->SetValue(x, f,
-                                                    dataBuffer[dataBufferPtr]);
-          ++dataBufferPtr;
-          _results[i]._flags[p]->SetValue(x, f, flagBuffer[flagBufferPtr]);
-          ++flagBufferPtr;
+    // The files store the samples of a time step consecutively, ordered by
+    // channel and then polarization, and the images are filled directly from
+    // the mapped files.
+    const size_t filePos = filePositions[i];
+    if (ReadData()) {
+      const float* data =
+          reinterpret_cast<const float*>(data_mapping_.Data()) + filePos * 2;
+      for (size_t x = 0; x < width; ++x) {
+        for (size_t f = 0; f < height; ++f) {
+          for (size_t p = 0; p < polarizationCount; ++p) {
+            result._realImages[p]->SetValue(x, f, data[0]);
+            result._imaginaryImages[p]->SetValue(x, f, data[1]);
+            data += 2;
+          }
+        }
+      }
+    }
+    if (ReadFlags()) {
+      const unsigned char* packed =
+          reinterpret_cast<const unsigned char*>(flag_mapping_.Data()) +
+          flagFilePositions[i];
+      const size_t samplesPerTime = height * polarizationCount;
+      const std::unique_ptr<bool[]> flags(new bool[samplesPerTime]);
+      for (size_t x = 0; x < width; ++x) {
+        UnpackFlags(packed, samplesPerTime, flags.get());
+        packed += PackedFlagsSize(samplesPerTime);
+        const bool* flagPtr = flags.get();
+        for (size_t f = 0; f < height; ++f) {
+          for (size_t p = 0; p < polarizationCount; ++p) {
+            result._flags[p]->SetValue(x, f, *flagPtr);
+            ++flagPtr;
+          }
         }
       }
     }
@@ -130,6 +180,15 @@ void ReorderingBaselineReader::PerformReadRequests(
   progress.OnFinish();
 }
 
+void ReorderingBaselineReader::mapReorderedFiles() {
+  // Each baseline is stored contiguously and is read from beginning to end, so
+  // sequential read-ahead suits the access pattern.
+  if (ReadData() && !data_mapping_.IsMapped())
+    data_mapping_ = MappedFile(data_filename_, true);
+  if (ReadFlags() && !flag_mapping_.IsMapped())
+    flag_mapping_ = MappedFile(flag_filename_, true);
+}
+
 void ReorderingBaselineReader::PerformFlagWriteRequests() {
   for (size_t i = 0; i != _writeRequests.size(); ++i) {
     const FlagWriteRequest request = _writeRequests[i];
@@ -147,9 +206,11 @@ void ReorderingBaselineReader::reorderMS(ProgressListener& progress) {
 
   if (std::filesystem::exists(path)) {
     std::ifstream str(path.string().c_str());
-    std::string name;
+    std::string name, flagFormat;
     std::getline(str, name);
-    if (std::filesystem::equivalent(std::filesystem::path(name),
+    std::getline(str, flagFormat);
+    if (flagFormat == kFlagFileFormat &&
+        std::filesystem::equivalent(std::filesystem::path(name),
                                     MetaData().Path())) {
       Logger::Debug << "Measurement set has already been reordered; using old "
                        "temporary files.\n";
@@ -164,14 +225,15 @@ void ReorderingBaselineReader::reorderMS(ProgressListener& progress) {
   if (reorderRequired) {
     reorderFull(progress);
     std::ofstream str(path.string().c_str());
-    str << MetaData().Path() << '\n';
+    str << MetaData().Path() << '\n' << kFlagFileFormat << '\n';
   } else {
-    size_t fileSize;
-    makeLookupTables(fileSize);
+    size_t fileSize, flagFileSize;
+    makeLookupTables(fileSize, flagFileSize);
   }
 }
 
-void ReorderingBaselineReader::makeLookupTables(size_t& fileSize) {
+void ReorderingBaselineReader::makeLookupTables(size_t& fileSize,
+                                                size_t& flagFileSize) {
   std::vector<MSMetaData::Sequence> sequences = MetaData().GetSequences();
   const size_t antennaCount = MetaData().AntennaCount(),
                polarizationCount = Polarizations().size(),
@@ -181,6 +243,7 @@ void ReorderingBaselineReader::makeLookupTables(size_t& fileSize) {
   sequence_index_table_.reset(new SeqIndexLookupTable(
       antennaCount, bandCount, sequencesPerBaselineCount));
   fileSize = 0;
+  flagFileSize = 0;
   for (size_t i = 0; i < sequences.size(); ++i) {
     // Initialize look-up table to get index into Sequence-array quickly
     const MSMetaData::Sequence& s = sequences[i];
@@ -188,11 +251,14 @@ void ReorderingBaselineReader::makeLookupTables(size_t& fileSize) {
         i;
 
     // Initialize look-up table to go from sequence array to file position. Is
-    // in samples, so multiple times sizeof(bool) or ..(float)) for exact
-    // position.
+    // in samples, so multiple times sizeof(float) for exact position.
     file_positions_.push_back(fileSize);
-    fileSize += ObservationTimes(s.sequenceId).size() *
-                MetaData().FrequencyCount(s.spw) * polarizationCount;
+    flag_file_positions_.push_back(flagFileSize);
+    const size_t timeCount = ObservationTimes(s.sequenceId).size(),
+                 samplesPerTime =
+                     MetaData().FrequencyCount(s.spw) * polarizationCount;
+    fileSize += timeCount * samplesPerTime;
+    flagFileSize += timeCount * PackedFlagsSize(samplesPerTime);
   }
 }
 
@@ -239,93 +305,211 @@ void ReorderingBaselineReader::reorderFull(ProgressListener& progressListener) {
   casacore::ScalarColumn<int> antenna2Column(ms, "ANTENNA2");
   casacore::ArrayColumn<casacore::Complex> dataColumn(ms, DataColumnName());
 
-  if (ms.nrow() == 0)
+  const size_t rowCount = ms.nrow();
+  if (rowCount == 0)
     throw std::runtime_error("Measurement set is empty (zero rows)");
 
   std::vector<size_t> dataIdToSpw;
   MetaData().GetDataDescToBandVector(dataIdToSpw);
 
-  size_t fileSize;
-  makeLookupTables(fileSize);
+  size_t fileSize, flagFileSize;
+  makeLookupTables(fileSize, flagFileSize);
 
   Logger::Debug << "Opening temporary files.\n";
-  ReorderInfo reorderInfo;
   preAllocate(data_filename_, fileSize * sizeof(float) * 2);
-  reorderInfo.dataFile.reset(new std::ofstream(
-      data_filename_,
-      std::ofstream::binary | std::ios_base::in | std::ios_base::out));
-  if (reorderInfo.dataFile->fail())
-    throw std::runtime_error(
-        "Error: failed to open temporary data files for writing! Check access "
-        "rights and free disk space.");
-
-  preAllocate(flag_filename_, fileSize * sizeof(bool));
-  reorderInfo.flagFile.reset(new std::ofstream(
-      flag_filename_,
-      std::ofstream::binary | std::ios_base::in | std::ios_base::out));
-  if (reorderInfo.flagFile->fail())
-    throw std::runtime_error(
-        "Error: failed to open temporary data files for writing! Check access "
-        "rights and free disk space.");
-
-  Logger::Debug << "Reordering data set...\n";
-
-  const size_t bufferMem = std::min<size_t>(
-      aocommon::system::TotalMemory() / 10, 1024l * 1024l * 1024l);
-  ReorderedFileBuffer dataFile(reorderInfo.dataFile.get(), bufferMem);
-  ReorderedFileBuffer flagFile(reorderInfo.flagFile.get(), bufferMem / 8);
+  preAllocate(flag_filename_, flagFileSize);
 
+  const size_t polarizationCount = Polarizations().size();
+  size_t maxChannelCount = 0;
+  for (size_t band = 0; band != MetaData().BandCount(); ++band)
+    maxChannelCount =
+        std::max(maxChannelCount, MetaData().FrequencyCount(band));
+  // Rows are handed out to the threads in chunks of about 8 MB of data.
+  const size_t maxRowSize =
+      std::max<size_t>(maxChannelCount * polarizationCount * sizeof(float) * 2,
+                       1);
+  const size_t rowsPerChunk = std::max<size_t>((8 << 20) / maxRowSize, 1);
+  const size_t chunkCount = (rowCount + rowsPerChunk - 1) / rowsPerChunk;
+  const size_t threadCount = std::min(
+      reorder_thread_count_ == 0 ? aocommon::system::ProcessorCount()
+                                 : reorder_thread_count_,
+      chunkCount);
+
+  Logger::Debug << "Reordering data set with " << threadCount
+                << " threads...\n";
+
+  const size_t bufferMem = MemoryPlanner::ReorderBufferSize();
+
+  // Everything below up to the per-thread statistics is only accessed while
+  // holding casacoreMutex: casacore is not thread safe, and the rows have to
+  // be scanned in order to determine their position in the files.
+  std::mutex casacoreMutex;
+  size_t nextRow = 0;
+  bool failed = false;
   std::vector<std::size_t> writeFilePositions = file_positions_;
+  std::vector<std::size_t> writeFlagFilePositions = flag_file_positions_;
   std::vector<std::size_t> timePositions(file_positions_.size(), size_t(-1));
-  size_t polarizationCount = Polarizations().size();
-
   MSSelection msSelection(ms, ObservationTimesPerSequence(), progressListener);
 
-  msSelection.Process(
-      [&](size_t rowIndex, size_t sequenceId, size_t timeIndexInSequence) {
-        size_t antenna1 = antenna1Column(rowIndex),
-               antenna2 = antenna2Column(rowIndex),
-               spw = dataIdToSpw[dataDescIdColumn(rowIndex)],
-               channelCount = MetaData().FrequencyCount(spw),
-               arrayIndex = sequence_index_table_->Value(antenna1, antenna2,
-                                                         spw, sequenceId),
-               sampleCount = channelCount * polarizationCount;
-        size_t& filePos = writeFilePositions[arrayIndex];
-        size_t& timePos = timePositions[arrayIndex];
-
-        casacore::Array<casacore::Complex> data = dataColumn(rowIndex);
-        casacore::Array<bool> flag = flagColumn(rowIndex);
-
-        dataFile.seekp(filePos * (sizeof(float) * 2));
-        flagFile.seekp(filePos * sizeof(bool));
-
-        // If this baseline missed some time steps, pad the files
-        // (we can't just skip over, because the flags should be set to true)
-        ++timePos;
-        while (timePos < timeIndexInSequence) {
-          const std::vector<float> nullData(sampleCount * 2, 0.0);
-          const std::vector<char> nullFlags(sampleCount, (char)true);
-          dataFile.write(reinterpret_cast<const char*>(&*nullData.begin()),
-                         sampleCount * 2 * sizeof(float));
-          flagFile.write(reinterpret_cast<const char*>(&*nullFlags.begin()),
-                         sampleCount * sizeof(bool));
-          ++timePos;
-          filePos += sampleCount;
+  struct ThreadStatistics {
+    size_t rowCount = 0;
+    size_t byteCount = 0;
+    double seconds = 0.0;
+    // Time spent waiting for and holding casacoreMutex, respectively. Only
+    // the remaining time (converting and writing the rows) runs in parallel.
+    double waitSeconds = 0.0;
+    double readSeconds = 0.0;
+  };
+  std::vector<ThreadStatistics> statistics(threadCount);
+
+  // Where a row that was read from the measurement set should be written
+  struct RowTarget {
+    size_t filePos;
+    size_t flagFilePos;
+    size_t sampleCount;
+    // Number of time steps before the row that are missing in the measurement
+    // set, and need to be padded.
+    size_t missingTimeSteps;
+    casacore::Array<casacore::Complex> data;
+    casacore::Array<bool> flags;
+  };
+
+  aocommon::ParallelFor<size_t> executor(threadCount);
+  executor.Run(0, threadCount, [&](size_t threadIndex) {
+    const Stopwatch threadWatch(true);
+    Stopwatch waitWatch, readWatch;
+    ThreadStatistics& threadStatistics = statistics[threadIndex];
+    ReorderedFileBuffer dataFile(data_filename_, bufferMem / threadCount);
+    ReorderedFileBuffer flagFile(flag_filename_, bufferMem / 8 / threadCount);
+    std::vector<RowTarget> targets;
+    std::vector<char> packedFlags;
+    try {
+      while (true) {
+        targets.clear();
+        {
+          waitWatch.Start();
+          const std::lock_guard<std::mutex> lock(casacoreMutex);
+          waitWatch.Pause();
+          if (nextRow == rowCount || failed) break;
+          readWatch.Start();
+          const size_t startRow = nextRow;
+          nextRow = std::min(startRow + rowsPerChunk, rowCount);
+          threadStatistics.rowCount += nextRow - startRow;
+          msSelection.ProcessRange(
+              startRow, nextRow,
+              [&](size_t rowIndex, size_t sequenceId,
+                  size_t timeIndexInSequence) {
+                const size_t antenna1 = antenna1Column(rowIndex),
+                             antenna2 = antenna2Column(rowIndex),
+                             spw = dataIdToSpw[dataDescIdColumn(rowIndex)],
+                             arrayIndex = sequence_index_table_->Value(
+                                 antenna1, antenna2, spw, sequenceId);
+                RowTarget& target = targets.emplace_back();
+                target.sampleCount =
+                    MetaData().FrequencyCount(spw) * polarizationCount;
+                const size_t packedSize = PackedFlagsSize(target.sampleCount);
+                size_t& timePos = timePositions[arrayIndex];
+                ++timePos;
+                if (timeIndexInSequence > timePos) {
+                  target.missingTimeSteps = timeIndexInSequence - timePos;
+                  timePos = timeIndexInSequence;
+                } else {
+                  target.missingTimeSteps = 0;
+                }
+                target.filePos =
+                    writeFilePositions[arrayIndex] +
+                    target.missingTimeSteps * target.sampleCount;
+                target.flagFilePos = writeFlagFilePositions[arrayIndex] +
+                                     target.missingTimeSteps * packedSize;
+                writeFilePositions[arrayIndex] =
+                    target.filePos + target.sampleCount;
+                writeFlagFilePositions[arrayIndex] =
+                    target.flagFilePos + packedSize;
+                target.data = dataColumn(rowIndex);
+                target.flags = flagColumn(rowIndex);
+              });
+          readWatch.Pause();
         }
 
-        dataFile.write(reinterpret_cast<const char*>(&*data.cbegin()),
-                       sampleCount * 2 * sizeof(float));
+        for (RowTarget& target : targets) {
+          const size_t sampleCount = target.sampleCount;
+          const size_t packedSize = PackedFlagsSize(sampleCount);
+          // If this baseline missed some time steps, pad the files
+          // (we can't just skip over, because the flags should be set to true)
+          if (target.missingTimeSteps != 0) {
+            const size_t paddedCount = target.missingTimeSteps * sampleCount;
+            const std::vector<float> nullData(paddedCount * 2, 0.0);
+            const std::unique_ptr<bool[]> nullFlags(new bool[sampleCount]);
+            std::fill_n(nullFlags.get(), sampleCount, true);
+            packedFlags.resize(packedSize * target.missingTimeSteps);
+            for (size_t i = 0; i != target.missingTimeSteps; ++i)
+              PackFlags(nullFlags.get(), sampleCount,
+                        reinterpret_cast<unsigned char*>(packedFlags.data() +
+                                                         i * packedSize));
+            dataFile.seekp((target.filePos - paddedCount) * sizeof(float) * 2);
+            dataFile.write(reinterpret_cast<const char*>(nullData.data()),
+                           paddedCount * 2 * sizeof(float));
+            flagFile.seekp(target.flagFilePos -
+                           target.missingTimeSteps * packedSize);
+            flagFile.write(packedFlags.data(), packedFlags.size());
+          }
+
+          dataFile.seekp(target.filePos * sizeof(float) * 2);
+          dataFile.write(reinterpret_cast<const char*>(target.data.data()),
+                         sampleCount * 2 * sizeof(float));
+
+          packedFlags.resize(packedSize);
+          PackFlags(target.flags.data(), sampleCount,
+                    reinterpret_cast<unsigned char*>(packedFlags.data()));
+          flagFile.seekp(target.flagFilePos);
+          flagFile.write(packedFlags.data(), packedSize);
 
-        flagFile.write(reinterpret_cast<const char*>(&*flag.cbegin()),
-                       sampleCount * sizeof(bool));
+          threadStatistics.byteCount +=
+              sampleCount * 2 * sizeof(float) + packedSize;
+        }
+      }
+      dataFile.flush();
+      flagFile.flush();
+    } catch (...) {
+      const std::lock_guard<std::mutex> lock(casacoreMutex);
+      failed = true;
+      throw;
+    }
+    threadStatistics.seconds = threadWatch.Seconds();
+    threadStatistics.waitSeconds = waitWatch.Seconds();
+    threadStatistics.readSeconds = readWatch.Seconds();
+  });
 
-        filePos += sampleCount;
-      });
+  double readSeconds = 0.0, writeSeconds = 0.0;
+  for (size_t i = 0; i != threadCount; ++i) {
+    const ThreadStatistics& s = statistics[i];
+    const double threadWriteSeconds =
+        std::max(s.seconds - s.waitSeconds - s.readSeconds, 0.0);
+    readSeconds += s.readSeconds;
+    writeSeconds += threadWriteSeconds;
+    Logger::Debug << "Reorder thread " << i << ": " << s.rowCount
+                  << " rows in " << s.seconds << " s ("
+                  << s.rowCount / s.seconds << " rows/s, "
+                  << s.byteCount / (1024.0 * 1024.0 * s.seconds)
+                  << " MB/s); reading " << s.readSeconds << " s, waiting "
+                  << s.waitSeconds << " s, writing " << threadWriteSeconds
+                  << " s\n";
+  }
+  // Reading is serialized, so a single thread would have needed about the
+  // summed reading and writing time. The ratio with the elapsed time is the
+  // gain of writing in parallel.
+  const double elapsedSeconds = std::max<double>(watch.Seconds(), 1e-9);
+  Logger::Debug << "Reordering spent " << readSeconds
+                << " s reading (serialized) and " << writeSeconds
+                << " s writing (summed over threads): "
+                << (readSeconds + writeSeconds) / elapsedSeconds
+                << "x the throughput of a single thread.\n";
 
   const uint64_t dataSetSize =
-      (uint64_t)fileSize * (uint64_t)(sizeof(float) * 2 + sizeof(bool));
+      (uint64_t)fileSize * (uint64_t)(sizeof(float) * 2) + flagFileSize;
   Logger::Debug << "Done reordering data set of " << dataSetSize / (1024 * 1024)
                 << " MB in " << watch.Seconds() << " s ("
+                << rowCount / watch.Seconds() << " rows/s, "
                 << (long double)dataSetSize /
                        (1024.0L * 1024.0L * watch.Seconds())
                 << " MB/s)\n";
@@ -336,6 +520,8 @@ void ReorderingBaselineReader::reorderFull(ProgressListener& progressListener) {
 }
 
 void ReorderingBaselineReader::removeTemporaryFiles() {
+  data_mapping_ = MappedFile();
+  flag_mapping_ = MappedFile();
   if (ms_is_reordered_ && remove_reordered_files_) {
     std::filesystem::remove(meta_filename_);
     std::filesystem::remove(data_filename_);
@@ -417,6 +603,7 @@ void ReorderingBaselineReader::PerformDataWriteTask(
 void ReorderingBaselineReader::performFlagWriteTask(
     std::vector<Mask2DCPtr> flags, unsigned antenna1, unsigned antenna2,
     unsigned spw, unsigned sequenceId) {
+  PrepareReadWrite(dummy_progress_);
   initializeMeta();
 
   const unsigned polarizationCount = Polarizations().size();
@@ -434,8 +621,6 @@ void ReorderingBaselineReader::performFlagWriteTask(
           "match");
   }
 
-  PrepareReadWrite(dummy_progress_);
-
   const size_t width = flags[0]->Width();
   const size_t bufferSize =
       MetaData().FrequencyCount(spw) * Polarizations().size();
@@ -445,9 +630,12 @@ void ReorderingBaselineReader::performFlagWriteTask(
                                              std::ios_base::out);
   const size_t index =
       sequence_index_table_->Value(antenna1, antenna2, spw, sequenceId);
-  const size_t filePos = file_positions_[index];
-  flagFile.seekp(filePos * (sizeof(bool)), std::ios_base::beg);
+  flagFile.seekp(flag_file_positions_[index], std::ios_base::beg);
 
+  // The flags of the whole baseline are packed first, so that they can be
+  // written with a single call.
+  const size_t packedSize = PackedFlagsSize(bufferSize);
+  std::vector<unsigned char> packedFlags(width * packedSize);
   const std::unique_ptr<bool[]> flagBuffer(new bool[bufferSize]);
   for (size_t x = 0; x < width; ++x) {
     size_t flagBufferPtr = 0;
@@ -457,15 +645,16 @@ void ReorderingBaselineReader::performFlagWriteTask(
         ++flagBufferPtr;
       }
     }
-
-    flagFile.write(reinterpret_cast<char*>(flagBuffer.get()),
-                   bufferSize * sizeof(bool));
-    if (flagFile.bad())
-      throw std::runtime_error(
-          "Error: failed to update temporary flag files! Check access rights "
-          "and free disk space.");
+    PackFlags(flagBuffer.get(), bufferSize, &packedFlags[x * packedSize]);
   }
 
+  flagFile.write(reinterpret_cast<char*>(packedFlags.data()),
+                 packedFlags.size());
+  if (flagFile.bad())
+    throw std::runtime_error(
+        "Error: failed to update temporary flag files! Check access rights "
+        "and free disk space.");
+
   reordered_flag_files_have_changed_ = true;
 }
 
@@ -507,6 +696,8 @@ void ReorderingBaselineReader::updateOriginalMS(ProgressListener& progress) {
   }
 
   std::vector<size_t> updatedFilePos = file_positions_;
+  std::vector<size_t> updatedFlagFilePos = flag_file_positions_;
+  std::vector<unsigned char> packedFlags;
   std::vector<size_t> timePositions(updatedFilePos.size(), size_t(-1));
 
   MSSelection msSelection(ms, ObservationTimesPerSequence(), progress);
@@ -518,8 +709,10 @@ void ReorderingBaselineReader::updateOriginalMS(ProgressListener& progress) {
            channelCount = MetaData().FrequencyCount(spw),
            arrayIndex = sequence_index_table_->Value(antenna1, antenna2, spw,
                                                      sequenceId),
-           sampleCount = channelCount * polarizationCount;
+           sampleCount = channelCount * polarizationCount,
+           packedSize = PackedFlagsSize(sampleCount);
     size_t& filePos = updatedFilePos[arrayIndex];
+    size_t& flagFilePos = updatedFlagFilePos[arrayIndex];
     size_t& timePos = timePositions[arrayIndex];
 
     const casacore::IPosition shape(2, polarizationCount, channelCount);
@@ -529,6 +722,7 @@ void ReorderingBaselineReader::updateOriginalMS(ProgressListener& progress) {
     ++timePos;
     while (timePos < timeIndexInSequence) {
       filePos += sampleCount;
+      flagFilePos += packedSize;
       ++timePos;
     }
 
@@ -548,16 +742,18 @@ void ReorderingBaselineReader::updateOriginalMS(ProgressListener& progress) {
       casacore::Array<bool> flagArray(shape);
 
       std::ifstream& flagFile = *updateInfo.flagFile;
-      flagFile.seekg(filePos * sizeof(bool), std::ios_base::beg);
-      flagFile.read(reinterpret_cast<char*>(&*flagArray.cbegin()),
-                    sampleCount * sizeof(bool));
+      packedFlags.resize(packedSize);
+      flagFile.seekg(flagFilePos, std::ios_base::beg);
+      flagFile.read(reinterpret_cast<char*>(packedFlags.data()), packedSize);
       if (flagFile.fail())
         throw std::runtime_error("Error: failed to read temporary flag files!");
+      UnpackFlags(packedFlags.data(), sampleCount, flagArray.data());
 
       flagColumn.basePut(rowIndex, flagArray);
     }
 
     filePos += sampleCount;
+    flagFilePos += packedSize;
   });
 
   Logger::Debug << "Freeing the data\n";
@@ -4,11 +4,13 @@
 #include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <stdexcept>
 
 #include "baselinereader.h"
 #include "directbaselinereader.h"
+#include "mappedfile.h"
 
 class ReorderingBaselineReader : public BaselineReader {
  public:
@@ -42,13 +44,25 @@ class ReorderingBaselineReader : public BaselineReader {
     return 2;
   }
 
+  /**
+   * After reordering, reads use a memory mapping and flag writes use their
+   * own file streams on different parts of the temporary files. The
+   * measurement set is only accessed by reads (for the UVWs), so reads and
+   * flag writes can overlap.
+   */
+  bool SupportsConcurrentReadWrite() const override { return true; }
+
   void SetReadUVW(bool readUVW) { read_uvw_ = readUVW; }
 
+  /**
+   * Number of threads used for reordering the measurement set. Zero, the
+   * default, means one thread per processor.
+   */
+  void SetReorderThreadCount(size_t threadCount) {
+    reorder_thread_count_ = threadCount;
+  }
+
  private:
-  struct ReorderInfo {
-    std::unique_ptr<std::ofstream> dataFile;
-    std::unique_ptr<std::ofstream> flagFile;
-  };
   struct UpdateInfo {
     std::unique_ptr<std::ifstream> dataFile;
     std::unique_ptr<std::ifstream> flagFile;
@@ -80,7 +94,7 @@ class ReorderingBaselineReader : public BaselineReader {
   };
   void reorderMS(class ProgressListener& progress);
   void reorderFull(class ProgressListener& progress);
-  void makeLookupTables(size_t& fileSize);
+  void makeLookupTables(size_t& fileSize, size_t& flagFileSize);
   void updateOriginalMSData(class ProgressListener& progress);
   void updateOriginalMSFlags(class ProgressListener& progress);
   void performFlagWriteTask(std::vector<Mask2DCPtr> flags, unsigned antenna1,
@@ -90,13 +104,28 @@ class ReorderingBaselineReader : public BaselineReader {
   template <bool UpdateData, bool UpdateFlags>
   void updateOriginalMS(class ProgressListener& progress);
 
+  /**
+   * Maps the temporary files into memory for reading, if not done already.
+   * The mappings are kept until the temporary files are removed.
+   */
+  void mapReorderedFiles();
+
   void removeTemporaryFiles();
 
   static void preAllocate(const std::string& filename, size_t fileSize);
 
   DirectBaselineReader direct_reader_;
+  // Makes sure that only one thread performs the reordering.
+  std::mutex prepare_mutex_;
   std::unique_ptr<SeqIndexLookupTable> sequence_index_table_;
+  // Start of each sequence in the data file, in samples.
   std::vector<size_t> file_positions_;
+  // Start of each sequence in the flag file, in bytes. Flags are packed into
+  // bits, and the flags of each time step start at a new byte, such that
+  // time steps can be written independently.
+  std::vector<size_t> flag_file_positions_;
+  MappedFile data_mapping_;
+  MappedFile flag_mapping_;
   std::string data_filename_;
   std::string flag_filename_;
   std::string meta_filename_;
@@ -105,6 +134,7 @@ class ReorderingBaselineReader : public BaselineReader {
   bool reordered_data_files_have_changed_;
   bool reordered_flag_files_have_changed_;
   bool read_uvw_;
+  size_t reorder_thread_count_;
 };
 
 #endif  // MSIO_REORDERING_BASELINE_READER_H_
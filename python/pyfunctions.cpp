@@ -2,6 +2,7 @@
 
 #include <pybind11/pybind11.h>
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace py = pybind11;
@@ -67,6 +68,57 @@ void SetImageBuffer(aoflagger::ImageSet* imageSet, size_t imageIndex,
   }
 }
 
+void SetImageBufferFloat(aoflagger::ImageSet* imageSet, size_t imageIndex,
+                         py::array_t<float>& values) {
+  if (imageIndex >= imageSet->ImageCount())
+    throw std::out_of_range(
+        "aoflagger.set_image_buffer: Image index out of bounds");
+  if (values.ndim() != 2)
+    throw std::runtime_error(
+        "ImageSet.set_image_buffer(): require a two-dimensional array");
+  if (values.shape(0) != int(imageSet->Height()) ||
+      values.shape(1) != int(imageSet->Width()))
+    throw std::runtime_error(
+        "ImageSet.set_image_buffer(): dimensions of provided array doesn't "
+        "match with image set");
+  const py::buffer_info buf = values.request();
+  const char* data = static_cast<const char*>(buf.ptr);
+  float* buffer = imageSet->ImageBuffer(imageIndex);
+  const size_t width = imageSet->Width();
+  for (size_t y = 0; y != imageSet->Height(); ++y) {
+    const char* rowIn = data + y * buf.strides[0];
+    float* rowOut = buffer + y * imageSet->HorizontalStride();
+    if (buf.strides[1] == ptrdiff_t(sizeof(float))) {
+      std::copy_n(reinterpret_cast<const float*>(rowIn), width, rowOut);
+    } else {
+      for (size_t x = 0; x != width; ++x)
+        rowOut[x] = *reinterpret_cast<const float*>(rowIn + x * buf.strides[1]);
+    }
+  }
+}
+
+py::array_t<float> GetImageView(py::object imageSetObject, size_t imageIndex) {
+  aoflagger::ImageSet& imageSet = imageSetObject.cast<aoflagger::ImageSet&>();
+  if (imageIndex >= imageSet.ImageCount())
+    throw std::out_of_range(
+        "aoflagger.get_image_view: Image index out of bounds");
+  // The array refers to the image set object, which keeps the image alive
+  // for as long as the array exists.
+  return py::array_t<float>(
+      {ptrdiff_t(imageSet.Height()), ptrdiff_t(imageSet.Width())},
+      {ptrdiff_t(sizeof(float) * imageSet.HorizontalStride()),
+       ptrdiff_t(sizeof(float))},
+      imageSet.ImageBuffer(imageIndex), imageSetObject);
+}
+
+py::buffer_info GetFlagMaskBufferInfo(aoflagger::FlagMask& flagMask) {
+  return py::buffer_info(
+      flagMask.Buffer(), sizeof(bool), py::format_descriptor<bool>::format(), 2,
+      {ptrdiff_t(flagMask.Height()), ptrdiff_t(flagMask.Width())},
+      {ptrdiff_t(sizeof(bool) * flagMask.HorizontalStride()),
+       ptrdiff_t(sizeof(bool))});
+}
+
 py::array_t<bool> GetBuffer(const aoflagger::FlagMask* flagMask) {
   const bool* values = flagMask->Buffer();
   py::buffer_info buf = py::buffer_info(
@@ -174,12 +226,24 @@ py::object LoadStrategyFile(aoflagger::AOFlagger* flagger,
 
 py::object Run1(aoflagger::Strategy* strategy,
                 const aoflagger::ImageSet& input) {
-  return py::cast(strategy->Run(input));
+  aoflagger::FlagMask result;
+  {
+    // The strategy is run by the interpreters of RunAsync(), because
+    // Strategy::Run() can not be called by several threads at the same time.
+    const py::gil_scoped_release release;
+    result = strategy->RunAsync(input).get();
+  }
+  return py::cast(std::move(result));
 }
 
 py::object Run2(aoflagger::Strategy* strategy, const aoflagger::ImageSet& input,
                 const aoflagger::FlagMask& existingFlags) {
-  return py::cast(strategy->Run(input, existingFlags));
+  aoflagger::FlagMask result;
+  {
+    const py::gil_scoped_release release;
+    result = strategy->RunAsync(input, existingFlags).get();
+  }
+  return py::cast(std::move(result));
 }
 
 py::object MakeQualityStatistics1(aoflagger::AOFlagger* flagger,
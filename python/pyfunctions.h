@@ -21,6 +21,14 @@ pybind11::array_t<double> GetImageBuffer(const aoflagger::ImageSet* imageSet,
 void SetImageBuffer(aoflagger::ImageSet* imageSet, size_t imageIndex,
                     pybind11::array_t<double>& values);
 
+void SetImageBufferFloat(aoflagger::ImageSet* imageSet, size_t imageIndex,
+                         pybind11::array_t<float>& values);
+
+pybind11::array_t<float> GetImageView(pybind11::object imageSetObject,
+                                      size_t imageIndex);
+
+pybind11::buffer_info GetFlagMaskBufferInfo(aoflagger::FlagMask& flagMask);
+
 pybind11::array_t<bool> GetBuffer(const aoflagger::FlagMask* flagMask);
 
 void SetBuffer(aoflagger::FlagMask* flagMask, pybind11::array_t<bool>& values);
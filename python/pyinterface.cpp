@@ -60,6 +60,13 @@ PYBIND11_MODULE(aoflagger, m) {
       .def("get_image_buffer", aoflagger_python::GetImageBuffer,
            "Get access to one of the image sets stored in this object. \n"
            "Returns a numpy double array of ntimes x nchannels.")
+      .def("get_image_view", aoflagger_python::GetImageView,
+           "Get a numpy float32 array of ntimes x nchannels that refers to \n"
+           "one of the images stored in this object, without copying it. \n"
+           "Changing the array changes the image.")
+      .def("set_image_buffer", aoflagger_python::SetImageBufferFloat,
+           "Replace the data of one of the image sets. This function expects\n"
+           "a numpy float32 array of ntimes x nchannels.")
       .def("set_image_buffer", aoflagger_python::SetImageBuffer,
            "Replace the data of one of the image sets. This function expects\n"
            "a numpy double array of ntimes x nchannels.")
@@ -67,7 +74,7 @@ PYBIND11_MODULE(aoflagger, m) {
            &aoflagger::ImageSet::ResizeWithoutReallocation);
 
   py::class_<aoflagger::FlagMask>(
-      m, "FlagMask",
+      m, "FlagMask", py::buffer_protocol(),
       "A two-dimensional flag mask.\n\n"
       "The flag mask specifies which values in an ImageSet are flagged.\n"
       "A value true means a value is flagged, i.e., contains RFI and should\n"
@@ -84,7 +91,11 @@ PYBIND11_MODULE(aoflagger, m) {
       "best\n"
       "when seeing the flags from all polarizations.\n"
       "\n"
+      "The flag mask supports the buffer protocol, such that e.g.\n"
+      "numpy.asarray() gives access to the flags without copying them.\n"
+      "\n"
       "This class wraps the C++ class aoflagger::FlagMask.")
+      .def_buffer(aoflagger_python::GetFlagMaskBufferInfo)
       .def("width", &aoflagger::FlagMask::Width,
            "Get width (number of time steps) of flag mask")
       .def("height", &aoflagger::FlagMask::Height,
@@ -105,7 +116,10 @@ PYBIND11_MODULE(aoflagger, m) {
       "can be loaded from disk with AOFlagger.load_strategy(). Strategies\n"
       "can not be changed with this interface. A user can create strategies\n"
       "with the @c rfigui tool that is part of the aoflagger package.")
-      .def("run", aoflagger_python::Run1)
+      .def("run", aoflagger_python::Run1,
+           "Run the strategy on an ImageSet and return the flags. The GIL is\n"
+           "released while the strategy runs, such that several Python\n"
+           "threads can run strategies at the same time.")
       .def("run", aoflagger_python::Run2);
 
   py::class_<aoflagger::QualityStatistics>(m, "QualityStatistics")
@@ -1,172 +1,149 @@
 #ifndef BASELINESTATISTICSMAP_H
 #define BASELINESTATISTICSMAP_H
 
-#include <vector>
-#include <map>
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 
 #include "../util/serializable.h"
 
 #include "defaultstatistics.h"
 
+/**
+ * Statistics per baseline. The statistics are indexed by antenna1 and
+ * antenna2 in a table that grows with the highest antenna index, such that
+ * looking up a baseline does not require a search. The statistics themselves
+ * do not move when the table grows, so references to them stay valid.
+ */
 class BaselineStatisticsMap : public Serializable {
  public:
   explicit BaselineStatisticsMap(unsigned polarizationCount)
       : _polarizationCount(polarizationCount) {}
 
+  BaselineStatisticsMap(const BaselineStatisticsMap& source)
+      : _polarizationCount(source._polarizationCount) {
+    *this += source;
+  }
+
+  BaselineStatisticsMap(BaselineStatisticsMap&& source) = default;
+
+  BaselineStatisticsMap& operator=(const BaselineStatisticsMap& source) {
+    if (this != &source) {
+      _table.clear();
+      _polarizationCount = source._polarizationCount;
+      *this += source;
+    }
+    return *this;
+  }
+
+  BaselineStatisticsMap& operator=(BaselineStatisticsMap&& source) = default;
+
   void operator+=(const BaselineStatisticsMap& other) {
-    for (OuterMap::const_iterator i = other._map.begin(); i != other._map.end();
-         ++i) {
-      unsigned antenna1 = i->first;
-      const InnerMap& innerMap = i->second;
-      for (InnerMap::const_iterator j = innerMap.begin(); j != innerMap.end();
-           ++j) {
-        unsigned antenna2 = j->first;
-        const DefaultStatistics& stat = j->second;
-        GetStatistics(antenna1, antenna2) += stat;
+    for (size_t antenna1 = 0; antenna1 != other._table.size(); ++antenna1) {
+      const Row& row = other._table[antenna1];
+      for (size_t antenna2 = 0; antenna2 != row.size(); ++antenna2) {
+        if (row[antenna2]) GetStatistics(antenna1, antenna2) += *row[antenna2];
       }
     }
   }
 
   DefaultStatistics& GetStatistics(unsigned antenna1, unsigned antenna2) {
-    OuterMap::iterator antenna1Map =
-        _map.insert(OuterPair(antenna1, InnerMap())).first;
-    InnerMap& innerMap = antenna1Map->second;
-    InnerMap::iterator antenna2Value = innerMap.find(antenna2);
-    DefaultStatistics* statistics;
-    if (antenna2Value == innerMap.end()) {
+    if (antenna1 >= _table.size()) _table.resize(antenna1 + 1);
+    Row& row = _table[antenna1];
+    if (antenna2 >= row.size()) row.resize(antenna2 + 1);
+    if (!row[antenna2]) {
       // The baseline does not exist yet, create empty statistics.
-      statistics = &(innerMap
-                         .insert(InnerPair(
-                             antenna2, DefaultStatistics(_polarizationCount)))
-                         .first->second);
-    } else {
-      statistics = &antenna2Value->second;
+      row[antenna2].reset(new DefaultStatistics(_polarizationCount));
     }
-    return *statistics;
+    return *row[antenna2];
   }
 
   const DefaultStatistics& GetStatistics(unsigned antenna1,
                                          unsigned antenna2) const {
-    OuterMap::const_iterator antenna1Map = _map.find(antenna1);
-    if (antenna1Map == _map.end()) {
+    if (antenna1 >= _table.size() || antenna2 >= _table[antenna1].size() ||
+        !_table[antenna1][antenna2])
       throw std::runtime_error(
           "BaselineStatisticsMap::GetStatistics() : Requested unavailable "
           "baseline");
-    } else {
-      const InnerMap& innerMap = antenna1Map->second;
-      InnerMap::const_iterator antenna2Value = innerMap.find(antenna2);
-      if (antenna2Value == innerMap.end()) {
-        throw std::runtime_error(
-            "BaselineStatisticsMap::GetStatistics() : Requested unavailable "
-            "baseline");
-      } else {
-        return antenna2Value->second;
-      }
-    }
+    return *_table[antenna1][antenna2];
   }
 
   std::vector<std::pair<unsigned, unsigned>> BaselineList() const {
     std::vector<std::pair<unsigned, unsigned>> list;
-    for (OuterMap::const_iterator outerIter = _map.begin();
-         outerIter != _map.end(); ++outerIter) {
-      const unsigned antenna1 = outerIter->first;
-      const InnerMap& innerMap = outerIter->second;
-
-      for (InnerMap::const_iterator innerIter = innerMap.begin();
-           innerIter != innerMap.end(); ++innerIter) {
-        const unsigned antenna2 = innerIter->first;
-        list.push_back(std::pair<unsigned, unsigned>(antenna1, antenna2));
+    for (size_t antenna1 = 0; antenna1 != _table.size(); ++antenna1) {
+      const Row& row = _table[antenna1];
+      for (size_t antenna2 = 0; antenna2 != row.size(); ++antenna2) {
+        if (row[antenna2]) list.emplace_back(antenna1, antenna2);
       }
     }
     return list;
   }
 
   unsigned AntennaCount() const {
-    if (_map.empty()) return 0;
-    unsigned highestIndex = _map.rbegin()->first;
-
-    for (OuterMap::const_iterator outerIter = _map.begin();
-         outerIter != _map.end(); ++outerIter) {
-      const InnerMap& innerMap = outerIter->second;
-      if (highestIndex < innerMap.rbegin()->first)
-        highestIndex = innerMap.rbegin()->first;
+    unsigned count = 0;
+    for (size_t antenna1 = 0; antenna1 != _table.size(); ++antenna1) {
+      const Row& row = _table[antenna1];
+      for (size_t antenna2 = 0; antenna2 != row.size(); ++antenna2) {
+        if (row[antenna2])
+          count = std::max<unsigned>(count, std::max(antenna1, antenna2) + 1);
+      }
     }
-    return highestIndex + 1;
+    return count;
   }
 
-  void Clear() { _map.clear(); }
+  void Clear() { _table.clear(); }
 
   unsigned PolarizationCount() const { return _polarizationCount; }
 
+  /**
+   * Writes, for every antenna1 that has baselines, the list of its antenna2
+   * indices with their statistics.
+   */
   virtual void Serialize(std::ostream& stream) const final override {
     SerializeToUInt32(stream, _polarizationCount);
-    serializeOuterMap(stream, _map);
-  }
-
-  virtual void Unserialize(std::istream& stream) final override {
-    _map.clear();
-    _polarizationCount = UnserializeUInt32(stream);
-    unserializeOuterMap(stream, _map);
-  }
-
- private:
-  typedef std::map<unsigned, DefaultStatistics> InnerMap;
-  typedef std::pair<unsigned, DefaultStatistics> InnerPair;
-  typedef std::map<unsigned, InnerMap> OuterMap;
-  typedef std::pair<unsigned, InnerMap> OuterPair;
-
-  OuterMap _map;
-  unsigned _polarizationCount;
-
-  void serializeOuterMap(std::ostream& stream, const OuterMap& map) const {
-    SerializeToUInt32(stream, map.size());
-
-    for (OuterMap::const_iterator i = map.begin(); i != map.end(); ++i) {
-      unsigned antenna1 = i->first;
-      SerializeToUInt32(stream, antenna1);
-
-      const InnerMap& innerMap = i->second;
-      serializeInnerMap(stream, innerMap);
+    std::vector<size_t> rowSizes(_table.size(), 0);
+    size_t rowCount = 0;
+    for (size_t antenna1 = 0; antenna1 != _table.size(); ++antenna1) {
+      for (const std::unique_ptr<DefaultStatistics>& s : _table[antenna1])
+        if (s) ++rowSizes[antenna1];
+      if (rowSizes[antenna1] != 0) ++rowCount;
     }
-  }
-
-  void unserializeOuterMap(std::istream& stream, OuterMap& map) const {
-    size_t size = UnserializeUInt32(stream);
-    for (size_t j = 0; j < size; ++j) {
-      unsigned antenna1 = UnserializeUInt32(stream);
 
-      OuterMap::iterator i =
-          map.insert(std::pair<unsigned, InnerMap>(antenna1, InnerMap())).first;
-      unserializeInnerMap(stream, i->second);
+    SerializeToUInt32(stream, rowCount);
+    for (size_t antenna1 = 0; antenna1 != _table.size(); ++antenna1) {
+      if (rowSizes[antenna1] == 0) continue;
+      SerializeToUInt32(stream, antenna1);
+      SerializeToUInt32(stream, rowSizes[antenna1]);
+      const Row& row = _table[antenna1];
+      for (size_t antenna2 = 0; antenna2 != row.size(); ++antenna2) {
+        if (row[antenna2]) {
+          SerializeToUInt32(stream, antenna2);
+          row[antenna2]->Serialize(stream);
+        }
+      }
     }
   }
 
-  void serializeInnerMap(std::ostream& stream, const InnerMap& map) const {
-    SerializeToUInt32(stream, map.size());
-
-    for (InnerMap::const_iterator i = map.begin(); i != map.end(); ++i) {
-      unsigned antenna2 = i->first;
-      SerializeToUInt32(stream, antenna2);
-
-      const DefaultStatistics& statistics = i->second;
-      statistics.Serialize(stream);
+  virtual void Unserialize(std::istream& stream) final override {
+    _table.clear();
+    _polarizationCount = UnserializeUInt32(stream);
+    const size_t rowCount = UnserializeUInt32(stream);
+    for (size_t i = 0; i != rowCount; ++i) {
+      const unsigned antenna1 = UnserializeUInt32(stream);
+      const size_t rowSize = UnserializeUInt32(stream);
+      for (size_t j = 0; j != rowSize; ++j) {
+        const unsigned antenna2 = UnserializeUInt32(stream);
+        GetStatistics(antenna1, antenna2).Unserialize(stream);
+      }
     }
   }
 
-  void unserializeInnerMap(std::istream& stream, InnerMap& map) const {
-    size_t size = UnserializeUInt32(stream);
-    for (size_t j = 0; j < size; ++j) {
-      unsigned antenna2 = UnserializeUInt32(stream);
-
-      InnerMap::iterator i =
-          map.insert(std::pair<unsigned, DefaultStatistics>(
-                         antenna2, DefaultStatistics(_polarizationCount)))
-              .first;
+ private:
+  typedef std::vector<std::unique_ptr<DefaultStatistics>> Row;
 
-      i->second.Unserialize(stream);
-    }
-  }
+  std::vector<Row> _table;
+  unsigned _polarizationCount;
 };
 
 #endif
@@ -2,24 +2,69 @@
 
 #include "../structures/msmetadata.h"
 
+#include "../util/logger.h"
 #include "../util/progress/progresslistener.h"
+#include "../util/stopwatch.h"
 
 #include "histogramcollection.h"
 #include "statisticscollection.h"
 
+#include <aocommon/parallelfor.h>
 #include <aocommon/system.h>
 
 #include <casacore/tables/Tables/ArrayColumn.h>
 #include <casacore/tables/Tables/ScalarColumn.h>
 
+#include <algorithm>
 #include <memory>
 
+namespace {
+// Number of samples that are read from the measurement set at once. Larger
+// blocks make the reading more efficient, but require more memory per
+// thread.
+constexpr size_t kSamplesPerBlock = 1 << 20;
+}  // namespace
+
+struct Collector::Block {
+  casacore::Array<casacore::Complex> samples;
+  casacore::Array<bool> isRFI;
+  casacore::Vector<int> antenna1, antenna2, bandIndex;
+  size_t startRow;
+  size_t rowCount;
+  // Number of channels in every row of this block
+  size_t channelCount;
+};
+
+/**
+ * The statistics that a thread has accumulated since it last merged them into
+ * the result. They are merged and cleared after about kSamplesPerBlock
+ * samples, so their size is bounded by the block size instead of growing with
+ * the measurement set.
+ *
+ * Only processing the samples happens in parallel. Reading the blocks is
+ * serialized, because casacore tables are not thread safe, and merging into
+ * the result is serialized by a mutex. A merge only touches the time steps,
+ * baselines and channels of about one block, which is cheap compared to
+ * processing its samples.
+ */
+struct Collector::Partial {
+  explicit Partial(size_t polarizationCount)
+      : statistics(polarizationCount), histograms(polarizationCount) {}
+  StatisticsCollection statistics;
+  HistogramCollection histograms;
+  size_t sampleCount = 0;
+  aocommon::UVector<std::complex<float>> histogramSamples;
+  aocommon::UVector<bool> histogramFlags;
+};
+
 Collector::Collector()
     : _mode(CollectDefault),
       _dataColumnName("DATA"),
       _intervalStart(0),
       _intervalEnd(0),
-      _flaggedTimesteps(0) {}
+      _flaggedTimesteps(0),
+      _compensatedSummation(false),
+      _threadCount(aocommon::system::ProcessorCount()) {}
 
 Collector::~Collector() = default;
 
@@ -28,12 +73,13 @@ void Collector::Collect(const std::string& filename,
                         HistogramCollection& histogramCollection,
                         ProgressListener& progressListener) {
   progressListener.OnStartTask("Collecting statistics");
+  const Stopwatch watch(true);
   std::unique_ptr<MSMetaData> ms(new MSMetaData(filename));
   const size_t polarizationCount = ms->PolarizationCount(),
                bandCount = ms->BandCount();
   const bool ignoreChannelZero =
       ms->IsChannelZeroRubish() && _mode != CollectTimeFrequency;
-  const std::string stationName = ms->GetStationName();
+  const size_t startChannel = ignoreChannelZero ? 1 : 0;
   std::vector<BandInfo> bands(bandCount);
   std::vector<std::vector<double>> frequencies(bandCount);
   for (unsigned b = 0; b < bandCount; ++b) {
@@ -45,172 +91,207 @@ void Collector::Collect(const std::string& filename,
   }
   ms.reset();
 
-  // Initialize statisticscollection
-  _statisticsCollection = &statisticsCollection;
-  _histogramCollection = &histogramCollection;
-  statisticsCollection.SetPolarizationCount(polarizationCount);
-  const size_t nCPU = aocommon::system::ProcessorCount();
-  _threadStats.clear();
-  for (size_t i = 0; i != nCPU; ++i)
-    _threadStats.emplace_back(polarizationCount);
-  if (_mode != CollectHistograms) {
-    for (unsigned b = 0; b < bandCount; ++b) {
-      if (ignoreChannelZero)
-        statisticsCollection.InitializeBand(b, (frequencies[b].data() + 1),
-                                            bands[b].channels.size() - 1);
-      else
-        statisticsCollection.InitializeBand(b, frequencies[b].data(),
-                                            bands[b].channels.size());
-      for (size_t i = 0; i != nCPU; ++i) {
-        if (ignoreChannelZero)
-          _threadStats[i].InitializeBand(b, (frequencies[b].data() + 1),
-                                         bands[b].channels.size() - 1);
-        else
-          _threadStats[i].InitializeBand(b, frequencies[b].data(),
-                                         bands[b].channels.size());
-      }
-    }
-  }
-  // Initialize Histograms collection
-  histogramCollection.SetPolarizationCount(polarizationCount);
-
   // get columns
   const casacore::Table table(filename);
   const casacore::ArrayColumn<casacore::Complex> dataColumn(table,
                                                             _dataColumnName);
   const casacore::ArrayColumn<bool> flagColumn(table, "FLAG");
   const casacore::ScalarColumn<double> timeColumn(table, "TIME");
-  casacore::ScalarColumn<int> antenna1Column(table, "ANTENNA1"),
+  const casacore::ScalarColumn<int> antenna1Column(table, "ANTENNA1"),
       antenna2Column(table, "ANTENNA2"), windowColumn(table, "DATA_DESC_ID");
 
-  const size_t channelCount = bands[0].channels.size();
-  _correlatorFlags.assign(channelCount, false);
-  _correlatorFlagsForBadAntenna.assign(channelCount, true);
-
-  aocommon::Lane<Work> workLane(nCPU * 4);
-  std::vector<std::thread> threads;
-  for (size_t i = 0; i != nCPU; ++i)
-    threads.emplace_back(
-        [&, i]() { process(&workLane, &_threadStats[i], polarizationCount); });
-
-  const bool hasInterval = !(_intervalStart == 0 && _intervalEnd == 0);
-
+  // Number the timesteps, such that blocks can be processed in any order
   const size_t nrow = table.nrow();
+  const casacore::Vector<double> times = timeColumn.getColumn();
+  _times.assign(times.begin(), times.end());
+  _timestepIndices.resize(nrow);
   size_t timestepIndex = (size_t)-1;
   double prevtime = -1.0;
   for (size_t row = 0; row != nrow; ++row) {
-    Work work;
-    work.time = timeColumn(row);
-
-    if (work.time != prevtime) {
+    if (_times[row] != prevtime) {
       ++timestepIndex;
-      prevtime = work.time;
+      prevtime = _times[row];
     }
+    _timestepIndices[row] = timestepIndex;
+  }
 
-    if (!hasInterval ||
-        (timestepIndex >= _intervalStart && timestepIndex < _intervalEnd)) {
-      work.antenna1Index = antenna1Column(row),
-      work.antenna2Index = antenna2Column(row),
-      work.bandIndex = windowColumn(row);
-      work.timestepIndex = timestepIndex;
-
-      const BandInfo& band = bands[work.bandIndex];
-
-      const casacore::Array<casacore::Complex> dataArray = dataColumn(row);
-      const casacore::Array<bool> flagArray = flagColumn(row);
-      work.hasFlaggedAntenna =
-          _flaggedAntennae.find(work.antenna1Index) != _flaggedAntennae.end() ||
-          _flaggedAntennae.find(work.antenna2Index) != _flaggedAntennae.end();
-
-      casacore::Array<casacore::Complex>::const_contiter dataIter =
-          dataArray.cbegin();
-      casacore::Array<bool>::const_contiter flagIter = flagArray.cbegin();
-      const unsigned startChannel = ignoreChannelZero ? 1 : 0;
-      if (ignoreChannelZero) {
-        dataIter += polarizationCount;
-        flagIter += polarizationCount;
-      }
+  // Since the timestep indices are increasing, the rows of the interval are
+  // consecutive.
+  const bool hasInterval = !(_intervalStart == 0 && _intervalEnd == 0);
+  size_t startRow = 0, endRow = nrow;
+  if (hasInterval) {
+    startRow = std::lower_bound(_timestepIndices.begin(),
+                                _timestepIndices.end(), _intervalStart) -
+               _timestepIndices.begin();
+    endRow = std::lower_bound(_timestepIndices.begin(), _timestepIndices.end(),
+                              _intervalEnd) -
+             _timestepIndices.begin();
+  }
 
-      work.nChan = band.channels.size() - startChannel;
-      work.isRFI.resize(polarizationCount);
-      work.samples.resize(polarizationCount);
-      for (unsigned p = 0; p < polarizationCount; ++p) {
-        work.isRFI[p].resize(band.channels.size());
-        work.samples[p].resize(band.channels.size());
-      }
-      for (unsigned channel = startChannel; channel < band.channels.size();
-           ++channel) {
-        for (unsigned p = 0; p < polarizationCount; ++p) {
-          work.samples[p][channel - startChannel] = *dataIter;
-          work.isRFI[p][channel - startChannel] = *flagIter;
-
-          ++dataIter;
-          ++flagIter;
-        }
-      }
+  // Several rows can only be read at once when all rows have the same shape
+  size_t maxChannelCount = 0;
+  bool sameChannelCount = true;
+  for (const BandInfo& band : bands) {
+    sameChannelCount = sameChannelCount &&
+                       band.channels.size() == bands[0].channels.size();
+    maxChannelCount = std::max(maxChannelCount, band.channels.size());
+  }
+  const size_t rowsPerBlock =
+      sameChannelCount
+          ? std::max<size_t>(
+                1, kSamplesPerBlock /
+                       std::max<size_t>(1, maxChannelCount * polarizationCount))
+          : 1;
+  const size_t blockCount =
+      endRow > startRow ? (endRow - startRow + rowsPerBlock - 1) / rowsPerBlock
+                        : 0;
+  const size_t threadCount =
+      std::max<size_t>(1, std::min(_threadCount, blockCount));
 
-      workLane.write(std::move(work));
+  // Initialize statisticscollection
+  statisticsCollection.SetPolarizationCount(polarizationCount);
+  std::vector<std::unique_ptr<Partial>> partials;
+  for (size_t i = 0; i != threadCount; ++i) {
+    partials.emplace_back(new Partial(polarizationCount));
+    partials.back()->statistics.SetCompensatedSummation(_compensatedSummation);
+  }
+  if (_mode != CollectHistograms) {
+    for (unsigned b = 0; b < bandCount; ++b) {
+      statisticsCollection.InitializeBand(
+          b, frequencies[b].data() + startChannel,
+          bands[b].channels.size() - startChannel);
+      for (std::unique_ptr<Partial>& partial : partials)
+        partial->statistics.InitializeBand(
+            b, frequencies[b].data() + startChannel,
+            bands[b].channels.size() - startChannel);
     }
-    progressListener.OnProgress(row, nrow);
   }
+  // Initialize Histograms collection
+  histogramCollection.SetPolarizationCount(polarizationCount);
 
-  workLane.write_end();
+  _correlatorFlags.assign(maxChannelCount, false);
+  _correlatorFlagsForBadAntenna.assign(maxChannelCount, true);
 
-  for (size_t i = 0; i != nCPU; ++i) threads[i].join();
+  size_t rowsRead = 0;
+  aocommon::ParallelFor<size_t> loop(threadCount);
+  loop.Run(0, blockCount, [&](size_t blockIndex, size_t thread) {
+    Block block;
+    block.startRow = startRow + blockIndex * rowsPerBlock;
+    block.rowCount = std::min(rowsPerBlock, endRow - block.startRow);
+    {
+      // casacore tables are not thread safe, so the threads take turns
+      // reading a block.
+      const std::lock_guard<std::mutex> lock(_mutex);
+      const casacore::Slicer rows(casacore::IPosition(1, block.startRow),
+                                  casacore::IPosition(1, block.rowCount));
+      dataColumn.getColumnRange(rows, block.samples, true);
+      flagColumn.getColumnRange(rows, block.isRFI, true);
+      antenna1Column.getColumnRange(rows, block.antenna1, true);
+      antenna2Column.getColumnRange(rows, block.antenna2, true);
+      windowColumn.getColumnRange(rows, block.bandIndex, true);
+      rowsRead += block.rowCount;
+      progressListener.OnProgress(rowsRead, endRow - startRow);
+    }
+    block.channelCount = block.samples.shape()[1];
+    Partial& partial = *partials[thread];
+    processBlock(block, partial, polarizationCount, startChannel);
+    partial.sampleCount +=
+        block.rowCount * block.channelCount * polarizationCount;
+    if (partial.sampleCount >= kSamplesPerBlock)
+      mergePartial(partial, statisticsCollection, histogramCollection);
+  });
+  for (std::unique_ptr<Partial>& partial : partials)
+    mergePartial(*partial, statisticsCollection, histogramCollection);
 
+  const long double seconds = watch.Seconds();
+  Logger::Info << "Collected statistics of " << (endRow - startRow)
+               << " rows in " << watch.ToString() << " ("
+               << size_t((endRow - startRow) / std::max(seconds, 1e-9L))
+               << " rows/s).\n";
   progressListener.OnFinish();
 }
 
-void Collector::process(aocommon::Lane<Work>* workLane,
-                        StatisticsCollection* stats, size_t polarizationCount) {
-  Work work;
-  HistogramCollection histos(polarizationCount);
-  while (workLane->read(work)) {
+void Collector::mergePartial(Partial& partial,
+                             StatisticsCollection& statisticsCollection,
+                             HistogramCollection& histogramCollection) {
+  {
+    // Merging is cheap compared to processing the samples, because the
+    // partial only holds the time steps, baselines and channels of about one
+    // block.
+    const std::lock_guard<std::mutex> lock(_mergeMutex);
+    statisticsCollection.Add(partial.statistics);
+    histogramCollection.Add(partial.histograms);
+  }
+  partial.statistics.Clear();
+  partial.histograms.Clear();
+  partial.sampleCount = 0;
+}
+
+void Collector::processBlock(const Block& block, Partial& partial,
+                             size_t polarizationCount, size_t startChannel) {
+  StatisticsCollection& stats = partial.statistics;
+  const size_t rowSize = block.channelCount * polarizationCount;
+  const size_t nChan = block.channelCount - startChannel;
+  // The data and flags are stored with the polarization varying fastest,
+  // then the channel and then the row. They are passed on with a stride.
+  bool deleteSamples, deleteFlags;
+  const casacore::Complex* samples = block.samples.getStorage(deleteSamples);
+  const bool* flags = block.isRFI.getStorage(deleteFlags);
+  for (size_t r = 0; r != block.rowCount; ++r) {
+    const size_t row = block.startRow + r;
+    const size_t antenna1Index = block.antenna1[r],
+                 antenna2Index = block.antenna2[r],
+                 bandIndex = block.bandIndex[r];
+    const size_t timestepIndex = _timestepIndices[row];
+    const double time = _times[row];
+    const bool hasFlaggedAntenna =
+        _flaggedAntennae.find(antenna1Index) != _flaggedAntennae.end() ||
+        _flaggedAntennae.find(antenna2Index) != _flaggedAntennae.end();
+    const bool* correlatorFlags =
+        (hasFlaggedAntenna || timestepIndex < _flaggedTimesteps)
+            ? _correlatorFlagsForBadAntenna.data()
+            : _correlatorFlags.data();
+    const casacore::Complex* rowSamples =
+        samples + r * rowSize + startChannel * polarizationCount;
+    const bool* rowFlags =
+        flags + r * rowSize + startChannel * polarizationCount;
     for (unsigned p = 0; p < polarizationCount; ++p) {
+      const float* reals = reinterpret_cast<const float*>(rowSamples + p);
+      const float* imags = reals + 1;
+      const bool* isRFI = rowFlags + p;
       switch (_mode) {
         case CollectDefault:
-          if (work.hasFlaggedAntenna || work.timestepIndex < _flaggedTimesteps)
-            stats->Add(work.antenna1Index, work.antenna2Index, work.time,
-                       work.bandIndex, p,
-                       &reinterpret_cast<float*>(work.samples[p].data())[0],
-                       &reinterpret_cast<float*>(work.samples[p].data())[1],
-                       work.isRFI[p].data(),
-                       _correlatorFlagsForBadAntenna.data(), work.nChan, 2, 1,
-                       1);
-          else
-            stats->Add(work.antenna1Index, work.antenna2Index, work.time,
-                       work.bandIndex, p,
-                       &reinterpret_cast<float*>(work.samples[p].data())[0],
-                       &reinterpret_cast<float*>(work.samples[p].data())[1],
-                       work.isRFI[p].data(), _correlatorFlags.data(),
-                       work.nChan, 2, 1, 1);
+          stats.Add(antenna1Index, antenna2Index, time, bandIndex, p, reals,
+                    imags, isRFI, correlatorFlags, nChan,
+                    2 * polarizationCount, polarizationCount, 1);
           break;
         case CollectHistograms:
-          histos.Add(work.antenna1Index, work.antenna2Index, p,
-                     work.samples[p].data(), work.isRFI[p].data(), work.nChan);
+          partial.histogramSamples.resize(nChan);
+          partial.histogramFlags.resize(nChan);
+          for (size_t ch = 0; ch != nChan; ++ch) {
+            partial.histogramSamples[ch] =
+                rowSamples[ch * polarizationCount + p];
+            partial.histogramFlags[ch] = rowFlags[ch * polarizationCount + p];
+          }
+          partial.histograms.Add(antenna1Index, antenna2Index, p,
+                                 partial.histogramSamples.data(),
+                                 partial.histogramFlags.data(), nChan);
           break;
         case CollectTimeFrequency:
-          if (work.hasFlaggedAntenna || work.timestepIndex < _flaggedTimesteps)
-            stats->Add(work.antenna1Index, work.antenna2Index, work.time,
-                       work.bandIndex, p,
-                       &reinterpret_cast<float*>(work.samples[p].data())[0],
-                       &reinterpret_cast<float*>(work.samples[p].data())[1],
-                       work.isRFI[p].data(),
-                       _correlatorFlagsForBadAntenna.data(), work.nChan, 2, 1,
-                       1);
+          if (hasFlaggedAntenna || timestepIndex < _flaggedTimesteps)
+            stats.Add(antenna1Index, antenna2Index, time, bandIndex, p, reals,
+                      imags, isRFI, correlatorFlags, nChan,
+                      2 * polarizationCount, polarizationCount, 1);
           else
-            stats->AddToTimeFrequency(
-                work.antenna1Index, work.antenna2Index, work.time,
-                work.bandIndex, p,
-                &reinterpret_cast<float*>(work.samples[p].data())[0],
-                &reinterpret_cast<float*>(work.samples[p].data())[1],
-                work.isRFI[p].data(), _correlatorFlags.data(), work.nChan, 2, 1,
-                1);
+            stats.AddToTimeFrequency(antenna1Index, antenna2Index, time,
+                                     bandIndex, p, reals, imags, isRFI,
+                                     correlatorFlags, nChan,
+                                     2 * polarizationCount, polarizationCount,
+                                     1);
           break;
       }
     }
   }
-  const std::unique_lock<std::mutex> lock(_mutex);
-  _statisticsCollection->Add(*stats);
-  _histogramCollection->Add(histos);
+  block.samples.freeStorage(samples, deleteSamples);
+  block.isRFI.freeStorage(flags, deleteFlags);
 }
@@ -1,13 +1,13 @@
 #ifndef COLLECTOR_H
 #define COLLECTOR_H
 
+#include <algorithm>
 #include <complex>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
-#include <thread>
 
-#include <aocommon/lane.h>
 #include <aocommon/uvector.h>
 
 class HistogramCollection;
@@ -26,6 +26,14 @@ class Collector {
 
   ~Collector();
 
+  /**
+   * Collects the statistics of a measurement set. The rows are read in large
+   * blocks, which are processed in parallel by one thread per processor.
+   * Every thread accumulates into its own statistics, which are merged into
+   * the result after about a block of samples, so the memory per thread is
+   * bounded by the block size. The threads take turns reading blocks and
+   * merging statistics: only processing the samples is parallel.
+   */
   void Collect(const std::string& filename,
                StatisticsCollection& statisticsCollection,
                HistogramCollection& histogramCollection,
@@ -45,30 +53,51 @@ class Collector {
   void SetFlaggedAntennae(std::set<size_t>&& flaggedAntennae) {
     _flaggedAntennae = flaggedAntennae;
   }
+  /**
+   * Accumulate the sums with compensated double precision instead of long
+   * double precision, see StatisticsCollection::SetCompensatedSummation().
+   */
+  void SetCompensatedSummation(bool compensatedSummation) {
+    _compensatedSummation = compensatedSummation;
+  }
+  /**
+   * Number of threads that process blocks. Defaults to the number of
+   * processors.
+   */
+  void SetThreadCount(size_t threadCount) {
+    _threadCount = std::max<size_t>(threadCount, 1);
+  }
 
  private:
-  struct Work {
-    std::vector<aocommon::UVector<std::complex<float>>> samples;
-    std::vector<aocommon::UVector<bool>> isRFI;
-    size_t antenna1Index, antenna2Index, bandIndex, timestepIndex, nChan;
-    double time;
-    bool hasFlaggedAntenna;
-  };
+  struct Block;
+  struct Partial;
 
-  void process(aocommon::Lane<Work>* workLane, StatisticsCollection* stats,
-               size_t polarizationCount);
+  void processBlock(const Block& block, Partial& partial,
+                    size_t polarizationCount, size_t startChannel);
+  /**
+   * Adds the statistics of @p partial to the result and clears them. Can be
+   * called from several threads at the same time.
+   */
+  void mergePartial(Partial& partial,
+                    StatisticsCollection& statisticsCollection,
+                    HistogramCollection& histogramCollection);
 
+  // Serializes the access to the measurement set.
   std::mutex _mutex;
+  // Serializes merging the statistics of a block into the result.
+  std::mutex _mergeMutex;
   CollectingMode _mode;
   std::string _dataColumnName;
   size_t _intervalStart, _intervalEnd;
   size_t _flaggedTimesteps;
   std::set<size_t> _flaggedAntennae;
+  bool _compensatedSummation;
+  size_t _threadCount;
   aocommon::UVector<bool> _correlatorFlags;
   aocommon::UVector<bool> _correlatorFlagsForBadAntenna;
-  StatisticsCollection* _statisticsCollection;
-  HistogramCollection* _histogramCollection;
-  std::vector<StatisticsCollection> _threadStats;
+  // Timestep index and time of every row
+  std::vector<size_t> _timestepIndices;
+  std::vector<double> _times;
 };
 
 #endif
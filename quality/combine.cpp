@@ -1,41 +1,85 @@
 #include "combine.h"
 
+#include "histogramtablesformatter.h"
+
 #include "../structures/msmetadata.h"
 
+#include <aocommon/parallelfor.h>
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
 namespace quality {
 
+namespace {
+
+void Merge(FileContents& destination, FileContents& source) {
+  destination.statistics_collection.Add(source.statistics_collection);
+  if (!source.histogram_collection.Empty())
+    destination.histogram_collection.Add(source.histogram_collection);
+  source.statistics_collection.Clear();
+  source.histogram_collection.Clear();
+}
+
+}  // namespace
+
 FileContents ReadAndCombine(const std::vector<std::string>& files,
-                            bool verbose) {
+                            bool verbose, size_t n_threads) {
   FileContents result;
-  size_t n_polarizations = 0;
-  for (size_t i = 0; i != files.size(); ++i) {
-    const std::string& filename = files[i];
-    if (n_polarizations == 0) {
-      n_polarizations = MSMetaData::PolarizationCount(filename);
-      result.statistics_collection.SetPolarizationCount(n_polarizations);
-      result.histogram_collection.SetPolarizationCount(n_polarizations);
-    } else {
-      if (n_polarizations != MSMetaData::PolarizationCount(filename)) {
-        throw std::runtime_error(
-            "Can't combine measurement set quality statistics with different "
-            "number of polarizations");
-      }
+  if (files.empty()) return result;
+
+  const size_t n_polarizations = MSMetaData::PolarizationCount(files.front());
+  n_threads = std::max<size_t>(1, std::min(n_threads, files.size()));
+  // The first partial result is the result itself, to avoid copying it at
+  // the end.
+  std::vector<FileContents> extra_partials(n_threads - 1);
+  std::vector<FileContents*> partials{&result};
+  for (FileContents& partial : extra_partials) partials.emplace_back(&partial);
+  for (FileContents* partial : partials) {
+    partial->statistics_collection.SetPolarizationCount(n_polarizations);
+    partial->histogram_collection.SetPolarizationCount(n_polarizations);
+  }
+
+  std::mutex mutex;
+  size_t n_read = 0;
+  aocommon::ParallelFor<size_t> loop(n_threads);
+  loop.Run(0, files.size(), [&](size_t file_index, size_t thread) {
+    const std::string& filename = files[file_index];
+    if (n_polarizations != MSMetaData::PolarizationCount(filename)) {
+      throw std::runtime_error(
+          "Can't combine measurement set quality statistics with different "
+          "number of polarizations");
     }
 
-    if (verbose)
-      std::cout << " (" << (i + 1) << "/" << files.size() << ") Adding "
+    if (verbose) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++n_read;
+      std::cout << " (" << n_read << "/" << files.size() << ") Adding "
                 << filename << " to statistics...\n";
-    QualityTablesFormatter qualityTables(filename);
-    StatisticsCollection statCollection(n_polarizations);
-    statCollection.Load(qualityTables);
-    result.statistics_collection.Add(statCollection);
-
-    HistogramTablesFormatter histogramTables(filename);
-    if (histogramTables.HistogramsExist()) {
-      HistogramCollection histCollection(n_polarizations);
-      histCollection.Load(histogramTables);
-      result.histogram_collection.Add(histCollection);
     }
+    FileContents& partial = *partials[thread];
+    QualityTablesFormatter quality_tables(filename);
+    StatisticsCollection stat_collection(n_polarizations);
+    stat_collection.Load(quality_tables);
+    partial.statistics_collection.Add(stat_collection);
+
+    HistogramTablesFormatter histogram_tables(filename);
+    if (histogram_tables.HistogramsExist()) {
+      HistogramCollection hist_collection(n_polarizations);
+      hist_collection.Load(histogram_tables);
+      partial.histogram_collection.Add(hist_collection);
+    }
+  });
+
+  // Merge pairs of partial results in parallel, until one is left
+  for (size_t step = 1; step < n_threads; step *= 2) {
+    const size_t n_pairs = (n_threads + 2 * step - 1) / (2 * step);
+    loop.Run(0, n_pairs, [&](size_t pair, size_t) {
+      const size_t destination = pair * 2 * step;
+      const size_t source = destination + step;
+      if (source < n_threads) Merge(*partials[destination], *partials[source]);
+    });
   }
   return result;
 }
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 
+#include <aocommon/system.h>
+
 #include "histogramcollection.h"
 #include "statisticscollection.h"
 
@@ -16,9 +18,15 @@ struct FileContents {
 
 /**
  * Reads and combines a number of quality statistics tables.
+ *
+ * The tables are read by @p n_threads threads. Each thread adds the files
+ * that it reads to its own partial result, such that at most one file per
+ * thread is held in memory, independent of the number of files. The partial
+ * results are finally merged in a reduction tree.
  */
-FileContents ReadAndCombine(const std::vector<std::string>& files,
-                            bool verbose);
+FileContents ReadAndCombine(
+    const std::vector<std::string>& files, bool verbose,
+    size_t n_threads = aocommon::system::ProcessorCount());
 
 }  // namespace quality
 
@@ -1,25 +1,25 @@
 #ifndef QUALITY__DEFAULT_STATISTICS_H
 #define QUALITY__DEFAULT_STATISTICS_H
 
+#include <algorithm>
 #include <complex>
+#include <memory>
 #include <stdint.h>
+#include <utility>
 
 #include "../util/serializable.h"
 
+/**
+ * Sums and counts of the visibilities of one time step, channel or baseline,
+ * for each polarization. The seven per-polarization arrays are stored in a
+ * single allocation: first the four complex sums, followed by the three
+ * counts.
+ */
 class DefaultStatistics : public Serializable {
  public:
   explicit DefaultStatistics(unsigned polarizationCount)
       : _polarizationCount(polarizationCount) {
     initialize();
-    for (unsigned p = 0; p < _polarizationCount; ++p) {
-      rfiCount[p] = 0;
-      count[p] = 0;
-      sum[p] = 0.0;
-      sumP2[p] = 0.0;
-      dCount[p] = 0;
-      dSum[p] = 0.0;
-      dSumP2[p] = 0.0;
-    }
   }
 
   ~DefaultStatistics() { destruct(); }
@@ -27,15 +27,12 @@ class DefaultStatistics : public Serializable {
   DefaultStatistics(const DefaultStatistics& other)
       : _polarizationCount(other._polarizationCount) {
     initialize();
-    for (unsigned p = 0; p < _polarizationCount; ++p) {
-      rfiCount[p] = other.rfiCount[p];
-      count[p] = other.count[p];
-      sum[p] = other.sum[p];
-      sumP2[p] = other.sumP2[p];
-      dCount[p] = other.dCount[p];
-      dSum[p] = other.dSum[p];
-      dSumP2[p] = other.dSumP2[p];
-    }
+    copyValues(other);
+  }
+
+  DefaultStatistics(DefaultStatistics&& other) noexcept
+      : DefaultStatistics() {
+    *this = std::move(other);
   }
 
   DefaultStatistics& operator=(const DefaultStatistics& other) {
@@ -44,15 +41,20 @@ class DefaultStatistics : public Serializable {
       _polarizationCount = other._polarizationCount;
       initialize();
     }
-    for (unsigned p = 0; p < _polarizationCount; ++p) {
-      rfiCount[p] = other.rfiCount[p];
-      count[p] = other.count[p];
-      sum[p] = other.sum[p];
-      sumP2[p] = other.sumP2[p];
-      dCount[p] = other.dCount[p];
-      dSum[p] = other.dSum[p];
-      dSumP2[p] = other.dSumP2[p];
-    }
+    copyValues(other);
+    return *this;
+  }
+
+  DefaultStatistics& operator=(DefaultStatistics&& other) noexcept {
+    std::swap(rfiCount, other.rfiCount);
+    std::swap(count, other.count);
+    std::swap(sum, other.sum);
+    std::swap(sumP2, other.sumP2);
+    std::swap(dCount, other.dCount);
+    std::swap(dSum, other.dSum);
+    std::swap(dSumP2, other.dSumP2);
+    std::swap(_polarizationCount, other._polarizationCount);
+    std::swap(_buffer, other._buffer);
     return *this;
   }
 
@@ -182,27 +184,45 @@ class DefaultStatistics : public Serializable {
   std::complex<long double>* dSumP2;
 
  private:
-  void initialize() {
-    rfiCount = new unsigned long[_polarizationCount];
-    count = new unsigned long[_polarizationCount];
-    sum = new std::complex<long double>[_polarizationCount];
-    sumP2 = new std::complex<long double>[_polarizationCount];
-    dCount = new unsigned long[_polarizationCount];
-    dSum = new std::complex<long double>[_polarizationCount];
-    dSumP2 = new std::complex<long double>[_polarizationCount];
-  }
+  DefaultStatistics()
+      : rfiCount(nullptr),
+        count(nullptr),
+        sum(nullptr),
+        sumP2(nullptr),
+        dCount(nullptr),
+        dSum(nullptr),
+        dSumP2(nullptr),
+        _polarizationCount(0),
+        _buffer(nullptr) {}
 
-  void destruct() {
-    delete[] rfiCount;
-    delete[] count;
-    delete[] sum;
-    delete[] sumP2;
-    delete[] dCount;
-    delete[] dSum;
-    delete[] dSumP2;
+  void initialize() {
+    static_assert(alignof(std::complex<long double>) <=
+                  __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    const size_t n = _polarizationCount;
+    // complex<long double> has the strictest alignment, so it goes first.
+    _buffer = new char[n * (4 * sizeof(std::complex<long double>) +
+                            3 * sizeof(unsigned long))];
+    sum = reinterpret_cast<std::complex<long double>*>(_buffer);
+    sumP2 = sum + n;
+    dSum = sumP2 + n;
+    dSumP2 = dSum + n;
+    rfiCount = reinterpret_cast<unsigned long*>(dSumP2 + n);
+    count = rfiCount + n;
+    dCount = count + n;
+    std::uninitialized_value_construct_n(sum, 4 * n);
+    std::uninitialized_value_construct_n(rfiCount, 3 * n);
+  }
+
+  void destruct() { delete[] _buffer; }
+
+  void copyValues(const DefaultStatistics& other) {
+    const size_t n = _polarizationCount;
+    std::copy_n(other.sum, 4 * n, sum);
+    std::copy_n(other.rfiCount, 3 * n, rfiCount);
   }
 
   unsigned _polarizationCount;
+  char* _buffer;
 };
 
 #endif
@@ -0,0 +1,154 @@
+#ifndef QUALITY__DOUBLE_STAT_MAP_H
+#define QUALITY__DOUBLE_STAT_MAP_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "defaultstatistics.h"
+
+/**
+ * Statistics per time step or per frequency, sorted by the time or frequency
+ * ("the key"). The keys and the statistics are stored in two dense arrays, so
+ * a lookup is a binary search over the keys only, and iterating touches
+ * consecutive memory. Keys are mostly added in increasing order (e.g. time
+ * steps), which appends to the arrays.
+ *
+ * The interface follows std::map, but iterators dereference to a pair of
+ * references instead of to a std::pair. Adding a key moves the statistics
+ * after it, so references and iterators are invalidated when a key is added.
+ */
+class DoubleStatMap {
+ public:
+  template <typename Value>
+  class Iterator {
+   public:
+    struct Reference {
+      const double& first;
+      Value& second;
+      const Reference* operator->() const { return this; }
+    };
+
+    Iterator() = default;
+    Iterator(const double* key, Value* value) : _key(key), _value(value) {}
+    /** Allows converting an iterator to a const_iterator. */
+    template <typename Other>
+    Iterator(const Iterator<Other>& other)
+        : _key(other._key), _value(other._value) {}
+
+    Reference operator*() const { return Reference{*_key, *_value}; }
+    Reference operator->() const { return **this; }
+
+    Iterator& operator++() {
+      ++_key;
+      ++_value;
+      return *this;
+    }
+    Iterator& operator--() {
+      --_key;
+      --_value;
+      return *this;
+    }
+    bool operator==(const Iterator& rhs) const { return _key == rhs._key; }
+    bool operator!=(const Iterator& rhs) const { return _key != rhs._key; }
+
+   private:
+    template <typename Other>
+    friend class Iterator;
+
+    const double* _key = nullptr;
+    Value* _value = nullptr;
+  };
+
+  using iterator = Iterator<DefaultStatistics>;
+  using const_iterator = Iterator<const DefaultStatistics>;
+
+  size_t size() const { return _keys.size(); }
+  bool empty() const { return _keys.empty(); }
+  void clear() {
+    _keys.clear();
+    _values.clear();
+  }
+
+  iterator begin() { return iterator(_keys.data(), _values.data()); }
+  iterator end() {
+    return iterator(_keys.data() + _keys.size(),
+                    _values.data() + _values.size());
+  }
+  const_iterator begin() const {
+    return const_iterator(_keys.data(), _values.data());
+  }
+  const_iterator end() const {
+    return const_iterator(_keys.data() + _keys.size(),
+                          _values.data() + _values.size());
+  }
+
+  /** The sorted keys. */
+  const std::vector<double>& Keys() const { return _keys; }
+  /** The statistics, in the order of Keys(). */
+  const std::vector<DefaultStatistics>& Values() const { return _values; }
+
+  iterator lower_bound(double key) { return atIndex(lowerIndex(key)); }
+  const_iterator lower_bound(double key) const {
+    return atIndex(lowerIndex(key));
+  }
+
+  iterator find(double key) { return atIndex(findIndex(key)); }
+  const_iterator find(double key) const { return atIndex(findIndex(key)); }
+
+  DefaultStatistics& at(double key) {
+    return _values[checkedIndex(findIndex(key))];
+  }
+  const DefaultStatistics& at(double key) const {
+    return _values[checkedIndex(findIndex(key))];
+  }
+
+  /**
+   * Adds a statistic constructed from @p args if @p key does not exist yet.
+   * Like std::map::try_emplace(), returns an iterator to the statistic of
+   * the key and whether it was added.
+   */
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(double key, Args&&... args) {
+    const size_t index = lowerIndex(key);
+    if (index != _keys.size() && _keys[index] == key)
+      return std::make_pair(atIndex(index), false);
+    _keys.insert(_keys.begin() + index, key);
+    _values.emplace(_values.begin() + index, std::forward<Args>(args)...);
+    return std::make_pair(atIndex(index), true);
+  }
+
+ private:
+  size_t lowerIndex(double key) const {
+    // Keys are mostly added in order, so check the end first
+    if (_keys.empty() || _keys.back() < key) return _keys.size();
+    return std::lower_bound(_keys.begin(), _keys.end(), key) - _keys.begin();
+  }
+
+  size_t findIndex(double key) const {
+    const size_t index = lowerIndex(key);
+    if (index != _keys.size() && _keys[index] == key)
+      return index;
+    else
+      return _keys.size();
+  }
+
+  size_t checkedIndex(size_t index) const {
+    if (index == _keys.size())
+      throw std::out_of_range("DoubleStatMap::at(): key not found");
+    return index;
+  }
+
+  iterator atIndex(size_t index) {
+    return iterator(_keys.data() + index, _values.data() + index);
+  }
+  const_iterator atIndex(size_t index) const {
+    return const_iterator(_keys.data() + index, _values.data() + index);
+  }
+
+  std::vector<double> _keys;
+  std::vector<DefaultStatistics> _values;
+};
+
+#endif
@@ -92,7 +92,7 @@ void CollectStatistics(const std::string& filename,
                        Collector::CollectingMode mode, size_t flaggedTimesteps,
                        std::set<size_t>&& flaggedAntennae,
                        const char* dataColumnName, size_t intervalStart,
-                       size_t intervalEnd) {
+                       size_t intervalEnd, bool compensatedSummation) {
   StatisticsCollection statisticsCollection;
   HistogramCollection histogramCollection;
 
@@ -102,6 +102,7 @@ void CollectStatistics(const std::string& filename,
   collector.SetMode(mode);
   collector.SetFlaggedAntennae(std::move(flaggedAntennae));
   collector.SetFlaggedTimesteps(flaggedTimesteps);
+  collector.SetCompensatedSummation(compensatedSummation);
   StdOutReporter reporter;
   collector.Collect(filename, statisticsCollection, histogramCollection,
                     reporter);
@@ -246,7 +247,7 @@ void PrintPerFrequencyStatistics(const std::string& kindName,
   quality::FileContents contents = quality::ReadAndCombine(filenames, false);
   if (downsample)
     contents.statistics_collection.LowerFrequencyResolution(*downsample);
-  const std::map<double, DefaultStatistics>& freqStats =
+  const DoubleStatMap& freqStats =
       contents.statistics_collection.FrequencyStatistics();
   const StatisticsDerivator derivator(contents.statistics_collection);
 
@@ -257,12 +258,13 @@ void PrintPerFrequencyStatistics(const std::string& kindName,
     std::cout << '\t' << kindName << "_POL" << p << "_R\t" << kindName << "_POL"
               << p << "_I";
   std::cout << '\n';
-  for (const std::pair<const double, DefaultStatistics>& freqStat : freqStats) {
-    const double frequency = freqStat.first;
+  for (DoubleStatMap::const_iterator i = freqStats.begin();
+       i != freqStats.end(); ++i) {
+    const double frequency = i->first;
     std::cout << frequency * 1e-6;
     for (unsigned p = 0; p < n_polarizations; ++p) {
       const std::complex<long double> val =
-          derivator.GetComplexStatistic(kind, freqStat.second, p);
+          derivator.GetComplexStatistic(kind, i->second, p);
       std::cout << '\t' << val.real() << '\t' << val.imag();
     }
     std::cout << '\n';
@@ -276,7 +278,7 @@ void PrintPerTimeStatistics(const std::string& kindName,
 
   quality::FileContents contents = quality::ReadAndCombine(filenames, false);
   contents.statistics_collection.IntegrateTimeToOneChannel();
-  const std::map<double, DefaultStatistics>& timeStats =
+  const DoubleStatMap& timeStats =
       contents.statistics_collection.TimeStatistics();
   const StatisticsDerivator derivator(contents.statistics_collection);
 
@@ -287,8 +289,7 @@ void PrintPerTimeStatistics(const std::string& kindName,
     std::cout << '\t' << kindName << "_POL" << p << "_R\t" << kindName << "_POL"
               << p << "_I";
   std::cout << '\n';
-  for (std::map<double, DefaultStatistics>::const_iterator i =
-           timeStats.begin();
+  for (DoubleStatMap::const_iterator i = timeStats.begin();
        i != timeStats.end(); ++i) {
     const double time = i->first;
     std::cout << time;
@@ -374,9 +375,9 @@ void PrintRfiSummary(const std::vector<std::string>& filenames) {
   const DefaultStatistics singlePolStat = statistics.ToSinglePolarization();
 
   double startTime =
-             contents.statistics_collection.TimeStatistics().begin()->first,
+             contents.statistics_collection.TimeStatistics().Keys().front(),
          endTime =
-             contents.statistics_collection.TimeStatistics().rbegin()->first,
+             contents.statistics_collection.TimeStatistics().Keys().back(),
          startFreq = band.channels.begin()->frequencyHz,
          endFreq = band.channels.rbegin()->frequencyHz;
   std::cout.precision(16);
@@ -484,26 +485,16 @@ void CombineStatistics(const std::string& result_filename,
               << result_filename << '\n';
 
     std::vector<AntennaInfo> antennae;
-    StatisticsCollection statisticsCollection;
-    const HistogramCollection histogramCollection;
     std::cout << "Reading antenna table...\n";
     const MSMetaData msMeta(firstInFilename);
     antennae.resize(msMeta.AntennaCount());
     for (size_t i = 0; i != msMeta.AntennaCount(); ++i)
       antennae[i] = msMeta.GetAntennaInfo(i);
 
-    for (std::vector<std::string>::const_iterator i = input_filenames.begin();
-         i != input_filenames.end(); ++i) {
-      std::cout << "Reading " << *i << "...\n";
-      // TODO read quality tables from all inFilenames
-      QualityTablesFormatter formatter(*i);
-      StatisticsCollection collectionPart;
-      collectionPart.Load(formatter);
-      if (i == input_filenames.begin())
-        statisticsCollection.SetPolarizationCount(
-            collectionPart.PolarizationCount());
-      statisticsCollection.Add(collectionPart);
-    }
+    std::cout << "Reading quality tables...\n";
+    quality::FileContents contents =
+        quality::ReadAndCombine(input_filenames, true);
+    StatisticsCollection& statisticsCollection = contents.statistics_collection;
     // Create main table
     casacore::TableDesc tableDesc = casacore::MS::requiredTableDesc();
     const casacore::ArrayColumnDesc<std::complex<float>> dataColumnDesc =
@@ -525,6 +516,12 @@ void CombineStatistics(const std::string& result_filename,
     std::cout << "Writing quality table...\n";
     QualityTablesFormatter formatter(result_filename);
     statisticsCollection.Save(formatter);
+
+    if (!contents.histogram_collection.Empty()) {
+      std::cout << "Writing histogram tables...\n";
+      HistogramTablesFormatter histograms(result_filename);
+      contents.histogram_collection.Save(histograms);
+    }
   }
 }
 
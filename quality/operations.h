@@ -15,7 +15,7 @@ void CollectStatistics(const std::string& filename,
                        Collector::CollectingMode mode, size_t flaggedTimesteps,
                        std::set<size_t>&& flaggedAntennae,
                        const char* dataColumnName, size_t intervalStart,
-                       size_t intervalEnd);
+                       size_t intervalEnd, bool compensatedSummation);
 
 void CollectHistograms(const std::string& filename,
                        HistogramCollection& histogramCollection,
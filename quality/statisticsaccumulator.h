@@ -0,0 +1,97 @@
+#ifndef QUALITY__STATISTICS_ACCUMULATOR_H
+#define QUALITY__STATISTICS_ACCUMULATOR_H
+
+#include <cmath>
+#include <complex>
+
+#include "defaultstatistics.h"
+
+/**
+ * Sum in long double precision. This is the precision of the values that
+ * are stored in DefaultStatistics.
+ */
+class LongDoubleSum {
+ public:
+  typedef long double ValueType;
+
+  void Add(long double value) { _sum += value; }
+  long double Value() const { return _sum; }
+
+ private:
+  long double _sum = 0.0;
+};
+
+/**
+ * Sum in double precision with Neumaier's compensated summation. The
+ * rounding error of every addition is accumulated separately, which makes
+ * the result about as accurate as a long double sum, while avoiding the slow
+ * x87 arithmetic that long double requires.
+ */
+class CompensatedSum {
+ public:
+  typedef double ValueType;
+
+  void Add(double value) {
+    const double t = _sum + value;
+    if (std::fabs(_sum) >= std::fabs(value))
+      _compensation += (_sum - t) + value;
+    else
+      _compensation += (value - t) + _sum;
+    _sum = t;
+  }
+  long double Value() const {
+    return static_cast<long double>(_sum) + _compensation;
+  }
+
+ private:
+  double _sum = 0.0;
+  double _compensation = 0.0;
+};
+
+/**
+ * Accumulates the statistics of one polarization in local variables, such
+ * that they can be added to a DefaultStatistics once for many samples.
+ * @tparam Sum LongDoubleSum or CompensatedSum.
+ */
+template <typename Sum>
+struct StatisticsAccumulator {
+  typedef typename Sum::ValueType ValueType;
+
+  unsigned long rfiCount = 0;
+  unsigned long count = 0;
+  unsigned long dCount = 0;
+  Sum sumR, sumI, sumP2R, sumP2I;
+  Sum dSumR, dSumI, dSumP2R, dSumP2I;
+
+  void AddSample(ValueType real, ValueType imag) {
+    ++count;
+    sumR.Add(real);
+    sumI.Add(imag);
+    sumP2R.Add(real * real);
+    sumP2I.Add(imag * imag);
+  }
+
+  void AddDifference(ValueType real, ValueType imag) {
+    ++dCount;
+    dSumR.Add(real);
+    dSumI.Add(imag);
+    dSumP2R.Add(real * real);
+    dSumP2I.Add(imag * imag);
+  }
+
+  void AddTo(DefaultStatistics& statistic, unsigned polarization) const {
+    statistic.rfiCount[polarization] += rfiCount;
+    statistic.count[polarization] += count;
+    statistic.sum[polarization] +=
+        std::complex<long double>(sumR.Value(), sumI.Value());
+    statistic.sumP2[polarization] +=
+        std::complex<long double>(sumP2R.Value(), sumP2I.Value());
+    statistic.dCount[polarization] += dCount;
+    statistic.dSum[polarization] +=
+        std::complex<long double>(dSumR.Value(), dSumI.Value());
+    statistic.dSumP2[polarization] +=
+        std::complex<long double>(dSumP2R.Value(), dSumP2I.Value());
+  }
+};
+
+#endif
@@ -1,28 +1,22 @@
 #include "statisticscollection.h"
 
-template <bool IsDiff>
+template <bool IsDiff, typename Sum>
 void StatisticsCollection::addTimeAndBaseline(
     unsigned antenna1, unsigned antenna2, double time, double centralFrequency,
     int polarization, const float* reals, const float* imags, const bool* isRFI,
     const bool* origFlags, unsigned nsamples, unsigned step, unsigned stepRFI,
     unsigned stepFlags) {
-  unsigned long rfiCount = 0;
-  unsigned long count = 0;
-  long double sum_R = 0.0, sum_I = 0.0;
-  long double sumP2_R = 0.0, sumP2_I = 0.0;
+  StatisticsAccumulator<Sum> accumulator;
   for (unsigned j = 0; j < nsamples; ++j) {
     if (!*origFlags) {
       if (std::isfinite(*reals) && std::isfinite(*imags)) {
         if (*isRFI) {
-          ++rfiCount;
+          // RFI is not counted for the differences
+          if (!IsDiff) ++accumulator.rfiCount;
+        } else if (IsDiff) {
+          accumulator.AddDifference(*reals, *imags);
         } else {
-          const long double rVal = *reals;
-          const long double iVal = *imags;
-          ++count;
-          sum_R += rVal;
-          sum_I += iVal;
-          sumP2_R += rVal * rVal;
-          sumP2_I += iVal * iVal;
+          accumulator.AddSample(*reals, *imags);
         }
       }
     }
@@ -34,13 +28,11 @@ void StatisticsCollection::addTimeAndBaseline(
 
   if (antenna1 != antenna2) {
     DefaultStatistics& timeStat = getTimeStatistic(time, centralFrequency);
-    addToStatistic<IsDiff>(timeStat, polarization, count, sum_R, sum_I, sumP2_R,
-                           sumP2_I, rfiCount);
+    accumulator.AddTo(timeStat, polarization);
   }
   DefaultStatistics& baselineStat =
       getBaselineStatistic(antenna1, antenna2, centralFrequency);
-  addToStatistic<IsDiff>(baselineStat, polarization, count, sum_R, sum_I,
-                         sumP2_R, sumP2_I, rfiCount);
+  accumulator.AddTo(baselineStat, polarization);
 }
 
 template <bool IsDiff>
@@ -48,7 +40,7 @@ void StatisticsCollection::addFrequency(
     unsigned band, int polarization, const float* reals, const float* imags,
     const bool* isRFI, const bool* origFlags, unsigned nsamples, unsigned step,
     unsigned stepRFI, unsigned stepFlags, bool shiftOneUp) {
-  std::vector<DefaultStatistics*>& bandStats = _bands.find(band)->second;
+  std::vector<DefaultStatistics*>& bandStats = bandStatistics(band);
   const unsigned fAdd = shiftOneUp ? 1 : 0;
   for (unsigned j = 0; j < nsamples; ++j) {
     if (!*origFlags) {
@@ -79,11 +71,28 @@ void StatisticsCollection::Add(unsigned antenna1, unsigned antenna2,
                                unsigned stepRFI, unsigned stepFlags) {
   if (nsamples == 0) return;
 
+  if (_compensatedSummation)
+    add<CompensatedSum>(antenna1, antenna2, time, band, polarization, reals,
+                        imags, isRFI, origFlags, nsamples, step, stepRFI,
+                        stepFlags);
+  else
+    add<LongDoubleSum>(antenna1, antenna2, time, band, polarization, reals,
+                       imags, isRFI, origFlags, nsamples, step, stepRFI,
+                       stepFlags);
+}
+
+template <typename Sum>
+void StatisticsCollection::add(unsigned antenna1, unsigned antenna2,
+                               double time, unsigned band, int polarization,
+                               const float* reals, const float* imags,
+                               const bool* isRFI, const bool* origFlags,
+                               unsigned nsamples, unsigned step,
+                               unsigned stepRFI, unsigned stepFlags) {
   const double centralFrequency = _centralFrequencies.find(band)->second;
 
-  addTimeAndBaseline<false>(antenna1, antenna2, time, centralFrequency,
-                            polarization, reals, imags, isRFI, origFlags,
-                            nsamples, step, stepRFI, stepFlags);
+  addTimeAndBaseline<false, Sum>(antenna1, antenna2, time, centralFrequency,
+                                 polarization, reals, imags, isRFI, origFlags,
+                                 nsamples, step, stepRFI, stepFlags);
   if (antenna1 != antenna2)
     addFrequency<false>(band, polarization, reals, imags, isRFI, origFlags,
                         nsamples, step, stepRFI, stepFlags, false);
@@ -101,9 +110,10 @@ void StatisticsCollection::Add(unsigned antenna1, unsigned antenna2,
     diffOrigFlags[i] =
         origFlags[i * stepFlags] | origFlags[(i + 1) * stepFlags];
   }
-  addTimeAndBaseline<true>(antenna1, antenna2, time, centralFrequency,
-                           polarization, &(diffReals[0]), &(diffImags[0]),
-                           diffRFIFlags, diffOrigFlags, nsamples - 1, 1, 1, 1);
+  addTimeAndBaseline<true, Sum>(antenna1, antenna2, time, centralFrequency,
+                                polarization, &(diffReals[0]), &(diffImags[0]),
+                                diffRFIFlags, diffOrigFlags, nsamples - 1, 1, 1,
+                                1);
   if (antenna1 != antenna2) {
     addFrequency<true>(band, polarization, &(diffReals[0]), &(diffImags[0]),
                        diffRFIFlags, diffOrigFlags, nsamples - 1, 1, 1, 1,
@@ -158,73 +168,76 @@ void StatisticsCollection::AddImage(unsigned antenna1, unsigned antenna2,
                                     const Image2DCPtr& realImage,
                                     const Image2DCPtr& imagImage,
                                     const Mask2DCPtr& rfiMask,
-                                    const Mask2DCPtr& correlatorMask) {
-  if (realImage->Width() == 0 || realImage->Height() == 0) return;
+                                    const Mask2DCPtr& correlatorMask,
+                                    size_t channelStart, size_t channelCount) {
+  if (realImage->Width() == 0 || channelCount == 0) return;
+
+  if (_compensatedSummation)
+    addImage<CompensatedSum>(antenna1, antenna2, times, band, polarization,
+                             realImage, imagImage, rfiMask, correlatorMask,
+                             channelStart, channelCount);
+  else
+    addImage<LongDoubleSum>(antenna1, antenna2, times, band, polarization,
+                            realImage, imagImage, rfiMask, correlatorMask,
+                            channelStart, channelCount);
+}
 
+template <typename Sum>
+void StatisticsCollection::addImage(unsigned antenna1, unsigned antenna2,
+                                    const double* times, unsigned band,
+                                    int polarization,
+                                    const Image2DCPtr& realImage,
+                                    const Image2DCPtr& imagImage,
+                                    const Mask2DCPtr& rfiMask,
+                                    const Mask2DCPtr& correlatorMask,
+                                    size_t channelStart, size_t channelCount) {
+  typedef typename StatisticsAccumulator<Sum>::ValueType ValueType;
+  const size_t width = realImage->Width();
+  const size_t height = channelCount;
   const double centralFrequency = _centralFrequencies.find(band)->second;
   DefaultStatistics& baselineStat =
       getBaselineStatistic(antenna1, antenna2, centralFrequency);
-  std::vector<DefaultStatistics*>& bandStats = _bands.find(band)->second;
-  std::vector<DefaultStatistics*> timeStats(realImage->Width());
-
-  for (size_t t = 0; t != realImage->Width(); ++t)
-    timeStats[t] = &getTimeStatistic(times[t], centralFrequency);
-
-  for (size_t f = 0; f < realImage->Height(); ++f) {
-    DefaultStatistics& freqStat = *bandStats[f];
-    const bool *origFlags = correlatorMask->ValuePtr(0, f),
+  std::vector<DefaultStatistics*>& bandStats = bandStatistics(band);
+
+  // The image is accumulated in dense, local arrays, which are added to the
+  // stored statistics at the end.
+  StatisticsAccumulator<Sum> baselineAccumulator;
+  std::vector<StatisticsAccumulator<Sum>> timeAccumulators(width);
+  std::vector<StatisticsAccumulator<Sum>> frequencyAccumulators(height);
+
+  for (size_t f = 0; f < height; ++f) {
+    StatisticsAccumulator<Sum>& freqAccumulator = frequencyAccumulators[f];
+    const size_t y = channelStart + f;
+    const bool *origFlags = correlatorMask->ValuePtr(0, y),
                *nextOrigFlags = origFlags + correlatorMask->Stride(),
-               *isRFI = rfiMask->ValuePtr(0, f),
+               *isRFI = rfiMask->ValuePtr(0, y),
                *isNextRFI = isRFI + rfiMask->Stride();
-    const float *reals = realImage->ValuePtr(0, f),
-                *imags = imagImage->ValuePtr(0, f),
+    const float *reals = realImage->ValuePtr(0, y),
+                *imags = imagImage->ValuePtr(0, y),
                 *nextReal = reals + realImage->Stride(),
                 *nextImag = imags + imagImage->Stride();
-    for (size_t t = 0; t < realImage->Width(); ++t) {
+    for (size_t t = 0; t < width; ++t) {
       if (!*origFlags && std::isfinite(*reals) && std::isfinite(*imags)) {
-        long double real = *reals, imag = *imags;
-
+        StatisticsAccumulator<Sum>& timeAccumulator = timeAccumulators[t];
         if (*isRFI) {
-          if (antenna1 != antenna2) {
-            ++timeStats[t]->rfiCount[polarization];
-            ++freqStat.rfiCount[polarization];
-          }
-          ++baselineStat.rfiCount[polarization];
+          ++timeAccumulator.rfiCount;
+          ++freqAccumulator.rfiCount;
+          ++baselineAccumulator.rfiCount;
         } else {
-          long double realSq = real * real, imagSq = imag * imag;
-
-          if (antenna1 != antenna2) {
-            addSingleNonRFISampleToStatistic<false>(*timeStats[t], polarization,
-                                                    real, imag, realSq, imagSq);
-            addSingleNonRFISampleToStatistic<false>(freqStat, polarization,
-                                                    real, imag, realSq, imagSq);
-          }
-          addSingleNonRFISampleToStatistic<false>(baselineStat, polarization,
-                                                  real, imag, realSq, imagSq);
+          timeAccumulator.AddSample(*reals, *imags);
+          freqAccumulator.AddSample(*reals, *imags);
+          baselineAccumulator.AddSample(*reals, *imags);
         }
 
-        if (f != realImage->Height() - 1) {
-          DefaultStatistics& nextFreqStat = *bandStats[f + 1];
+        if (f != height - 1) {
           if (!*nextOrigFlags && std::isfinite(*nextReal) &&
-              std::isfinite(*nextImag)) {
-            real = (*nextReal - *reals) * M_SQRT1_2;
-            imag = (*nextImag - *imags) * M_SQRT1_2;
-
-            if (!(*isRFI || *isNextRFI)) {
-              long double realSq = real * real, imagSq = imag * imag;
-
-              if (antenna1 != antenna2) {
-                addSingleNonRFISampleToStatistic<true>(
-                    *timeStats[t], polarization, real, imag, realSq, imagSq);
-                addSingleNonRFISampleToStatistic<true>(
-                    freqStat, polarization, real, imag, realSq, imagSq);
-                addSingleNonRFISampleToStatistic<true>(
-                    nextFreqStat, polarization, real, imag, realSq, imagSq);
-              }
-
-              addSingleNonRFISampleToStatistic<true>(
-                  baselineStat, polarization, real, imag, realSq, imagSq);
-            }
+              std::isfinite(*nextImag) && !(*isRFI || *isNextRFI)) {
+            const ValueType real = (*nextReal - *reals) * M_SQRT1_2;
+            const ValueType imag = (*nextImag - *imags) * M_SQRT1_2;
+            timeAccumulator.AddDifference(real, imag);
+            freqAccumulator.AddDifference(real, imag);
+            frequencyAccumulators[f + 1].AddDifference(real, imag);
+            baselineAccumulator.AddDifference(real, imag);
           }
         }
       }
@@ -240,22 +253,34 @@ void StatisticsCollection::AddImage(unsigned antenna1, unsigned antenna2,
       ++nextImag;
     }
   }
+
+  // Auto-correlations are only added to the baseline statistics
+  if (antenna1 != antenna2) {
+    // Adding a time step moves the other time statistics, so each is looked
+    // up right before it is used.
+    for (size_t t = 0; t != width; ++t)
+      timeAccumulators[t].AddTo(getTimeStatistic(times[t], centralFrequency),
+                                polarization);
+    for (size_t f = 0; f != height; ++f)
+      frequencyAccumulators[f].AddTo(*bandStats[f], polarization);
+  }
+  baselineAccumulator.AddTo(baselineStat, polarization);
 }
 
-void StatisticsCollection::lowerResolution(
-    StatisticsCollection::DoubleStatMap& map, size_t maxSteps) const {
+void StatisticsCollection::lowerResolution(DoubleStatMap& map,
+                                           size_t maxSteps) const {
   if (map.size() > maxSteps) {
     DoubleStatMap newMap;
     double gridStep, gridStart;
     if (maxSteps > 1) {
       const double oldGridStep =
-          (map.rbegin()->first - map.begin()->first) / (map.size() - 1);
+          (map.Keys().back() - map.Keys().front()) / (map.size() - 1);
       gridStep =
-          (map.rbegin()->first - map.begin()->first + oldGridStep) / maxSteps;
-      gridStart = map.begin()->first - 0.5 * oldGridStep;
+          (map.Keys().back() - map.Keys().front() + oldGridStep) / maxSteps;
+      gridStart = map.Keys().front() - 0.5 * oldGridStep;
     } else {
-      gridStep = map.rbegin()->first - map.begin()->first;
-      gridStart = map.begin()->first;
+      gridStep = map.Keys().back() - map.Keys().front();
+      gridStart = map.Keys().front();
     }
     size_t gridIndex = 0;
     for (DoubleStatMap::iterator i = map.begin(); i != map.end();) {
@@ -278,11 +303,9 @@ void StatisticsCollection::lowerResolution(
           ++i;
         }
       }
-      if (count > 0)
-        newMap.insert(
-            std::pair<double, DefaultStatistics>(cellMid, integratedStat));
+      if (count > 0) newMap.try_emplace(cellMid, std::move(integratedStat));
     }
-    map = newMap;
+    map = std::move(newMap);
   }
 }
 
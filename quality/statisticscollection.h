@@ -10,29 +10,35 @@
 
 #include "baselinestatisticsmap.h"
 #include "defaultstatistics.h"
+#include "doublestatmap.h"
 #include "qualitytablesformatter.h"
 #include "statisticalvalue.h"
+#include "statisticsaccumulator.h"
+
+#include <map>
+#include <vector>
 
 #include <boost/concept_check.hpp>
 
 class StatisticsCollection : public Serializable {
- private:
-  typedef std::map<double, DefaultStatistics> DoubleStatMap;
-
  public:
   StatisticsCollection()
-      : _polarizationCount(0), _emptyBaselineStatisticsMap(0) {}
+      : _polarizationCount(0),
+        _emptyBaselineStatisticsMap(0),
+        _compensatedSummation(false) {}
 
   explicit StatisticsCollection(unsigned polarizationCount)
       : _polarizationCount(polarizationCount),
-        _emptyBaselineStatisticsMap(polarizationCount) {}
+        _emptyBaselineStatisticsMap(polarizationCount),
+        _compensatedSummation(false) {}
 
   StatisticsCollection(const StatisticsCollection& source)
       : _timeStatistics(source._timeStatistics),
         _frequencyStatistics(source._frequencyStatistics),
         _baselineStatistics(source._baselineStatistics),
         _polarizationCount(source._polarizationCount),
-        _emptyBaselineStatisticsMap(source._polarizationCount) {}
+        _emptyBaselineStatisticsMap(source._polarizationCount),
+        _compensatedSummation(source._compensatedSummation) {}
 
   StatisticsCollection& operator=(const StatisticsCollection& source) {
     _timeStatistics = source._timeStatistics;
@@ -40,6 +46,8 @@ class StatisticsCollection : public Serializable {
     _baselineStatistics = source._baselineStatistics;
     _polarizationCount = source._polarizationCount;
     _emptyBaselineStatisticsMap = source._emptyBaselineStatisticsMap;
+    _compensatedSummation = source._compensatedSummation;
+    resetLookupCache();
     return *this;
   }
 
@@ -47,19 +55,29 @@ class StatisticsCollection : public Serializable {
     _timeStatistics.clear();
     _frequencyStatistics.clear();
     _baselineStatistics.clear();
+    resetLookupCache();
+  }
+
+  /**
+   * When enabled, the sums of the data that is added with Add() and
+   * AddImage() are accumulated in double precision with compensated
+   * summation, instead of in long double precision. This is considerably
+   * faster, and almost as accurate. The stored statistics are always long
+   * double values, and the file formats do not change. Disabled by default.
+   */
+  void SetCompensatedSummation(bool compensatedSummation) {
+    _compensatedSummation = compensatedSummation;
   }
+  bool CompensatedSummation() const { return _compensatedSummation; }
 
   bool HasBand(unsigned band) const {
-    return _bands.find(band) != _bands.end();
+    return _bandFrequencies.find(band) != _bandFrequencies.end();
   }
 
   void InitializeBand(unsigned band, const double* frequencies,
                       unsigned channelCount) {
-    std::vector<DefaultStatistics*> pointers;
-    for (unsigned i = 0; i < channelCount; ++i) {
-      pointers.emplace_back(&getFrequencyStatistic(frequencies[i]));
-    }
-    _bands.emplace(band, pointers);
+    for (unsigned i = 0; i < channelCount; ++i)
+      getFrequencyStatistic(frequencies[i]);
     double centralFrequency =
         (frequencies[0] + frequencies[channelCount - 1]) / 2.0;
     _centralFrequencies.emplace(band, centralFrequency);
@@ -93,7 +111,48 @@ class StatisticsCollection : public Serializable {
   void AddImage(unsigned antenna1, unsigned antenna2, const double* times,
                 unsigned band, int polarization, const Image2DCPtr& realImage,
                 const Image2DCPtr& imagImage, const Mask2DCPtr& rfiMask,
-                const Mask2DCPtr& correlatorMask);
+                const Mask2DCPtr& correlatorMask) {
+    AddImage(antenna1, antenna2, times, band, polarization, realImage,
+             imagImage, rfiMask, correlatorMask, 0, realImage->Height());
+  }
+
+  /**
+   * Like AddImage(), but only adds the rows (channels) @p channelStart to
+   * @p channelStart + @p channelCount of the images to @p band. This allows
+   * adding the channels of spectrally concatenated bands to separate bands.
+   */
+  void AddImage(unsigned antenna1, unsigned antenna2, const double* times,
+                unsigned band, int polarization, const Image2DCPtr& realImage,
+                const Image2DCPtr& imagImage, const Mask2DCPtr& rfiMask,
+                const Mask2DCPtr& correlatorMask, size_t channelStart,
+                size_t channelCount);
+
+  /**
+   * Returns a collection with the statistics of a single band, i.e. the
+   * statistics that were added to the band that was initialized with the
+   * same frequencies by InitializeBand().
+   */
+  StatisticsCollection ExtractBand(const double* frequencies,
+                                   unsigned channelCount) const {
+    StatisticsCollection result(_polarizationCount);
+    const double centralFrequency =
+        (frequencies[0] + frequencies[channelCount - 1]) / 2.0;
+    const std::map<double, DoubleStatMap>::const_iterator time =
+        _timeStatistics.find(centralFrequency);
+    if (time != _timeStatistics.end()) result._timeStatistics.insert(*time);
+    const std::map<double, BaselineStatisticsMap>::const_iterator baseline =
+        _baselineStatistics.find(centralFrequency);
+    if (baseline != _baselineStatistics.end())
+      result._baselineStatistics.insert(*baseline);
+    for (unsigned i = 0; i != channelCount; ++i) {
+      const DoubleStatMap::const_iterator frequency =
+          _frequencyStatistics.find(frequencies[i]);
+      if (frequency != _frequencyStatistics.end())
+        result._frequencyStatistics.try_emplace(frequency->first,
+                                                frequency->second);
+    }
+    return result;
+  }
 
   void Save(QualityTablesFormatter& qualityData) const {
     saveTime(qualityData);
@@ -157,7 +216,7 @@ class StatisticsCollection : public Serializable {
           "collection with multiple bands");
   }
 
-  const std::map<double, DefaultStatistics>& TimeStatistics() const {
+  const DoubleStatMap& TimeStatistics() const {
     if (_timeStatistics.size() == 1)
       return _timeStatistics.begin()->second;
     else
@@ -166,12 +225,11 @@ class StatisticsCollection : public Serializable {
           "collection with multiple bands");
   }
 
-  const std::map<double, std::map<double, DefaultStatistics>>&
-  AllTimeStatistics() const {
+  const std::map<double, DoubleStatMap>& AllTimeStatistics() const {
     return _timeStatistics;
   }
 
-  const std::map<double, DefaultStatistics>& FrequencyStatistics() const {
+  const DoubleStatMap& FrequencyStatistics() const {
     return _frequencyStatistics;
   }
 
@@ -200,6 +258,7 @@ class StatisticsCollection : public Serializable {
       _timeStatistics.clear();
       _frequencyStatistics.clear();
       _baselineStatistics.clear();
+      resetLookupCache();
     }
   }
 
@@ -234,6 +293,7 @@ class StatisticsCollection : public Serializable {
       _baselineStatistics.clear();
       _baselineStatistics.insert(std::pair<double, BaselineStatisticsMap>(
           frequencySum / size, fullMap));
+      resetLookupCache();
     }
   }
 
@@ -253,6 +313,7 @@ class StatisticsCollection : public Serializable {
       _timeStatistics.clear();
       _timeStatistics.insert(
           std::pair<double, DoubleStatMap>(frequencySum / size, fullMap));
+      resetLookupCache();
     }
   }
 
@@ -261,10 +322,12 @@ class StatisticsCollection : public Serializable {
          i != _timeStatistics.end(); ++i) {
       lowerResolution(i->second, maxSteps);
     }
+    resetLookupCache();
   }
 
   void LowerFrequencyResolution(size_t maxSteps) {
     lowerResolution(_frequencyStatistics, maxSteps);
+    resetLookupCache();
   }
 
   /**
@@ -283,6 +346,7 @@ class StatisticsCollection : public Serializable {
         regrid(referenceMap, i->second);
         ++i;
       } while (i != _timeStatistics.end());
+      resetLookupCache();
     }
   }
 
@@ -341,7 +405,20 @@ class StatisticsCollection : public Serializable {
     }
   };
 
-  template <bool IsDiff>
+  template <typename Sum>
+  void add(unsigned antenna1, unsigned antenna2, double time, unsigned band,
+           int polarization, const float* reals, const float* imags,
+           const bool* isRFI, const bool* origFlags, unsigned nsamples,
+           unsigned step, unsigned stepRFI, unsigned stepFlags);
+
+  template <typename Sum>
+  void addImage(unsigned antenna1, unsigned antenna2, const double* times,
+                unsigned band, int polarization, const Image2DCPtr& realImage,
+                const Image2DCPtr& imagImage, const Mask2DCPtr& rfiMask,
+                const Mask2DCPtr& correlatorMask, size_t channelStart,
+                size_t channelCount);
+
+  template <bool IsDiff, typename Sum>
   void addTimeAndBaseline(unsigned antenna1, unsigned antenna2, double time,
                           double centralFrequency, int polarization,
                           const float* reals, const float* imags,
@@ -460,6 +537,13 @@ class StatisticsCollection : public Serializable {
   void saveBaseline(QualityTablesFormatter& qd) const;
 
   DefaultStatistics& getTimeStatistic(double time, double centralFrequency) {
+    // Consecutive requests are mostly for the same time step, e.g. for all
+    // baselines and polarizations of a time step, so the last one is
+    // remembered.
+    if (_lastTimeStatistic && _lastTime == time &&
+        _lastTimeFrequency == centralFrequency)
+      return *_lastTimeStatistic;
+
     // We use find() to see if the value exists, and only use insert() when it
     // does not, because insert is slow (because a "Statistic" needs to be
     // created). Holds for both frequency and time maps.
@@ -473,37 +557,78 @@ class StatisticsCollection : public Serializable {
     }
     DoubleStatMap& selectedTimeStatistic = i->second;
 
-    return getDoubleStatMapStatistic(selectedTimeStatistic, time);
+    _lastTimeStatistic =
+        &getDoubleStatMapStatistic(selectedTimeStatistic, time);
+    _lastTime = time;
+    _lastTimeFrequency = centralFrequency;
+    return *_lastTimeStatistic;
   }
 
   DefaultStatistics& getFrequencyStatistic(double frequency) {
-    return getDoubleStatMapStatistic(_frequencyStatistics, frequency);
+    const std::pair<DoubleStatMap::iterator, bool> result =
+        _frequencyStatistics.try_emplace(frequency, _polarizationCount);
+    // A new frequency moves the statistics that bandStatistics() points to
+    if (result.second) _bands.clear();
+    return result.first->second;
   }
 
-  DefaultStatistics& getDoubleStatMapStatistic(DoubleStatMap& map, double key) {
-    // Use insert() only when not exist, as it is slower then find because a
-    // Statistic is created.
-    DoubleStatMap::iterator i = map.find(key);
-    if (i == map.end()) {
-      i = map.insert(std::pair<double, DefaultStatistics>(
-                         key, DefaultStatistics(_polarizationCount)))
-              .first;
+  /**
+   * Statistics of the channels of a band that was initialized with
+   * InitializeBand(). The pointers are looked up once, and stay valid until a
+   * frequency is added.
+   */
+  std::vector<DefaultStatistics*>& bandStatistics(unsigned band) {
+    std::map<unsigned, std::vector<DefaultStatistics*>>::iterator i =
+        _bands.find(band);
+    if (i == _bands.end()) {
+      const std::vector<double>& frequencies =
+          _bandFrequencies.find(band)->second;
+      // Missing frequencies are added before taking pointers, because adding
+      // a frequency moves the others.
+      for (const double frequency : frequencies)
+        getFrequencyStatistic(frequency);
+      std::vector<DefaultStatistics*> pointers;
+      pointers.reserve(frequencies.size());
+      for (const double frequency : frequencies)
+        pointers.emplace_back(&_frequencyStatistics.find(frequency)->second);
+      i = _bands.emplace(band, std::move(pointers)).first;
     }
     return i->second;
   }
 
+  DefaultStatistics& getDoubleStatMapStatistic(DoubleStatMap& map, double key) {
+    return map.try_emplace(key, _polarizationCount).first->second;
+  }
+
   DefaultStatistics& getBaselineStatistic(unsigned antenna1, unsigned antenna2,
                                           double centralFrequency) {
-    std::map<double, BaselineStatisticsMap>::iterator i =
-        _baselineStatistics.find(centralFrequency);
-    if (i == _baselineStatistics.end()) {
-      i = _baselineStatistics
-              .insert(std::pair<double, BaselineStatisticsMap>(
-                  centralFrequency, BaselineStatisticsMap(_polarizationCount)))
-              .first;
+    if (!_lastBaselineMap || _lastBaselineFrequency != centralFrequency) {
+      std::map<double, BaselineStatisticsMap>::iterator i =
+          _baselineStatistics.find(centralFrequency);
+      if (i == _baselineStatistics.end()) {
+        i = _baselineStatistics
+                .insert(std::pair<double, BaselineStatisticsMap>(
+                    centralFrequency,
+                    BaselineStatisticsMap(_polarizationCount)))
+                .first;
+      }
+      _lastBaselineMap = &i->second;
+      _lastBaselineFrequency = centralFrequency;
     }
-    BaselineStatisticsMap& selectedBaselineStatistic = i->second;
-    return selectedBaselineStatistic.GetStatistics(antenna1, antenna2);
+    return _lastBaselineMap->GetStatistics(antenna1, antenna2);
+  }
+
+  /**
+   * Forgets the statistics that getTimeStatistic(), getBaselineStatistic()
+   * and bandStatistics() remember. Must be called when the time, frequency or
+   * baseline maps are replaced or elements are removed from them.
+   * getTimeStatistic() and getFrequencyStatistic() take care of the elements
+   * that they add.
+   */
+  void resetLookupCache() {
+    _lastTimeStatistic = nullptr;
+    _lastBaselineMap = nullptr;
+    _bands.clear();
   }
 
   template <bool PerformAdd, typename T>
@@ -656,8 +781,8 @@ class StatisticsCollection : public Serializable {
   }
 
   double centralFrequency() const {
-    double min = _frequencyStatistics.begin()->first;
-    double max = _frequencyStatistics.rbegin()->first;
+    double min = _frequencyStatistics.Keys().front();
+    double max = _frequencyStatistics.Keys().back();
     return (min + max) / 2.0;
   }
 
@@ -738,6 +863,7 @@ class StatisticsCollection : public Serializable {
 
   void unserializeTime(std::istream& stream) {
     _timeStatistics.clear();
+    resetLookupCache();
     size_t count = (size_t)UnserializeUInt64(stream);
 
     std::map<double, DoubleStatMap>::iterator insertPos =
@@ -757,6 +883,7 @@ class StatisticsCollection : public Serializable {
 
   void unserializeFrequency(std::istream& stream) {
     _frequencyStatistics.clear();
+    resetLookupCache();
     unserializeDoubleStatMap(stream, _frequencyStatistics);
   }
 
@@ -776,6 +903,7 @@ class StatisticsCollection : public Serializable {
 
   void unserializeBaselines(std::istream& stream) {
     _baselineStatistics.clear();
+    resetLookupCache();
     size_t count = (size_t)UnserializeUInt64(stream);
 
     std::map<double, BaselineStatisticsMap>::iterator insertPos =
@@ -806,13 +934,10 @@ class StatisticsCollection : public Serializable {
                                 DoubleStatMap& statMap) const {
     size_t count = (size_t)UnserializeUInt64(stream);
 
-    std::map<double, DefaultStatistics>::iterator insertPos = statMap.begin();
     for (size_t i = 0; i < count; ++i) {
       double key = UnserializeDouble(stream);
-      insertPos = statMap.insert(
-          insertPos, std::pair<double, DefaultStatistics>(
-                         key, DefaultStatistics(_polarizationCount)));
-      insertPos->second.Unserialize(stream);
+      statMap.try_emplace(key, _polarizationCount)
+          .first->second.Unserialize(stream);
     }
   }
 
@@ -893,9 +1018,9 @@ class StatisticsCollection : public Serializable {
             key = leftKey;
         }
       }
-      newMap.insert(std::pair<double, DefaultStatistics>(key, i->second));
+      newMap.try_emplace(key, i->second);
     }
-    regridMap = newMap;
+    regridMap = std::move(newMap);
   }
 
   static void addAntennaStatistic(
@@ -913,12 +1038,20 @@ class StatisticsCollection : public Serializable {
   DoubleStatMap _frequencyStatistics;
   std::map<double, BaselineStatisticsMap> _baselineStatistics;
 
+  // Lookup cache of bandStatistics()
   std::map<unsigned, std::vector<DefaultStatistics*>> _bands;
   std::map<unsigned, double> _centralFrequencies;
   std::map<unsigned, std::vector<double>> _bandFrequencies;
 
   unsigned _polarizationCount;
   BaselineStatisticsMap _emptyBaselineStatisticsMap;
+  bool _compensatedSummation;
+
+  DefaultStatistics* _lastTimeStatistic = nullptr;
+  double _lastTime = 0.0;
+  double _lastTimeFrequency = 0.0;
+  BaselineStatisticsMap* _lastBaselineMap = nullptr;
+  double _lastBaselineFrequency = 0.0;
 };
 
 #endif
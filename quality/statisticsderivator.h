@@ -79,20 +79,18 @@ class StatisticsDerivator {
 
   std::pair<TimeFrequencyData, TimeFrequencyMetaDataPtr> CreateTFData(
       QualityTablesFormatter::StatisticKind kind) {
-    const std::map<double, std::map<double, DefaultStatistics>>& map =
+    const std::map<double, DoubleStatMap>& map =
         _collection.AllTimeStatistics();
     std::set<double> frequencies;
     std::set<double> timesteps;
     // List the frequencies and timesteps
-    for (std::map<double, std::map<double, DefaultStatistics>>::const_iterator
-             i = map.begin();
+    for (std::map<double, DoubleStatMap>::const_iterator i = map.begin();
          i != map.end(); ++i) {
       const double frequency = i->first;
       frequencies.insert(frequency);
 
-      const std::map<double, DefaultStatistics>& innerMap = i->second;
-      for (std::map<double, DefaultStatistics>::const_iterator j =
-               innerMap.begin();
+      const DoubleStatMap& innerMap = i->second;
+      for (DoubleStatMap::const_iterator j = innerMap.begin();
            j != innerMap.end(); ++j) {
         const double time = j->first;
         timesteps.insert(time);
@@ -133,15 +131,13 @@ class StatisticsDerivator {
     }
 
     // add the statistis
-    for (std::map<double, std::map<double, DefaultStatistics>>::const_iterator
-             i = map.begin();
+    for (std::map<double, DoubleStatMap>::const_iterator i = map.begin();
          i != map.end(); ++i) {
       const double frequency = i->first;
       const size_t freqIndex = freqIndices.find(frequency)->second;
 
-      const std::map<double, DefaultStatistics>& innerMap = i->second;
-      for (std::map<double, DefaultStatistics>::const_iterator j =
-               innerMap.begin();
+      const DoubleStatMap& innerMap = i->second;
+      for (DoubleStatMap::const_iterator j = innerMap.begin();
            j != innerMap.end(); ++j) {
         const double time = j->first;
         const size_t timeIndex = timeIndices.find(time)->second;
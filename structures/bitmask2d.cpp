@@ -0,0 +1,145 @@
+#include "bitmask2d.h"
+
+#include "packedflags.h"
+
+namespace {
+
+using Word = BitMask2D::Word;
+constexpr size_t kWordBits = BitMask2D::kWordBits;
+
+/**
+ * Sets output[x] = input[x - shift] for a row of @p n words, where samples
+ * shifted in from before the start of the row are zero.
+ */
+void ShiftUp(const Word* input, Word* output, size_t n, size_t shift) {
+  const size_t wordShift = shift / kWordBits;
+  const size_t bitShift = shift % kWordBits;
+  for (size_t i = n; i != 0; --i) {
+    const size_t w = i - 1;
+    Word value = 0;
+    if (w >= wordShift) {
+      value = input[w - wordShift] << bitShift;
+      if (bitShift != 0 && w > wordShift)
+        value |= input[w - wordShift - 1] >> (kWordBits - bitShift);
+    }
+    output[w] = value;
+  }
+}
+
+/**
+ * Sets output[x] = input[x + shift] for a row of @p n words, where samples
+ * shifted in from after the end of the row are zero.
+ */
+void ShiftDown(const Word* input, Word* output, size_t n, size_t shift) {
+  const size_t wordShift = shift / kWordBits;
+  const size_t bitShift = shift % kWordBits;
+  for (size_t w = 0; w != n; ++w) {
+    Word value = 0;
+    if (w + wordShift < n) {
+      value = input[w + wordShift] >> bitShift;
+      if (bitShift != 0 && w + wordShift + 1 < n)
+        value |= input[w + wordShift + 1] << (kWordBits - bitShift);
+    }
+    output[w] = value;
+  }
+}
+
+}  // namespace
+
+BitMask2D::BitMask2D(const Mask2D& mask)
+    : BitMask2D(mask.Width(), mask.Height()) {
+  const size_t fullBytes = _width - _width % 8;
+  for (size_t y = 0; y != _height; ++y) {
+    const bool* values = mask.ValuePtr(0, y);
+    Word* row = RowPtr(y);
+    for (size_t x = 0; x != fullBytes; x += 8)
+      row[x / kWordBits] |= Word(PackFlagByte(&values[x])) << (x % kWordBits);
+    for (size_t x = fullBytes; x != _width; ++x)
+      row[x / kWordBits] |= Word(values[x]) << (x % kWordBits);
+  }
+}
+
+Mask2D BitMask2D::ToMask2D() const {
+  Mask2D mask = Mask2D::MakeUnsetMask(_width, _height);
+  CopyTo(mask);
+  return mask;
+}
+
+void BitMask2D::CopyTo(Mask2D& mask) const {
+  const size_t fullBytes = _width - _width % 8;
+  for (size_t y = 0; y != _height; ++y) {
+    bool* values = mask.ValuePtr(0, y);
+    const Word* row = RowPtr(y);
+    for (size_t x = 0; x != fullBytes; x += 8)
+      UnpackFlagByte(row[x / kWordBits] >> (x % kWordBits), &values[x]);
+    for (size_t x = fullBytes; x != _width; ++x)
+      values[x] = (row[x / kWordBits] >> (x % kWordBits)) & 1u;
+  }
+}
+
+size_t BitMask2D::RowCount(size_t y) const {
+  const Word* row = RowPtr(y);
+  size_t count = 0;
+  for (size_t w = 0; w != _wordsPerRow; ++w)
+    count += __builtin_popcountll(row[w]);
+  return count;
+}
+
+void BitMask2D::clearPadding() {
+  const size_t usedBits = _width % kWordBits;
+  if (usedBits != 0) {
+    const Word lastWordMask = (Word(1) << usedBits) - 1;
+    for (size_t y = 0; y != _height; ++y)
+      RowPtr(y)[_wordsPerRow - 1] &= lastWordMask;
+  }
+}
+
+// Both dilations grow the dilated distance d (initially zero) by steps s:
+// a value is set after a step when it was set before the step at distance
+// zero or s. Because s <= d + 1, the covered ranges stay contiguous, and
+// values that are shifted out of the mask can be dropped. Hence, the number of
+// steps is logarithmic in the dilation size.
+
+void BitMask2D::DilateHorizontally(size_t size) {
+  if (size == 0 || _width == 0) return;
+  size = std::min(size, _width);
+  std::vector<Word> original(_wordsPerRow), shifted(_wordsPerRow);
+  for (size_t y = 0; y != _height; ++y) {
+    if (RowCount(y) == 0) continue;
+    Word* row = RowPtr(y);
+    size_t distance = 0;
+    while (distance < size) {
+      const size_t step = std::min(distance + 1, size - distance);
+      std::copy_n(row, _wordsPerRow, original.begin());
+      ShiftUp(original.data(), shifted.data(), _wordsPerRow, step);
+      for (size_t w = 0; w != _wordsPerRow; ++w) row[w] |= shifted[w];
+      ShiftDown(original.data(), shifted.data(), _wordsPerRow, step);
+      for (size_t w = 0; w != _wordsPerRow; ++w) row[w] |= shifted[w];
+      distance += step;
+    }
+  }
+  clearPadding();
+}
+
+void BitMask2D::DilateVertically(size_t size) {
+  if (size == 0 || _height == 0) return;
+  size = std::min(size, _height);
+  size_t distance = 0;
+  std::vector<Word> original;
+  while (distance < size) {
+    const size_t step = std::min(distance + 1, size - distance);
+    original = _words;
+    for (size_t y = 0; y != _height; ++y) {
+      Word* row = RowPtr(y);
+      if (y >= step) {
+        const Word* above = &original[(y - step) * _wordsPerRow];
+        for (size_t w = 0; w != _wordsPerRow; ++w) row[w] |= above[w];
+      }
+      if (y + step < _height) {
+        const Word* below = &original[(y + step) * _wordsPerRow];
+        for (size_t w = 0; w != _wordsPerRow; ++w) row[w] |= below[w];
+      }
+    }
+    distance += step;
+  }
+}
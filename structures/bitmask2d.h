@@ -0,0 +1,150 @@
+#ifndef BIT_MASK_2D_H
+#define BIT_MASK_2D_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mask2d.h"
+
+/**
+ * A two-dimensional flag mask that stores one bit per sample, whereas Mask2D
+ * stores one bool (i.e. one byte) per sample. It is used where masks are kept
+ * in memory for a longer time, and for the operations that can work on 64
+ * samples at a time, such as joining, counting and dilating masks.
+ *
+ * Every row starts at a new 64-bit word. The bits after the width in the last
+ * word of a row are always zero, so that whole words can be combined and
+ * counted without special treatment of the row ends.
+ *
+ * Sample x of a row is stored in bit (x % 64) of word (x / 64).
+ */
+class BitMask2D {
+ public:
+  using Word = uint64_t;
+  static constexpr size_t kWordBits = 64;
+
+  BitMask2D() : _width(0), _height(0), _wordsPerRow(0) {}
+
+  /**
+   * Creates a mask with all values set to false.
+   */
+  BitMask2D(size_t width, size_t height)
+      : _width(width),
+        _height(height),
+        _wordsPerRow((width + kWordBits - 1) / kWordBits),
+        _words(_wordsPerRow * height, 0) {}
+
+  explicit BitMask2D(const Mask2D& mask);
+
+  bool operator==(const BitMask2D& rhs) const {
+    return _width == rhs._width && _height == rhs._height &&
+           _words == rhs._words;
+  }
+
+  bool operator!=(const BitMask2D& rhs) const { return !(*this == rhs); }
+
+  /**
+   * Unpacks the mask into a new Mask2D.
+   */
+  Mask2D ToMask2D() const;
+
+  /**
+   * Unpacks the mask into @p mask, which should have the same size.
+   */
+  void CopyTo(Mask2D& mask) const;
+
+  bool Value(size_t x, size_t y) const {
+    return (RowPtr(y)[x / kWordBits] >> (x % kWordBits)) & 1u;
+  }
+
+  void SetValue(size_t x, size_t y, bool newValue) {
+    Word& word = RowPtr(y)[x / kWordBits];
+    const Word bit = Word(1) << (x % kWordBits);
+    word = newValue ? (word | bit) : (word & ~bit);
+  }
+
+  size_t Width() const { return _width; }
+
+  size_t Height() const { return _height; }
+
+  /**
+   * Number of 64-bit words that hold one row.
+   */
+  size_t WordsPerRow() const { return _wordsPerRow; }
+
+  Word* RowPtr(size_t y) { return &_words[y * _wordsPerRow]; }
+
+  const Word* RowPtr(size_t y) const { return &_words[y * _wordsPerRow]; }
+
+  template <bool NewValue>
+  void SetAll() {
+    std::fill(_words.begin(), _words.end(), NewValue ? ~Word(0) : Word(0));
+    if (NewValue) clearPadding();
+  }
+
+  /**
+   * Sets each value to true when it is true in this mask or in @p other.
+   * @p other should have the same size.
+   */
+  void Join(const BitMask2D& other) {
+    for (size_t i = 0; i != _words.size(); ++i) _words[i] |= other._words[i];
+  }
+
+  /**
+   * Sets each value to true when it is true in both this mask and @p other.
+   * @p other should have the same size.
+   */
+  void Intersect(const BitMask2D& other) {
+    for (size_t i = 0; i != _words.size(); ++i) _words[i] &= other._words[i];
+  }
+
+  void Invert() {
+    for (Word& word : _words) word = ~word;
+    clearPadding();
+  }
+
+  bool AllFalse() const {
+    for (const Word word : _words)
+      if (word != 0) return false;
+    return true;
+  }
+
+  /**
+   * Number of values in row @p y that are set to true.
+   */
+  size_t RowCount(size_t y) const;
+
+  template <bool BoolValue>
+  size_t GetCount() const {
+    size_t count = 0;
+    for (size_t y = 0; y != _height; ++y) count += RowCount(y);
+    return BoolValue ? count : _width * _height - count;
+  }
+
+  /**
+   * Flags all values that are at most @p size samples away in horizontal
+   * direction from a flagged value. The result is equal to
+   * MorphologicalFlagger::DilateFlagsHorizontally(), but it uses a
+   * logarithmic number of passes over whole words.
+   */
+  void DilateHorizontally(size_t size);
+
+  /**
+   * Like DilateHorizontally(), but in vertical direction.
+   */
+  void DilateVertically(size_t size);
+
+ private:
+  /**
+   * Sets the bits after the width of each row to zero.
+   */
+  void clearPadding();
+
+  size_t _width, _height;
+  size_t _wordsPerRow;
+  std::vector<Word> _words;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef MASK2D_H
 #define MASK2D_H
 
+#include <cstdint>
 #include <cstring>
 #include <memory>
 
@@ -125,14 +126,7 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
 
   size_t Height() const { return _height; }
 
-  bool AllFalse() const {
-    for (size_t y = 0; y < _height; ++y) {
-      for (size_t x = 0; x < _width; ++x) {
-        if (_values[y][x]) return false;
-      }
-    }
-    return true;
-  }
+  bool AllFalse() const { return GetCount<true>() == 0; }
 
   /**
    * Returns a pointer to one row of data. This can be used to step
@@ -204,9 +198,9 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
   }
 
   void Invert() {
-    for (size_t y = 0; y < _height; ++y) {
-      for (size_t x = 0; x < _width; ++x) _values[y][x] = !_values[y][x];
-    }
+    combineRows(*this, [](uint64_t a, uint64_t) {
+      return a ^ uint64_t(0x0101010101010101);
+    });
   }
 
   /**
@@ -224,10 +218,16 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
   size_t GetCount() const {
     size_t count = 0;
     for (size_t y = 0; y < _height; ++y) {
-      for (size_t x = 0; x < _width; ++x)
-        if (BoolValue == _values[y][x]) ++count;
+      const bool* row = _values[y];
+      size_t x = 0;
+      for (; x + 8 <= _width; x += 8) {
+        uint64_t values;
+        std::memcpy(&values, &row[x], sizeof(values));
+        count += __builtin_popcountll(values);
+      }
+      for (; x < _width; ++x) count += row[x];
     }
-    return count;
+    return BoolValue ? count : _width * _height - count;
   }
 
   Mask2D ShrinkHorizontally(int factor) const;
@@ -240,17 +240,11 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
   void EnlargeVerticallyAndSet(const Mask2D& smallMask, int factor);
 
   void Join(const Mask2D& other) {
-    for (size_t y = 0; y < _height; ++y) {
-      for (size_t x = 0; x < _width; ++x)
-        SetValue(x, y, other.Value(x, y) || Value(x, y));
-    }
+    combineRows(other, [](uint64_t a, uint64_t b) { return a | b; });
   }
 
   void Intersect(const Mask2D& other) {
-    for (size_t y = 0; y < _height; ++y) {
-      for (size_t x = 0; x < _width; ++x)
-        SetValue(x, y, other.Value(x, y) && Value(x, y));
-    }
+    combineRows(other, [](uint64_t a, uint64_t b) { return a & b; });
   }
 
   Mask2D Trim(size_t startX, size_t startY, size_t endX, size_t endY) const {
@@ -294,6 +288,30 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
 
   void allocate();
 
+  /**
+   * Replaces each value v of this mask by operation(v, o), with o the
+   * corresponding value of @p other. This processes 8 values at a time as one
+   * 64-bit word: because bools are stored as bytes with value 0 or 1, the
+   * bitwise operations on the words are equal to the logical operations.
+   */
+  template <typename Operation>
+  void combineRows(const Mask2D& other, Operation operation) {
+    for (size_t y = 0; y < _height; ++y) {
+      bool* row = _values[y];
+      const bool* otherRow = other._values[y];
+      size_t x = 0;
+      for (; x + 8 <= _width; x += 8) {
+        uint64_t values, otherValues;
+        std::memcpy(&values, &row[x], sizeof(values));
+        std::memcpy(&otherValues, &otherRow[x], sizeof(otherValues));
+        values = operation(values, otherValues);
+        std::memcpy(&row[x], &values, sizeof(values));
+      }
+      for (; x < _width; ++x)
+        row[x] = operation(uint64_t(row[x]), uint64_t(otherRow[x])) & 1;
+    }
+  }
+
   size_t _width, _height;
   size_t _stride;
 
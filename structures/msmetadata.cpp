@@ -3,10 +3,14 @@
 #include <casacore/tables/Tables/ScalarColumn.h>
 
 #include "msmetadata.h"
+#include "msmetadataindex.h"
 #include "date.h"
 
 #include "../util/logger.h"
 
+#include <cassert>
+#include <stdexcept>
+
 MSMetaData::~MSMetaData() {}
 
 size_t MSMetaData::BandCount(const std::string& location) {
@@ -145,74 +149,155 @@ void MSMetaData::InitializeMainTableData() {
     Logger::Debug << "Initializing ms metadata cache data...\n";
 
     const casacore::MeasurementSet ms(_path);
-    const casacore::ScalarColumn<int> antenna1Col(
-        ms, casacore::MeasurementSet::columnName(
-                casacore::MeasurementSet::ANTENNA1));
-    const casacore::ScalarColumn<int> antenna2Col(
-        ms, casacore::MeasurementSet::columnName(
-                casacore::MeasurementSet::ANTENNA2));
-    const casacore::ScalarColumn<int> fieldIdCol(
-        ms, casacore::MeasurementSet::columnName(
-                casacore::MeasurementSet::FIELD_ID));
-    const casacore::ScalarColumn<int> dataDescIdCol(
-        ms, casacore::MeasurementSet::columnName(
-                casacore::MeasurementSet::DATA_DESC_ID));
-    const casacore::ScalarColumn<double> timeCol(
-        ms,
-        casacore::MeasurementSet::columnName(casacore::MeasurementSet::TIME));
-
-    double time = -1.0;
-    std::set<std::pair<size_t, size_t>> baselineSet;
-    std::set<Sequence> sequenceSet;
-    size_t prevFieldId = size_t(-1), sequenceId = size_t(-1);
-    for (size_t row = 0; row != ms.nrow(); ++row) {
-      size_t a1 = antenna1Col(row), a2 = antenna2Col(row),
-             fieldId = fieldIdCol(row), spw = dataDescIdCol(row);
-      const double cur_time = timeCol(row);
-
-      const bool isNewTime = cur_time != time;
-      if (fieldId != prevFieldId) {
-        prevFieldId = fieldId;
-        sequenceId++;
-        _observationTimesPerSequence.emplace_back();
-      }
-      if (isNewTime) {
-        time = cur_time;
-        _observationTimesPerSequence[sequenceId].insert(cur_time);
-        _observationTimes.emplace_hint(_observationTimes.end(), cur_time);
+    auto data = std::make_shared<MainTableData>();
+    if (MSMetaDataIndex::IsEnabled()) {
+      const MSMetaDataIndex::Key key =
+          MSMetaDataIndex::MakeKey(_path, ms.nrow());
+      const std::string indexFilename = MSMetaDataIndex::Filename(_path);
+      std::optional<MSMetaDataIndex::Contents> contents =
+          MSMetaDataIndex::Load(indexFilename, key);
+      if (contents) {
+        Logger::Debug << "Using metadata index " << indexFilename << ".\n";
+        data->baselines = std::move(contents->baselines);
+        data->sequences = std::move(contents->sequences);
+        data->observationTimesPerSequence =
+            std::move(contents->observationTimesPerSequence);
+        for (const std::set<double>& times : data->observationTimesPerSequence)
+          data->observationTimes.insert(times.begin(), times.end());
+      } else {
+        readMainTable(ms, *data);
+        Logger::Debug << "Writing metadata index " << indexFilename << ".\n";
+        MSMetaDataIndex::Save(indexFilename, key,
+                              MSMetaDataIndex::Contents{
+                                  data->baselines, data->sequences,
+                                  data->observationTimesPerSequence});
       }
-
-      baselineSet.insert(std::pair<size_t, size_t>(a1, a2));
-      sequenceSet.insert(Sequence(a1, a2, spw, sequenceId, fieldId));
+    } else {
+      readMainTable(ms, *data);
+    }
+    data->rowCount = ms.nrow();
+    if (data->rowCount != 0) {
+      data->firstRow = readRowKey(ms, 0);
+      data->lastRow = readRowKey(ms, data->rowCount - 1);
     }
-
-    _baselines.assign(baselineSet.begin(), baselineSet.end());
-    _sequences.assign(sequenceSet.begin(), sequenceSet.end());
 
     if (_intervalEnd) {
-      for (std::set<double>& seq : _observationTimesPerSequence) {
+      for (std::set<double>& seq : data->observationTimesPerSequence) {
         if (seq.size() > *_intervalEnd)
           seq.erase(std::next(seq.begin(), *_intervalEnd), seq.end());
       }
-      _observationTimes.erase(
-          std::next(_observationTimes.begin(), *_intervalEnd),
-          _observationTimes.end());
+      data->observationTimes.erase(
+          std::next(data->observationTimes.begin(), *_intervalEnd),
+          data->observationTimes.end());
     }
     if (_intervalStart) {
-      for (std::set<double>& seq : _observationTimesPerSequence) {
+      for (std::set<double>& seq : data->observationTimesPerSequence) {
         if (seq.size() > *_intervalStart)
           seq.erase(seq.begin(), std::next(seq.begin(), *_intervalStart));
         else
           seq.clear();
       }
-      _observationTimes.erase(
-          _observationTimes.begin(),
-          std::next(_observationTimes.begin(), *_intervalStart));
+      data->observationTimes.erase(
+          data->observationTimes.begin(),
+          std::next(data->observationTimes.begin(), *_intervalStart));
     }
+    _mainTableData = std::move(data);
     _isMainTableDataInitialized = true;
   }
 }
 
+void MSMetaData::ShareMainTableData(const MSMetaData& source) {
+  assert(source._isMainTableDataInitialized);
+  const casacore::MeasurementSet ms(_path);
+  const MainTableData& data = *source._mainTableData;
+  bool isConsistent = ms.nrow() == data.rowCount &&
+                      _intervalStart == source._intervalStart &&
+                      _intervalEnd == source._intervalEnd;
+  if (isConsistent && data.rowCount != 0) {
+    isConsistent = readRowKey(ms, 0) == data.firstRow &&
+                   readRowKey(ms, data.rowCount - 1) == data.lastRow;
+  }
+  if (!isConsistent)
+    throw std::runtime_error("The main table of measurement set " + _path +
+                             " does not have the same baselines, "
+                             "timesteps, spectral windows and fields as the "
+                             "main table of " +
+                             source._path);
+  _mainTableData = source._mainTableData;
+  _isMainTableDataInitialized = true;
+}
+
+MSMetaData::RowKey MSMetaData::readRowKey(const casacore::MeasurementSet& ms,
+                                          size_t row) {
+  const casacore::ScalarColumn<int> antenna1Col(
+      ms, casacore::MeasurementSet::columnName(
+              casacore::MeasurementSet::ANTENNA1));
+  const casacore::ScalarColumn<int> antenna2Col(
+      ms, casacore::MeasurementSet::columnName(
+              casacore::MeasurementSet::ANTENNA2));
+  const casacore::ScalarColumn<double> timeCol(
+      ms, casacore::MeasurementSet::columnName(casacore::MeasurementSet::TIME));
+  const casacore::ScalarColumn<int> dataDescIdCol(
+      ms, casacore::MeasurementSet::columnName(
+              casacore::MeasurementSet::DATA_DESC_ID));
+  const casacore::ScalarColumn<int> fieldIdCol(
+      ms, casacore::MeasurementSet::columnName(
+              casacore::MeasurementSet::FIELD_ID));
+  RowKey key;
+  key.antenna1 = antenna1Col(row);
+  key.antenna2 = antenna2Col(row);
+  key.time = timeCol(row);
+  key.dataDescId = dataDescIdCol(row);
+  key.fieldId = fieldIdCol(row);
+  return key;
+}
+
+void MSMetaData::readMainTable(const casacore::MeasurementSet& ms,
+                               MainTableData& data) {
+  const casacore::ScalarColumn<int> antenna1Col(
+      ms, casacore::MeasurementSet::columnName(
+              casacore::MeasurementSet::ANTENNA1));
+  const casacore::ScalarColumn<int> antenna2Col(
+      ms, casacore::MeasurementSet::columnName(
+              casacore::MeasurementSet::ANTENNA2));
+  const casacore::ScalarColumn<int> fieldIdCol(
+      ms, casacore::MeasurementSet::columnName(
+              casacore::MeasurementSet::FIELD_ID));
+  const casacore::ScalarColumn<int> dataDescIdCol(
+      ms, casacore::MeasurementSet::columnName(
+              casacore::MeasurementSet::DATA_DESC_ID));
+  const casacore::ScalarColumn<double> timeCol(
+      ms, casacore::MeasurementSet::columnName(casacore::MeasurementSet::TIME));
+
+  double time = -1.0;
+  std::set<std::pair<size_t, size_t>> baselineSet;
+  std::set<Sequence> sequenceSet;
+  size_t prevFieldId = size_t(-1), sequenceId = size_t(-1);
+  for (size_t row = 0; row != ms.nrow(); ++row) {
+    size_t a1 = antenna1Col(row), a2 = antenna2Col(row),
+           fieldId = fieldIdCol(row), spw = dataDescIdCol(row);
+    const double cur_time = timeCol(row);
+
+    const bool isNewTime = cur_time != time;
+    if (fieldId != prevFieldId) {
+      prevFieldId = fieldId;
+      sequenceId++;
+      data.observationTimesPerSequence.emplace_back();
+    }
+    if (isNewTime) {
+      time = cur_time;
+      data.observationTimesPerSequence[sequenceId].insert(cur_time);
+      data.observationTimes.emplace_hint(data.observationTimes.end(), cur_time);
+    }
+
+    baselineSet.insert(std::pair<size_t, size_t>(a1, a2));
+    sequenceSet.insert(Sequence(a1, a2, spw, sequenceId, fieldId));
+  }
+
+  data.baselines.assign(baselineSet.begin(), baselineSet.end());
+  data.sequences.assign(sequenceSet.begin(), sequenceSet.end());
+}
+
 size_t MSMetaData::PolarizationCount(const std::string& filename) {
   casacore::MeasurementSet ms(filename);
   const casacore::Table polTable = ms.polarization();
@@ -5,6 +5,7 @@
 
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
@@ -16,7 +17,9 @@ class MSMetaData {
   class Sequence;
 
   explicit MSMetaData(const std::string& path)
-      : _path(path), _isMainTableDataInitialized(false) {
+      : _path(path),
+        _isMainTableDataInitialized(false),
+        _mainTableData(std::make_shared<MainTableData>()) {
     initializeOtherData();
   }
 
@@ -31,12 +34,12 @@ class MSMetaData {
 
   size_t TimestepCount() {
     InitializeMainTableData();
-    return _observationTimes.size();
+    return _mainTableData->observationTimes.size();
   }
 
   size_t TimestepCount(size_t sequenceId) {
     InitializeMainTableData();
-    return _observationTimesPerSequence[sequenceId].size();
+    return _mainTableData->observationTimesPerSequence[sequenceId].size();
   }
 
   size_t PolarizationCount() const { return PolarizationCount(Path()); }
@@ -58,7 +61,7 @@ class MSMetaData {
    */
   size_t SequenceCount() {
     InitializeMainTableData();
-    return _observationTimesPerSequence.size();
+    return _mainTableData->observationTimesPerSequence.size();
   }
 
   const AntennaInfo& GetAntennaInfo(unsigned antennaId) const {
@@ -86,42 +89,66 @@ class MSMetaData {
    */
   void InitializeMainTableData();
 
+  /**
+   * Initializes the main table data by referring to the main table data of
+   * @p source, instead of reading the main table. This is used for
+   * measurement sets that contain different subbands of the same
+   * observation, which have the same baselines, sequences and timesteps.
+   *
+   * To verify that the sets are consistent without reading the main table,
+   * the number of rows and the antennas, times, data description ids
+   * (spectral windows) and field ids of the first and last row are compared.
+   * An exception is thrown when they are different.
+   * @pre InitializeMainTableData() is called on @p source.
+   */
+  void ShareMainTableData(const MSMetaData& source);
+
+  /**
+   * True when the main table data of this set and @p other are the same
+   * object, see ShareMainTableData().
+   */
+  bool SharesMainTableData(const MSMetaData& other) const {
+    return _mainTableData == other._mainTableData;
+  }
+
   void GetBaselines(std::vector<std::pair<size_t, size_t>>& baselines) {
     InitializeMainTableData();
-    baselines = _baselines;
+    baselines = _mainTableData->baselines;
   }
 
   /// @pre InitializeMainTableData is called.
   const std::vector<std::pair<size_t, size_t>>& GetBaselines() const {
-    return _baselines;
+    return _mainTableData->baselines;
   }
 
   const std::vector<Sequence>& GetSequences() {
     InitializeMainTableData();
-    return _sequences;
+    return _mainTableData->sequences;
   }
 
   /// @pre InitializeMainTableData is called.
-  const std::vector<Sequence>& GetSequences() const { return _sequences; }
+  const std::vector<Sequence>& GetSequences() const {
+    return _mainTableData->sequences;
+  }
 
   const std::set<double>& GetObservationTimes() {
     InitializeMainTableData();
-    return _observationTimes;
+    return _mainTableData->observationTimes;
   }
 
   /// @pre InitializeMainTableData is called.
   const std::set<double>& GetObservationTimes() const {
-    return _observationTimes;
+    return _mainTableData->observationTimes;
   }
 
   const std::set<double>& GetObservationTimesSet(size_t sequenceId) {
     InitializeMainTableData();
-    return _observationTimesPerSequence[sequenceId];
+    return _mainTableData->observationTimesPerSequence[sequenceId];
   }
 
   /// @pre InitializeMainTableData is called.
   const std::vector<std::set<double>>& GetObservationTimesPerSequence() const {
-    return _observationTimesPerSequence;
+    return _mainTableData->observationTimesPerSequence;
   }
 
   const std::vector<AntennaInfo>& GetAntennas() const { return _antennas; }
@@ -180,7 +207,38 @@ class MSMetaData {
   static std::string GetTelescopeName(casacore::MeasurementSet& ms);
 
  private:
+  struct RowKey {
+    int antenna1 = 0;
+    int antenna2 = 0;
+    double time = 0.0;
+    int dataDescId = 0;
+    int fieldId = 0;
+
+    bool operator==(const RowKey& rhs) const {
+      return antenna1 == rhs.antenna1 && antenna2 == rhs.antenna2 &&
+             time == rhs.time && dataDescId == rhs.dataDescId &&
+             fieldId == rhs.fieldId;
+    }
+  };
+
+  /**
+   * The metadata from the main table. It is not changed after it has been
+   * initialized, such that it can be shared by several MSMetaData objects.
+   */
+  struct MainTableData {
+    std::vector<std::pair<size_t, size_t>> baselines;
+    std::set<double> observationTimes;
+    std::vector<std::set<double>> observationTimesPerSequence;
+    std::vector<Sequence> sequences;
+    // Used to verify that a set is consistent with a shared main table
+    size_t rowCount = 0;
+    RowKey firstRow, lastRow;
+  };
+
   void initializeOtherData();
+  static void readMainTable(const casacore::MeasurementSet& ms,
+                            MainTableData& data);
+  static RowKey readRowKey(const casacore::MeasurementSet& ms, size_t row);
 
   void initializeAntennas(casacore::MeasurementSet& ms);
   void initializeBands(casacore::MeasurementSet& ms);
@@ -190,11 +248,7 @@ class MSMetaData {
 
   bool _isMainTableDataInitialized;
 
-  std::vector<std::pair<size_t, size_t>> _baselines;
-
-  std::set<double> _observationTimes;
-
-  std::vector<std::set<double>> _observationTimesPerSequence;
+  std::shared_ptr<const MainTableData> _mainTableData;
 
   std::vector<AntennaInfo> _antennas;
 
@@ -202,8 +256,6 @@ class MSMetaData {
 
   std::vector<FieldInfo> _fields;
 
-  std::vector<Sequence> _sequences;
-
   std::optional<size_t> _intervalStart, _intervalEnd;
 };
 
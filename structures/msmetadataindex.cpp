@@ -0,0 +1,157 @@
+#include "msmetadataindex.h"
+
+#include "../util/logger.h"
+#include "../util/serializable.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+std::optional<std::string> MSMetaDataIndex::_directory;
+
+namespace {
+const std::string kMagic = "AOFlagger MS metadata index";
+constexpr uint32_t kFormatVersion = 1;
+const std::string kExtension = ".aoflagger-index";
+
+std::string NormalizePath(const std::string& path) {
+  std::error_code error;
+  std::filesystem::path result = std::filesystem::absolute(path, error);
+  if (error) result = path;
+  result = result.lexically_normal();
+  // "set.ms/" and "set.ms" refer to the same set
+  if (!result.has_filename()) result = result.parent_path();
+  return result.string();
+}
+}  // namespace
+
+std::string MSMetaDataIndex::Filename(const std::string& msPath) {
+  const std::string path = NormalizePath(msPath);
+  if (_directory->empty()) return path + kExtension;
+  // Sets with the same name in different directories get different indices
+  std::ostringstream filename;
+  filename << std::filesystem::path(path).filename().string() << '-'
+           << std::hex << std::hash<std::string>()(path) << kExtension;
+  return (std::filesystem::path(*_directory) / filename.str()).string();
+}
+
+MSMetaDataIndex::Key MSMetaDataIndex::MakeKey(const std::string& msPath,
+                                              uint64_t rowCount) {
+  Key key;
+  key.path = NormalizePath(msPath);
+  key.rowCount = rowCount;
+  // casacore rewrites table.dat when the structure or the number of rows of
+  // the table changes.
+  std::error_code error;
+  const std::filesystem::file_time_type time = std::filesystem::last_write_time(
+      std::filesystem::path(key.path) / "table.dat", error);
+  if (!error) key.modificationTime = time.time_since_epoch().count();
+  return key;
+}
+
+std::optional<MSMetaDataIndex::Contents> MSMetaDataIndex::Load(
+    const std::string& filename, const Key& key) {
+  try {
+    return read(filename, key);
+  } catch (std::exception&) {
+    // E.g. a truncated file can cause too large allocations
+    return {};
+  }
+}
+
+std::optional<MSMetaDataIndex::Contents> MSMetaDataIndex::read(
+    const std::string& filename, const Key& key) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) return {};
+  std::string magic(kMagic.size(), '\0');
+  file.read(&magic[0], magic.size());
+  if (!file || magic != kMagic ||
+      Serializable::UnserializeUInt32(file) != kFormatVersion)
+    return {};
+  Key fileKey;
+  fileKey.path = Serializable::UnserializeString(file);
+  fileKey.rowCount = Serializable::UnserializeUInt64(file);
+  fileKey.modificationTime = Serializable::UnserializeUInt64(file);
+  if (!file || !(fileKey == key)) return {};
+
+  Contents contents;
+  const size_t baselineCount = Serializable::UnserializeUInt64(file);
+  if (!file) return {};
+  contents.baselines.resize(baselineCount);
+  for (std::pair<size_t, size_t>& baseline : contents.baselines) {
+    baseline.first = Serializable::UnserializeUInt32(file);
+    baseline.second = Serializable::UnserializeUInt32(file);
+  }
+  const size_t sequenceCount = Serializable::UnserializeUInt64(file);
+  if (!file) return {};
+  contents.sequences.reserve(sequenceCount);
+  for (size_t i = 0; i != sequenceCount; ++i) {
+    const unsigned antenna1 = Serializable::UnserializeUInt32(file);
+    const unsigned antenna2 = Serializable::UnserializeUInt32(file);
+    const unsigned spw = Serializable::UnserializeUInt32(file);
+    const unsigned sequenceId = Serializable::UnserializeUInt32(file);
+    const unsigned fieldId = Serializable::UnserializeUInt32(file);
+    contents.sequences.emplace_back(antenna1, antenna2, spw, sequenceId,
+                                    fieldId);
+  }
+  const size_t timeSequenceCount = Serializable::UnserializeUInt64(file);
+  if (!file) return {};
+  contents.observationTimesPerSequence.resize(timeSequenceCount);
+  for (std::set<double>& times : contents.observationTimesPerSequence) {
+    const size_t timeCount = Serializable::UnserializeUInt64(file);
+    if (!file) return {};
+    for (size_t i = 0; i != timeCount; ++i)
+      times.emplace_hint(times.end(), Serializable::UnserializeDouble(file));
+  }
+  if (!file) return {};
+  return contents;
+}
+
+void MSMetaDataIndex::Save(const std::string& filename, const Key& key,
+                           const Contents& contents) {
+  // Write to a temporary file first, such that a reader never sees a
+  // partially written index.
+  const std::string temporaryFilename =
+      filename + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream file(temporaryFilename, std::ios::binary);
+    file.write(kMagic.data(), kMagic.size());
+    Serializable::SerializeToUInt32(file, kFormatVersion);
+    Serializable::SerializeToString(file, key.path);
+    Serializable::SerializeToUInt64(file, key.rowCount);
+    Serializable::SerializeToUInt64(file, key.modificationTime);
+    Serializable::SerializeToUInt64(file, contents.baselines.size());
+    for (const std::pair<size_t, size_t>& baseline : contents.baselines) {
+      Serializable::SerializeToUInt32(file, baseline.first);
+      Serializable::SerializeToUInt32(file, baseline.second);
+    }
+    Serializable::SerializeToUInt64(file, contents.sequences.size());
+    for (const MSMetaData::Sequence& sequence : contents.sequences) {
+      Serializable::SerializeToUInt32(file, sequence.antenna1);
+      Serializable::SerializeToUInt32(file, sequence.antenna2);
+      Serializable::SerializeToUInt32(file, sequence.spw);
+      Serializable::SerializeToUInt32(file, sequence.sequenceId);
+      Serializable::SerializeToUInt32(file, sequence.fieldId);
+    }
+    Serializable::SerializeToUInt64(
+        file, contents.observationTimesPerSequence.size());
+    for (const std::set<double>& times : contents.observationTimesPerSequence) {
+      Serializable::SerializeToUInt64(file, times.size());
+      for (double time : times) Serializable::SerializeToDouble(file, time);
+    }
+    if (!file) {
+      Logger::Warn << "Could not write metadata index " << filename << ".\n";
+      file.close();
+      std::remove(temporaryFilename.c_str());
+      return;
+    }
+  }
+  if (std::rename(temporaryFilename.c_str(), filename.c_str()) != 0) {
+    Logger::Warn << "Could not write metadata index " << filename << ".\n";
+    std::remove(temporaryFilename.c_str());
+  }
+}
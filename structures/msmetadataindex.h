@@ -0,0 +1,91 @@
+#ifndef MS_META_DATA_INDEX_H
+#define MS_META_DATA_INDEX_H
+
+#include "msmetadata.h"
+
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A file that stores the metadata that MSMetaData::InitializeMainTableData()
+ * collects from the main table of a measurement set. Collecting it requires
+ * reading several columns of all rows, which takes long for large sets.
+ * The index is stored next to the measurement set or in a cache directory,
+ * and is only used when the main table has not changed since the index was
+ * written.
+ */
+class MSMetaDataIndex {
+ public:
+  /**
+   * Identifies the state of the main table of a measurement set. When the
+   * table changes, the index of the previous state is no longer used.
+   */
+  struct Key {
+    std::string path;
+    uint64_t rowCount = 0;
+    int64_t modificationTime = 0;
+
+    bool operator==(const Key& rhs) const {
+      return path == rhs.path && rowCount == rhs.rowCount &&
+             modificationTime == rhs.modificationTime;
+    }
+  };
+
+  struct Contents {
+    std::vector<std::pair<size_t, size_t>> baselines;
+    std::vector<MSMetaData::Sequence> sequences;
+    std::vector<std::set<double>> observationTimesPerSequence;
+  };
+
+  /**
+   * Enables the use of index files. The files are stored in @p directory, or
+   * next to the measurement set when @p directory is empty.
+   */
+  static void Enable(const std::string& directory) {
+    _directory = directory;
+  }
+
+  static void Disable() { _directory.reset(); }
+
+  static bool IsEnabled() { return _directory.has_value(); }
+
+  /**
+   * Filename of the index of the measurement set at @p msPath.
+   * @pre IsEnabled()
+   */
+  static std::string Filename(const std::string& msPath);
+
+  /**
+   * Makes the key of the current state of the main table of the measurement
+   * set at @p msPath, which has @p rowCount rows.
+   */
+  static Key MakeKey(const std::string& msPath, uint64_t rowCount);
+
+  /**
+   * Reads an index. Returns an empty optional when the file does not exist,
+   * is invalid or was written for a different key.
+   */
+  static std::optional<Contents> Load(const std::string& filename,
+                                      const Key& key);
+
+  /**
+   * Writes an index. The file is replaced atomically, such that processes
+   * that read the index at the same time either see the old or the new file.
+   * Failing to write the index is not an error, because the index is only a
+   * cache: it is reported and otherwise ignored.
+   */
+  static void Save(const std::string& filename, const Key& key,
+                   const Contents& contents);
+
+ private:
+  static std::optional<Contents> read(const std::string& filename,
+                                      const Key& key);
+
+  static std::optional<std::string> _directory;
+};
+
+#endif
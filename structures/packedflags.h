@@ -0,0 +1,63 @@
+#ifndef PACKED_FLAGS_H
+#define PACKED_FLAGS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Functions to convert between one bool per flag and flags that are packed
+ * into bits. Flag i is stored in bit (i % 8) of byte (i / 8), and unused bits
+ * in the last byte are zero. This is the layout of the flags in the temporary
+ * flag file of the ReorderingBaselineReader, and of the words of BitMask2D.
+ */
+
+/**
+ * Converts 8 bools (bytes with value 0 or 1) into 8 bits, such that the
+ * first bool ends up in the lowest bit.
+ */
+inline unsigned char PackFlagByte(const bool* flags) {
+  uint64_t bytes;
+  std::memcpy(&bytes, flags, sizeof(bytes));
+  // Moves the lowest bit of each byte to bit 56-63, in order of the bytes
+  // (assuming a little-endian machine, like the rest of aoflagger).
+  return (bytes * 0x0102040810204080ULL) >> 56;
+}
+
+/**
+ * Inverse of PackFlagByte(): converts the 8 bits of @p bits into 8 bools.
+ */
+inline void UnpackFlagByte(unsigned char bits, bool* flags) {
+  // Copy the 8 bits to every byte, keep bit i in byte i, and turn each
+  // non-zero byte into 1 (the addition never carries into the next byte).
+  const uint64_t selected =
+      (bits * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+  const uint64_t bytes =
+      ((selected + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+  std::memcpy(flags, &bytes, sizeof(bytes));
+}
+
+/**
+ * Number of bytes that hold @p count packed flags.
+ */
+inline size_t PackedFlagsSize(size_t count) { return (count + 7) / 8; }
+
+inline void PackFlags(const bool* flags, size_t count, unsigned char* packed) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) packed[i / 8] = PackFlagByte(flags + i);
+  if (i != count) {
+    unsigned char last = 0;
+    for (size_t bit = 0; i + bit != count; ++bit)
+      last |= (flags[i + bit] ? 1 : 0) << bit;
+    packed[i / 8] = last;
+  }
+}
+
+inline void UnpackFlags(const unsigned char* packed, size_t count,
+                        bool* flags) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) UnpackFlagByte(packed[i / 8], flags + i);
+  for (; i != count; ++i) flags[i] = (packed[i / 8] >> (i % 8)) & 1;
+}
+
+#endif  // PACKED_FLAGS_H
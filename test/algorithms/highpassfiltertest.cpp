@@ -5,10 +5,78 @@
 
 #include "../../algorithms/highpassfilter.h"
 
+#include "../../util/rng.h"
+
 #include <boost/test/unit_test.hpp>
 
+#include <cmath>
+#include <limits>
+#include <random>
+
 using algorithms::HighPassFilter;
 
+namespace {
+void MakeRandomSet(size_t width, size_t height, Image2DPtr& image,
+                   Mask2DPtr& mask) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> values(-1.0, 1.0);
+  std::uniform_int_distribution<int> flags(0, 9);
+  image = Image2D::CreateUnsetImagePtr(width, height);
+  mask = Mask2D::CreateUnsetMaskPtr(width, height);
+  for (size_t y = 0; y != height; ++y) {
+    for (size_t x = 0; x != width; ++x) {
+      image->SetValue(x, y, values(rng));
+      mask->SetValue(x, y, flags(rng) == 0);
+    }
+  }
+  // A fully flagged channel and a non-finite value
+  mask->SetAllHorizontally<true>(height / 2);
+  image->SetValue(3, 1, std::numeric_limits<float>::quiet_NaN());
+}
+
+/**
+ * Straightforward 2D convolution in double precision.
+ */
+Image2DPtr ApplyLowPassDirectly(const Image2D& image, const Mask2D& mask,
+                                size_t hWindowSize, double hSigmaSq,
+                                size_t vWindowSize, double vSigmaSq) {
+  const int hMid = hWindowSize / 2, vMid = vWindowSize / 2;
+  const int width = image.Width(), height = image.Height();
+  Image2DPtr result = Image2D::CreateUnsetImagePtr(width, height);
+  for (int y = 0; y != height; ++y) {
+    for (int x = 0; x != width; ++x) {
+      double data = 0.0, weight = 0.0;
+      for (int j = -vMid; j <= vMid; ++j) {
+        for (int i = -hMid; i <= hMid; ++i) {
+          const int sx = x + i, sy = y + j;
+          if (sx >= 0 && sx < width && sy >= 0 && sy < height &&
+              !mask.Value(sx, sy) && std::isfinite(image.Value(sx, sy))) {
+            const double k =
+                RNG::EvaluateUnnormalizedGaussian(i, hSigmaSq) *
+                RNG::EvaluateUnnormalizedGaussian(j, vSigmaSq);
+            data += k * image.Value(sx, sy);
+            weight += k;
+          }
+        }
+      }
+      result->SetValue(x, y, weight == 0.0 ? 0.0 : data / weight);
+    }
+  }
+  return result;
+}
+
+size_t CountDifferences(const Image2D& a, const Image2D& b,
+                        double tolerance) {
+  size_t count = 0;
+  for (size_t y = 0; y != a.Height(); ++y) {
+    for (size_t x = 0; x != a.Width(); ++x) {
+      if (std::fabs(a.Value(x, y) - b.Value(x, y)) > tolerance) ++count;
+    }
+  }
+  return count;
+}
+}  // namespace
+
 BOOST_AUTO_TEST_SUITE(high_pass_filter, *boost::unit_test::label("algorithms"))
 
 BOOST_AUTO_TEST_CASE(filter_with_mask) {
@@ -65,4 +133,79 @@ BOOST_AUTO_TEST_CASE(nan_image) {
   ImageAsserter::AssertFinite(image);
 }
 
+BOOST_AUTO_TEST_CASE(direct_mode_kernels) {
+  // Wider than one tile, and with a width that is not a multiple of the
+  // vector sizes.
+  const size_t width = 1100, height = 45;
+  Image2DPtr image;
+  Mask2DPtr mask;
+  MakeRandomSet(width, height, image, mask);
+  const Image2DCPtr expected =
+      ApplyLowPassDirectly(*image, *mask, 21, 2.5, 31, 5.0);
+
+  for (HighPassFilter::Isa isa :
+       {HighPassFilter::Isa::Reference, HighPassFilter::Isa::AVX2,
+        HighPassFilter::Isa::AVX512}) {
+    if (!HighPassFilter::IsSupported(isa)) continue;
+    BOOST_TEST_CONTEXT("ISA " << HighPassFilter::IsaName(isa)) {
+      HighPassFilter filter;
+      filter.SetIsa(isa);
+      filter.SetHWindowSize(21);
+      filter.SetVWindowSize(31);
+      filter.SetHKernelSigmaSq(2.5);
+      filter.SetVKernelSigmaSq(5.0);
+      const Image2DCPtr result = filter.ApplyLowPass(image, mask);
+      BOOST_CHECK_EQUAL(CountDifferences(*result, *expected, 1e-5), 0u);
+      // The flagged channel is interpolated from its neighbours
+      BOOST_CHECK_NE(result->Value(100, height / 2), 0.0);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(small_images) {
+  for (size_t size : {1, 2, 5, 17, 40}) {
+    Image2DPtr image;
+    Mask2DPtr mask;
+    MakeRandomSet(size, size + 1, image, mask);
+    const Image2DCPtr expected =
+        ApplyLowPassDirectly(*image, *mask, 7, 2.0, 9, 3.0);
+    HighPassFilter filter;
+    filter.SetHWindowSize(7);
+    filter.SetVWindowSize(9);
+    filter.SetHKernelSigmaSq(2.0);
+    filter.SetVKernelSigmaSq(3.0);
+    const Image2DCPtr result = filter.ApplyLowPass(image, mask);
+    BOOST_CHECK_EQUAL(CountDifferences(*result, *expected, 1e-5), 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(recursive_mode) {
+  const size_t width = 600, height = 80;
+  Image2DPtr image;
+  Mask2DPtr mask;
+  MakeRandomSet(width, height, image, mask);
+  // Use a smooth image, so that the truncation of the kernel in the direct
+  // mode does not matter much.
+  for (size_t y = 0; y != height; ++y) {
+    for (size_t x = 0; x != width; ++x)
+      image->SetValue(x, y, std::sin(x * 0.05) + std::cos(y * 0.1));
+  }
+
+  HighPassFilter filter;
+  filter.SetHWindowSize(41);
+  filter.SetVWindowSize(61);
+  filter.SetHKernelSigmaSq(16.0);
+  filter.SetVKernelSigmaSq(36.0);
+  const Image2DCPtr direct = filter.ApplyLowPass(image, mask);
+  filter.SetMode(HighPassFilter::Mode::Recursive);
+  BOOST_CHECK(filter.GetMode() == HighPassFilter::Mode::Recursive);
+  const Image2DCPtr recursive = filter.ApplyLowPass(image, mask);
+  ImageAsserter::AssertFinite(recursive);
+  // The recursive filter approximates the Gaussian within about a percent
+  BOOST_CHECK_EQUAL(CountDifferences(*recursive, *direct, 0.05), 0u);
+
+  const Mask2DPtr fullMask = Mask2D::CreateSetMaskPtr<true>(width, height);
+  ImageAsserter::AssertConstant(filter.ApplyLowPass(image, fullMask), 0.0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
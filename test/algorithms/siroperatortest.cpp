@@ -1,3 +1,4 @@
+#include "../../structures/bitmask2d.h"
 #include "../../structures/mask2d.h"
 
 #include "../../algorithms/siroperator.h"
@@ -407,6 +408,27 @@ BOOST_AUTO_TEST_CASE(masked_frequency_direction) {
                     " xxxxxxxxxxxxxxxxxxxxxxx xxxxxxxxxxxxxxxxx x x");
 }
 
+BOOST_AUTO_TEST_CASE(bit_mask) {
+  const size_t width = 131, height = 67;
+  Mask2D mask = Mask2D::MakeSetMask<false>(width, height);
+  for (size_t y = 0; y != height; ++y) {
+    // Leave some rows and columns empty
+    if (y % 3 == 0) continue;
+    for (size_t x = 0; x != width; ++x) {
+      if (x % 5 != 0) mask.SetValue(x, y, RNG::Uniform() < 0.1);
+    }
+  }
+  for (const num_t eta : {0.0, 0.2, 0.4, 1.0}) {
+    Mask2D expected = mask;
+    SIROperator::OperateHorizontally(expected, eta);
+    SIROperator::OperateVertically(expected, eta);
+    BitMask2D bitMask(mask);
+    SIROperator::OperateHorizontally(bitMask, eta);
+    SIROperator::OperateVertically(bitMask, eta);
+    BOOST_CHECK(bitMask.ToMask2D() == expected);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(time_direction_speed, *boost::unit_test::disabled()) {
   const unsigned flagsSize = 10000;
   const unsigned channels = 256;
@@ -10,6 +10,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <sstream>
+
 using algorithms::SumThreshold;
 using algorithms::SumThresholdMissing;
 using algorithms::ThresholdConfig;
@@ -231,4 +233,108 @@ BOOST_AUTO_TEST_CASE(stability_AVX_dumas) { StabilityAVX(true); }
 
 #endif  // defined(__AVX2__) || defined(__x86_64__)
 
+#if defined(__AVX512F__) || defined(__x86_64__)
+BOOST_AUTO_TEST_CASE(horizontal_sumthreshold_AVX512_dumas) {
+  if (!SumThreshold::IsSupported(SumThreshold::Isa::AVX512)) return;
+  CompareHorizontalSumThreshold([](const Image2D* input, Mask2D* mask, Mask2D*,
+                                   size_t length, num_t threshold) {
+    SumThreshold::HorizontalAVX512Dumas(input, mask, length, threshold);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(vertical_sumthreshold_AVX512_dumas) {
+  if (!SumThreshold::IsSupported(SumThreshold::Isa::AVX512)) return;
+  CompareVerticalSumThreshold(
+      [](const Image2D* input, Mask2D* mask, Mask2D*, size_t length,
+         num_t threshold) {
+        SumThreshold::VerticalScratch vScratch(input->Width(), input->Height());
+        SumThreshold::VerticalAVX512Dumas(input, mask, &vScratch, length,
+                                          threshold);
+      },
+      {});
+}
+
+BOOST_AUTO_TEST_CASE(stability_AVX512_dumas) {
+  if (!SumThreshold::IsSupported(SumThreshold::Isa::AVX512)) return;
+  ThresholdConfig config;
+  config.InitializeLengthsDefault(9);
+  config.InitializeThresholdsFromFirstThreshold(6.0, ThresholdConfig::Rayleigh);
+  // Sizes around the vector width of 16 test the partial vectors at the
+  // borders of the image.
+  for (size_t size : {1, 2, 3, 4, 15, 16, 17, 33}) {
+    Image2D image = Image2D::MakeZeroImage(size, size);
+    for (size_t y = 0; y != size; ++y) {
+      for (size_t x = 0; x != size; ++x)
+        image.SetValue(x, y, ((x * 7 + y * 13) % 5) * 0.5);
+    }
+    Mask2D referenceMask = Mask2D::MakeSetMask<false>(size, size),
+           mask = Mask2D::MakeSetMask<false>(size, size),
+           scratch = Mask2D::MakeUnsetMask(size, size);
+    SumThreshold::VerticalScratch vScratch(size, size);
+    for (unsigned i = 0; i < 9; ++i) {
+      const unsigned length = config.GetHorizontalLength(i);
+      std::ostringstream str;
+      str << "size " << size << ", length " << length;
+
+      referenceMask.SetAll<false>();
+      mask.SetAll<false>();
+      SumThreshold::HorizontalLargeReference(&image, &referenceMask, &scratch,
+                                             length, 1.0);
+      SumThreshold::HorizontalAVX512Dumas(&image, &mask, length, 1.0);
+      BOOST_CHECK_MESSAGE(referenceMask == mask, "horizontal, " + str.str());
+
+      referenceMask.SetAll<false>();
+      mask.SetAll<false>();
+      SumThreshold::VerticalLargeReference(&image, &referenceMask, &scratch,
+                                           length, 1.0);
+      SumThreshold::VerticalAVX512Dumas(&image, &mask, &vScratch, length, 1.0);
+      BOOST_CHECK_MESSAGE(referenceMask == mask, "vertical, " + str.str());
+    }
+  }
+}
+#endif  // defined(__AVX512F__) || defined(__x86_64__)
+
+BOOST_AUTO_TEST_CASE(isa_names) {
+  for (SumThreshold::Isa isa :
+       {SumThreshold::Isa::Reference, SumThreshold::Isa::SSE,
+        SumThreshold::Isa::AVX2, SumThreshold::Isa::AVX512}) {
+    BOOST_CHECK(SumThreshold::ParseIsa(SumThreshold::IsaName(isa)) == isa);
+  }
+  BOOST_CHECK(SumThreshold::ParseIsa("AVX512") == SumThreshold::Isa::AVX512);
+  BOOST_CHECK_THROW(SumThreshold::ParseIsa("mmx"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(selected_isa) {
+  const SumThreshold::Isa initial = SumThreshold::SelectedIsa();
+  BOOST_CHECK(SumThreshold::IsSupported(initial));
+  BOOST_CHECK(SumThreshold::IsSupported(SumThreshold::BestSupportedIsa()));
+
+  for (SumThreshold::Isa isa :
+       {SumThreshold::Isa::Reference, SumThreshold::Isa::SSE,
+        SumThreshold::Isa::AVX2, SumThreshold::Isa::AVX512}) {
+    if (SumThreshold::IsSupported(isa)) {
+      SumThreshold::SelectIsa(isa);
+      BOOST_CHECK(SumThreshold::SelectedIsa() == isa);
+      CompareHorizontalSumThreshold(
+          [](const Image2D* input, Mask2D* mask, Mask2D* scratch,
+             size_t length, num_t threshold) {
+            SumThreshold::HorizontalLarge(input, mask, scratch, length,
+                                          threshold);
+          });
+      CompareVerticalSumThreshold(
+          [](const Image2D* input, Mask2D* mask, Mask2D* scratch,
+             size_t length, num_t threshold) {
+            SumThreshold::VerticalScratch vScratch(input->Width(),
+                                                   input->Height());
+            SumThreshold::VerticalLarge(input, mask, scratch, &vScratch,
+                                        length, threshold);
+          },
+          {});
+    } else {
+      BOOST_CHECK_THROW(SumThreshold::SelectIsa(isa), std::runtime_error);
+    }
+  }
+  SumThreshold::SelectIsa(initial);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+#include "../../aoluarunner/baselinequeue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using imagesets::BaselineData;
+using imagesets::ImageSetIndex;
+
+namespace {
+constexpr size_t kBaselineCount = 1000;
+
+std::vector<std::unique_ptr<BaselineData>> MakeBatch(size_t start,
+                                                     size_t count) {
+  std::vector<std::unique_ptr<BaselineData>> batch;
+  for (size_t i = start; i != start + count; ++i)
+    batch.emplace_back(
+        std::make_unique<BaselineData>(ImageSetIndex(kBaselineCount, i)));
+  return batch;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(baseline_queue, *boost::unit_test::label("aoluarunner"))
+
+BOOST_AUTO_TEST_CASE(fifo_order) {
+  BaselineQueue queue(1, BaselineOrder::Read);
+  queue.PushBatch(MakeBatch(0, 3));
+  queue.PushBatch(MakeBatch(3, 2));
+  BOOST_CHECK_EQUAL(queue.Size(), 5u);
+  for (size_t i = 0; i != 5; ++i) {
+    const std::unique_ptr<BaselineData> baseline = queue.Pop(0);
+    BOOST_REQUIRE(baseline);
+    BOOST_CHECK_EQUAL(baseline->Index().Value(), i);
+    BOOST_CHECK_EQUAL(queue.Size(), 4 - i);
+  }
+  queue.SetFinished();
+  BOOST_CHECK(!queue.Pop(0));
+}
+
+BOOST_AUTO_TEST_CASE(steal_from_other_queue) {
+  BaselineQueue queue(2, BaselineOrder::Read);
+  queue.PushBatch(MakeBatch(0, 2));
+  // Thread 0 first takes its own baseline, and then the one of thread 1
+  BOOST_CHECK_EQUAL(queue.Pop(0)->Index().Value(), 0u);
+  BOOST_CHECK_EQUAL(queue.Pop(0)->Index().Value(), 1u);
+  BOOST_CHECK_EQUAL(queue.StolenCount(), 1u);
+  BOOST_CHECK_EQUAL(queue.Size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(producer_consumer) {
+  constexpr size_t kThreadCount = 4;
+  constexpr size_t kMaxQueued = 16;
+  BaselineQueue queue(kThreadCount, BaselineOrder::Read);
+
+  std::vector<std::atomic<size_t>> popCounts(kBaselineCount);
+  std::vector<std::thread> consumers;
+  for (size_t thread = 0; thread != kThreadCount; ++thread) {
+    consumers.emplace_back([&, thread]() {
+      while (std::unique_ptr<BaselineData> baseline = queue.Pop(thread))
+        ++popCounts[baseline->Index().Value()];
+    });
+  }
+
+  // Like the reader thread, the producer waits until the queue has room
+  // before it pushes the next batch. The size may never exceed what was
+  // pushed, otherwise the room computed from it underflows.
+  bool sizeIsValid = true;
+  size_t pushed = 0;
+  while (pushed != kBaselineCount) {
+    queue.WaitForSizeAtMost(kMaxQueued / 2);
+    const size_t queued = queue.Size();
+    sizeIsValid = sizeIsValid && queued <= kMaxQueued;
+    const size_t count =
+        std::min(kMaxQueued - queued, kBaselineCount - pushed);
+    queue.PushBatch(MakeBatch(pushed, count));
+    pushed += count;
+  }
+  queue.SetFinished();
+  for (std::thread& consumer : consumers) consumer.join();
+
+  BOOST_CHECK(sizeIsValid);
+  BOOST_CHECK_EQUAL(queue.Size(), 0u);
+  for (size_t i = 0; i != kBaselineCount; ++i)
+    BOOST_CHECK_EQUAL(popCounts[i].load(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(abort_wakes_waiters) {
+  BaselineQueue queue(2, BaselineOrder::Read);
+  queue.PushBatch(MakeBatch(0, 4));
+  std::thread consumer([&]() {
+    // Blocks in Pop() once the own and the other queue are empty
+    while (queue.Pop(0)) {
+    }
+  });
+  queue.WaitForSizeAtMost(0);
+  queue.Abort();
+  consumer.join();
+  BOOST_CHECK(queue.IsAborted());
+  // The reader is not blocked after an abort either
+  queue.PushBatch(MakeBatch(4, 4));
+  queue.WaitForSizeAtMost(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,192 @@
+#include "../../imagesets/filterbankset.h"
+
+#include "../../util/memoryplanner.h"
+#include "../../util/progress/dummyprogresslistener.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using imagesets::BaselineData;
+using imagesets::FilterBankSet;
+
+namespace {
+constexpr size_t kChannelCount = 70;
+constexpr size_t kSampleCount = 150;
+const std::string kFilename = "test-filterbank-set.fil";
+
+void WriteString(std::ostream& stream, const std::string& str) {
+  const int32_t length = str.size();
+  stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+  stream.write(str.data(), length);
+}
+
+void WriteInt(std::ostream& stream, const std::string& keyword,
+              int32_t value) {
+  WriteString(stream, keyword);
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void WriteDouble(std::ostream& stream, const std::string& keyword,
+                 double value) {
+  WriteString(stream, keyword);
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+float TestValue(size_t timestep, size_t channel) {
+  return (timestep * 7 + channel) % 200;
+}
+
+/**
+ * Writes a filterbank file with samples of type T and returns the size of
+ * the header.
+ */
+template <typename T>
+size_t WriteFilterBank(size_t bitCount, size_t sampleCount = kSampleCount) {
+  std::ofstream file(kFilename, std::ios::binary);
+  WriteString(file, "HEADER_START");
+  WriteDouble(file, "tsamp", 0.5);
+  WriteDouble(file, "fch1", 150.0);
+  WriteDouble(file, "foff", -0.1);
+  WriteInt(file, "nchans", kChannelCount);
+  WriteInt(file, "nbits", bitCount);
+  WriteString(file, "HEADER_END");
+  const size_t headerSize = file.tellp();
+  for (size_t t = 0; t != sampleCount; ++t) {
+    for (size_t ch = 0; ch != kChannelCount; ++ch) {
+      T value = TestValue(t, ch);
+      if constexpr (std::is_floating_point_v<T>)
+        if (t == 3 && ch == 5) value = std::numeric_limits<T>::quiet_NaN();
+      file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+  }
+  return headerSize;
+}
+
+template <typename T>
+void TestReadAndWrite(size_t bitCount) {
+  const size_t headerSize = WriteFilterBank<T>(bitCount);
+  {
+    FilterBankSet set(kFilename);
+    set.SetThreadCount(3);
+    set.Initialize();
+    BOOST_REQUIRE_EQUAL(set.Size(), 1u);
+
+    set.AddReadRequest(set.StartIndex());
+    DummyProgressListener progress;
+    set.PerformReadRequests(progress);
+    const std::unique_ptr<BaselineData> baseline = set.GetNextRequested();
+    const Image2DCPtr image = baseline->Data().GetSingleImage();
+    const Mask2DCPtr mask = baseline->Data().GetSingleMask();
+    BOOST_REQUIRE_EQUAL(image->Width(), kSampleCount);
+    BOOST_REQUIRE_EQUAL(image->Height(), kChannelCount);
+    BOOST_CHECK_EQUAL(baseline->MetaData()->ObservationTimes().size(),
+                      kSampleCount);
+    const bool isFloat = std::is_floating_point_v<T>;
+    for (size_t ch = 0; ch != kChannelCount; ++ch) {
+      for (size_t t = 0; t != kSampleCount; ++t) {
+        if (isFloat && t == 3 && ch == 5) {
+          BOOST_CHECK(!std::isfinite(image->Value(t, ch)));
+          BOOST_CHECK(mask->Value(t, ch));
+        } else {
+          BOOST_CHECK_EQUAL(image->Value(t, ch), TestValue(t, ch));
+          BOOST_CHECK(!mask->Value(t, ch));
+        }
+      }
+    }
+
+    const Mask2DPtr flags =
+        Mask2D::CreateSetMaskPtr<false>(kSampleCount, kChannelCount);
+    flags->SetValue(0, 0, true);
+    flags->SetValue(kSampleCount - 1, kChannelCount - 1, true);
+    flags->SetValue(100, 66, true);
+    std::vector<Mask2DCPtr> flagVector{flags};
+    set.AddWriteFlagsTask(set.StartIndex(), flagVector);
+  }
+
+  std::ifstream file(kFilename, std::ios::binary);
+  file.seekg(headerSize);
+  std::vector<T> data(kSampleCount * kChannelCount);
+  file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(T));
+  BOOST_REQUIRE(file.good());
+  for (size_t t = 0; t != kSampleCount; ++t) {
+    for (size_t ch = 0; ch != kChannelCount; ++ch) {
+      const T value = data[t * kChannelCount + ch];
+      const bool isNaN = std::is_floating_point_v<T> && t == 3 && ch == 5;
+      const bool isFlagged =
+          (t == 0 && ch == 0) || (t == 100 && ch == 66) ||
+          (t == kSampleCount - 1 && ch == kChannelCount - 1) || isNaN;
+      if (!isFlagged)
+        BOOST_CHECK_EQUAL(value, T(TestValue(t, ch)));
+      else if constexpr (std::is_floating_point_v<T>)
+        BOOST_CHECK(std::isnan(value));
+      else
+        BOOST_CHECK_EQUAL(value, T(0));
+    }
+  }
+  std::filesystem::remove(kFilename);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(filterbank_set, *boost::unit_test::label("imagesets"))
+
+BOOST_AUTO_TEST_CASE(read_and_write_8_bit) { TestReadAndWrite<uint8_t>(8); }
+
+BOOST_AUTO_TEST_CASE(read_and_write_16_bit) { TestReadAndWrite<uint16_t>(16); }
+
+BOOST_AUTO_TEST_CASE(read_and_write_32_bit) { TestReadAndWrite<float>(32); }
+
+BOOST_AUTO_TEST_CASE(interval_count_independent_of_threads) {
+  WriteFilterBank<float>(32);
+  // Limit the memory such that the set needs to be split
+  MemoryPlanner::SetLimit(uint64_t(kSampleCount * kChannelCount * 5 * 4));
+  std::vector<size_t> sizes;
+  for (size_t threadCount : {1, 4, 16}) {
+    FilterBankSet set(kFilename);
+    set.SetThreadCount(threadCount);
+    set.Initialize();
+    sizes.emplace_back(set.Size());
+  }
+  MemoryPlanner::SetLimit(uint64_t(0));
+  BOOST_CHECK_GT(sizes[0], 1u);
+  BOOST_CHECK_EQUAL(sizes[1], sizes[0]);
+  BOOST_CHECK_EQUAL(sizes[2], sizes[0]);
+  std::filesystem::remove(kFilename);
+}
+
+BOOST_AUTO_TEST_CASE(zero_samples) {
+  const size_t headerSize = WriteFilterBank<float>(32, 0);
+  {
+    FilterBankSet set(kFilename);
+    set.SetThreadCount(4);
+    set.Initialize();
+    BOOST_REQUIRE_EQUAL(set.Size(), 1u);
+
+    set.AddReadRequest(set.StartIndex());
+    DummyProgressListener progress;
+    set.PerformReadRequests(progress);
+    const std::unique_ptr<BaselineData> baseline = set.GetNextRequested();
+    BOOST_CHECK_EQUAL(baseline->Data().GetSingleImage()->Width(), 0u);
+
+    std::vector<Mask2DCPtr> flags{
+        Mask2D::CreateSetMaskPtr<false>(0, kChannelCount)};
+    set.AddWriteFlagsTask(set.StartIndex(), flags);
+  }
+  BOOST_CHECK_EQUAL(std::filesystem::file_size(kFilename), headerSize);
+  std::filesystem::remove(kFilename);
+}
+
+BOOST_AUTO_TEST_CASE(unsupported_bit_count) {
+  WriteFilterBank<double>(64);
+  BOOST_CHECK_THROW(FilterBankSet set(kFilename), std::runtime_error);
+  std::filesystem::remove(kFilename);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -55,3 +55,28 @@ def test_set_mask():
     buf = flag_mask.get_buffer()
     assert sum(sum(buf)) == 1
     assert buf[10, 20] == True
+
+
+def test_views():
+    flagger = aoflagger.AOFlagger()
+    n_channels = 30
+    n_times = 70
+    data = flagger.make_image_set(n_times, n_channels, 2, 0.0)
+    values = numpy.arange(n_channels * n_times, dtype=numpy.float32).reshape(
+        n_channels, n_times
+    )
+    data.set_image_buffer(1, values)
+    view = data.get_image_view(1)
+    assert view.dtype == numpy.float32
+    assert (view == values).all()
+    view[3, 4] = -1.0
+    assert data.get_image_buffer(1)[3, 4] == -1.0
+    assert not data.get_image_view(0).any()
+
+    flag_mask = flagger.make_flag_mask(n_times, n_channels, False)
+    flag_view = numpy.asarray(flag_mask)
+    assert flag_view.shape == (n_channels, n_times)
+    flag_view[5, 6] = True
+    buf = flag_mask.get_buffer()
+    assert sum(sum(buf)) == 1
+    assert buf[5, 6] == True
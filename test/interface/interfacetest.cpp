@@ -8,6 +8,10 @@
 
 #include <version.h>
 
+#include <algorithm>
+#include <future>
+#include <vector>
+
 using algorithms::TestSetGenerator;
 
 BOOST_AUTO_TEST_SUITE(interface, *boost::unit_test::label("interface"))
@@ -100,6 +104,129 @@ BOOST_AUTO_TEST_CASE(runs) {
   BOOST_CHECK_LT(mask2DB.GetCount<true>(), width * height / 5);
 }
 
+BOOST_AUTO_TEST_CASE(run_batch_and_async) {
+  const size_t width = 200, height = 50, nSets = 6;
+  aoflagger::AOFlagger flagger;
+  aoflagger::Strategy strategy =
+      flagger.LoadStrategyFile(flagger.FindStrategyFile());
+  strategy.SetThreadCount(3);
+  BOOST_CHECK_EQUAL(strategy.ThreadCount(), 3u);
+
+  std::vector<aoflagger::ImageSet> imageSets;
+  std::vector<aoflagger::FlagMask> inputMasks;
+  for (size_t i = 0; i != nSets; ++i) {
+    const TimeFrequencyData data = TestSetGenerator::MakeTestSet(
+        algorithms::RFITestSet::FullBandBursts,
+        algorithms::BackgroundTestSet::Empty, width, height);
+    aoflagger::ImageSet imageSet = flagger.MakeImageSet(width, height, 2);
+    for (size_t image = 0; image != 2; ++image) {
+      const Image2DCPtr source = data.GetImage(image);
+      for (size_t y = 0; y != height; ++y)
+        std::copy_n(source->ValuePtr(0, y), width,
+                    imageSet.ImageBuffer(image) +
+                        y * imageSet.HorizontalStride());
+    }
+    imageSets.emplace_back(std::move(imageSet));
+    inputMasks.emplace_back(flagger.MakeFlagMask(width, height, false));
+  }
+
+  const std::vector<aoflagger::FlagMask> batchMasks =
+      strategy.RunBatch(imageSets);
+  const std::vector<aoflagger::FlagMask> batchMasksWithInput =
+      strategy.RunBatch(imageSets, inputMasks);
+  std::vector<std::future<aoflagger::FlagMask>> futures;
+  for (const aoflagger::ImageSet& imageSet : imageSets)
+    futures.emplace_back(strategy.RunAsync(imageSet));
+  BOOST_REQUIRE_EQUAL(batchMasks.size(), nSets);
+  BOOST_REQUIRE_EQUAL(batchMasksWithInput.size(), nSets);
+
+  // All ways of running give the same flags
+  for (size_t i = 0; i != nSets; ++i) {
+    const aoflagger::FlagMask expected = strategy.Run(imageSets[i]);
+    const aoflagger::FlagMask asyncMask = futures[i].get();
+    size_t count = 0;
+    for (size_t y = 0; y != height; ++y) {
+      for (size_t x = 0; x != width; ++x) {
+        const size_t index = x + y * expected.HorizontalStride();
+        const bool flag = expected.Buffer()[index];
+        BOOST_CHECK_EQUAL(batchMasks[i].Buffer()[index], flag);
+        BOOST_CHECK_EQUAL(batchMasksWithInput[i].Buffer()[index], flag);
+        BOOST_CHECK_EQUAL(asyncMask.Buffer()[index], flag);
+        if (flag) ++count;
+      }
+    }
+    BOOST_CHECK_GT(count, 0u);
+  }
+
+  BOOST_CHECK_THROW(strategy.RunBatch(imageSets, {}), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(streaming) {
+  const size_t width = 500, height = 50, blockSize = 100, contextSize = 30;
+  aoflagger::AOFlagger flagger;
+  aoflagger::Strategy strategy =
+      flagger.LoadStrategyFile(flagger.FindStrategyFile());
+  const TimeFrequencyData data = TestSetGenerator::MakeTestSet(
+      algorithms::RFITestSet::FullBandBursts,
+      algorithms::BackgroundTestSet::Empty, width, height);
+  const auto makeImageSet = [&](size_t start, size_t end) {
+    aoflagger::ImageSet imageSet = flagger.MakeImageSet(end - start, height, 2);
+    for (size_t image = 0; image != 2; ++image) {
+      const Image2DCPtr source = data.GetImage(image);
+      for (size_t y = 0; y != height; ++y)
+        std::copy_n(source->ValuePtr(start, y), end - start,
+                    imageSet.ImageBuffer(image) +
+                        y * imageSet.HorizontalStride());
+    }
+    return imageSet;
+  };
+
+  aoflagger::StreamingFlagger stream = flagger.MakeStreamingFlagger(
+      strategy, height, 2, blockSize, contextSize);
+  BOOST_CHECK_EQUAL(stream.Latency(), blockSize + contextSize);
+  BOOST_CHECK_THROW(stream.TakeFinished(), std::runtime_error);
+  // Pieces of varying width
+  const std::vector<size_t> pieceEnds{1, 37, 130, 131, 300, 451, width};
+  size_t start = 0;
+  for (const size_t end : pieceEnds) {
+    stream.Add(makeImageSet(start, end));
+    BOOST_CHECK_GE(stream.FinishedCount() + stream.Latency(), end);
+    start = end;
+  }
+  const size_t finishedBeforeEnd = stream.FinishedCount();
+  BOOST_CHECK_EQUAL(finishedBeforeEnd % blockSize, 0u);
+  stream.Finish();
+  BOOST_CHECK_EQUAL(stream.FinishedCount(), width);
+  const aoflagger::FlagMask flags = stream.TakeFinished();
+  BOOST_CHECK_EQUAL(flags.Width(), width);
+  BOOST_CHECK_EQUAL(flags.Height(), height);
+  BOOST_CHECK_EQUAL(stream.FinishedCount(), 0u);
+
+  size_t count = 0;
+  for (size_t y = 0; y != height; ++y)
+    count += std::count(flags.Buffer() + y * flags.HorizontalStride(),
+                        flags.Buffer() + y * flags.HorizontalStride() + width,
+                        true);
+  BOOST_CHECK_GT(count, 0u);
+  BOOST_CHECK_LT(count, width * height / 5);
+
+  // Without context, every block is flagged like a separate image set
+  aoflagger::StreamingFlagger blockStream =
+      flagger.MakeStreamingFlagger(strategy, height, 2, blockSize, 0);
+  blockStream.Add(makeImageSet(0, 2 * blockSize));
+  const aoflagger::FlagMask blockFlags = blockStream.TakeFinished();
+  BOOST_REQUIRE_EQUAL(blockFlags.Width(), 2 * blockSize);
+  const aoflagger::FlagMask expected =
+      strategy.Run(makeImageSet(blockSize, 2 * blockSize));
+  for (size_t y = 0; y != height; ++y) {
+    const bool* row = blockFlags.Buffer() + y * blockFlags.HorizontalStride();
+    const bool* expectedRow =
+        expected.Buffer() + y * expected.HorizontalStride();
+    for (size_t x = 0; x != blockSize; ++x)
+      BOOST_CHECK_EQUAL(row[blockSize + x], expectedRow[x]);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(version) {
   short major, minor, subminor;
   aoflagger::AOFlagger::GetVersion(major, minor, subminor);
@@ -0,0 +1,53 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../../lua/luathreadgroup.h"
+
+#include <stdexcept>
+
+BOOST_AUTO_TEST_SUITE(lua_thread_group, *boost::unit_test::label("lua"))
+
+namespace {
+lua_Integer GetInteger(lua_State* state, const char* name) {
+  lua_getglobal(state, name);
+  const lua_Integer value = lua_tointeger(state, -1);
+  lua_pop(state, 1);
+  return value;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(lazy_initialization) {
+  LuaThreadGroup lua(4);
+  BOOST_CHECK_EQUAL(lua.NThreads(), 4u);
+  BOOST_CHECK_EQUAL(lua.InitializedThreadCount(), 1u);
+
+  lua.RunPreamble({"x = 3"});
+  lua.LoadText("y = x * 2\n");
+  BOOST_CHECK_EQUAL(lua.InitializedThreadCount(), 1u);
+  BOOST_CHECK_EQUAL(GetInteger(lua.GetThread(0).State(), "y"), 6);
+
+  // A thread that is used later ends up in the same state
+  BOOST_CHECK_EQUAL(GetInteger(lua.GetThread(3).State(), "y"), 6);
+  BOOST_CHECK_EQUAL(lua.InitializedThreadCount(), 2u);
+
+  // Every thread has its own state
+  lua_pushinteger(lua.GetThread(3).State(), 7);
+  lua_setglobal(lua.GetThread(3).State(), "y");
+  BOOST_CHECK_EQUAL(GetInteger(lua.GetThread(0).State(), "y"), 6);
+  BOOST_CHECK_EQUAL(GetInteger(lua.GetThread(3).State(), "y"), 7);
+}
+
+BOOST_AUTO_TEST_CASE(steps_are_ordered) {
+  LuaThreadGroup lua(2);
+  lua.LoadText("z = 1\n");
+  lua.RunPreamble({"z = z + 10"});
+  lua.LoadText("z = z * 2\n");
+  BOOST_CHECK_EQUAL(GetInteger(lua.GetThread(0).State(), "z"), 22);
+  BOOST_CHECK_EQUAL(GetInteger(lua.GetThread(1).State(), "z"), 22);
+}
+
+BOOST_AUTO_TEST_CASE(syntax_error) {
+  LuaThreadGroup lua(2);
+  BOOST_CHECK_THROW(lua.LoadText("this is not lua"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,151 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../../lua/default-strategy.h"
+#include "../../lua/luastrategy.h"
+#include "../../lua/luathreadgroup.h"
+#include "../../lua/nativedefaultstrategy.h"
+#include "../../lua/scriptdata.h"
+
+#include "../../algorithms/testsetgenerator.h"
+
+#include <aocommon/polarization.h>
+
+#include <cmath>
+#include <string>
+
+using aocommon::Polarization;
+using aocommon::PolarizationEnum;
+
+using algorithms::BackgroundTestSet;
+using algorithms::RFITestSet;
+using algorithms::TestSetGenerator;
+
+BOOST_AUTO_TEST_SUITE(native_default_strategy,
+                      *boost::unit_test::label("lua"))
+
+namespace {
+std::string DefaultStrategyText() {
+  return std::string(
+      reinterpret_cast<const char*>(data_strategies_generic_default_lua),
+      data_strategies_generic_default_lua_len);
+}
+
+TimeFrequencyData MakeFullPolarizationSet(size_t width, size_t height) {
+  TimeFrequencyData allData;
+  const PolarizationEnum pols[4] = {Polarization::XX, Polarization::XY,
+                                    Polarization::YX, Polarization::YY};
+  for (size_t i = 0; i != 4; ++i) {
+    TimeFrequencyData real = TestSetGenerator::MakeTestSet(
+        RFITestSet::FullBandBursts, BackgroundTestSet::Empty, width, height);
+    TimeFrequencyData imag = TestSetGenerator::MakeTestSet(
+        RFITestSet::FullBandBursts, BackgroundTestSet::Empty, width, height);
+    TimeFrequencyData tfData(pols[i], real.GetImage(0), imag.GetImage(0));
+    if (i == 0)
+      allData = tfData;
+    else
+      allData =
+          TimeFrequencyData::MakeFromPolarizationCombination(allData, tfData);
+  }
+  return allData;
+}
+
+void CheckEqual(const Image2D& a, const Image2D& b) {
+  BOOST_REQUIRE_EQUAL(a.Width(), b.Width());
+  BOOST_REQUIRE_EQUAL(a.Height(), b.Height());
+  size_t differences = 0;
+  for (size_t y = 0; y != a.Height(); ++y) {
+    for (size_t x = 0; x != a.Width(); ++x) {
+      const num_t va = a.Value(x, y), vb = b.Value(x, y);
+      if (va != vb && !(std::isnan(va) && std::isnan(vb))) ++differences;
+    }
+  }
+  BOOST_CHECK_EQUAL(differences, 0u);
+}
+
+void CheckEqualToLua(const TimeFrequencyData& input) {
+  const TimeFrequencyMetaDataCPtr metaData(new TimeFrequencyMetaData());
+
+  LuaStrategy lua;
+  lua.Initialize();
+  lua.LoadText(DefaultStrategyText());
+  ScriptData luaScriptData;
+  TimeFrequencyData luaResult = input;
+  lua.Execute(luaResult, metaData, luaScriptData, "execute");
+
+  NativeDefaultStrategy native;
+  ScriptData nativeScriptData;
+  // Run twice, to also test that reusing the scratch masks does not change
+  // the result.
+  for (size_t run = 0; run != 2; ++run) {
+    TimeFrequencyData nativeResult = input;
+    native.Execute(nativeResult, metaData, nativeScriptData);
+
+    BOOST_REQUIRE_EQUAL(nativeResult.MaskCount(), luaResult.MaskCount());
+    for (size_t i = 0; i != luaResult.MaskCount(); ++i)
+      BOOST_CHECK(*nativeResult.GetMask(i) == *luaResult.GetMask(i));
+    BOOST_REQUIRE_EQUAL(nativeResult.ImageCount(), luaResult.ImageCount());
+    for (size_t i = 0; i != luaResult.ImageCount(); ++i)
+      CheckEqual(*nativeResult.GetImage(i), *luaResult.GetImage(i));
+  }
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(is_default_strategy) {
+  const std::string text = DefaultStrategyText();
+  BOOST_CHECK(NativeDefaultStrategy::IsDefaultStrategy(text));
+  BOOST_CHECK(!NativeDefaultStrategy::IsDefaultStrategy(text + "\n"));
+  BOOST_CHECK(!NativeDefaultStrategy::IsDefaultStrategy(""));
+  BOOST_CHECK(
+      !NativeDefaultStrategy::IsDefaultStrategyFile("does-not-exist.lua"));
+}
+
+BOOST_AUTO_TEST_CASE(amplitude_equals_lua) {
+  const size_t width = 200, height = 50;
+  const TimeFrequencyData data = TestSetGenerator::MakeTestSet(
+      RFITestSet::FullBandBursts, BackgroundTestSet::Empty, width, height);
+  const TimeFrequencyData amplitude(TimeFrequencyData::AmplitudePart,
+                                    Polarization::StokesI, data.GetImage(0));
+  CheckEqualToLua(amplitude);
+}
+
+BOOST_AUTO_TEST_CASE(full_polarization_equals_lua) {
+  TimeFrequencyData data = MakeFullPolarizationSet(200, 50);
+  // Also test existing flags and non-finite values
+  Mask2DPtr mask = Mask2D::CreateSetMaskPtr<false>(200, 50);
+  mask->SetAllVertically<true>(17);
+  data.SetGlobalMask(mask);
+  Image2DPtr image = Image2D::MakePtr(*data.GetImage(2));
+  image->SetValue(30, 10, std::nan(""));
+  data.SetImage(2, image);
+  CheckEqualToLua(data);
+}
+
+BOOST_AUTO_TEST_CASE(thread_group_selection) {
+  const std::string text = DefaultStrategyText();
+  {
+    LuaThreadGroup lua(2);
+    lua.LoadText(text);
+    BOOST_CHECK(lua.UsesNativeDefaultStrategy());
+
+    TimeFrequencyData data = MakeFullPolarizationSet(100, 20);
+    ScriptData scriptData;
+    lua.Execute(1, data, TimeFrequencyMetaDataCPtr(), scriptData, "execute");
+    BOOST_CHECK_GT(data.MaskCount(), 0u);
+    // The native strategy does not need a Lua state
+    BOOST_CHECK_EQUAL(lua.InitializedThreadCount(), 1u);
+  }
+  {
+    LuaThreadGroup lua(1);
+    lua.RunPreamble({"x = 1"});
+    lua.LoadText(text);
+    BOOST_CHECK(!lua.UsesNativeDefaultStrategy());
+  }
+  {
+    LuaThreadGroup lua(1);
+    lua.LoadText(text);
+    lua.LoadText("function execute(data) data:clear_mask() end\n");
+    BOOST_CHECK(!lua.UsesNativeDefaultStrategy());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,9 +1,46 @@
 #include "msio/baselinereader.h"
+#include "msio/directbaselinereader.h"
+
+#include "structures/timefrequencydata.h"
+
+#include "util/progress/dummyprogresslistener.h"
 
 #include "test/config.h"
 
+#include <casacore/tables/Tables/ArrayColumn.h>
+#include <casacore/tables/Tables/ScalarColumn.h>
+#include <casacore/tables/Tables/Table.h>
+
 #include <boost/test/unit_test.hpp>
 
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+const std::string kCopyPath = "test-baseline-reader-copy.ms";
+
+bool TestFlag(size_t baseline, size_t polarization, size_t x, size_t y) {
+  return (x * 3 + y + polarization + baseline) % 5 == 0;
+}
+
+TimeFrequencyData ReadBaseline(DirectBaselineReader& reader,
+                               const std::pair<int, int>& baseline) {
+  reader.AddReadRequest(baseline.first, baseline.second, 0, 0);
+  DummyProgressListener progress;
+  reader.PerformReadRequests(progress);
+  std::vector<UVW> uvw;
+  return reader.GetNextResult(uvw);
+}
+
+std::vector<bool> ReadFlagColumn(casacore::Table& table) {
+  const casacore::ArrayColumn<bool> flagColumn(table, "FLAG");
+  const casacore::Array<bool> flags = flagColumn.getColumn();
+  return std::vector<bool>(flags.begin(), flags.end());
+}
+}  // namespace
+
 BOOST_AUTO_TEST_SUITE(baseline_reader)
 
 BOOST_AUTO_TEST_CASE(test_measurement_set_interval_data_size) {
@@ -36,4 +73,80 @@ BOOST_AUTO_TEST_CASE(test_measurement_set_interval_data_size) {
                       ms_name, 0, 15 * i) == 3'952'800 * i);
 }
 
+BOOST_AUTO_TEST_CASE(direct_reader_write_flags) {
+  std::filesystem::remove_all(kCopyPath);
+  std::filesystem::copy(std::string(kTestMsSize), kCopyPath,
+                        std::filesystem::copy_options::recursive);
+
+  // The first two rows have different baselines of the same timestep, so the
+  // rows of these baselines are interleaved in the main table.
+  std::vector<std::pair<int, int>> baselines;
+  std::vector<bool> originalFlags;
+  size_t rowSize;
+  {
+    casacore::Table table(kCopyPath);
+    const casacore::ScalarColumn<int> antenna1Column(table, "ANTENNA1");
+    const casacore::ScalarColumn<int> antenna2Column(table, "ANTENNA2");
+    BOOST_REQUIRE_GT(table.nrow(), 2u);
+    for (size_t row = 0; row != 2; ++row)
+      baselines.emplace_back(antenna1Column(row), antenna2Column(row));
+    BOOST_REQUIRE(baselines[0] != baselines[1]);
+    originalFlags = ReadFlagColumn(table);
+    rowSize = originalFlags.size() / table.nrow();
+  }
+
+  {
+    DirectBaselineReader reader(kCopyPath);
+    for (size_t b = 0; b != baselines.size(); ++b) {
+      const TimeFrequencyData data = ReadBaseline(reader, baselines[b]);
+      std::vector<Mask2DCPtr> flags;
+      for (size_t p = 0; p != data.MaskCount(); ++p) {
+        const Mask2DPtr mask = Mask2D::MakePtr(*data.GetMask(p));
+        for (size_t y = 0; y != mask->Height(); ++y) {
+          for (size_t x = 0; x != mask->Width(); ++x)
+            mask->SetValue(x, y, TestFlag(b, p, x, y));
+        }
+        flags.emplace_back(mask);
+      }
+      reader.AddWriteTask(flags, baselines[b].first, baselines[b].second, 0,
+                          0);
+    }
+    reader.PerformFlagWriteRequests();
+  }
+
+  // Read the written flags back
+  DirectBaselineReader reader(kCopyPath);
+  for (size_t b = 0; b != baselines.size(); ++b) {
+    const TimeFrequencyData data = ReadBaseline(reader, baselines[b]);
+    BOOST_REQUIRE_GT(data.MaskCount(), 0u);
+    for (size_t p = 0; p != data.MaskCount(); ++p) {
+      const Mask2DCPtr mask = data.GetMask(p);
+      BOOST_REQUIRE_GT(mask->Width(), 1u);
+      for (size_t y = 0; y != mask->Height(); ++y) {
+        for (size_t x = 0; x != mask->Width(); ++x)
+          BOOST_REQUIRE_EQUAL(mask->Value(x, y), TestFlag(b, p, x, y));
+      }
+    }
+  }
+
+  // The rows of other baselines keep their flags
+  casacore::Table table(kCopyPath);
+  const casacore::ScalarColumn<int> antenna1Column(table, "ANTENNA1");
+  const casacore::ScalarColumn<int> antenna2Column(table, "ANTENNA2");
+  const std::vector<bool> flags = ReadFlagColumn(table);
+  BOOST_REQUIRE_EQUAL(flags.size(), originalFlags.size());
+  size_t untouchedRowCount = 0;
+  for (size_t row = 0; row != table.nrow(); ++row) {
+    const std::pair<int, int> baseline(antenna1Column(row),
+                                       antenna2Column(row));
+    if (baseline != baselines[0] && baseline != baselines[1]) {
+      ++untouchedRowCount;
+      for (size_t i = row * rowSize; i != (row + 1) * rowSize; ++i)
+        BOOST_REQUIRE_EQUAL(flags[i], originalFlags[i]);
+    }
+  }
+  BOOST_CHECK_GT(untouchedRowCount, 0u);
+  std::filesystem::remove_all(kCopyPath);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
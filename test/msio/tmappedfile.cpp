@@ -0,0 +1,65 @@
+#include "msio/mappedfile.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(mapped_file)
+
+BOOST_AUTO_TEST_CASE(unmapped) {
+  const MappedFile file;
+  BOOST_CHECK(!file.IsMapped());
+  BOOST_CHECK_EQUAL(file.Size(), 0u);
+  // Hints on an unmapped file should be ignored.
+  file.WillNeed(0, 100);
+}
+
+BOOST_AUTO_TEST_CASE(read_and_update) {
+  const std::string filename = "test-mapped-file.tmp";
+  std::string contents;
+  for (size_t i = 0; i != 10000; ++i) contents += char('a' + i % 26);
+  std::ofstream(filename, std::ios::binary) << contents;
+
+  MappedFile file(filename, true);
+  BOOST_REQUIRE(file.IsMapped());
+  BOOST_REQUIRE_EQUAL(file.Size(), contents.size());
+  BOOST_CHECK(std::string(file.Data(), file.Size()) == contents);
+  file.WillNeed(4097, 20000);
+
+  // Changes made through a stream are visible in the mapping
+  {
+    std::ofstream stream(filename,
+                         std::ios::binary | std::ios::in | std::ios::out);
+    stream.seekp(5000);
+    stream.write("XYZ", 3);
+  }
+  BOOST_CHECK_EQUAL(std::string(file.Data() + 5000, 3), "XYZ");
+
+  MappedFile moved(std::move(file));
+  BOOST_CHECK(!file.IsMapped());
+  BOOST_CHECK(moved.IsMapped());
+  BOOST_CHECK_EQUAL(moved.Data()[1], 'b');
+
+  moved = MappedFile();
+  BOOST_CHECK(!moved.IsMapped());
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(empty_file) {
+  const std::string filename = "test-mapped-file-empty.tmp";
+  std::ofstream(filename, std::ios::binary).close();
+  const MappedFile file(filename, false);
+  BOOST_CHECK(!file.IsMapped());
+  BOOST_CHECK_EQUAL(file.Size(), 0u);
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(missing_file) {
+  BOOST_CHECK_THROW(MappedFile("this-file-does-not-exist.tmp", true),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+#include "msio/reorderedfilebuffer.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+std::string ReadFile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(reordered_file_buffer)
+
+BOOST_AUTO_TEST_CASE(reordered_writes) {
+  const std::string filename = "test-reordered-file-buffer.tmp";
+  constexpr size_t kBlockSize = 13;
+  constexpr size_t kBlockCount = 1000;
+  std::ofstream(filename, std::ios::binary)
+      << std::string(kBlockSize * kBlockCount, '-');
+
+  std::vector<size_t> order(kBlockCount);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 rng(42);
+  std::shuffle(order.begin(), order.end(), rng);
+
+  std::string expected(kBlockSize * kBlockCount, '-');
+  {
+    // A small buffer makes sure that several (double-buffered) flushes are
+    // performed.
+    ReorderedFileBuffer buffer(filename, 2000);
+    for (size_t i = 0; i != kBlockCount; ++i) {
+      // Leave some blocks unwritten
+      if (order[i] % 10 == 3) continue;
+      const std::string block(kBlockSize, char('a' + order[i] % 26));
+      buffer.seekp(order[i] * kBlockSize);
+      // Write the block in two parts, which should be joined again.
+      buffer.write(block.data(), 5);
+      buffer.write(block.data() + 5, kBlockSize - 5);
+      expected.replace(order[i] * kBlockSize, kBlockSize, block);
+    }
+    buffer.flush();
+    BOOST_CHECK_EQUAL(buffer.WrittenBytes(), kBlockSize * kBlockCount * 9 / 10);
+    BOOST_CHECK_LT(buffer.WriteCallCount(), kBlockCount * 2);
+  }
+  BOOST_CHECK(ReadFile(filename) == expected);
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(sequential_writes) {
+  const std::string filename = "test-reordered-file-buffer-seq.tmp";
+  std::ofstream(filename, std::ios::binary).close();
+  std::string expected;
+  {
+    ReorderedFileBuffer buffer(filename, 1 << 20);
+    for (size_t i = 0; i != 100; ++i) {
+      const std::string value = std::to_string(i) + ",";
+      buffer.write(value.data(), value.size());
+      expected += value;
+    }
+    buffer.flush();
+    // All writes are consecutive, so they should be combined in one call.
+    BOOST_CHECK_EQUAL(buffer.WriteCallCount(), 1u);
+  }
+  BOOST_CHECK(ReadFile(filename) == expected);
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(last_write_wins) {
+  const std::string filename = "test-reordered-file-buffer-overwrite.tmp";
+  std::ofstream(filename, std::ios::binary).close();
+  {
+    ReorderedFileBuffer buffer(filename, 1 << 20);
+    buffer.seekp(0);
+    buffer.write("abc", 3);
+    buffer.seekp(0);
+    buffer.write("xyz", 3);
+  }
+  BOOST_CHECK_EQUAL(ReadFile(filename), "xyz");
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(missing_file) {
+  BOOST_CHECK_THROW(
+      ReorderedFileBuffer("this-directory-does-not-exist/file.tmp", 1024),
+      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
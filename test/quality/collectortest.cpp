@@ -0,0 +1,90 @@
+#include "../../quality/collector.h"
+#include "../../quality/histogramcollection.h"
+#include "../../quality/statisticscollection.h"
+
+#include "../../util/progress/dummyprogresslistener.h"
+
+#include "test/config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <complex>
+#include <map>
+#include <string>
+
+namespace {
+
+void Collect(size_t threadCount, StatisticsCollection& statistics) {
+  Collector collector;
+  collector.SetThreadCount(threadCount);
+  HistogramCollection histograms;
+  DummyProgressListener progress;
+  collector.Collect(std::string(kTestMsSize), statistics, histograms,
+                    progress);
+}
+
+// Sums are added in a different order when the rows are processed by several
+// threads, so they may differ by rounding.
+void CheckClose(std::complex<long double> a, std::complex<long double> b) {
+  const long double tolerance = 1e-9L * std::max(1.0L, std::abs(a));
+  BOOST_CHECK_LE(std::abs(a - b), tolerance);
+}
+
+void CheckEqual(const DefaultStatistics& a, const DefaultStatistics& b) {
+  BOOST_REQUIRE_EQUAL(a.PolarizationCount(), b.PolarizationCount());
+  for (size_t p = 0; p != a.PolarizationCount(); ++p) {
+    BOOST_CHECK_EQUAL(a.rfiCount[p], b.rfiCount[p]);
+    BOOST_CHECK_EQUAL(a.count[p], b.count[p]);
+    BOOST_CHECK_EQUAL(a.dCount[p], b.dCount[p]);
+    CheckClose(a.sum[p], b.sum[p]);
+    CheckClose(a.sumP2[p], b.sumP2[p]);
+    CheckClose(a.dSum[p], b.dSum[p]);
+    CheckClose(a.dSumP2[p], b.dSumP2[p]);
+  }
+}
+
+void CheckEqual(const DoubleStatMap& a, const DoubleStatMap& b) {
+  BOOST_REQUIRE(a.Keys() == b.Keys());
+  for (size_t i = 0; i != a.size(); ++i)
+    CheckEqual(a.Values()[i], b.Values()[i]);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(collector, *boost::unit_test::label("quality"))
+
+BOOST_AUTO_TEST_CASE(parallel_equals_single_threaded) {
+  StatisticsCollection single;
+  Collect(1, single);
+  StatisticsCollection parallel;
+  Collect(4, parallel);
+
+  BOOST_REQUIRE_EQUAL(parallel.PolarizationCount(), single.PolarizationCount());
+  BOOST_CHECK(!single.FrequencyStatistics().empty());
+  CheckEqual(parallel.FrequencyStatistics(), single.FrequencyStatistics());
+
+  const std::map<double, DoubleStatMap>& singleTimes =
+      single.AllTimeStatistics();
+  const std::map<double, DoubleStatMap>& parallelTimes =
+      parallel.AllTimeStatistics();
+  BOOST_REQUIRE_EQUAL(parallelTimes.size(), singleTimes.size());
+  for (const std::pair<const double, DoubleStatMap>& times : singleTimes) {
+    BOOST_REQUIRE(parallelTimes.count(times.first));
+    CheckEqual(parallelTimes.find(times.first)->second, times.second);
+  }
+
+  const BaselineStatisticsMap& singleBaselines = single.BaselineStatistics();
+  const BaselineStatisticsMap& parallelBaselines =
+      parallel.BaselineStatistics();
+  const std::vector<std::pair<unsigned, unsigned>> baselines =
+      singleBaselines.BaselineList();
+  BOOST_CHECK(!baselines.empty());
+  BOOST_REQUIRE(parallelBaselines.BaselineList() == baselines);
+  for (const std::pair<unsigned, unsigned>& baseline : baselines)
+    CheckEqual(
+        parallelBaselines.GetStatistics(baseline.first, baseline.second),
+        singleBaselines.GetStatistics(baseline.first, baseline.second));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 
 #include <cmath>
 #include <iomanip>
+#include <sstream>
 
 BOOST_AUTO_TEST_SUITE(statistics_collection,
                       *boost::unit_test::label("quality"))
@@ -260,4 +261,209 @@ BOOST_AUTO_TEST_CASE(comparison) {
   testCollectingImage(image, mask, nTimes, nFreq);
 }
 
+BOOST_AUTO_TEST_CASE(compensated_summation) {
+  const size_t nFreq = 50, nTimes = 300;
+  Image2DPtr realImage = Image2D::CreateUnsetImagePtr(nTimes, nFreq),
+             imagImage = Image2D::CreateUnsetImagePtr(nTimes, nFreq);
+  Mask2DPtr mask = Mask2D::CreateSetMaskPtr<false>(nTimes, nFreq);
+  for (size_t y = 0; y != nFreq; ++y) {
+    for (size_t x = 0; x != nTimes; ++x) {
+      // Values of different orders of magnitude
+      realImage->SetValue(x, y, 1e4 + (x * 7 + y * 13) % 101 * 0.01f);
+      imagImage->SetValue(x, y, ((x * 3 + y) % 17) * 1e-3f - 0.008f);
+      mask->SetValue(x, y, (x + 3 * y) % 23 == 0);
+    }
+  }
+  std::vector<double> frequencies(nFreq), times(nTimes);
+  for (size_t i = 0; i != nFreq; ++i) frequencies[i] = i + 1;
+  for (size_t i = 0; i != nTimes; ++i) times[i] = i + 1;
+
+  StatisticsCollection reference(1), compensated(1);
+  compensated.SetCompensatedSummation(true);
+  BOOST_CHECK(!reference.CompensatedSummation());
+  BOOST_CHECK(compensated.CompensatedSummation());
+  for (StatisticsCollection* collection : {&reference, &compensated}) {
+    collection->InitializeBand(0, frequencies.data(), nFreq);
+    collection->AddImage(0, 1, times.data(), 0, 0, realImage, imagImage, mask,
+                         Mask2D::CreateSetMaskPtr<false>(nTimes, nFreq));
+    for (size_t t = 0; t != nTimes; ++t) {
+      collection->Add(0, 2, times[t], 0, 0, realImage->Data() + t,
+                      imagImage->Data() + t, mask->Data() + t,
+                      mask->Data() + t, nFreq, realImage->Stride(),
+                      mask->Stride(), mask->Stride());
+    }
+  }
+
+  DefaultStatistics a(1), b(1);
+  const auto checkClose = [&]() {
+    BOOST_CHECK_EQUAL(a.count[0], b.count[0]);
+    BOOST_CHECK_EQUAL(a.rfiCount[0], b.rfiCount[0]);
+    BOOST_CHECK_EQUAL(a.dCount[0], b.dCount[0]);
+    BOOST_CHECK_CLOSE(double(a.sum[0].real()), double(b.sum[0].real()), 1e-9);
+    BOOST_CHECK_CLOSE(double(a.sum[0].imag()), double(b.sum[0].imag()), 1e-9);
+    BOOST_CHECK_CLOSE(double(a.sumP2[0].real()), double(b.sumP2[0].real()),
+                      1e-9);
+    BOOST_CHECK_CLOSE(double(a.dSumP2[0].imag()), double(b.dSumP2[0].imag()),
+                      1e-9);
+  };
+  reference.GetGlobalCrossBaselineStatistics(a);
+  compensated.GetGlobalCrossBaselineStatistics(b);
+  checkClose();
+  reference.GetGlobalTimeStatistics(a);
+  compensated.GetGlobalTimeStatistics(b);
+  checkClose();
+  reference.GetGlobalFrequencyStatistics(a);
+  compensated.GetGlobalFrequencyStatistics(b);
+  checkClose();
+}
+
+BOOST_AUTO_TEST_CASE(baseline_statistics_map) {
+  BaselineStatisticsMap map(2);
+  BOOST_CHECK_EQUAL(map.AntennaCount(), 0u);
+  map.GetStatistics(3, 5).count[1] = 7;
+  map.GetStatistics(0, 1).count[0] = 2;
+  map.GetStatistics(5, 3).rfiCount[0] = 4;
+  // References stay valid when the map grows
+  DefaultStatistics& statistics = map.GetStatistics(0, 0);
+  map.GetStatistics(40, 41);
+  statistics.sum[1] = std::complex<long double>(1.5, -2.5);
+  BOOST_CHECK_EQUAL(map.AntennaCount(), 42u);
+
+  const std::vector<std::pair<unsigned, unsigned>> expected{
+      {0, 0}, {0, 1}, {3, 5}, {5, 3}, {40, 41}};
+  BOOST_CHECK(map.BaselineList() == expected);
+
+  std::stringstream stream;
+  map.Serialize(stream);
+  BaselineStatisticsMap copy(1);
+  copy.Unserialize(stream);
+  BOOST_CHECK_EQUAL(copy.PolarizationCount(), 2u);
+  BOOST_CHECK(copy.BaselineList() == expected);
+  const BaselineStatisticsMap& constCopy = copy;
+  BOOST_CHECK(constCopy.GetStatistics(3, 5) == map.GetStatistics(3, 5));
+  BOOST_CHECK(constCopy.GetStatistics(0, 0) == map.GetStatistics(0, 0));
+  BOOST_CHECK_EQUAL(constCopy.GetStatistics(5, 3).rfiCount[0], 4u);
+  BOOST_CHECK_THROW(constCopy.GetStatistics(1, 0), std::runtime_error);
+  BOOST_CHECK_THROW(constCopy.GetStatistics(50, 0), std::runtime_error);
+
+  copy += map;
+  BOOST_CHECK_EQUAL(copy.GetStatistics(0, 1).count[0], 4u);
+  BOOST_CHECK(copy.BaselineList() == expected);
+}
+
+BOOST_AUTO_TEST_CASE(double_stat_map) {
+  DoubleStatMap map;
+  BOOST_CHECK(map.empty());
+  map.try_emplace(2.0, 1).first->second.count[0] = 2;
+  map.try_emplace(3.0, 1).first->second.count[0] = 3;
+  map.try_emplace(1.0, 1).first->second.count[0] = 1;
+  // An existing key is not replaced
+  const std::pair<DoubleStatMap::iterator, bool> existing =
+      map.try_emplace(2.0, 1);
+  BOOST_CHECK(!existing.second);
+  BOOST_CHECK_EQUAL(existing.first->second.count[0], 2u);
+
+  BOOST_REQUIRE_EQUAL(map.size(), 3u);
+  const std::vector<double> expected_keys{1.0, 2.0, 3.0};
+  BOOST_CHECK(map.Keys() == expected_keys);
+  size_t index = 0;
+  for (DoubleStatMap::const_iterator i = map.begin(); i != map.end(); ++i) {
+    BOOST_CHECK_EQUAL(i->first, expected_keys[index]);
+    BOOST_CHECK_EQUAL(i->second.count[0], index + 1);
+    ++index;
+  }
+
+  const DoubleStatMap& constMap = map;
+  BOOST_CHECK(constMap.find(2.5) == constMap.end());
+  BOOST_CHECK_EQUAL(constMap.find(3.0)->second.count[0], 3u);
+  BOOST_CHECK_EQUAL(constMap.lower_bound(2.5)->first, 3.0);
+  BOOST_CHECK(constMap.lower_bound(3.5) == constMap.end());
+  BOOST_CHECK_EQUAL(constMap.at(1.0).count[0], 1u);
+  BOOST_CHECK_THROW(constMap.at(0.0), std::out_of_range);
+
+  map.clear();
+  BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(initialize_band_after_adding) {
+  StatisticsCollection collection(1);
+  const double frequenciesA[3] = {200, 201, 202};
+  collection.InitializeBand(0, frequenciesA, 3);
+  float reals[3] = {1.0, 2.0, 3.0}, imags[3] = {4.0, 6.0, 8.0};
+  bool isRFI[3] = {false, false, false};
+  bool isPreFlagged[3] = {false, false, false};
+  collection.Add(0, 1, 0.0, 0, 0, reals, imags, isRFI, isPreFlagged, 3, 1, 1,
+                 1);
+  // The channels of the second band are sorted before the first band, which
+  // moves the frequency statistics of the first band.
+  const double frequenciesB[3] = {100, 101, 102};
+  collection.InitializeBand(1, frequenciesB, 3);
+  collection.Add(0, 1, 0.0, 0, 0, reals, imags, isRFI, isPreFlagged, 3, 1, 1,
+                 1);
+  collection.Add(0, 1, 0.0, 1, 0, reals, imags, isRFI, isPreFlagged, 3, 1, 1,
+                 1);
+
+  const DoubleStatMap& frequencyStatistics = collection.FrequencyStatistics();
+  BOOST_REQUIRE_EQUAL(frequencyStatistics.size(), 6u);
+  for (size_t ch = 0; ch != 3; ++ch) {
+    BOOST_CHECK_EQUAL(frequencyStatistics.at(frequenciesA[ch]).count[0], 2u);
+    BOOST_CHECK_EQUAL(frequencyStatistics.at(frequenciesA[ch]).sum[0].real(),
+                      2.0 * reals[ch]);
+    BOOST_CHECK_EQUAL(frequencyStatistics.at(frequenciesB[ch]).count[0], 1u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(extract_band) {
+  const size_t nFreq = 10, nTimes = 20, nFreqA = 4, nFreqB = nFreq - nFreqA;
+  Image2DPtr realImage = Image2D::CreateUnsetImagePtr(nTimes, nFreq),
+             imagImage = Image2D::CreateUnsetImagePtr(nTimes, nFreq);
+  Mask2DPtr mask = Mask2D::CreateSetMaskPtr<false>(nTimes, nFreq);
+  for (size_t y = 0; y != nFreq; ++y) {
+    for (size_t x = 0; x != nTimes; ++x) {
+      realImage->SetValue(x, y, (x * 7 + y * 3) % 11);
+      imagImage->SetValue(x, y, (x + y * 5) % 13);
+    }
+  }
+  const Mask2DCPtr correlatorMask =
+      Mask2D::CreateSetMaskPtr<false>(nTimes, nFreq);
+  std::vector<double> frequencies(nFreq), times(nTimes);
+  for (size_t i = 0; i != nFreq; ++i) frequencies[i] = 100.0 + i;
+  for (size_t i = 0; i != nTimes; ++i) times[i] = i + 1;
+
+  StatisticsCollection full(1), split(1);
+  full.InitializeBand(0, frequencies.data(), nFreq);
+  full.AddImage(0, 1, times.data(), 0, 0, realImage, imagImage, mask,
+                correlatorMask);
+  split.InitializeBand(0, frequencies.data(), nFreqA);
+  split.InitializeBand(1, frequencies.data() + nFreqA, nFreqB);
+  split.AddImage(0, 1, times.data(), 0, 0, realImage, imagImage, mask,
+                 correlatorMask, 0, nFreqA);
+  split.AddImage(0, 1, times.data(), 1, 0, realImage, imagImage, mask,
+                 correlatorMask, nFreqA, nFreqB);
+
+  const StatisticsCollection bandA =
+      split.ExtractBand(frequencies.data(), nFreqA);
+  const StatisticsCollection bandB =
+      split.ExtractBand(frequencies.data() + nFreqA, nFreqB);
+  BOOST_CHECK_EQUAL(bandA.FrequencyStatistics().size(), nFreqA);
+  BOOST_CHECK_EQUAL(bandB.FrequencyStatistics().size(), nFreqB);
+  for (const StatisticsCollection* band : {&bandA, &bandB}) {
+    // Differences with the channel after the band are not part of the band
+    for (const auto& frequency : band->FrequencyStatistics()) {
+      const DefaultStatistics& expected =
+          full.FrequencyStatistics().at(frequency.first);
+      BOOST_CHECK_EQUAL(frequency.second.count[0], expected.count[0]);
+      BOOST_CHECK(frequency.second.sum[0] == expected.sum[0]);
+      BOOST_CHECK(frequency.second.sumP2[0] == expected.sumP2[0]);
+    }
+    BOOST_CHECK_EQUAL(band->TimeStatistics().size(), nTimes);
+  }
+  BOOST_CHECK_EQUAL(bandA.TimeStatistics().begin()->second.count[0], nFreqA);
+  BOOST_CHECK_EQUAL(bandB.TimeStatistics().begin()->second.count[0], nFreqB);
+  BOOST_CHECK_EQUAL(bandA.BaselineStatistics().GetStatistics(0, 1).count[0],
+                    nFreqA * nTimes);
+  BOOST_CHECK_EQUAL(bandB.BaselineStatistics().GetStatistics(0, 1).count[0],
+                    nFreqB * nTimes);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,94 @@
+#include "../../structures/msmetadataindex.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+const std::string kFilename = "test-metadata.aoflagger-index";
+
+MSMetaDataIndex::Contents MakeContents() {
+  MSMetaDataIndex::Contents contents;
+  contents.baselines = {{0, 0}, {0, 1}, {1, 1}};
+  contents.sequences = {MSMetaData::Sequence(0, 0, 0, 0, 3),
+                        MSMetaData::Sequence(0, 1, 1, 0, 3),
+                        MSMetaData::Sequence(1, 1, 0, 1, 2)};
+  contents.observationTimesPerSequence = {{1.0, 2.5, 4.0}, {5.0}};
+  return contents;
+}
+
+MSMetaDataIndex::Key MakeKey() {
+  MSMetaDataIndex::Key key;
+  key.path = "/data/observation.ms";
+  key.rowCount = 1234;
+  key.modificationTime = 987654321;
+  return key;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(ms_meta_data_index,
+                      *boost::unit_test::label("structures"))
+
+BOOST_AUTO_TEST_CASE(save_and_load) {
+  const MSMetaDataIndex::Contents contents = MakeContents();
+  MSMetaDataIndex::Save(kFilename, MakeKey(), contents);
+  const std::optional<MSMetaDataIndex::Contents> loaded =
+      MSMetaDataIndex::Load(kFilename, MakeKey());
+  BOOST_REQUIRE(loaded);
+  BOOST_CHECK(loaded->baselines == contents.baselines);
+  BOOST_CHECK(loaded->sequences == contents.sequences);
+  BOOST_REQUIRE_EQUAL(loaded->sequences.size(), contents.sequences.size());
+  for (size_t i = 0; i != contents.sequences.size(); ++i)
+    BOOST_CHECK_EQUAL(loaded->sequences[i].fieldId,
+                      contents.sequences[i].fieldId);
+  BOOST_CHECK(loaded->observationTimesPerSequence ==
+              contents.observationTimesPerSequence);
+  std::filesystem::remove(kFilename);
+}
+
+BOOST_AUTO_TEST_CASE(changed_table) {
+  MSMetaDataIndex::Save(kFilename, MakeKey(), MakeContents());
+  MSMetaDataIndex::Key key = MakeKey();
+  ++key.rowCount;
+  BOOST_CHECK(!MSMetaDataIndex::Load(kFilename, key));
+  key = MakeKey();
+  ++key.modificationTime;
+  BOOST_CHECK(!MSMetaDataIndex::Load(kFilename, key));
+  key = MakeKey();
+  key.path = "/data/other.ms";
+  BOOST_CHECK(!MSMetaDataIndex::Load(kFilename, key));
+  std::filesystem::remove(kFilename);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_file) {
+  BOOST_CHECK(!MSMetaDataIndex::Load("nonexisting.aoflagger-index", MakeKey()));
+
+  MSMetaDataIndex::Save(kFilename, MakeKey(), MakeContents());
+  const uintmax_t size = std::filesystem::file_size(kFilename);
+  std::filesystem::resize_file(kFilename, size - 5);
+  BOOST_CHECK(!MSMetaDataIndex::Load(kFilename, MakeKey()));
+
+  std::ofstream(kFilename) << "Not an index";
+  BOOST_CHECK(!MSMetaDataIndex::Load(kFilename, MakeKey()));
+  std::filesystem::remove(kFilename);
+}
+
+BOOST_AUTO_TEST_CASE(filename) {
+  MSMetaDataIndex::Enable("");
+  BOOST_CHECK(MSMetaDataIndex::IsEnabled());
+  BOOST_CHECK_EQUAL(MSMetaDataIndex::Filename("/data/observation.ms/"),
+                    "/data/observation.ms.aoflagger-index");
+
+  MSMetaDataIndex::Enable("/cache");
+  const std::string a = MSMetaDataIndex::Filename("/data/a/observation.ms");
+  const std::string b = MSMetaDataIndex::Filename("/data/b/observation.ms");
+  BOOST_CHECK_EQUAL(a.rfind("/cache/observation.ms-", 0), 0u);
+  BOOST_CHECK_NE(a, b);
+  BOOST_CHECK_EQUAL(MSMetaDataIndex::Filename("/data/a/observation.ms/"), a);
+
+  MSMetaDataIndex::Disable();
+  BOOST_CHECK(!MSMetaDataIndex::IsEnabled());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
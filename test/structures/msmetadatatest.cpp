@@ -0,0 +1,65 @@
+#include "../../structures/msmetadata.h"
+
+#include "test/config.h"
+
+#include <casacore/tables/Tables/ScalarColumn.h>
+#include <casacore/tables/Tables/Table.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+namespace {
+const std::string kCopyPath = "test-ms-metadata-copy.ms";
+
+/**
+ * Copies the test set, optionally with a different value in every row of
+ * the given integer column of the main table.
+ */
+void CopyTestMs(const std::string& columnName = std::string(),
+                int increment = 0) {
+  std::filesystem::remove_all(kCopyPath);
+  std::filesystem::copy(std::string(kTestMsSize), kCopyPath,
+                        std::filesystem::copy_options::recursive);
+  if (!columnName.empty()) {
+    casacore::Table table(kCopyPath, casacore::Table::Update);
+    casacore::ScalarColumn<int> column(table, columnName);
+    column.fillColumn(column(0) + increment);
+  }
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(ms_meta_data, *boost::unit_test::label("structures"))
+
+BOOST_AUTO_TEST_CASE(share_main_table_data) {
+  CopyTestMs();
+  MSMetaData source{std::string(kTestMsSize)};
+  source.InitializeMainTableData();
+  MSMetaData copy(kCopyPath);
+  BOOST_CHECK_NO_THROW(copy.ShareMainTableData(source));
+  BOOST_CHECK(copy.SharesMainTableData(source));
+  std::filesystem::remove_all(kCopyPath);
+}
+
+BOOST_AUTO_TEST_CASE(share_main_table_data_different_spectral_window) {
+  CopyTestMs("DATA_DESC_ID", 1);
+  MSMetaData source{std::string(kTestMsSize)};
+  source.InitializeMainTableData();
+  MSMetaData copy(kCopyPath);
+  BOOST_CHECK_THROW(copy.ShareMainTableData(source), std::runtime_error);
+  BOOST_CHECK(!copy.SharesMainTableData(source));
+  std::filesystem::remove_all(kCopyPath);
+}
+
+BOOST_AUTO_TEST_CASE(share_main_table_data_different_field) {
+  CopyTestMs("FIELD_ID", 1);
+  MSMetaData source{std::string(kTestMsSize)};
+  source.InitializeMainTableData();
+  MSMetaData copy(kCopyPath);
+  BOOST_CHECK_THROW(copy.ShareMainTableData(source), std::runtime_error);
+  std::filesystem::remove_all(kCopyPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
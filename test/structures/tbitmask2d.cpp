@@ -0,0 +1,149 @@
+#include "../../structures/bitmask2d.h"
+#include "../../structures/mask2d.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(bitmask2d, *boost::unit_test::label("structures"))
+
+namespace {
+
+/**
+ * Makes a mask with a pattern that is irregular enough to catch errors in
+ * the bit and word arithmetic.
+ */
+Mask2D MakePattern(size_t width, size_t height, size_t seed) {
+  Mask2D mask = Mask2D::MakeUnsetMask(width, height);
+  for (size_t y = 0; y != height; ++y) {
+    for (size_t x = 0; x != width; ++x)
+      mask.SetValue(x, y, ((x * 7 + y * 13 + seed) % 11) < 3);
+  }
+  return mask;
+}
+
+/**
+ * Straightforward dilation that flags each value that is at most @p size
+ * values away from a flagged value in the given direction.
+ */
+Mask2D ReferenceDilation(const Mask2D& input, size_t size, bool vertical) {
+  Mask2D output = Mask2D::MakeSetMask<false>(input.Width(), input.Height());
+  for (size_t y = 0; y != input.Height(); ++y) {
+    for (size_t x = 0; x != input.Width(); ++x) {
+      if (input.Value(x, y)) {
+        const size_t end = vertical ? input.Height() : input.Width();
+        const size_t pos = vertical ? y : x;
+        const size_t first = pos > size ? pos - size : 0;
+        const size_t last = std::min(pos + size + 1, end);
+        for (size_t i = first; i != last; ++i) {
+          if (vertical)
+            output.SetValue(x, i, true);
+          else
+            output.SetValue(i, y, true);
+        }
+      }
+    }
+  }
+  return output;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(empty) {
+  const BitMask2D mask;
+  BOOST_CHECK_EQUAL(mask.Width(), 0);
+  BOOST_CHECK_EQUAL(mask.Height(), 0);
+  BOOST_CHECK(mask.AllFalse());
+  BOOST_CHECK_EQUAL(mask.GetCount<true>(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(set_and_get) {
+  BitMask2D mask(130, 3);
+  BOOST_CHECK_EQUAL(mask.WordsPerRow(), 3);
+  BOOST_CHECK(mask.AllFalse());
+  mask.SetValue(0, 0, true);
+  mask.SetValue(63, 1, true);
+  mask.SetValue(64, 1, true);
+  mask.SetValue(129, 2, true);
+  BOOST_CHECK(mask.Value(0, 0));
+  BOOST_CHECK(!mask.Value(1, 0));
+  BOOST_CHECK(mask.Value(63, 1));
+  BOOST_CHECK(mask.Value(64, 1));
+  BOOST_CHECK(mask.Value(129, 2));
+  BOOST_CHECK(!mask.Value(128, 2));
+  BOOST_CHECK_EQUAL(mask.RowCount(0), 1);
+  BOOST_CHECK_EQUAL(mask.RowCount(1), 2);
+  BOOST_CHECK_EQUAL(mask.GetCount<true>(), 4);
+  BOOST_CHECK_EQUAL(mask.GetCount<false>(), 130 * 3 - 4);
+  mask.SetValue(64, 1, false);
+  BOOST_CHECK(!mask.Value(64, 1));
+  BOOST_CHECK(mask.Value(63, 1));
+}
+
+BOOST_AUTO_TEST_CASE(conversion) {
+  for (size_t width : {1, 7, 8, 9, 63, 64, 65, 200}) {
+    const Mask2D mask = MakePattern(width, 5, width);
+    const BitMask2D bitMask(mask);
+    BOOST_CHECK(bitMask.ToMask2D() == mask);
+    BOOST_CHECK_EQUAL(bitMask.GetCount<true>(), mask.GetCount<true>());
+    for (size_t y = 0; y != mask.Height(); ++y) {
+      for (size_t x = 0; x != width; ++x)
+        BOOST_CHECK_EQUAL(bitMask.Value(x, y), mask.Value(x, y));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(join_intersect_invert) {
+  const Mask2D a = MakePattern(100, 4, 0), b = MakePattern(100, 4, 5);
+
+  Mask2D expected = a;
+  expected.Join(b);
+  BitMask2D result(a);
+  result.Join(BitMask2D(b));
+  BOOST_CHECK(result.ToMask2D() == expected);
+
+  expected = a;
+  expected.Intersect(b);
+  result = BitMask2D(a);
+  result.Intersect(BitMask2D(b));
+  BOOST_CHECK(result.ToMask2D() == expected);
+
+  expected = a;
+  expected.Invert();
+  result = BitMask2D(a);
+  result.Invert();
+  BOOST_CHECK(result.ToMask2D() == expected);
+  // The padding bits should not be counted
+  BOOST_CHECK_EQUAL(result.GetCount<true>(), expected.GetCount<true>());
+
+  result.SetAll<true>();
+  BOOST_CHECK_EQUAL(result.GetCount<true>(), 400);
+  result.SetAll<false>();
+  BOOST_CHECK(result.AllFalse());
+}
+
+BOOST_AUTO_TEST_CASE(dilation) {
+  for (size_t width : {1, 10, 64, 70, 150}) {
+    Mask2D sparse = Mask2D::MakeSetMask<false>(width, 9);
+    sparse.SetValue(0, 0, true);
+    sparse.SetValue(width - 1, 8, true);
+    sparse.SetValue(width / 2, 4, true);
+    const std::vector<Mask2D> inputs{MakePattern(width, 9, width), sparse};
+    for (const Mask2D& input : inputs) {
+      for (size_t size : {0, 1, 2, 3, 5, 8, 63, 64, 65, 200}) {
+        BitMask2D horizontal(input);
+        horizontal.DilateHorizontally(size);
+        BOOST_CHECK(horizontal.ToMask2D() ==
+                    ReferenceDilation(input, size, false));
+
+        BitMask2D vertical(input);
+        vertical.DilateVertically(size);
+        BOOST_CHECK(vertical.ToMask2D() ==
+                    ReferenceDilation(input, size, true));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
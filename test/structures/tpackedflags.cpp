@@ -0,0 +1,40 @@
+#include "structures/packedflags.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(packed_flags, *boost::unit_test::label("structures"))
+
+BOOST_AUTO_TEST_CASE(packed_size) {
+  BOOST_CHECK_EQUAL(PackedFlagsSize(0), 0u);
+  BOOST_CHECK_EQUAL(PackedFlagsSize(1), 1u);
+  BOOST_CHECK_EQUAL(PackedFlagsSize(8), 1u);
+  BOOST_CHECK_EQUAL(PackedFlagsSize(9), 2u);
+  BOOST_CHECK_EQUAL(PackedFlagsSize(256), 32u);
+}
+
+BOOST_AUTO_TEST_CASE(bit_layout) {
+  const bool flags[10] = {true,  false, false, true,  false,
+                          false, false, true,  false, true};
+  unsigned char packed[2] = {0xFF, 0xFF};
+  PackFlags(flags, 10, packed);
+  BOOST_CHECK_EQUAL(packed[0], 0x89);
+  // Unused bits should be zero
+  BOOST_CHECK_EQUAL(packed[1], 0x02);
+}
+
+BOOST_AUTO_TEST_CASE(round_trip) {
+  for (size_t count = 0; count != 70; ++count) {
+    const std::unique_ptr<bool[]> input(new bool[count]);
+    for (size_t i = 0; i != count; ++i) input[i] = (i * 7 + count) % 3 == 0;
+    std::vector<unsigned char> packed(PackedFlagsSize(count));
+    PackFlags(input.get(), count, packed.data());
+    const std::unique_ptr<bool[]> output(new bool[count]);
+    UnpackFlags(packed.data(), count, output.get());
+    for (size_t i = 0; i != count; ++i) BOOST_CHECK_EQUAL(output[i], input[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,154 @@
+#include "../../util/memoryplanner.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+constexpr uint64_t kGiB = 1024ul * 1024ul * 1024ul;
+
+void WriteFile(const std::filesystem::path& path, const std::string& content) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path) << content;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(memory_planner, *boost::unit_test::label("util"))
+
+BOOST_AUTO_TEST_CASE(parse_limit) {
+  const uint64_t available = 64 * kGiB;
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("16G", available), 16 * kGiB);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("16 GB", available), 16 * kGiB);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("16gib", available), 16 * kGiB);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("1.5T", available),
+                    1536 * kGiB);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("512M", available), kGiB / 2);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("2048k", available),
+                    2ul * 1024ul * 1024ul);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("100b", available), 100u);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("25%", available), 16 * kGiB);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("0.5", available), 32 * kGiB);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ParseLimit("1", available), available);
+
+  BOOST_CHECK_THROW(MemoryPlanner::ParseLimit("", available),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(MemoryPlanner::ParseLimit("G", available),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(MemoryPlanner::ParseLimit("16", available),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(MemoryPlanner::ParseLimit("16Q", available),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(MemoryPlanner::ParseLimit("0G", available),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(MemoryPlanner::ParseLimit("-1G", available),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(cgroup_limit) {
+  const std::filesystem::path root =
+      std::filesystem::temp_directory_path() / "aoflagger-cgroup-test";
+  std::filesystem::remove_all(root);
+
+  // Missing files: no limit
+  BOOST_CHECK(!MemoryPlanner::CGroupLimit((root / "none").string(),
+                                          (root / "fs").string()));
+
+  // cgroup v2, where the parent has the lowest limit
+  WriteFile(root / "v2" / "cgroup", "0::/job/step\n");
+  WriteFile(root / "v2fs" / "memory.max", "max\n");
+  WriteFile(root / "v2fs" / "job" / "memory.max", "4000000000\n");
+  WriteFile(root / "v2fs" / "job" / "step" / "memory.max", "max\n");
+  std::optional<uint64_t> limit = MemoryPlanner::CGroupLimit(
+      (root / "v2" / "cgroup").string(), (root / "v2fs").string());
+  BOOST_REQUIRE(limit);
+  BOOST_CHECK_EQUAL(*limit, 4000000000u);
+
+  // cgroup v1, including the "unlimited" value
+  WriteFile(root / "v1" / "cgroup",
+            "12:cpu,cpuacct:/slurm\n4:memory:/slurm/job\n");
+  WriteFile(root / "v1fs" / "memory" / "memory.limit_in_bytes",
+            "9223372036854771712\n");
+  WriteFile(root / "v1fs" / "memory" / "slurm" / "job" /
+                "memory.limit_in_bytes",
+            "2000000000\n");
+  limit = MemoryPlanner::CGroupLimit((root / "v1" / "cgroup").string(),
+                                     (root / "v1fs").string());
+  BOOST_REQUIRE(limit);
+  BOOST_CHECK_EQUAL(*limit, 2000000000u);
+
+  WriteFile(root / "v1" / "cgroup", "4:memory:/\n");
+  BOOST_CHECK(!MemoryPlanner::CGroupLimit((root / "v1" / "cgroup").string(),
+                                          (root / "v1fs").string()));
+
+  std::filesystem::remove_all(root);
+}
+
+BOOST_AUTO_TEST_CASE(budget) {
+  const uint64_t available = MemoryPlanner::AvailableMemory();
+  BOOST_CHECK_GT(available, 0u);
+  BOOST_CHECK(!MemoryPlanner::HasLimit());
+  BOOST_CHECK_EQUAL(MemoryPlanner::Budget(), available);
+
+  MemoryPlanner::SetLimit(std::string("50%"));
+  BOOST_CHECK(MemoryPlanner::HasLimit());
+  BOOST_CHECK_EQUAL(MemoryPlanner::Budget(), available / 2);
+
+  // A limit can not increase the budget
+  MemoryPlanner::SetLimit(available * 2);
+  BOOST_CHECK_EQUAL(MemoryPlanner::Budget(), available);
+
+  MemoryPlanner::SetLimit(uint64_t(0));
+  BOOST_CHECK(!MemoryPlanner::HasLimit());
+}
+
+BOOST_AUTO_TEST_CASE(chunk_size) {
+  // Fits in memory: no chunking
+  BOOST_CHECK_EQUAL(MemoryPlanner::ChunkSize(10 * kGiB, 1000, 64 * kGiB), 0u);
+  // Twice the size of the data is required
+  const size_t chunkSize = MemoryPlanner::ChunkSize(64 * kGiB, 1000, 64 * kGiB);
+  BOOST_CHECK_EQUAL(chunkSize, 499u);
+  BOOST_CHECK(MemoryPlanner::FitsInMemory(64 * kGiB * chunkSize / 1000,
+                                          64 * kGiB));
+  // Chunks would become too small
+  BOOST_CHECK_EQUAL(MemoryPlanner::ChunkSize(1024 * kGiB, 1000, 64 * kGiB),
+                    0u);
+  BOOST_CHECK_EQUAL(MemoryPlanner::ChunkSize(64 * kGiB, 0, 64 * kGiB), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(plan_processing) {
+  // Everything fits
+  MemoryPlanner::ProcessingPlan plan =
+      MemoryPlanner::PlanProcessing(kGiB, 10 * kGiB, 8, 8, 16, 100 * kGiB);
+  BOOST_CHECK_EQUAL(plan.threadCount, 8u);
+  BOOST_CHECK_EQUAL(plan.maxBufferSize, 16u);
+
+  // The buffer is reduced first: 8 threads use 24 GiB, leaving 10 GiB
+  plan = MemoryPlanner::PlanProcessing(kGiB, 10 * kGiB, 8, 8, 16, 44 * kGiB);
+  BOOST_CHECK_EQUAL(plan.threadCount, 8u);
+  BOOST_CHECK_EQUAL(plan.maxBufferSize, 10u);
+
+  // Then the threads: 4 threads with a buffer of 4 use exactly 16 GiB
+  plan = MemoryPlanner::PlanProcessing(kGiB, 10 * kGiB, 8, 8, 16, 26 * kGiB);
+  BOOST_CHECK_EQUAL(plan.threadCount, 4u);
+  BOOST_CHECK_EQUAL(plan.maxBufferSize, 4u);
+
+  // At least one thread is used
+  plan = MemoryPlanner::PlanProcessing(kGiB, 10 * kGiB, 8, 8, 16, kGiB);
+  BOOST_CHECK_EQUAL(plan.threadCount, 1u);
+  BOOST_CHECK_EQUAL(plan.maxBufferSize, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(interval_count) {
+  BOOST_CHECK_EQUAL(MemoryPlanner::IntervalCount(1e6, 1000, 16 * kGiB), 1u);
+  BOOST_CHECK_EQUAL(
+      MemoryPlanner::IntervalCount(3.0 * kGiB, 100000, 16 * kGiB), 3u);
+  // Intervals have at least 8 samples
+  BOOST_CHECK_EQUAL(MemoryPlanner::IntervalCount(3.0 * kGiB, 16, 16 * kGiB),
+                    2u);
+  BOOST_CHECK_EQUAL(MemoryPlanner::IntervalCount(3.0 * kGiB, 4, 16 * kGiB),
+                    1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,194 @@
+#include "memoryplanner.h"
+
+#include "logger.h"
+
+#include <aocommon/system.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+std::atomic<uint64_t> MemoryPlanner::_limit(0);
+
+namespace {
+// Values this large are used by cgroup v1 to indicate that there is no limit.
+constexpr uint64_t kUnlimitedCGroupValue = uint64_t(1) << 60;
+
+std::optional<uint64_t> ReadCGroupValue(const std::string& filename) {
+  std::ifstream file(filename);
+  std::string value;
+  if (!(file >> value) || value == "max") return {};
+  try {
+    const uint64_t limit = std::stoull(value);
+    if (limit >= kUnlimitedCGroupValue) return {};
+    return limit;
+  } catch (std::exception&) {
+    return {};
+  }
+}
+
+// Returns the lowest limit of the cgroup at @p path and its parents. Limits
+// of a parent also apply to its children.
+std::optional<uint64_t> ReadHierarchyLimit(const std::string& root,
+                                           std::string path,
+                                           const std::string& name) {
+  std::optional<uint64_t> result;
+  while (true) {
+    if (!path.empty() && path.back() == '/') path.pop_back();
+    const std::optional<uint64_t> limit =
+        ReadCGroupValue(root + path + "/" + name);
+    if (limit && (!result || *limit < *result)) result = limit;
+    if (path.empty()) break;
+    path = path.substr(0, path.rfind('/'));
+  }
+  return result;
+}
+}  // namespace
+
+uint64_t MemoryPlanner::AvailableMemory() {
+  static const uint64_t available = [] {
+    const uint64_t system = aocommon::system::TotalMemory();
+    const std::optional<uint64_t> cgroupLimit = CGroupLimit();
+    if (cgroupLimit && *cgroupLimit < system) {
+      Logger::Debug << "Memory is limited by cgroup to "
+                    << (*cgroupLimit / 1000000) << " MB (system has "
+                    << (system / 1000000) << " MB).\n";
+      return *cgroupLimit;
+    }
+    return system;
+  }();
+  return available;
+}
+
+uint64_t MemoryPlanner::Budget() {
+  const uint64_t limit = _limit.load();
+  const uint64_t available = AvailableMemory();
+  return limit == 0 ? available : std::min(limit, available);
+}
+
+void MemoryPlanner::SetLimit(const std::string& limit) {
+  SetLimit(ParseLimit(limit, AvailableMemory()));
+}
+
+void MemoryPlanner::SetLimit(uint64_t limit) {
+  _limit.store(limit);
+  if (limit != 0)
+    Logger::Debug << "Memory limit set to " << (limit / 1000000) << " MB.\n";
+}
+
+uint64_t MemoryPlanner::ParseLimit(const std::string& limit,
+                                   uint64_t availableMemory) {
+  size_t unitStart = 0;
+  double value;
+  try {
+    value = std::stod(limit, &unitStart);
+  } catch (std::exception&) {
+    throw std::runtime_error("Invalid memory limit: '" + limit + "'");
+  }
+  std::string unit;
+  for (const char c : limit.substr(unitStart))
+    if (!std::isspace(static_cast<unsigned char>(c)))
+      unit.push_back(std::tolower(static_cast<unsigned char>(c)));
+  // "MB" and "MiB" mean the same
+  if (unit.size() == 3 && unit[1] == 'i') unit.erase(1, 1);
+  if (unit.size() == 2 && unit[1] == 'b') unit.pop_back();
+
+  double bytes;
+  if (unit == "%") {
+    bytes = value * 0.01 * availableMemory;
+  } else if (unit.empty()) {
+    if (value > 1.0)
+      throw std::runtime_error("Memory limit '" + limit +
+                               "' needs a unit, e.g. '" + limit + "G'");
+    bytes = value * availableMemory;
+  } else {
+    const std::string units = "bkmgt";
+    const size_t power = units.find(unit);
+    if (unit.size() != 1 || power == std::string::npos)
+      throw std::runtime_error("Invalid unit in memory limit: '" + limit +
+                               "'");
+    bytes = value * std::pow(1024.0, double(power));
+  }
+  if (!(bytes >= 1.0))
+    throw std::runtime_error("Memory limit should be positive: '" + limit +
+                             "'");
+  return uint64_t(bytes);
+}
+
+std::optional<uint64_t> MemoryPlanner::CGroupLimit(
+    const std::string& cgroupFile, const std::string& cgroupRoot) {
+  std::ifstream file(cgroupFile);
+  std::optional<uint64_t> result;
+  std::string line;
+  // Every line has the format "hierarchy-ID:controller-list:cgroup-path".
+  // cgroup v2 has a single line with an empty controller list.
+  while (std::getline(file, line)) {
+    const size_t first = line.find(':');
+    const size_t second =
+        first == std::string::npos ? first : line.find(':', first + 1);
+    if (second == std::string::npos) continue;
+    const std::string controllers = line.substr(first + 1, second - first - 1);
+    const std::string path = line.substr(second + 1);
+    std::optional<uint64_t> limit;
+    if (controllers.empty()) {
+      limit = ReadHierarchyLimit(cgroupRoot, path, "memory.max");
+    } else if (("," + controllers + ",").find(",memory,") !=
+               std::string::npos) {
+      limit = ReadHierarchyLimit(cgroupRoot + "/memory", path,
+                                 "memory.limit_in_bytes");
+    }
+    if (limit && (!result || *limit < *result)) result = limit;
+  }
+  return result;
+}
+
+size_t MemoryPlanner::ChunkSize(uint64_t dataSize, size_t timestepCount,
+                                uint64_t budget) {
+  if (timestepCount == 0 || FitsInMemory(dataSize, budget)) return 0;
+  // Largest number of timesteps for which the data fits in memory
+  const size_t chunkSize =
+      size_t(static_cast<long double>(timestepCount) * (budget - 1) /
+             (2.0L * dataSize));
+  return chunkSize < kMinChunkSize ? 0 : chunkSize;
+}
+
+MemoryPlanner::ProcessingPlan MemoryPlanner::PlanProcessing(
+    uint64_t baselineSize, uint64_t residentSize, size_t threadCount,
+    size_t minBufferSize, size_t maxBufferSize, uint64_t budget) {
+  const uint64_t available = budget > residentSize ? budget - residentSize : 0;
+  const uint64_t threadSize = 3 * baselineSize;
+  const auto required = [&](size_t threads, size_t bufferSize) {
+    return threads * threadSize + bufferSize * baselineSize;
+  };
+  if (baselineSize == 0 || required(threadCount, maxBufferSize) <= available)
+    return ProcessingPlan{threadCount, maxBufferSize};
+  if (required(threadCount, minBufferSize) <= available)
+    return ProcessingPlan{
+        threadCount, size_t((available - threadCount * threadSize) /
+                            baselineSize)};
+
+  // The buffer recommendations are proportional to the number of threads or
+  // constant, so they are scaled along with the number of threads.
+  size_t threads = threadCount;
+  size_t bufferSize = minBufferSize;
+  while (threads > 1 && required(threads, bufferSize) > available) {
+    --threads;
+    bufferSize = std::max<size_t>(
+        1, (minBufferSize * threads + threadCount - 1) / threadCount);
+  }
+  return ProcessingPlan{threads, bufferSize};
+}
+
+size_t MemoryPlanner::ReorderBufferSize(uint64_t budget) {
+  return std::min<uint64_t>(budget / 10, 1024l * 1024l * 1024l);
+}
+
+size_t MemoryPlanner::IntervalCount(double imageSize, size_t sampleCount,
+                                    uint64_t budget) {
+  size_t count = std::ceil(imageSize / (budget / 16.0));
+  if (count < 1) count = 1;
+  if (count * 8 > sampleCount) count = std::max<size_t>(1, sampleCount / 8);
+  return count;
+}
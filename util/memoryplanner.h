@@ -0,0 +1,141 @@
+#ifndef MEMORY_PLANNER_H
+#define MEMORY_PLANNER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/**
+ * Decides how the memory that aoflagger may use is divided over the data
+ * that is read, the processing threads and the buffers of the readers.
+ *
+ * The available memory ("the budget") is the memory of the system, limited by
+ * the memory limit of the control group (cgroup) in which the process runs,
+ * and by the limit that is set with SetLimit() (the -memory-limit option).
+ * Jobs on a cluster are often limited by a cgroup, which the total system
+ * memory does not show.
+ *
+ * All planning functions take the budget as a parameter, such that they can
+ * be tested, and default to Budget().
+ */
+class MemoryPlanner {
+ public:
+  /**
+   * Smallest chunk (in number of timesteps) that is automatically selected.
+   * Smaller chunks give the flagger too little information.
+   */
+  static constexpr size_t kMinChunkSize = 100;
+
+  /**
+   * Memory in bytes that aoflagger may use.
+   */
+  static uint64_t Budget();
+
+  /**
+   * Memory of the system, limited by the cgroup limit, but not by the limit
+   * that was set with SetLimit().
+   */
+  static uint64_t AvailableMemory();
+
+  /**
+   * Sets the limit from a string as given on the command line, see
+   * ParseLimit(). Throws std::runtime_error when the limit is invalid.
+   */
+  static void SetLimit(const std::string& limit);
+
+  /**
+   * Sets the limit in bytes. Zero removes the limit.
+   */
+  static void SetLimit(uint64_t limit);
+
+  /**
+   * True when a limit was set with SetLimit(). Chunks are only selected
+   * automatically when this is the case, because chunking changes the result
+   * slightly.
+   */
+  static bool HasLimit() { return _limit.load() != 0; }
+
+  /**
+   * Parses a memory limit. This is either an absolute size with a unit
+   * (e.g. "16G", "500MB", "1.5TiB"; units are powers of 1024), a percentage
+   * of the available memory (e.g. "50%") or a fraction of the available
+   * memory (e.g. "0.5").
+   */
+  static uint64_t ParseLimit(const std::string& limit,
+                             uint64_t availableMemory);
+
+  /**
+   * Memory limit of the cgroup of this process, or an empty optional when
+   * there is no limit. Both cgroup v1 and v2 are supported.
+   */
+  static std::optional<uint64_t> CGroupLimit() {
+    return CGroupLimit("/proc/self/cgroup", "/sys/fs/cgroup");
+  }
+
+  /**
+   * Like CGroupLimit(), with the paths of the cgroup file of the process
+   * (normally /proc/self/cgroup) and of the cgroup file system.
+   */
+  static std::optional<uint64_t> CGroupLimit(const std::string& cgroupFile,
+                                             const std::string& cgroupRoot);
+
+  /**
+   * True when a data set of the given size can be read in memory. Memory read
+   * mode requires about twice the size of the data.
+   */
+  static bool FitsInMemory(uint64_t dataSize, uint64_t budget = Budget()) {
+    return dataSize * 2 < budget;
+  }
+
+  /**
+   * Number of timesteps per chunk such that every chunk fits in memory.
+   * Returns 0 when the data does not need chunking, or when the chunks would
+   * become smaller than kMinChunkSize; it is then better to read the data
+   * with the reordering reader.
+   */
+  static size_t ChunkSize(uint64_t dataSize, size_t timestepCount,
+                          uint64_t budget = Budget());
+
+  struct ProcessingPlan {
+    size_t threadCount;
+    size_t maxBufferSize;
+  };
+
+  /**
+   * Selects the number of processing threads and the maximum number of
+   * baselines that the reader buffers, such that they fit in the budget that
+   * remains after the reader took @p residentSize. Each thread is assumed to
+   * make three copies of a baseline. The buffer is reduced first, down to
+   * @p minBufferSize, before the number of threads is reduced.
+   * @param baselineSize Size in bytes of the data of one baseline.
+   * @param minBufferSize,maxBufferSize Buffer sizes (in baselines) that the
+   * reader recommends for @p threadCount threads.
+   */
+  static ProcessingPlan PlanProcessing(uint64_t baselineSize,
+                                       uint64_t residentSize,
+                                       size_t threadCount, size_t minBufferSize,
+                                       size_t maxBufferSize,
+                                       uint64_t budget = Budget());
+
+  /**
+   * Size of the buffer that is used while reordering a measurement set.
+   */
+  static size_t ReorderBufferSize(uint64_t budget = Budget());
+
+  /**
+   * Number of intervals in which a single image of @p imageSize bytes with
+   * @p sampleCount samples is split, such that an interval uses at most a
+   * sixteenth of the budget. Intervals have at least 8 samples. The count
+   * does not depend on the number of threads, because the flags depend on how
+   * the image is split.
+   */
+  static size_t IntervalCount(double imageSize, size_t sampleCount,
+                              uint64_t budget = Budget());
+
+ private:
+  static std::atomic<uint64_t> _limit;
+};
+
+#endif